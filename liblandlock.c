@@ -1,20 +1,50 @@
 #include "liblandlock.h"
 
+#include <arpa/inet.h>
+#include <dlfcn.h>
+#include <elf.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <dirent.h>
 #include <sys/stat.h>
 #include <sys/socket.h>
+#include <sys/sysmacros.h>
+#include <signal.h>
 #include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
 #include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #if defined(__GLIBC__)
 #include <linux/prctl.h>
 #endif
 
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/futex.h>
 #include <linux/netlink.h>
+#include <linux/seccomp.h>
+#ifdef __NR_openat2
+#include <linux/openat2.h>
+#endif
 
 #ifndef NETLINK_SOCKET
 #ifdef NETLINK_AUDIT
@@ -54,6 +84,111 @@ static inline int landlock_restrict_self(const int ruleset_fd,
 }
 #endif
 
+/*
+ * Syscall backend: the running kernel unless another backend is installed.
+ */
+
+static int ll_kernel_create_ruleset(void *const ctx, const struct landlock_ruleset_attr *const attr,
+                                    const size_t size, const __u32 flags)
+{
+    (void)ctx;
+    return landlock_create_ruleset(attr, size, flags);
+}
+
+static int ll_kernel_add_rule(void *const ctx, const int ruleset_fd, const enum landlock_rule_type rule_type,
+                              const void *const rule_attr, const __u32 flags)
+{
+    (void)ctx;
+    return landlock_add_rule(ruleset_fd, rule_type, rule_attr, flags);
+}
+
+static int ll_kernel_restrict_self(void *const ctx, const int ruleset_fd, const __u32 flags)
+{
+    (void)ctx;
+    return landlock_restrict_self(ruleset_fd, flags);
+}
+
+static int ll_kernel_set_no_new_privs(void *const ctx)
+{
+    (void)ctx;
+    return prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0);
+}
+
+static int ll_kernel_audit_supported(void *const ctx);
+
+static const ll_backend_t ll_kernel_backend = {
+    .ctx = NULL,
+    .create_ruleset = ll_kernel_create_ruleset,
+    .add_rule = ll_kernel_add_rule,
+    .restrict_self = ll_kernel_restrict_self,
+    .set_no_new_privs = ll_kernel_set_no_new_privs,
+    .audit_supported = ll_kernel_audit_supported,
+};
+
+static const ll_backend_t *ll_backend_installed;
+
+const ll_backend_t *ll_backend_get(void)
+{
+    const ll_backend_t *backend = __atomic_load_n(&ll_backend_installed, __ATOMIC_ACQUIRE);
+#ifdef LL_BACKEND_FAKE_ABI
+    if (!backend)
+    {
+        static ll_fake_kernel_t *fake;
+        ll_fake_kernel_t *created = NULL;
+        if (!__atomic_load_n(&fake, __ATOMIC_ACQUIRE) && ll_fake_kernel_create(LL_BACKEND_FAKE_ABI, &created) == LL_ERROR_OK)
+        {
+            ll_fake_kernel_t *expected = NULL;
+            if (!__atomic_compare_exchange_n(&fake, &expected, created, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            {
+                ll_fake_kernel_free(created);
+            }
+        }
+        ll_fake_kernel_t *const current = __atomic_load_n(&fake, __ATOMIC_ACQUIRE);
+        if (current)
+        {
+            return ll_fake_kernel_backend(current);
+        }
+    }
+#endif
+    return backend ? backend : &ll_kernel_backend;
+}
+
+void ll_backend_set(const ll_backend_t *const backend)
+{
+    __atomic_store_n(&ll_backend_installed, backend, __ATOMIC_RELEASE);
+}
+
+static int ll_sys_create_ruleset(const struct landlock_ruleset_attr *const attr, const size_t size, const __u32 flags)
+{
+    const ll_backend_t *const backend = ll_backend_get();
+    return backend->create_ruleset(backend->ctx, attr, size, flags);
+}
+
+static int ll_sys_add_rule(const int ruleset_fd, const enum landlock_rule_type rule_type, const void *const rule_attr,
+                           const __u32 flags)
+{
+    const ll_backend_t *const backend = ll_backend_get();
+    return backend->add_rule(backend->ctx, ruleset_fd, rule_type, rule_attr, flags);
+}
+
+static int ll_sys_restrict_self(const int ruleset_fd, const __u32 flags)
+{
+    const ll_backend_t *const backend = ll_backend_get();
+    return backend->restrict_self(backend->ctx, ruleset_fd, flags);
+}
+
+static int ll_sys_set_no_new_privs(void)
+{
+    const ll_backend_t *const backend = ll_backend_get();
+    return backend->set_no_new_privs(backend->ctx);
+}
+
+static int ll_audit_supported(void)
+{
+    const ll_backend_t *const backend = ll_backend_get();
+    return backend->audit_supported(backend->ctx);
+}
+
 struct ll_ruleset
 {
     int ruleset_fd;
@@ -153,6 +288,22 @@ const char *ll_error_string(const ll_error_t error)
         return "Required syscall is not available.";
     case LL_ERROR_RULESET_INCOMPATIBLE:
         return "Ruleset cannot be created due to compatibility checks.";
+    case LL_ERROR_AUDIT_UNAVAILABLE:
+        return "The audit subsystem cannot be read.";
+    case LL_ERROR_POLICY_SYNTAX:
+        return "Policy text could not be parsed.";
+    case LL_ERROR_BROKER_NOT_FOUND:
+        return "The ruleset broker has no ruleset under the requested name.";
+    case LL_ERROR_BROKER_PROTOCOL:
+        return "Malformed or unexpected ruleset broker message.";
+    case LL_ERROR_PLUGIN_EXITED:
+        return "The plugin helper process exited or was killed.";
+    case LL_ERROR_TIMEOUT:
+        return "A path could not be opened before its deadline and was skipped.";
+    case LL_ERROR_CANCELED:
+        return "The operation was cancelled before it completed.";
+    case LL_ERROR_BROKER_DENIED:
+        return "The ruleset broker does not serve the requesting peer's user.";
     case LL_ERROR_RULESET_CREATE_DISABLED:
         return "Landlock is supported by the kernel but disabled at boot time.";
     case LL_ERROR_RULESET_CREATE_INVALID:
@@ -208,7 +359,7 @@ static ll_abi_t ll_resolve_abi(const ll_abi_t abi)
 {
     if (abi == LL_ABI_LATEST)
     {
-        const int ret = landlock_create_ruleset(NULL, 0, LANDLOCK_CREATE_RULESET_VERSION);
+        const int ret = ll_sys_create_ruleset(NULL, 0, LANDLOCK_CREATE_RULESET_VERSION);
         if (ret < 0)
         {
             /* Fallback for kernels without Landlock support (ABI v1 baseline). */
@@ -279,8 +430,9 @@ static __u32 ll_supported_restrict_self_flags(const ll_abi_t abi)
            LANDLOCK_RESTRICT_SELF_LOG_SUBDOMAINS_OFF;
 }
 
-static int ll_audit_supported(void)
+static int ll_kernel_audit_supported(void *const ctx)
 {
+    (void)ctx;
 #ifdef NETLINK_SOCKET
     const int audit_fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_SOCKET);
     if (audit_fd < 0)
@@ -305,7 +457,7 @@ ll_error_t ll_get_abi_version(ll_abi_t *const out_abi)
         return LL_ERROR_INVALID_ARGUMENT;
     }
 
-    const int ret = landlock_create_ruleset(NULL, 0, LANDLOCK_CREATE_RULESET_VERSION);
+    const int ret = ll_sys_create_ruleset(NULL, 0, LANDLOCK_CREATE_RULESET_VERSION);
     if (ret < 0)
     {
         return ll_error_from_create_ruleset_errno(errno);
@@ -322,7 +474,7 @@ ll_error_t ll_get_errata(int *const out_errata)
         return LL_ERROR_INVALID_ARGUMENT;
     }
 
-    const int ret = landlock_create_ruleset(NULL, 0, LANDLOCK_CREATE_RULESET_ERRATA);
+    const int ret = ll_sys_create_ruleset(NULL, 0, LANDLOCK_CREATE_RULESET_ERRATA);
     if (ret < 0)
     {
         return ll_error_from_create_ruleset_errno(errno);
@@ -359,7 +511,7 @@ ll_ruleset_result_t ll_ruleset_create_result(const ll_ruleset_attr_t ruleset_att
     ll_ruleset_result_t out = {.err = LL_ERROR_OK, .ruleset = NULL};
 
     const ll_abi_t policy_abi = ll_resolve_abi(ruleset_attr.abi);
-    int kernel_abi = landlock_create_ruleset(NULL, 0, LANDLOCK_CREATE_RULESET_VERSION);
+    int kernel_abi = ll_sys_create_ruleset(NULL, 0, LANDLOCK_CREATE_RULESET_VERSION);
     if (kernel_abi < 0)
     {
         out.err = ll_error_from_create_ruleset_errno(errno);
@@ -392,7 +544,7 @@ ll_ruleset_result_t ll_ruleset_create_result(const ll_ruleset_attr_t ruleset_att
     attr.scoped &= scope_mask;
 
     const int create_flags = (int)(ruleset_attr.flags);
-    const int ruleset_fd = landlock_create_ruleset(&attr, sizeof(attr), create_flags);
+    const int ruleset_fd = ll_sys_create_ruleset(&attr, sizeof(attr), create_flags);
     if (ruleset_fd < 0)
     {
         out.err = ll_error_from_create_ruleset_errno(errno);
@@ -455,6 +607,19 @@ void ll_ruleset_close(ll_ruleset_t *const ruleset)
     free(ruleset);
 }
 
+/* Library-only flags for the path rule APIs, never passed to the kernel. */
+#define LL_ADD_RULE_LIBRARY_FLAGS (LL_ADD_RULE_TRIM_DIR_ONLY | LL_ADD_RULE_SKIP_MISSING)
+
+struct ll_fd_cache_node;
+static int ll_path_open(const char *const path, struct ll_fd_cache_node **const out_node);
+static void ll_path_close(const int fd, struct ll_fd_cache_node *const node);
+
+/* Whether a failed open() should be ignored under LL_ADD_RULE_SKIP_MISSING. */
+static int ll_path_missing(const __u32 flags)
+{
+    return (flags & LL_ADD_RULE_SKIP_MISSING) && (errno == ENOENT || errno == ENOTDIR);
+}
+
 ll_error_t ll_ruleset_add_path(const ll_ruleset_t *const ruleset,
                                const char *const path,
                                const __u64 access_masks,
@@ -465,30 +630,52 @@ ll_error_t ll_ruleset_add_path(const ll_ruleset_t *const ruleset,
         return LL_ERROR_INVALID_ARGUMENT;
     }
 
-    const int dir_fd = open(path, O_PATH | O_CLOEXEC);
+    struct ll_fd_cache_node *cached = NULL;
+    const int dir_fd = ll_path_open(path, &cached);
+    if (dir_fd < 0 && ll_path_missing(flags))
+    {
+        return LL_ERROR_OK;
+    }
 
     const int ret = ll_ruleset_add_path_fd(ruleset, dir_fd, access_masks, flags);
-    close(dir_fd);
+    ll_path_close(dir_fd, cached);
     return ret;
 }
 
-ll_error_t ll_ruleset_add_path_fd(const ll_ruleset_t *const ruleset,
-                                  const int dir_fd,
-                                  const __u64 access_masks,
-                                  const __u32 flags)
+/* Add a path-beneath rule, honouring LL_ADD_RULE_TRIM_DIR_ONLY; @p out_trimmed receives the dropped rights. */
+static ll_error_t ll_ruleset_add_path_fd_trim(const ll_ruleset_t *const ruleset,
+                                              const int dir_fd,
+                                              __u64 access_masks,
+                                              const __u32 flags,
+                                              __u64 *const out_trimmed)
 {
     if (!ruleset)
     {
         return LL_ERROR_INVALID_ARGUMENT;
     }
 
+    struct stat st;
+    if ((flags & LL_ADD_RULE_TRIM_DIR_ONLY) && (access_masks & LL_ACCESS_FS_DIR_ONLY) && dir_fd >= 0 &&
+        fstat(dir_fd, &st) == 0 && !S_ISDIR(st.st_mode))
+    {
+        if (out_trimmed)
+        {
+            *out_trimmed = access_masks & LL_ACCESS_FS_DIR_ONLY;
+        }
+        access_masks &= ~(__u64)LL_ACCESS_FS_DIR_ONLY;
+        if (access_masks == 0)
+        {
+            return LL_ERROR_OK;
+        }
+    }
+
     struct landlock_path_beneath_attr path_attr = {
         .allowed_access = access_masks,
         .parent_fd = dir_fd,
     };
 
-    const int ret = landlock_add_rule(ruleset->ruleset_fd, LANDLOCK_RULE_PATH_BENEATH,
-                                      &path_attr, flags);
+    const int ret = ll_sys_add_rule(ruleset->ruleset_fd, LANDLOCK_RULE_PATH_BENEATH,
+                                      &path_attr, flags & ~LL_ADD_RULE_LIBRARY_FLAGS);
     if (ret < 0)
     {
         return ll_error_from_add_rule_errno(errno);
@@ -496,6 +683,14 @@ ll_error_t ll_ruleset_add_path_fd(const ll_ruleset_t *const ruleset,
     return LL_ERROR_OK;
 }
 
+ll_error_t ll_ruleset_add_path_fd(const ll_ruleset_t *const ruleset,
+                                  const int dir_fd,
+                                  const __u64 access_masks,
+                                  const __u32 flags)
+{
+    return ll_ruleset_add_path_fd_trim(ruleset, dir_fd, access_masks, flags, NULL);
+}
+
 ll_error_t ll_ruleset_add_net_port(const ll_ruleset_t *const ruleset,
                                    const __u64 port,
                                    const __u64 access_masks,
@@ -511,7 +706,7 @@ ll_error_t ll_ruleset_add_net_port(const ll_ruleset_t *const ruleset,
         .port = port,
     };
 
-    const int ret = landlock_add_rule(ruleset->ruleset_fd, LANDLOCK_RULE_NET_PORT, &net_attr, flags);
+    const int ret = ll_sys_add_rule(ruleset->ruleset_fd, LANDLOCK_RULE_NET_PORT, &net_attr, flags);
     if (ret < 0)
     {
         return ll_error_from_add_rule_errno(errno);
@@ -519,6 +714,74 @@ ll_error_t ll_ruleset_add_net_port(const ll_ruleset_t *const ruleset,
     return LL_ERROR_OK;
 }
 
+/*
+ * Layer accounting. The count inherited at startup comes from the
+ * environment; the running total is written back only when the caller asks,
+ * so that enforcing never touches the environment behind its back.
+ */
+
+#define LL_LAYERS_ENV "LIBLANDLOCK_LAYERS"
+
+static int ll_layers_inherited = -1;
+static unsigned int ll_layers_applied = 0;
+
+static unsigned int ll_layers_get_inherited(void)
+{
+    int inherited = __atomic_load_n(&ll_layers_inherited, __ATOMIC_ACQUIRE);
+    if (inherited >= 0)
+    {
+        return (unsigned int)inherited;
+    }
+
+    const char *env = getenv(LL_LAYERS_ENV);
+    inherited = 0;
+    for (; env && *env >= '0' && *env <= '9' && inherited <= LL_MAX_LAYERS; env++)
+    {
+        inherited = inherited * 10 + (*env - '0');
+    }
+    if (inherited > LL_MAX_LAYERS)
+    {
+        inherited = LL_MAX_LAYERS;
+    }
+    int expected = -1;
+    if (!__atomic_compare_exchange_n(&ll_layers_inherited, &expected, inherited, 0, __ATOMIC_ACQ_REL,
+                                     __ATOMIC_ACQUIRE))
+    {
+        inherited = expected;
+    }
+    return (unsigned int)inherited;
+}
+
+static void ll_layers_note_applied(void)
+{
+    (void)ll_layers_get_inherited();
+    __atomic_add_fetch(&ll_layers_applied, 1, __ATOMIC_ACQ_REL);
+}
+
+void ll_layer_export(void)
+{
+    char value[16];
+    unsigned int total = ll_layers_get_inherited() + __atomic_load_n(&ll_layers_applied, __ATOMIC_ACQUIRE);
+    size_t pos = sizeof(value) - 1;
+    value[pos] = '\0';
+    do
+    {
+        value[--pos] = (char)('0' + total % 10);
+        total /= 10;
+    } while (total);
+    setenv(LL_LAYERS_ENV, value + pos, 1);
+}
+
+ll_layer_report_t ll_layer_report(void)
+{
+    ll_layer_report_t report;
+    report.inherited = ll_layers_get_inherited();
+    report.applied = __atomic_load_n(&ll_layers_applied, __ATOMIC_ACQUIRE);
+    report.total = report.inherited + report.applied;
+    report.remaining = (report.total < LL_MAX_LAYERS) ? LL_MAX_LAYERS - report.total : 0;
+    return report;
+}
+
 ll_error_t ll_ruleset_enforce(const ll_ruleset_t *const ruleset,
                               const __u32 flags)
 {
@@ -543,15 +806,10668 @@ ll_error_t ll_ruleset_enforce(const ll_ruleset_t *const ruleset,
         masked_flags = 0;
     }
 
-    if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0))
+    if (ll_sys_set_no_new_privs())
     {
         return LL_ERROR_SYSTEM;
     }
 
-    const int ret = landlock_restrict_self(ruleset->ruleset_fd, masked_flags);
+    const int ret = ll_sys_restrict_self(ruleset->ruleset_fd, masked_flags);
     if (ret < 0)
     {
         return ll_error_from_restrict_errno(errno);
     }
+    ll_layers_note_applied();
+    return LL_ERROR_OK;
+}
+
+/*
+ * Audit reader.
+ *
+ * Messages are received in batches into a ring of fixed-size slots, then parsed
+ * in place: quoted values are NUL-terminated where they stand and hex-encoded
+ * values are decoded over themselves, so no per-record allocation happens.
+ */
+
+#define LL_AUDIT_SLOT_SIZE 9216
+#define LL_AUDIT_RECV_BATCH 64
+#define LL_AUDIT_NLGRP_READLOG 1
+
+struct ll_access_name
+{
+    const char *name;
+    ll_ruleset_access_class_t access_class;
+    __u64 access;
+};
+
+static const struct ll_access_name ll_access_names[] = {
+    {"fs.execute", LL_RULESET_ACCESS_CLASS_FS, LANDLOCK_ACCESS_FS_EXECUTE},
+    {"fs.write_file", LL_RULESET_ACCESS_CLASS_FS, LANDLOCK_ACCESS_FS_WRITE_FILE},
+    {"fs.read_file", LL_RULESET_ACCESS_CLASS_FS, LANDLOCK_ACCESS_FS_READ_FILE},
+    {"fs.read_dir", LL_RULESET_ACCESS_CLASS_FS, LANDLOCK_ACCESS_FS_READ_DIR},
+    {"fs.remove_dir", LL_RULESET_ACCESS_CLASS_FS, LANDLOCK_ACCESS_FS_REMOVE_DIR},
+    {"fs.remove_file", LL_RULESET_ACCESS_CLASS_FS, LANDLOCK_ACCESS_FS_REMOVE_FILE},
+    {"fs.make_char", LL_RULESET_ACCESS_CLASS_FS, LANDLOCK_ACCESS_FS_MAKE_CHAR},
+    {"fs.make_dir", LL_RULESET_ACCESS_CLASS_FS, LANDLOCK_ACCESS_FS_MAKE_DIR},
+    {"fs.make_reg", LL_RULESET_ACCESS_CLASS_FS, LANDLOCK_ACCESS_FS_MAKE_REG},
+    {"fs.make_sock", LL_RULESET_ACCESS_CLASS_FS, LANDLOCK_ACCESS_FS_MAKE_SOCK},
+    {"fs.make_fifo", LL_RULESET_ACCESS_CLASS_FS, LANDLOCK_ACCESS_FS_MAKE_FIFO},
+    {"fs.make_block", LL_RULESET_ACCESS_CLASS_FS, LANDLOCK_ACCESS_FS_MAKE_BLOCK},
+    {"fs.make_sym", LL_RULESET_ACCESS_CLASS_FS, LANDLOCK_ACCESS_FS_MAKE_SYM},
+    {"fs.refer", LL_RULESET_ACCESS_CLASS_FS, LANDLOCK_ACCESS_FS_REFER},
+    {"fs.truncate", LL_RULESET_ACCESS_CLASS_FS, LANDLOCK_ACCESS_FS_TRUNCATE},
+    {"fs.ioctl_dev", LL_RULESET_ACCESS_CLASS_FS, LANDLOCK_ACCESS_FS_IOCTL_DEV},
+    {"net.bind_tcp", LL_RULESET_ACCESS_CLASS_NET, LANDLOCK_ACCESS_NET_BIND_TCP},
+    {"net.connect_tcp", LL_RULESET_ACCESS_CLASS_NET, LANDLOCK_ACCESS_NET_CONNECT_TCP},
+    {"scope.abstract_unix_socket", LL_RULESET_ACCESS_CLASS_SCOPE, LANDLOCK_SCOPE_ABSTRACT_UNIX_SOCKET},
+    {"scope.signal", LL_RULESET_ACCESS_CLASS_SCOPE, LANDLOCK_SCOPE_SIGNAL},
+};
+
+static const struct ll_access_name *ll_access_name_lookup(const char *const name, const size_t len)
+{
+    for (size_t i = 0; i < sizeof(ll_access_names) / sizeof(ll_access_names[0]); i++)
+    {
+        if (strncmp(ll_access_names[i].name, name, len) == 0 && ll_access_names[i].name[len] == '\0')
+        {
+            return &ll_access_names[i];
+        }
+    }
+    return NULL;
+}
+
+/* Linux struct mmsghdr, declared by glibc only under _GNU_SOURCE. */
+struct ll_mmsghdr
+{
+    struct msghdr msg_hdr;
+    unsigned int msg_len;
+};
+
+struct ll_audit_slot
+{
+    /* Record type, or 0 for an audit.log line and -1 for a netlink datagram. */
+    int type;
+    size_t len;
+    char data[LL_AUDIT_SLOT_SIZE];
+};
+
+struct ll_audit_reader
+{
+    ll_audit_reader_config_t config;
+    int fd;
+
+    struct ll_audit_slot *slots;
+    size_t slot_mask;
+    size_t head;
+    size_t tail;
+
+    ll_audit_summary_entry_t *entries;
+    size_t entry_count;
+    __u32 *index;
+    size_t index_mask;
+
+    __u64 last_summary_ms;
+    ll_audit_reader_stats_t stats;
+};
+
+static __u64 ll_monotonic_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (__u64)ts.tv_sec * 1000 + (__u64)ts.tv_nsec / 1000000;
+}
+
+static size_t ll_round_pow2(size_t value)
+{
+    size_t out = 1;
+    while (out < value)
+    {
+        out <<= 1;
+    }
+    return out;
+}
+
+ll_error_t ll_audit_reader_create(const ll_audit_reader_config_t *const config,
+                                  ll_audit_reader_t **const out_reader)
+{
+    if (!config || !out_reader || config->ring_slots == 0 || config->aggregate_capacity == 0 ||
+        config->aggregate_capacity > 0x7fffffff)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    ll_audit_reader_t *reader = calloc(1, sizeof(*reader));
+    if (!reader)
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    reader->config = *config;
+    reader->fd = -1;
+
+    const size_t slots = ll_round_pow2(config->ring_slots);
+    const size_t index_size = ll_round_pow2(config->aggregate_capacity * 2);
+    reader->slot_mask = slots - 1;
+    reader->index_mask = index_size - 1;
+    reader->slots = malloc(slots * sizeof(*reader->slots));
+    reader->entries = calloc(config->aggregate_capacity, sizeof(*reader->entries));
+    reader->index = malloc(index_size * sizeof(*reader->index));
+    if (!reader->slots || !reader->entries || !reader->index)
+    {
+        ll_audit_reader_close(reader);
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    memset(reader->index, 0xff, index_size * sizeof(*reader->index));
+    reader->last_summary_ms = ll_monotonic_ms();
+
+    *out_reader = reader;
+    return LL_ERROR_OK;
+}
+
+void ll_audit_reader_close(ll_audit_reader_t *const reader)
+{
+    if (!reader)
+    {
+        return;
+    }
+
+    if (reader->fd >= 0)
+    {
+        close(reader->fd);
+    }
+    free(reader->slots);
+    free(reader->entries);
+    free(reader->index);
+    free(reader);
+}
+
+ll_error_t ll_audit_reader_open_netlink(ll_audit_reader_t *const reader)
+{
+    if (!reader || reader->fd >= 0)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+#ifdef NETLINK_SOCKET
+    const int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_SOCKET);
+    if (fd < 0)
+    {
+        return (errno == EPROTONOSUPPORT || errno == EAFNOSUPPORT) ? LL_ERROR_AUDIT_UNAVAILABLE : LL_ERROR_SYSTEM;
+    }
+
+    /* SO_RCVBUFFORCE bypasses rmem_max when privileged; fall back to the capped size. */
+    const int rcvbuf = reader->config.socket_rcvbuf;
+    if (rcvbuf > 0 && setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(rcvbuf)) < 0)
+    {
+        (void)setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = 1U << (LL_AUDIT_NLGRP_READLOG - 1);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        const int err = errno;
+        close(fd);
+        return (err == EPERM || err == EACCES || err == ECONNREFUSED) ? LL_ERROR_AUDIT_UNAVAILABLE
+                                                                       : LL_ERROR_SYSTEM;
+    }
+
+    reader->fd = fd;
     return LL_ERROR_OK;
-}
\ No newline at end of file
+#else
+    return LL_ERROR_AUDIT_UNAVAILABLE;
+#endif
+}
+
+int ll_audit_reader_fd(const ll_audit_reader_t *const reader)
+{
+    return reader ? reader->fd : -1;
+}
+
+ll_audit_reader_stats_t ll_audit_reader_stats(const ll_audit_reader_t *const reader)
+{
+    ll_audit_reader_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+    if (reader)
+    {
+        stats = reader->stats;
+    }
+    return stats;
+}
+
+static int ll_hex_value(const char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+static __u64 ll_parse_u64(const char *s, const int base)
+{
+    __u64 value = 0;
+    for (;; s++)
+    {
+        const int digit = ll_hex_value(*s);
+        if (digit < 0 || digit >= base)
+        {
+            return value;
+        }
+        value = value * (__u64)base + (__u64)digit;
+    }
+}
+
+/*
+ * Audit encodes untrusted strings either quoted or, when they contain spaces,
+ * quotes or control characters, as an unquoted hex string. Both are decoded in
+ * place and NUL-terminated.
+ */
+static char *ll_audit_decode_value(char *value, const int untrusted)
+{
+    if (*value == '"')
+    {
+        char *end = strchr(value + 1, '"');
+        if (end)
+        {
+            *end = '\0';
+        }
+        return value + 1;
+    }
+    if (!untrusted)
+    {
+        return value;
+    }
+
+    const size_t len = strlen(value);
+    if (len == 0 || len % 2 != 0)
+    {
+        return value;
+    }
+    for (size_t i = 0; i < len; i++)
+    {
+        if (ll_hex_value(value[i]) < 0)
+        {
+            return value;
+        }
+    }
+    for (size_t i = 0; i < len / 2; i++)
+    {
+        value[i] = (char)((ll_hex_value(value[2 * i]) << 4) | ll_hex_value(value[2 * i + 1]));
+    }
+    value[len / 2] = '\0';
+    return value;
+}
+
+static void ll_audit_parse_blockers(ll_audit_record_t *const record, const char *blockers)
+{
+    while (*blockers)
+    {
+        const char *end = strchr(blockers, ',');
+        const size_t len = end ? (size_t)(end - blockers) : strlen(blockers);
+        const struct ll_access_name *name = ll_access_name_lookup(blockers, len);
+        if (name)
+        {
+            switch (name->access_class)
+            {
+            case LL_RULESET_ACCESS_CLASS_FS:
+                record->access_fs |= name->access;
+                break;
+            case LL_RULESET_ACCESS_CLASS_NET:
+                record->access_net |= name->access;
+                break;
+            case LL_RULESET_ACCESS_CLASS_SCOPE:
+                record->access_scope |= name->access;
+                break;
+            }
+        }
+        if (!end)
+        {
+            break;
+        }
+        blockers = end + 1;
+    }
+}
+
+/* Parse "audit(SEC.MSEC:SERIAL): key=value ..." in place. Returns 0 on success. */
+static int ll_audit_parse_body(char *text, ll_audit_record_t *const record)
+{
+    char *p = strstr(text, "audit(");
+    if (!p)
+    {
+        return -1;
+    }
+    p += strlen("audit(");
+    const __u64 sec = ll_parse_u64(p, 10);
+    char *dot = strchr(p, '.');
+    char *colon = strchr(p, ':');
+    char *close_paren = strchr(p, ')');
+    if (!close_paren || !colon || colon > close_paren)
+    {
+        return -1;
+    }
+    record->timestamp_ms = sec * 1000 + ((dot && dot < colon) ? ll_parse_u64(dot + 1, 10) : 0);
+    record->serial = ll_parse_u64(colon + 1, 10);
+
+    p = close_paren + 1;
+    if (*p == ':')
+    {
+        p++;
+    }
+
+    while (*p)
+    {
+        while (*p == ' ')
+        {
+            p++;
+        }
+        if (!*p)
+        {
+            break;
+        }
+
+        char *key = p;
+        char *eq = NULL;
+        while (*p && *p != ' ' && *p != '=')
+        {
+            p++;
+        }
+        if (*p != '=')
+        {
+            continue;
+        }
+        eq = p;
+        *eq = '\0';
+        char *value = eq + 1;
+
+        /* Find the end of the value, honouring quotes. */
+        p = value;
+        if (*p == '"')
+        {
+            p++;
+            while (*p && *p != '"')
+            {
+                p++;
+            }
+            if (*p == '"')
+            {
+                p++;
+            }
+        }
+        else
+        {
+            while (*p && *p != ' ')
+            {
+                p++;
+            }
+        }
+        if (*p)
+        {
+            *p++ = '\0';
+        }
+
+        if (strcmp(key, "domain") == 0)
+        {
+            record->domain = ll_parse_u64(value, 16);
+        }
+        else if (strcmp(key, "blockers") == 0)
+        {
+            record->blockers = value;
+            ll_audit_parse_blockers(record, value);
+        }
+        else if (strcmp(key, "path") == 0 || (strcmp(key, "name") == 0 && !record->path))
+        {
+            record->path = ll_audit_decode_value(value, 1);
+        }
+        else if (strcmp(key, "dest") == 0 || strcmp(key, "src") == 0 ||
+                 strcmp(key, "lport") == 0 || strcmp(key, "fport") == 0)
+        {
+            if (record->port == 0)
+            {
+                record->port = ll_parse_u64(value, 10);
+            }
+        }
+        else if (strcmp(key, "status") == 0)
+        {
+            record->status = ll_audit_decode_value(value, 0);
+        }
+        else if (strcmp(key, "pid") == 0)
+        {
+            record->pid = (int)ll_parse_u64(value, 10);
+        }
+        else if (strcmp(key, "denials") == 0)
+        {
+            record->denials = ll_parse_u64(value, 10);
+        }
+    }
+    return 0;
+}
+
+static int ll_audit_type_from_line(const char *line)
+{
+    if (strncmp(line, "type=", 5) != 0)
+    {
+        return 0;
+    }
+    line += 5;
+    if (strncmp(line, "LANDLOCK_ACCESS ", 16) == 0)
+    {
+        return LL_AUDIT_LANDLOCK_ACCESS;
+    }
+    if (strncmp(line, "LANDLOCK_DOMAIN ", 16) == 0)
+    {
+        return LL_AUDIT_LANDLOCK_DOMAIN;
+    }
+    if (strncmp(line, "UNKNOWN[", 8) == 0)
+    {
+        return (int)ll_parse_u64(line + 8, 10);
+    }
+    return 0;
+}
+
+static __u64 ll_hash_bytes(__u64 hash, const void *const data, const size_t len)
+{
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+#define LL_HASH_INIT 0xcbf29ce484222325ULL
+
+static size_t ll_audit_prefix_len(const char *const path, const unsigned int depth)
+{
+    const size_t len = strlen(path);
+    if (depth == 0)
+    {
+        return len;
+    }
+
+    unsigned int components = 0;
+    for (size_t i = 1; i < len; i++)
+    {
+        if (path[i] == '/' && ++components == depth)
+        {
+            return i;
+        }
+    }
+    return len;
+}
+
+static void ll_audit_aggregate_one(ll_audit_reader_t *const reader,
+                                   const ll_audit_record_t *const record,
+                                   const ll_ruleset_access_class_t access_class,
+                                   const __u64 access)
+{
+    const char *prefix = "";
+    size_t prefix_len = 0;
+    if (access_class == LL_RULESET_ACCESS_CLASS_FS && record->path)
+    {
+        prefix = record->path;
+        prefix_len = ll_audit_prefix_len(record->path, reader->config.path_prefix_depth);
+    }
+    if (prefix_len >= sizeof(reader->entries[0].prefix))
+    {
+        prefix_len = sizeof(reader->entries[0].prefix) - 1;
+    }
+    const __u64 port = (access_class == LL_RULESET_ACCESS_CLASS_NET) ? record->port : 0;
+
+    __u64 hash = LL_HASH_INIT;
+    hash = ll_hash_bytes(hash, &record->domain, sizeof(record->domain));
+    hash = ll_hash_bytes(hash, &access, sizeof(access));
+    hash = ll_hash_bytes(hash, &port, sizeof(port));
+    hash = ll_hash_bytes(hash, &access_class, sizeof(access_class));
+    hash = ll_hash_bytes(hash, prefix, prefix_len);
+
+    for (size_t probe = 0;; probe++)
+    {
+        __u32 *const slot = &reader->index[(hash + probe) & reader->index_mask];
+        if (*slot == UINT32_MAX)
+        {
+            if (reader->entry_count == reader->config.aggregate_capacity)
+            {
+                reader->stats.aggregate_overflows++;
+                return;
+            }
+            ll_audit_summary_entry_t *entry = &reader->entries[reader->entry_count];
+            entry->domain = record->domain;
+            entry->access_class = access_class;
+            entry->access = access;
+            memcpy(entry->prefix, prefix, prefix_len);
+            entry->prefix[prefix_len] = '\0';
+            entry->port = port;
+            entry->count = 1;
+            entry->first_ms = record->timestamp_ms;
+            entry->last_ms = record->timestamp_ms;
+            *slot = (__u32)reader->entry_count++;
+            return;
+        }
+
+        ll_audit_summary_entry_t *entry = &reader->entries[*slot];
+        if (entry->domain == record->domain && entry->access_class == access_class &&
+            entry->access == access && entry->port == port &&
+            strncmp(entry->prefix, prefix, prefix_len) == 0 && entry->prefix[prefix_len] == '\0')
+        {
+            entry->count++;
+            entry->last_ms = record->timestamp_ms;
+            return;
+        }
+    }
+}
+
+static void ll_audit_aggregate(ll_audit_reader_t *const reader, const ll_audit_record_t *const record)
+{
+    const struct
+    {
+        ll_ruleset_access_class_t access_class;
+        __u64 mask;
+    } classes[] = {
+        {LL_RULESET_ACCESS_CLASS_FS, record->access_fs},
+        {LL_RULESET_ACCESS_CLASS_NET, record->access_net},
+        {LL_RULESET_ACCESS_CLASS_SCOPE, record->access_scope},
+    };
+
+    for (size_t i = 0; i < sizeof(classes) / sizeof(classes[0]); i++)
+    {
+        __u64 mask = classes[i].mask;
+        while (mask)
+        {
+            const __u64 bit = mask & (~mask + 1);
+            ll_audit_aggregate_one(reader, record, classes[i].access_class, bit);
+            mask &= mask - 1;
+        }
+    }
+}
+
+static void ll_audit_process_text(ll_audit_reader_t *const reader, int type, char *const text)
+{
+    if (type == 0)
+    {
+        type = ll_audit_type_from_line(text);
+    }
+    if (type != LL_AUDIT_LANDLOCK_ACCESS && type != LL_AUDIT_LANDLOCK_DOMAIN)
+    {
+        reader->stats.skipped++;
+        return;
+    }
+
+    ll_audit_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.type = type;
+    if (ll_audit_parse_body(text, &record) != 0)
+    {
+        reader->stats.skipped++;
+        return;
+    }
+
+    reader->stats.records++;
+    if (type == LL_AUDIT_LANDLOCK_ACCESS)
+    {
+        reader->stats.denials++;
+        ll_audit_aggregate(reader, &record);
+    }
+    if (reader->config.on_record)
+    {
+        reader->config.on_record(&record, reader->config.ctx);
+    }
+}
+
+static void ll_audit_process_slot(ll_audit_reader_t *const reader, struct ll_audit_slot *const slot)
+{
+    if (slot->type >= 0)
+    {
+        slot->data[slot->len] = '\0';
+        ll_audit_process_text(reader, slot->type, slot->data);
+        return;
+    }
+
+    size_t remaining = slot->len;
+    struct nlmsghdr *nlh = (struct nlmsghdr *)slot->data;
+    for (; NLMSG_OK(nlh, remaining); nlh = NLMSG_NEXT(nlh, remaining))
+    {
+        char *payload = NLMSG_DATA(nlh);
+        size_t payload_len = nlh->nlmsg_len - NLMSG_HDRLEN;
+        /* Terminate in place; the slot keeps one spare byte past the datagram. */
+        char saved = payload[payload_len];
+        payload[payload_len] = '\0';
+        ll_audit_process_text(reader, nlh->nlmsg_type, payload);
+        payload[payload_len] = saved;
+    }
+}
+
+static void ll_audit_maybe_summarize(ll_audit_reader_t *const reader)
+{
+    if (reader->config.summary_interval_ms == 0 || !reader->config.on_summary)
+    {
+        return;
+    }
+    const __u64 now = ll_monotonic_ms();
+    if (now - reader->last_summary_ms >= reader->config.summary_interval_ms)
+    {
+        ll_audit_reader_summarize(reader, NULL, NULL);
+        reader->last_summary_ms = now;
+    }
+}
+
+static void ll_audit_drain_ring(ll_audit_reader_t *const reader)
+{
+    const size_t pending = reader->head - reader->tail;
+    if (pending > reader->stats.ring_high_water)
+    {
+        reader->stats.ring_high_water = pending;
+    }
+    while (reader->tail != reader->head)
+    {
+        ll_audit_process_slot(reader, &reader->slots[reader->tail & reader->slot_mask]);
+        reader->tail++;
+    }
+    ll_audit_maybe_summarize(reader);
+}
+
+/* Receive as many datagrams as fit in the contiguous free part of the ring. */
+static int ll_audit_recv_batch(ll_audit_reader_t *const reader)
+{
+    const size_t capacity = reader->slot_mask + 1;
+    const size_t start = reader->head & reader->slot_mask;
+    size_t batch = capacity - (reader->head - reader->tail);
+    if (batch > capacity - start)
+    {
+        batch = capacity - start;
+    }
+    if (batch > LL_AUDIT_RECV_BATCH)
+    {
+        batch = LL_AUDIT_RECV_BATCH;
+    }
+
+    struct ll_mmsghdr msgs[LL_AUDIT_RECV_BATCH];
+    struct iovec iovs[LL_AUDIT_RECV_BATCH];
+    memset(msgs, 0, sizeof(msgs[0]) * batch);
+    for (size_t i = 0; i < batch; i++)
+    {
+        iovs[i].iov_base = reader->slots[start + i].data;
+        iovs[i].iov_len = LL_AUDIT_SLOT_SIZE - 1;
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+#ifdef __NR_recvmmsg
+    const int ret = (int)syscall(__NR_recvmmsg, reader->fd, msgs, (unsigned int)batch, MSG_DONTWAIT, NULL);
+#else
+    int ret = 0;
+    for (; (size_t)ret < batch; ret++)
+    {
+        const ssize_t len = recvmsg(reader->fd, &msgs[ret].msg_hdr, MSG_DONTWAIT);
+        if (len < 0)
+        {
+            if (ret == 0)
+            {
+                ret = -1;
+            }
+            break;
+        }
+        msgs[ret].msg_len = (unsigned int)len;
+    }
+#endif
+    if (ret < 0)
+    {
+        return -1;
+    }
+
+    for (int i = 0; i < ret; i++)
+    {
+        struct ll_audit_slot *slot = &reader->slots[start + (size_t)i];
+        slot->type = -1;
+        slot->len = msgs[i].msg_len;
+    }
+    reader->head += (size_t)ret;
+    reader->stats.received += (__u64)ret;
+    return ret;
+}
+
+ll_error_t ll_audit_reader_poll(ll_audit_reader_t *const reader,
+                                const int timeout_ms,
+                                size_t *const out_count)
+{
+    if (!reader || reader->fd < 0)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    size_t count = 0;
+    if (timeout_ms != 0)
+    {
+        struct pollfd pfd = {.fd = reader->fd, .events = POLLIN, .revents = 0};
+        if (poll(&pfd, 1, timeout_ms) < 0 && errno != EINTR)
+        {
+            return LL_ERROR_SYSTEM;
+        }
+    }
+
+    for (;;)
+    {
+        const int ret = ll_audit_recv_batch(reader);
+        if (ret < 0)
+        {
+            if (errno == ENOBUFS)
+            {
+                /* The kernel dropped messages; keep draining what is left. */
+                reader->stats.overruns++;
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            {
+                break;
+            }
+            ll_audit_drain_ring(reader);
+            return LL_ERROR_SYSTEM;
+        }
+        if (ret == 0)
+        {
+            break;
+        }
+        count += (size_t)ret;
+        if (reader->head - reader->tail > reader->slot_mask)
+        {
+            ll_audit_drain_ring(reader);
+        }
+    }
+    ll_audit_drain_ring(reader);
+
+    if (out_count)
+    {
+        *out_count = count;
+    }
+    return LL_ERROR_OK;
+}
+
+ll_error_t ll_audit_reader_feed(ll_audit_reader_t *const reader,
+                                const int type,
+                                const char *const text,
+                                const size_t len)
+{
+    if (!reader || !text || len >= LL_AUDIT_SLOT_SIZE)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    /* Negative slot types mark netlink datagrams, so they must not come from callers. */
+    if (type != 0 && (type < AUDIT_GET || type > AUDIT_LAST_USER_MSG2))
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    struct ll_audit_slot *slot = &reader->slots[reader->head & reader->slot_mask];
+    memcpy(slot->data, text, len);
+    slot->type = type;
+    slot->len = len;
+    reader->head++;
+    reader->stats.received++;
+    ll_audit_drain_ring(reader);
+    return LL_ERROR_OK;
+}
+
+ll_error_t ll_audit_reader_replay_file(ll_audit_reader_t *const reader, const char *const path)
+{
+    if (!reader || !path)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return LL_ERROR_SYSTEM;
+    }
+
+    /*
+     * Lines are copied straight from the read buffer into ring slots and the
+     * ring is drained whenever it fills, as with live netlink input.
+     */
+    char buf[65536];
+    size_t used = 0;
+    ll_error_t err = LL_ERROR_OK;
+    for (;;)
+    {
+        const ssize_t n = read(fd, buf + used, sizeof(buf) - used);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            err = LL_ERROR_SYSTEM;
+            break;
+        }
+
+        used += (size_t)n;
+        size_t start = 0;
+        for (;;)
+        {
+            char *nl = memchr(buf + start, '\n', used - start);
+            if (!nl && n == 0 && start < used)
+            {
+                nl = buf + used;
+            }
+            if (!nl)
+            {
+                break;
+            }
+
+            const size_t len = (size_t)(nl - (buf + start));
+            if (len > 0 && len < LL_AUDIT_SLOT_SIZE)
+            {
+                struct ll_audit_slot *slot = &reader->slots[reader->head & reader->slot_mask];
+                memcpy(slot->data, buf + start, len);
+                slot->type = 0;
+                slot->len = len;
+                reader->head++;
+                reader->stats.received++;
+                if (reader->head - reader->tail > reader->slot_mask)
+                {
+                    ll_audit_drain_ring(reader);
+                }
+            }
+            else if (len > 0)
+            {
+                reader->stats.skipped++;
+            }
+            start = (size_t)(nl - buf) + 1;
+            if (start > used)
+            {
+                start = used;
+            }
+        }
+
+        memmove(buf, buf + start, used - start);
+        used -= start;
+        if (n == 0)
+        {
+            break;
+        }
+        if (used == sizeof(buf))
+        {
+            /* Overlong line: skip it. */
+            reader->stats.skipped++;
+            used = 0;
+        }
+    }
+    close(fd);
+    ll_audit_drain_ring(reader);
+    return err;
+}
+
+void ll_audit_reader_summarize(ll_audit_reader_t *const reader, ll_audit_summary_cb cb, void *ctx)
+{
+    if (!reader)
+    {
+        return;
+    }
+    if (!cb)
+    {
+        cb = reader->config.on_summary;
+        ctx = reader->config.ctx;
+    }
+    if (cb && reader->entry_count > 0)
+    {
+        cb(reader->entries, reader->entry_count, ctx);
+    }
+
+    reader->entry_count = 0;
+    memset(reader->index, 0xff, (reader->index_mask + 1) * sizeof(*reader->index));
+}
+
+
+static ll_error_t ll_ruleset_add_paths_impl(const ll_ruleset_t *const ruleset,
+                                            const ll_path_rule_t *const rules,
+                                            const size_t count,
+                                            const __u32 flags,
+                                            __u64 *const out_trimmed,
+                                            size_t *const out_failed)
+{
+    if (!ruleset || ruleset->ruleset_fd < 0 || (!rules && count > 0))
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (out_trimmed)
+        {
+            out_trimmed[i] = 0;
+        }
+        __u64 access = rules[i].access;
+        if (ruleset->compat_mode == LL_ABI_COMPAT_BEST_EFFORT)
+        {
+            access &= ruleset->handled_access_fs;
+            if (access == 0)
+            {
+                continue;
+            }
+        }
+
+        ll_error_t err = LL_ERROR_INVALID_ARGUMENT;
+        if (rules[i].path)
+        {
+            struct ll_fd_cache_node *cached = NULL;
+            const int dir_fd = ll_path_open(rules[i].path, &cached);
+            if (dir_fd < 0 && ll_path_missing(flags))
+            {
+                continue;
+            }
+            err = ll_ruleset_add_path_fd_trim(ruleset, dir_fd, access, flags, out_trimmed ? &out_trimmed[i] : NULL);
+            ll_path_close(dir_fd, cached);
+        }
+        if (LL_ERRORED(err))
+        {
+            if (out_failed)
+            {
+                *out_failed = i;
+            }
+            return err;
+        }
+    }
+    return LL_ERROR_OK;
+}
+
+ll_error_t ll_ruleset_add_paths(const ll_ruleset_t *const ruleset,
+                                const ll_path_rule_t *const rules,
+                                const size_t count,
+                                const __u32 flags,
+                                size_t *const out_failed)
+{
+    return ll_ruleset_add_paths_impl(ruleset, rules, count, flags, NULL, out_failed);
+}
+
+ll_error_t ll_ruleset_add_paths_trimmed(const ll_ruleset_t *const ruleset,
+                                        const ll_path_rule_t *const rules,
+                                        const size_t count,
+                                        const __u32 flags,
+                                        __u64 *const out_trimmed,
+                                        size_t *const out_failed)
+{
+    return ll_ruleset_add_paths_impl(ruleset, rules, count, flags | LL_ADD_RULE_TRIM_DIR_ONLY, out_trimmed,
+                                     out_failed);
+}
+
+/*
+ * Policies.
+ */
+
+/* Rights that the kernel only accepts on directory rules. */
+#define LL_ACCESS_FS_DIR_ONLY                                                                   \
+    (LANDLOCK_ACCESS_FS_READ_DIR | LANDLOCK_ACCESS_FS_REMOVE_DIR | LANDLOCK_ACCESS_FS_REMOVE_FILE | \
+     LANDLOCK_ACCESS_FS_MAKE_CHAR | LANDLOCK_ACCESS_FS_MAKE_DIR | LANDLOCK_ACCESS_FS_MAKE_REG |      \
+     LANDLOCK_ACCESS_FS_MAKE_SOCK | LANDLOCK_ACCESS_FS_MAKE_FIFO | LANDLOCK_ACCESS_FS_MAKE_BLOCK |   \
+     LANDLOCK_ACCESS_FS_MAKE_SYM | LANDLOCK_ACCESS_FS_REFER)
+
+struct ll_policy
+{
+    __u64 handled_access_fs;
+    __u64 handled_access_net;
+    __u64 handled_access_scope;
+
+    ll_path_rule_t *paths;
+    size_t path_count;
+    size_t path_capacity;
+    /* Open-addressing index into paths; SIZE_MAX marks an empty slot. */
+    size_t *path_index;
+    size_t path_index_mask;
+
+    ll_port_rule_t *ports;
+    size_t port_count;
+    size_t port_capacity;
+};
+
+ll_error_t ll_policy_create(ll_policy_t **const out_policy)
+{
+    if (!out_policy)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    ll_policy_t *policy = calloc(1, sizeof(*policy));
+    if (!policy)
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    *out_policy = policy;
+    return LL_ERROR_OK;
+}
+
+void ll_policy_free(ll_policy_t *const policy)
+{
+    if (!policy)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < policy->path_count; i++)
+    {
+        free((char *)policy->paths[i].path);
+    }
+    free(policy->paths);
+    free(policy->path_index);
+    free(policy->ports);
+    free(policy);
+}
+
+ll_error_t ll_policy_handle(ll_policy_t *const policy,
+                            const __u64 fs_mask,
+                            const __u64 net_mask,
+                            const __u64 scope_mask)
+{
+    if (!policy)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    policy->handled_access_fs |= fs_mask;
+    policy->handled_access_net |= net_mask;
+    policy->handled_access_scope |= scope_mask;
+    return LL_ERROR_OK;
+}
+
+static __u64 ll_hash_path(const char *const path, const size_t len)
+{
+    return ll_hash_bytes(LL_HASH_INIT, path, len);
+}
+
+/* Return the slot of @p path in the index: either its entry or the empty slot to insert at. */
+static size_t *ll_policy_index_slot(const ll_policy_t *const policy, const char *const path, const size_t len)
+{
+    const __u64 hash = ll_hash_path(path, len);
+    for (size_t probe = 0;; probe++)
+    {
+        size_t *slot = &policy->path_index[(hash + probe) & policy->path_index_mask];
+        if (*slot == SIZE_MAX)
+        {
+            return slot;
+        }
+        const char *candidate = policy->paths[*slot].path;
+        if (strncmp(candidate, path, len) == 0 && candidate[len] == '\0')
+        {
+            return slot;
+        }
+    }
+}
+
+static ll_error_t ll_policy_grow_index(ll_policy_t *const policy)
+{
+    const size_t size = policy->path_index ? (policy->path_index_mask + 1) * 2 : 64;
+    size_t *index = malloc(size * sizeof(*index));
+    if (!index)
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    memset(index, 0xff, size * sizeof(*index));
+
+    free(policy->path_index);
+    policy->path_index = index;
+    policy->path_index_mask = size - 1;
+    for (size_t i = 0; i < policy->path_count; i++)
+    {
+        const char *path = policy->paths[i].path;
+        *ll_policy_index_slot(policy, path, strlen(path)) = i;
+    }
+    return LL_ERROR_OK;
+}
+
+/* Look up a path rule by the first @p len bytes of @p path. */
+static ll_path_rule_t *ll_policy_find_path(const ll_policy_t *const policy, const char *const path, const size_t len)
+{
+    if (!policy->path_index)
+    {
+        return NULL;
+    }
+    const size_t *slot = ll_policy_index_slot(policy, path, len);
+    return (*slot == SIZE_MAX) ? NULL : &policy->paths[*slot];
+}
+
+ll_error_t ll_policy_add_path(ll_policy_t *const policy, const char *const path, const __u64 access)
+{
+    if (!policy || !path || !*path)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    const size_t len = strlen(path);
+    ll_path_rule_t *existing = ll_policy_find_path(policy, path, len);
+    if (existing)
+    {
+        existing->access |= access;
+        return LL_ERROR_OK;
+    }
+
+    if (!policy->path_index || (policy->path_count + 1) * 2 > policy->path_index_mask + 1)
+    {
+        const ll_error_t err = ll_policy_grow_index(policy);
+        if (LL_ERRORED(err))
+        {
+            return err;
+        }
+    }
+    if (policy->path_count == policy->path_capacity)
+    {
+        const size_t capacity = policy->path_capacity ? policy->path_capacity * 2 : 16;
+        ll_path_rule_t *paths = realloc(policy->paths, capacity * sizeof(*paths));
+        if (!paths)
+        {
+            return LL_ERROR_OUT_OF_MEMORY;
+        }
+        policy->paths = paths;
+        policy->path_capacity = capacity;
+    }
+
+    char *copy = malloc(len + 1);
+    if (!copy)
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    memcpy(copy, path, len + 1);
+
+    *ll_policy_index_slot(policy, path, len) = policy->path_count;
+    policy->paths[policy->path_count].path = copy;
+    policy->paths[policy->path_count].access = access;
+    policy->path_count++;
+    return LL_ERROR_OK;
+}
+
+ll_error_t ll_policy_add_net_port(ll_policy_t *const policy, const __u64 port, const __u64 access)
+{
+    if (!policy)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    if (port > 65535)
+    {
+        return LL_ERROR_ADD_RULE_PORT_OUT_OF_RANGE;
+    }
+
+    for (size_t i = 0; i < policy->port_count; i++)
+    {
+        if (policy->ports[i].port == port)
+        {
+            policy->ports[i].access |= access;
+            return LL_ERROR_OK;
+        }
+    }
+
+    if (policy->port_count == policy->port_capacity)
+    {
+        const size_t capacity = policy->port_capacity ? policy->port_capacity * 2 : 8;
+        ll_port_rule_t *ports = realloc(policy->ports, capacity * sizeof(*ports));
+        if (!ports)
+        {
+            return LL_ERROR_OUT_OF_MEMORY;
+        }
+        policy->ports = ports;
+        policy->port_capacity = capacity;
+    }
+    policy->ports[policy->port_count].port = port;
+    policy->ports[policy->port_count].access = access;
+    policy->port_count++;
+    return LL_ERROR_OK;
+}
+
+const ll_path_rule_t *ll_policy_paths(const ll_policy_t *const policy, size_t *const out_count)
+{
+    if (out_count)
+    {
+        *out_count = policy ? policy->path_count : 0;
+    }
+    return policy ? policy->paths : NULL;
+}
+
+const ll_port_rule_t *ll_policy_ports(const ll_policy_t *const policy, size_t *const out_count)
+{
+    if (out_count)
+    {
+        *out_count = policy ? policy->port_count : 0;
+    }
+    return policy ? policy->ports : NULL;
+}
+
+ll_ruleset_attr_t ll_policy_attr(const ll_policy_t *const policy, ll_ruleset_attr_t attr)
+{
+    if (policy)
+    {
+        attr.access.handled_access_fs = policy->handled_access_fs;
+        attr.access.handled_access_net = policy->handled_access_net;
+        attr.access.scoped = policy->handled_access_scope;
+    }
+    return attr;
+}
+
+/* Parse a comma-separated access list into per-class masks. Returns 0 on success. */
+static int ll_parse_access_list(const char *list, const size_t len, __u64 masks[3])
+{
+    size_t start = 0;
+    while (start < len)
+    {
+        size_t end = start;
+        while (end < len && list[end] != ',')
+        {
+            end++;
+        }
+        if (end > start)
+        {
+            const struct ll_access_name *name = ll_access_name_lookup(list + start, end - start);
+            if (!name)
+            {
+                return -1;
+            }
+            masks[name->access_class] |= name->access;
+        }
+        start = end + 1;
+    }
+    return 0;
+}
+
+static ll_error_t ll_policy_parse_line(ll_policy_t *const policy, const char *line, size_t len)
+{
+    while (len > 0 && (line[len - 1] == ' ' || line[len - 1] == '\t' || line[len - 1] == '\r'))
+    {
+        len--;
+    }
+    while (len > 0 && (*line == ' ' || *line == '\t'))
+    {
+        line++;
+        len--;
+    }
+    if (len == 0 || *line == '#')
+    {
+        return LL_ERROR_OK;
+    }
+
+    /* "<directive> <access-list> [<argument>]", where the argument runs to the end of the line. */
+    const char *directive = line;
+    const char *end = line + len;
+    const char *p = memchr(line, ' ', len);
+    if (!p)
+    {
+        return LL_ERROR_POLICY_SYNTAX;
+    }
+    const size_t directive_len = (size_t)(p - directive);
+    while (p < end && *p == ' ')
+    {
+        p++;
+    }
+    const char *list = p;
+    while (p < end && *p != ' ')
+    {
+        p++;
+    }
+    const size_t list_len = (size_t)(p - list);
+    while (p < end && *p == ' ')
+    {
+        p++;
+    }
+    const char *arg = p;
+    const size_t arg_len = (size_t)(end - arg);
+
+    __u64 masks[3] = {0, 0, 0};
+    if (ll_parse_access_list(list, list_len, masks) != 0)
+    {
+        return LL_ERROR_POLICY_SYNTAX;
+    }
+
+    if (directive_len == 6 && strncmp(directive, "handle", 6) == 0 && arg_len == 0)
+    {
+        return ll_policy_handle(policy,
+                                masks[LL_RULESET_ACCESS_CLASS_FS],
+                                masks[LL_RULESET_ACCESS_CLASS_NET],
+                                masks[LL_RULESET_ACCESS_CLASS_SCOPE]);
+    }
+    if (directive_len == 4 && strncmp(directive, "path", 4) == 0 && arg_len > 0 &&
+        masks[LL_RULESET_ACCESS_CLASS_NET] == 0 && masks[LL_RULESET_ACCESS_CLASS_SCOPE] == 0)
+    {
+        char path[4096];
+        if (arg_len >= sizeof(path))
+        {
+            return LL_ERROR_POLICY_SYNTAX;
+        }
+        memcpy(path, arg, arg_len);
+        path[arg_len] = '\0';
+        return ll_policy_add_path(policy, path, masks[LL_RULESET_ACCESS_CLASS_FS]);
+    }
+    if (directive_len == 4 && strncmp(directive, "port", 4) == 0 && arg_len > 0 && arg_len <= 10 &&
+        masks[LL_RULESET_ACCESS_CLASS_FS] == 0 && masks[LL_RULESET_ACCESS_CLASS_SCOPE] == 0)
+    {
+        __u64 port = 0;
+        for (size_t i = 0; i < arg_len; i++)
+        {
+            if (arg[i] < '0' || arg[i] > '9')
+            {
+                return LL_ERROR_POLICY_SYNTAX;
+            }
+            port = port * 10 + (__u64)(arg[i] - '0');
+        }
+        return ll_policy_add_net_port(policy, port, masks[LL_RULESET_ACCESS_CLASS_NET]);
+    }
+    return LL_ERROR_POLICY_SYNTAX;
+}
+
+ll_error_t ll_policy_parse(ll_policy_t *const policy,
+                           const char *const text,
+                           const size_t len,
+                           size_t *const out_line)
+{
+    if (!policy || (!text && len > 0))
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    size_t line_no = 0;
+    size_t start = 0;
+    while (start < len)
+    {
+        const char *nl = memchr(text + start, '\n', len - start);
+        const size_t line_len = nl ? (size_t)(nl - (text + start)) : len - start;
+        line_no++;
+
+        const ll_error_t err = ll_policy_parse_line(policy, text + start, line_len);
+        if (LL_ERRORED(err))
+        {
+            if (out_line)
+            {
+                *out_line = line_no;
+            }
+            return err;
+        }
+        start += line_len + 1;
+    }
+    return LL_ERROR_OK;
+}
+
+/* Read a whole file into a NUL-terminated buffer to release with free(). */
+/* Read @p fd to its end into a NUL-terminated buffer; the descriptor stays open. */
+static char *ll_read_fd(const int fd, size_t *const out_len)
+{
+    size_t len = 0;
+    size_t capacity = 4096;
+    char *buf = malloc(capacity);
+    while (buf)
+    {
+        if (len + 1 == capacity)
+        {
+            char *grown = realloc(buf, capacity * 2);
+            if (!grown)
+            {
+                free(buf);
+                buf = NULL;
+                break;
+            }
+            buf = grown;
+            capacity *= 2;
+        }
+        const ssize_t n = read(fd, buf + len, capacity - len - 1);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n < 0)
+        {
+            free(buf);
+            buf = NULL;
+            break;
+        }
+        if (n == 0)
+        {
+            buf[len] = '\0';
+            break;
+        }
+        len += (size_t)n;
+    }
+    if (buf && out_len)
+    {
+        *out_len = len;
+    }
+    return buf;
+}
+
+static char *ll_read_file(const char *const path, size_t *const out_len)
+{
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    char *const buf = ll_read_fd(fd, out_len);
+    close(fd);
+    return buf;
+}
+
+ll_error_t ll_policy_load_file(ll_policy_t *const policy, const char *const path, size_t *const out_line)
+{
+    if (!policy || !path)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    size_t len = 0;
+    char *text = ll_read_file(path, &len);
+    if (!text)
+    {
+        return LL_ERROR_SYSTEM;
+    }
+    const ll_error_t err = ll_policy_parse(policy, text, len, out_line);
+    free(text);
+    return err;
+}
+
+struct ll_strbuf
+{
+    char *data;
+    size_t len;
+    size_t capacity;
+    int failed;
+};
+
+static void ll_strbuf_append(struct ll_strbuf *const buf, const char *const data, const size_t len)
+{
+    if (buf->failed)
+    {
+        return;
+    }
+    if (buf->len + len + 1 > buf->capacity)
+    {
+        size_t capacity = buf->capacity ? buf->capacity : 256;
+        while (buf->len + len + 1 > capacity)
+        {
+            capacity *= 2;
+        }
+        char *grown = realloc(buf->data, capacity);
+        if (!grown)
+        {
+            buf->failed = 1;
+            return;
+        }
+        buf->data = grown;
+        buf->capacity = capacity;
+    }
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    buf->data[buf->len] = '\0';
+}
+
+static void ll_strbuf_puts(struct ll_strbuf *const buf, const char *const str)
+{
+    ll_strbuf_append(buf, str, strlen(str));
+}
+
+static void ll_strbuf_put_u64(struct ll_strbuf *const buf, __u64 value)
+{
+    char digits[24];
+    size_t pos = sizeof(digits);
+    do
+    {
+        digits[--pos] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    ll_strbuf_append(buf, digits + pos, sizeof(digits) - pos);
+}
+
+static void ll_strbuf_put_access(struct ll_strbuf *const buf,
+                                 const __u64 fs_mask,
+                                 const __u64 net_mask,
+                                 const __u64 scope_mask)
+{
+    int first = 1;
+    for (size_t i = 0; i < sizeof(ll_access_names) / sizeof(ll_access_names[0]); i++)
+    {
+        const struct ll_access_name *name = &ll_access_names[i];
+        const __u64 mask = (name->access_class == LL_RULESET_ACCESS_CLASS_FS)    ? fs_mask
+                           : (name->access_class == LL_RULESET_ACCESS_CLASS_NET) ? net_mask
+                                                                                 : scope_mask;
+        if (mask & name->access)
+        {
+            if (!first)
+            {
+                ll_strbuf_puts(buf, ",");
+            }
+            ll_strbuf_puts(buf, name->name);
+            first = 0;
+        }
+    }
+}
+
+char *ll_policy_format(const ll_policy_t *const policy)
+{
+    if (!policy)
+    {
+        return NULL;
+    }
+
+    struct ll_strbuf buf = {NULL, 0, 0, 0};
+    ll_strbuf_append(&buf, "", 0);
+    if (policy->handled_access_fs | policy->handled_access_net | policy->handled_access_scope)
+    {
+        ll_strbuf_puts(&buf, "handle ");
+        ll_strbuf_put_access(&buf, policy->handled_access_fs, policy->handled_access_net,
+                             policy->handled_access_scope);
+        ll_strbuf_puts(&buf, "\n");
+    }
+    for (size_t i = 0; i < policy->path_count; i++)
+    {
+        if (policy->paths[i].access == 0)
+        {
+            continue;
+        }
+        ll_strbuf_puts(&buf, "path ");
+        ll_strbuf_put_access(&buf, policy->paths[i].access, 0, 0);
+        ll_strbuf_puts(&buf, " ");
+        ll_strbuf_puts(&buf, policy->paths[i].path);
+        ll_strbuf_puts(&buf, "\n");
+    }
+    for (size_t i = 0; i < policy->port_count; i++)
+    {
+        if (policy->ports[i].access == 0)
+        {
+            continue;
+        }
+        ll_strbuf_puts(&buf, "port ");
+        ll_strbuf_put_access(&buf, 0, policy->ports[i].access, 0);
+        ll_strbuf_puts(&buf, " ");
+        ll_strbuf_put_u64(&buf, policy->ports[i].port);
+        ll_strbuf_puts(&buf, "\n");
+    }
+
+    if (buf.failed)
+    {
+        free(buf.data);
+        return NULL;
+    }
+    return buf.data;
+}
+
+static ll_error_t ll_policy_apply_ports(const ll_policy_t *const policy,
+                                        const ll_ruleset_t *const ruleset,
+                                        size_t *const out_failed)
+{
+    for (size_t i = 0; i < policy->port_count; i++)
+    {
+        __u64 access = policy->ports[i].access;
+        if (ruleset->compat_mode == LL_ABI_COMPAT_BEST_EFFORT)
+        {
+            access &= ruleset->handled_access_net;
+            if (access == 0)
+            {
+                continue;
+            }
+        }
+
+        const ll_error_t err = ll_ruleset_add_net_port(ruleset, policy->ports[i].port, access, 0);
+        if (LL_ERRORED(err))
+        {
+            if (out_failed)
+            {
+                *out_failed = policy->path_count + i;
+            }
+            return err;
+        }
+    }
+    return LL_ERROR_OK;
+}
+
+ll_error_t ll_policy_apply(const ll_policy_t *const policy,
+                           const ll_ruleset_t *const ruleset,
+                           size_t *const out_failed)
+{
+    if (!policy || !ruleset)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    const ll_error_t err = ll_ruleset_add_paths(ruleset, policy->paths, policy->path_count, 0, out_failed);
+    if (LL_ERRORED(err))
+    {
+        return err;
+    }
+    return ll_policy_apply_ports(policy, ruleset, out_failed);
+}
+
+ll_ruleset_result_t ll_policy_create_ruleset(const ll_policy_t *const policy, const ll_ruleset_attr_t attr)
+{
+    ll_ruleset_result_t out = {.err = LL_ERROR_INVALID_ARGUMENT, .ruleset = NULL};
+    if (!policy)
+    {
+        return out;
+    }
+
+    out = ll_ruleset_create_result(ll_policy_attr(policy, attr));
+    if (LL_ERRORED(out.err))
+    {
+        return out;
+    }
+
+    const ll_error_t err = ll_policy_apply(policy, out.ruleset, NULL);
+    if (LL_ERRORED(err))
+    {
+        ll_ruleset_close(out.ruleset);
+        out.ruleset = NULL;
+        out.err = err;
+    }
+    return out;
+}
+
+/*
+ * Policy learning.
+ */
+
+#define LL_LEARN_MAX_DOMAINS 64
+
+struct ll_learner
+{
+    ll_ruleset_attr_t attr;
+    /* Observed (path, access) and (port, access) pairs, merged per path and port. */
+    ll_policy_t *observed;
+    size_t new_rules;
+    __u64 denials;
+    __u64 unresolved;
+
+    /* While running a workload, only denials from domains it created are learned. */
+    int filter_domains;
+    int workload_pid;
+    __u64 domains[LL_LEARN_MAX_DOMAINS];
+    size_t domain_count;
+};
+
+ll_error_t ll_learner_create(const ll_ruleset_attr_t attr, ll_learner_t **const out_learner)
+{
+    if (!out_learner)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    ll_learner_t *learner = calloc(1, sizeof(*learner));
+    if (!learner)
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    learner->attr = attr;
+    const ll_error_t err = ll_policy_create(&learner->observed);
+    if (LL_ERRORED(err))
+    {
+        free(learner);
+        return err;
+    }
+    (void)ll_policy_handle(learner->observed, attr.access.handled_access_fs, attr.access.handled_access_net,
+                           attr.access.scoped);
+
+    *out_learner = learner;
+    return LL_ERROR_OK;
+}
+
+void ll_learner_free(ll_learner_t *const learner)
+{
+    if (!learner)
+    {
+        return;
+    }
+
+    ll_policy_free(learner->observed);
+    free(learner);
+}
+
+static int ll_learner_domain_known(const ll_learner_t *const learner, const __u64 domain)
+{
+    for (size_t i = 0; i < learner->domain_count; i++)
+    {
+        if (learner->domains[i] == domain)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Rules can only be added on existing objects, and directory-only rights are
+ * rejected on files: attach the access to the nearest existing ancestor when
+ * the object is gone, and drop directory-only rights for non-directories.
+ */
+static void ll_learner_add_fs(ll_learner_t *const learner, const char *const path, __u64 access)
+{
+    const ll_path_rule_t *existing = ll_policy_find_path(learner->observed, path, strlen(path));
+    if (existing && (existing->access & access) == access)
+    {
+        return;
+    }
+
+    char resolved[4096];
+    const size_t len = strlen(path);
+    if (path[0] != '/' || len >= sizeof(resolved))
+    {
+        learner->unresolved++;
+        return;
+    }
+    memcpy(resolved, path, len + 1);
+
+    struct stat st;
+    while (stat(resolved, &st) != 0)
+    {
+        char *slash = strrchr(resolved, '/');
+        if (!slash)
+        {
+            learner->unresolved++;
+            return;
+        }
+        if (slash == resolved)
+        {
+            slash[1] = '\0';
+        }
+        else
+        {
+            *slash = '\0';
+        }
+    }
+    if (!S_ISDIR(st.st_mode))
+    {
+        access &= ~(__u64)LL_ACCESS_FS_DIR_ONLY;
+    }
+    if (access == 0)
+    {
+        learner->unresolved++;
+        return;
+    }
+
+    existing = ll_policy_find_path(learner->observed, resolved, strlen(resolved));
+    if (existing && (existing->access & access) == access)
+    {
+        return;
+    }
+    if (ll_policy_add_path(learner->observed, resolved, access) == LL_ERROR_OK)
+    {
+        learner->new_rules++;
+    }
+}
+
+void ll_learner_record_cb(const ll_audit_record_t *record, void *ctx)
+{
+    ll_learner_t *const learner = ctx;
+    if (!record || !learner)
+    {
+        return;
+    }
+
+    if (record->type == LL_AUDIT_LANDLOCK_DOMAIN)
+    {
+        if (learner->filter_domains && record->status && strcmp(record->status, "allocated") == 0 &&
+            record->pid == learner->workload_pid && learner->domain_count < LL_LEARN_MAX_DOMAINS &&
+            !ll_learner_domain_known(learner, record->domain))
+        {
+            learner->domains[learner->domain_count++] = record->domain;
+        }
+        return;
+    }
+    if (learner->filter_domains && !ll_learner_domain_known(learner, record->domain))
+    {
+        return;
+    }
+
+    learner->denials++;
+    const __u64 fs_access = record->access_fs & learner->attr.access.handled_access_fs;
+    const __u64 net_access = record->access_net & learner->attr.access.handled_access_net;
+    if (fs_access && record->path)
+    {
+        ll_learner_add_fs(learner, record->path, fs_access);
+    }
+    if (net_access && record->port <= 65535)
+    {
+        size_t count = 0;
+        const ll_port_rule_t *ports = ll_policy_ports(learner->observed, &count);
+        int known = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (ports[i].port == record->port && (ports[i].access & net_access) == net_access)
+            {
+                known = 1;
+                break;
+            }
+        }
+        if (!known && ll_policy_add_net_port(learner->observed, record->port, net_access) == LL_ERROR_OK)
+        {
+            learner->new_rules++;
+        }
+    }
+    if ((!fs_access || !record->path) && !net_access)
+    {
+        learner->unresolved++;
+    }
+}
+
+ll_error_t ll_learner_ingest_file(ll_learner_t *const learner, const char *const path)
+{
+    if (!learner || !path)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    ll_audit_reader_config_t config = ll_audit_reader_config_defaults();
+    config.on_record = ll_learner_record_cb;
+    config.ctx = learner;
+    ll_audit_reader_t *reader = NULL;
+    ll_error_t err = ll_audit_reader_create(&config, &reader);
+    if (LL_ERRORED(err))
+    {
+        return err;
+    }
+    err = ll_audit_reader_replay_file(reader, path);
+    ll_audit_reader_close(reader);
+    return err;
+}
+
+/* Fork and exec the workload under the rules learned so far; returns the child PID or -1. */
+static int ll_learner_spawn(const ll_learner_t *const learner, char *const argv[])
+{
+    const int pid = fork();
+    if (pid != 0)
+    {
+        return pid;
+    }
+
+    ll_ruleset_result_t res = ll_policy_create_ruleset(learner->observed, learner->attr);
+    if (LL_ERRORED(res.err))
+    {
+        _exit(126);
+    }
+    /* Denials before the exec, such as the workload's own execve(), are logged too. */
+    const ll_error_t err = ll_ruleset_enforce(res.ruleset, LANDLOCK_RESTRICT_SELF_LOG_NEW_EXEC_ON);
+    ll_ruleset_close(res.ruleset);
+    if (LL_ERRORED(err))
+    {
+        _exit(126);
+    }
+    ll_layer_export();
+    execvp(argv[0], argv);
+    _exit(127);
+}
+
+ll_error_t ll_learner_run(ll_learner_t *const learner,
+                          char *const argv[],
+                          const ll_learn_options_t *const options,
+                          ll_learn_report_t *const out_report)
+{
+    if (!learner || !argv || !argv[0])
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    const ll_learn_options_t opts = options ? *options : ll_learn_options_defaults();
+
+    ll_audit_reader_config_t config = ll_audit_reader_config_defaults();
+    config.on_record = ll_learner_record_cb;
+    config.ctx = learner;
+    ll_audit_reader_t *reader = NULL;
+    ll_error_t err = ll_audit_reader_create(&config, &reader);
+    if (LL_ERRORED(err))
+    {
+        return err;
+    }
+    err = ll_audit_reader_open_netlink(reader);
+    if (LL_ERRORED(err))
+    {
+        ll_audit_reader_close(reader);
+        return err;
+    }
+
+    ll_learn_report_t report;
+    memset(&report, 0, sizeof(report));
+    const __u64 denials_before = learner->denials;
+    const __u64 unresolved_before = learner->unresolved;
+
+    while (report.iterations < opts.max_iterations && !report.clean)
+    {
+        learner->new_rules = 0;
+        learner->domain_count = 0;
+        learner->filter_domains = 1;
+
+        const int pid = ll_learner_spawn(learner, argv);
+        if (pid < 0)
+        {
+            err = LL_ERROR_SYSTEM;
+            break;
+        }
+        learner->workload_pid = pid;
+        report.iterations++;
+
+        for (;;)
+        {
+            size_t count = 0;
+            err = ll_audit_reader_poll(reader, 50, &count);
+            if (LL_ERRORED(err))
+            {
+                break;
+            }
+            if (waitpid(pid, &report.exit_status, WNOHANG) == pid)
+            {
+                break;
+            }
+        }
+        if (LL_ERRORED(err))
+        {
+            (void)waitpid(pid, &report.exit_status, 0);
+            break;
+        }
+
+        /* Records can trail the workload's exit. */
+        const __u64 deadline = ll_monotonic_ms() + opts.settle_ms;
+        while (ll_monotonic_ms() < deadline)
+        {
+            err = ll_audit_reader_poll(reader, (int)(deadline - ll_monotonic_ms()), NULL);
+            if (LL_ERRORED(err))
+            {
+                break;
+            }
+        }
+        if (LL_ERRORED(err))
+        {
+            break;
+        }
+        /*
+         * 126: the ruleset could not be enforced. 127: the workload never ran,
+         * which is only worth another run if this one learned a rule, e.g. for
+         * its own binary. Neither is ever a clean run.
+         */
+        const int status = WIFEXITED(report.exit_status) ? WEXITSTATUS(report.exit_status) : 0;
+        if (status == 126 || status == 127)
+        {
+            if (status == 126 || learner->new_rules == 0)
+            {
+                err = LL_ERROR_SYSTEM;
+                break;
+            }
+            continue;
+        }
+        report.clean = (learner->new_rules == 0);
+    }
+
+    learner->filter_domains = 0;
+    ll_audit_reader_close(reader);
+    report.denials = learner->denials - denials_before;
+    report.unresolved = learner->unresolved - unresolved_before;
+    if (out_report)
+    {
+        *out_report = report;
+    }
+    return err;
+}
+
+/* Length of @p path's parent directory, 0 for entries of "/". */
+static size_t ll_path_parent_len(const char *const path)
+{
+    const char *const slash = strrchr(path, '/');
+    return slash ? (size_t)(slash - path) : 0;
+}
+
+/* Orders rules by parent directory, then by name, so that the files of one directory are adjacent. */
+static int ll_path_rule_parent_cmp(const void *a, const void *b)
+{
+    const char *const pa = ((const ll_path_rule_t *)a)->path;
+    const char *const pb = ((const ll_path_rule_t *)b)->path;
+    const size_t la = ll_path_parent_len(pa);
+    const size_t lb = ll_path_parent_len(pb);
+    const int cmp = strncmp(pa, pb, la < lb ? la : lb);
+    if (cmp != 0 || la == lb)
+    {
+        return cmp != 0 ? cmp : strcmp(pa + la, pb + lb);
+    }
+    return la < lb ? -1 : 1;
+}
+
+/* Union of the access granted to @p path by rules on its ancestors (and itself if @p include_self). */
+static __u64 ll_policy_beneath_access(const ll_policy_t *const policy, const char *const path, const int include_self)
+{
+    __u64 inherited = 0;
+    const ll_path_rule_t *root = (path[1] || include_self) ? ll_policy_find_path(policy, "/", 1) : NULL;
+    if (root)
+    {
+        inherited |= root->access;
+    }
+    size_t i = 1;
+    for (; path[i]; i++)
+    {
+        if (path[i] == '/')
+        {
+            const ll_path_rule_t *rule = ll_policy_find_path(policy, path, i);
+            if (rule)
+            {
+                inherited |= rule->access;
+            }
+        }
+    }
+    if (include_self && i > 1)
+    {
+        const ll_path_rule_t *rule = ll_policy_find_path(policy, path, i);
+        if (rule)
+        {
+            inherited |= rule->access;
+        }
+    }
+    return inherited;
+}
+
+ll_error_t ll_learner_emit(const ll_learner_t *const learner,
+                           const ll_learn_options_t *const options,
+                           ll_policy_t **const out_policy)
+{
+    if (!learner || !out_policy)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    const ll_learn_options_t opts = options ? *options : ll_learn_options_defaults();
+
+    size_t count = 0;
+    const ll_path_rule_t *observed = ll_policy_paths(learner->observed, &count);
+    ll_path_rule_t *sorted = malloc((count ? count : 1) * sizeof(*sorted));
+    if (!sorted)
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    if (count)
+    {
+        memcpy(sorted, observed, count * sizeof(*sorted));
+    }
+    qsort(sorted, count, sizeof(*sorted), ll_path_rule_parent_cmp);
+
+    /* Merge step: optionally collapse many file rules of one directory into a directory rule. */
+    ll_policy_t *merged = NULL;
+    ll_error_t err = ll_policy_create(&merged);
+    for (size_t i = 0; i < count && !LL_ERRORED(err);)
+    {
+        /* [i, end) holds every rule whose parent is this directory; only file rules count towards collapsing. */
+        const size_t dir_len = ll_path_parent_len(sorted[i].path);
+        size_t end = i;
+        size_t files = 0;
+        __u64 access = 0;
+        while (end < count && ll_path_parent_len(sorted[end].path) == dir_len &&
+               strncmp(sorted[end].path, sorted[i].path, dir_len) == 0)
+        {
+            if (!(sorted[end].access & LL_ACCESS_FS_DIR_ONLY))
+            {
+                access |= sorted[end].access;
+                files++;
+            }
+            end++;
+        }
+
+        const int collapse = opts.collapse_threshold > 0 && files >= opts.collapse_threshold;
+        if (collapse)
+        {
+            char dir[4096];
+            const size_t len = dir_len ? dir_len : 1;
+            memcpy(dir, sorted[i].path, len);
+            dir[len] = '\0';
+            err = ll_policy_add_path(merged, dir, access);
+        }
+        for (; i < end && !LL_ERRORED(err); i++)
+        {
+            if (!collapse || (sorted[i].access & LL_ACCESS_FS_DIR_ONLY))
+            {
+                err = ll_policy_add_path(merged, sorted[i].path, sorted[i].access);
+            }
+        }
+    }
+    free(sorted);
+
+    /* Prune step: drop rules fully covered by their ancestors. */
+    ll_policy_t *policy = NULL;
+    if (!LL_ERRORED(err))
+    {
+        err = ll_policy_create(&policy);
+    }
+    if (!LL_ERRORED(err))
+    {
+        (void)ll_policy_handle(policy, learner->observed->handled_access_fs, learner->observed->handled_access_net,
+                               learner->observed->handled_access_scope);
+        size_t merged_count = 0;
+        const ll_path_rule_t *rules = ll_policy_paths(merged, &merged_count);
+        for (size_t i = 0; i < merged_count && !LL_ERRORED(err); i++)
+        {
+            if ((ll_policy_beneath_access(merged, rules[i].path, 0) & rules[i].access) != rules[i].access)
+            {
+                err = ll_policy_add_path(policy, rules[i].path, rules[i].access);
+            }
+        }
+        size_t port_count = 0;
+        const ll_port_rule_t *ports = ll_policy_ports(learner->observed, &port_count);
+        for (size_t i = 0; i < port_count && !LL_ERRORED(err); i++)
+        {
+            err = ll_policy_add_net_port(policy, ports[i].port, ports[i].access);
+        }
+    }
+    ll_policy_free(merged);
+
+    if (LL_ERRORED(err))
+    {
+        ll_policy_free(policy);
+        return err;
+    }
+    *out_policy = policy;
+    return LL_ERROR_OK;
+}
+
+
+/*
+ * Policy evaluator.
+ *
+ * All layers share one prefix tree of path components. Edges live in a single
+ * open-addressing table keyed by (parent node, component), so each component of
+ * a query costs one hash and usually one probe. Nodes carrying rules point to a
+ * chain of (layer, access) grants. Port rules are one 65536-bit bitmap per
+ * layer and network access right.
+ */
+
+#define LL_EVAL_NO_NODE UINT32_MAX
+#define LL_PORT_WORDS (65536 / 64)
+
+struct ll_eval_node
+{
+    __u32 parent;
+    __u32 name_offset;
+    __u32 name_len;
+    __u32 grants;
+};
+
+struct ll_eval_grant
+{
+    __u32 layer;
+    __u32 next;
+    __u64 access;
+};
+
+struct ll_eval_layer
+{
+    __u64 handled_access_fs;
+    __u64 handled_access_net;
+    __u64 handled_access_scope;
+    __u64 *bind_ports;
+    __u64 *connect_ports;
+};
+
+struct ll_evaluator
+{
+    struct ll_eval_layer layers[LL_EVALUATOR_MAX_LAYERS];
+    size_t layer_count;
+
+    struct ll_eval_node *nodes;
+    size_t node_count;
+    size_t node_capacity;
+
+    __u32 *edges;
+    size_t edge_mask;
+
+    char *names;
+    size_t names_len;
+    size_t names_capacity;
+
+    struct ll_eval_grant *grants;
+    size_t grant_count;
+    size_t grant_capacity;
+};
+
+static __u64 ll_eval_edge_hash(const __u32 parent, const char *const name, const size_t len)
+{
+    return ll_hash_bytes(LL_HASH_INIT ^ ((__u64)parent * 0x9e3779b97f4a7c15ULL), name, len);
+}
+
+static __u32 ll_eval_find_child(const ll_evaluator_t *const evaluator,
+                                const __u32 parent,
+                                const char *const name,
+                                const size_t len)
+{
+    const __u64 hash = ll_eval_edge_hash(parent, name, len);
+    for (size_t probe = 0;; probe++)
+    {
+        const __u32 child = evaluator->edges[(hash + probe) & evaluator->edge_mask];
+        if (child == LL_EVAL_NO_NODE)
+        {
+            return LL_EVAL_NO_NODE;
+        }
+        const struct ll_eval_node *node = &evaluator->nodes[child];
+        if (node->parent == parent && node->name_len == len &&
+            memcmp(evaluator->names + node->name_offset, name, len) == 0)
+        {
+            return child;
+        }
+    }
+}
+
+static void ll_eval_insert_edge(ll_evaluator_t *const evaluator, const __u32 child)
+{
+    const struct ll_eval_node *node = &evaluator->nodes[child];
+    const __u64 hash = ll_eval_edge_hash(node->parent, evaluator->names + node->name_offset, node->name_len);
+    for (size_t probe = 0;; probe++)
+    {
+        __u32 *slot = &evaluator->edges[(hash + probe) & evaluator->edge_mask];
+        if (*slot == LL_EVAL_NO_NODE)
+        {
+            *slot = child;
+            return;
+        }
+    }
+}
+
+static ll_error_t ll_eval_grow_edges(ll_evaluator_t *const evaluator)
+{
+    const size_t size = (evaluator->edge_mask + 1) * 2;
+    __u32 *edges = malloc(size * sizeof(*edges));
+    if (!edges)
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    memset(edges, 0xff, size * sizeof(*edges));
+    free(evaluator->edges);
+    evaluator->edges = edges;
+    evaluator->edge_mask = size - 1;
+    /* Node 0 is the root and has no incoming edge. */
+    for (size_t i = 1; i < evaluator->node_count; i++)
+    {
+        ll_eval_insert_edge(evaluator, (__u32)i);
+    }
+    return LL_ERROR_OK;
+}
+
+static __u32 ll_eval_add_child(ll_evaluator_t *const evaluator,
+                               const __u32 parent,
+                               const char *const name,
+                               const size_t len)
+{
+    if ((evaluator->node_count + 1) * 2 > evaluator->edge_mask + 1 &&
+        LL_ERRORED(ll_eval_grow_edges(evaluator)))
+    {
+        return LL_EVAL_NO_NODE;
+    }
+    if (evaluator->node_count == evaluator->node_capacity)
+    {
+        const size_t capacity = evaluator->node_capacity * 2;
+        struct ll_eval_node *nodes = realloc(evaluator->nodes, capacity * sizeof(*nodes));
+        if (!nodes)
+        {
+            return LL_EVAL_NO_NODE;
+        }
+        evaluator->nodes = nodes;
+        evaluator->node_capacity = capacity;
+    }
+    if (evaluator->names_len + len > evaluator->names_capacity)
+    {
+        size_t capacity = evaluator->names_capacity;
+        while (evaluator->names_len + len > capacity)
+        {
+            capacity *= 2;
+        }
+        char *names = realloc(evaluator->names, capacity);
+        if (!names)
+        {
+            return LL_EVAL_NO_NODE;
+        }
+        evaluator->names = names;
+        evaluator->names_capacity = capacity;
+    }
+
+    memcpy(evaluator->names + evaluator->names_len, name, len);
+    const __u32 id = (__u32)evaluator->node_count++;
+    evaluator->nodes[id].parent = parent;
+    evaluator->nodes[id].name_offset = (__u32)evaluator->names_len;
+    evaluator->nodes[id].name_len = (__u32)len;
+    evaluator->nodes[id].grants = LL_EVAL_NO_NODE;
+    evaluator->names_len += len;
+    ll_eval_insert_edge(evaluator, id);
+    return id;
+}
+
+ll_error_t ll_evaluator_create(ll_evaluator_t **const out_evaluator)
+{
+    if (!out_evaluator)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    ll_evaluator_t *evaluator = calloc(1, sizeof(*evaluator));
+    if (!evaluator)
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    evaluator->node_capacity = 64;
+    evaluator->names_capacity = 1024;
+    evaluator->grant_capacity = 64;
+    evaluator->edge_mask = 127;
+    evaluator->nodes = malloc(evaluator->node_capacity * sizeof(*evaluator->nodes));
+    evaluator->names = malloc(evaluator->names_capacity);
+    evaluator->grants = malloc(evaluator->grant_capacity * sizeof(*evaluator->grants));
+    evaluator->edges = malloc((evaluator->edge_mask + 1) * sizeof(*evaluator->edges));
+    if (!evaluator->nodes || !evaluator->names || !evaluator->grants || !evaluator->edges)
+    {
+        ll_evaluator_free(evaluator);
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    memset(evaluator->edges, 0xff, (evaluator->edge_mask + 1) * sizeof(*evaluator->edges));
+
+    evaluator->nodes[0].parent = LL_EVAL_NO_NODE;
+    evaluator->nodes[0].name_offset = 0;
+    evaluator->nodes[0].name_len = 0;
+    evaluator->nodes[0].grants = LL_EVAL_NO_NODE;
+    evaluator->node_count = 1;
+
+    *out_evaluator = evaluator;
+    return LL_ERROR_OK;
+}
+
+void ll_evaluator_free(ll_evaluator_t *const evaluator)
+{
+    if (!evaluator)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < evaluator->layer_count; i++)
+    {
+        free(evaluator->layers[i].bind_ports);
+        free(evaluator->layers[i].connect_ports);
+    }
+    free(evaluator->nodes);
+    free(evaluator->names);
+    free(evaluator->grants);
+    free(evaluator->edges);
+    free(evaluator);
+}
+
+ll_error_t ll_evaluator_push_layer_masks(ll_evaluator_t *const evaluator,
+                                         const __u64 fs_mask,
+                                         const __u64 net_mask,
+                                         const __u64 scope_mask)
+{
+    if (!evaluator)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    if (evaluator->layer_count == LL_EVALUATOR_MAX_LAYERS)
+    {
+        return LL_ERROR_RESTRICT_LIMIT_REACHED;
+    }
+
+    struct ll_eval_layer *layer = &evaluator->layers[evaluator->layer_count];
+    memset(layer, 0, sizeof(*layer));
+    layer->handled_access_fs = fs_mask;
+    layer->handled_access_net = net_mask;
+    layer->handled_access_scope = scope_mask;
+    if (net_mask)
+    {
+        layer->bind_ports = calloc(LL_PORT_WORDS, sizeof(__u64));
+        layer->connect_ports = calloc(LL_PORT_WORDS, sizeof(__u64));
+        if (!layer->bind_ports || !layer->connect_ports)
+        {
+            free(layer->bind_ports);
+            free(layer->connect_ports);
+            return LL_ERROR_OUT_OF_MEMORY;
+        }
+    }
+    evaluator->layer_count++;
+    return LL_ERROR_OK;
+}
+
+ll_error_t ll_evaluator_push_layer(ll_evaluator_t *const evaluator, const ll_ruleset_t *const ruleset)
+{
+    if (!ruleset)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    return ll_evaluator_push_layer_masks(evaluator, ruleset->handled_access_fs, ruleset->handled_access_net,
+                                         ruleset->handled_access_scope);
+}
+
+/*
+ * Discard the top layer and the grants added since there were @p grant_count.
+ * A layer's grants are the newest ones and head their nodes' lists. Nodes
+ * created for its paths stay in the tree; without grants they allow nothing.
+ */
+static void ll_eval_pop_layer(ll_evaluator_t *const evaluator, const size_t grant_count)
+{
+    for (size_t n = 0; n < evaluator->node_count; n++)
+    {
+        struct ll_eval_node *node = &evaluator->nodes[n];
+        while (node->grants != LL_EVAL_NO_NODE && node->grants >= grant_count)
+        {
+            node->grants = evaluator->grants[node->grants].next;
+        }
+    }
+    evaluator->grant_count = grant_count;
+
+    struct ll_eval_layer *layer = &evaluator->layers[--evaluator->layer_count];
+    free(layer->bind_ports);
+    free(layer->connect_ports);
+    memset(layer, 0, sizeof(*layer));
+}
+
+ll_error_t ll_evaluator_push_policy(ll_evaluator_t *const evaluator, const ll_policy_t *const policy)
+{
+    if (!policy)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    ll_error_t err = ll_evaluator_push_layer_masks(evaluator, policy->handled_access_fs,
+                                                   policy->handled_access_net, policy->handled_access_scope);
+    if (LL_ERRORED(err))
+    {
+        return err;
+    }
+    const size_t grant_count = evaluator->grant_count;
+    for (size_t i = 0; i < policy->path_count && !LL_ERRORED(err); i++)
+    {
+        err = ll_evaluator_add_path(evaluator, policy->paths[i].path, policy->paths[i].access);
+    }
+    for (size_t i = 0; i < policy->port_count && !LL_ERRORED(err); i++)
+    {
+        err = ll_evaluator_add_net_port(evaluator, policy->ports[i].port, policy->ports[i].access);
+    }
+    if (LL_ERRORED(err))
+    {
+        ll_eval_pop_layer(evaluator, grant_count);
+    }
+    return err;
+}
+
+/* Advance to the next path component; returns its length, or 0 at the end. */
+static size_t ll_next_component(const char **const cursor)
+{
+    const char *p = *cursor;
+    for (;;)
+    {
+        while (*p == '/')
+        {
+            p++;
+        }
+        if (p[0] == '.' && (p[1] == '/' || p[1] == '\0'))
+        {
+            p++;
+            continue;
+        }
+        break;
+    }
+    const char *start = p;
+    while (*p && *p != '/')
+    {
+        p++;
+    }
+    *cursor = start;
+    return (size_t)(p - start);
+}
+
+ll_error_t ll_evaluator_add_path(ll_evaluator_t *const evaluator, const char *const path, const __u64 access_masks)
+{
+    if (!evaluator || !path || path[0] != '/' || evaluator->layer_count == 0)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    const __u32 layer = (__u32)(evaluator->layer_count - 1);
+    if ((access_masks & ~evaluator->layers[layer].handled_access_fs) != 0)
+    {
+        return LL_ERROR_ADD_RULE_INCONSISTENT_ACCESS;
+    }
+
+    __u32 node = 0;
+    const char *cursor = path;
+    for (size_t len; (len = ll_next_component(&cursor)) != 0; cursor += len)
+    {
+        if (len == 2 && cursor[0] == '.' && cursor[1] == '.')
+        {
+            return LL_ERROR_INVALID_ARGUMENT;
+        }
+        __u32 child = ll_eval_find_child(evaluator, node, cursor, len);
+        if (child == LL_EVAL_NO_NODE)
+        {
+            child = ll_eval_add_child(evaluator, node, cursor, len);
+            if (child == LL_EVAL_NO_NODE)
+            {
+                return LL_ERROR_OUT_OF_MEMORY;
+            }
+        }
+        node = child;
+    }
+
+    struct ll_eval_node *target = &evaluator->nodes[node];
+    for (__u32 g = target->grants; g != LL_EVAL_NO_NODE; g = evaluator->grants[g].next)
+    {
+        if (evaluator->grants[g].layer == layer)
+        {
+            evaluator->grants[g].access |= access_masks;
+            return LL_ERROR_OK;
+        }
+    }
+    if (evaluator->grant_count == evaluator->grant_capacity)
+    {
+        const size_t capacity = evaluator->grant_capacity * 2;
+        struct ll_eval_grant *grants = realloc(evaluator->grants, capacity * sizeof(*grants));
+        if (!grants)
+        {
+            return LL_ERROR_OUT_OF_MEMORY;
+        }
+        evaluator->grants = grants;
+        evaluator->grant_capacity = capacity;
+    }
+    const __u32 g = (__u32)evaluator->grant_count++;
+    evaluator->grants[g].layer = layer;
+    evaluator->grants[g].access = access_masks;
+    evaluator->grants[g].next = target->grants;
+    target->grants = g;
+    return LL_ERROR_OK;
+}
+
+ll_error_t ll_evaluator_add_net_port(ll_evaluator_t *const evaluator, const __u64 port, const __u64 access_masks)
+{
+    if (!evaluator || evaluator->layer_count == 0)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    if (port > 65535)
+    {
+        return LL_ERROR_ADD_RULE_PORT_OUT_OF_RANGE;
+    }
+    struct ll_eval_layer *layer = &evaluator->layers[evaluator->layer_count - 1];
+    if ((access_masks & ~layer->handled_access_net) != 0)
+    {
+        return LL_ERROR_ADD_RULE_INCONSISTENT_ACCESS;
+    }
+
+    const __u64 bit = 1ULL << (port % 64);
+    if (access_masks & LANDLOCK_ACCESS_NET_BIND_TCP)
+    {
+        layer->bind_ports[port / 64] |= bit;
+    }
+    if (access_masks & LANDLOCK_ACCESS_NET_CONNECT_TCP)
+    {
+        layer->connect_ports[port / 64] |= bit;
+    }
+    return LL_ERROR_OK;
+}
+
+static void ll_eval_collect(const ll_evaluator_t *const evaluator, const __u32 node, __u64 *const allowed)
+{
+    for (__u32 g = evaluator->nodes[node].grants; g != LL_EVAL_NO_NODE; g = evaluator->grants[g].next)
+    {
+        allowed[evaluator->grants[g].layer] |= evaluator->grants[g].access;
+    }
+}
+
+int ll_evaluator_check_path(const ll_evaluator_t *const evaluator, const char *const path, const __u64 access)
+{
+    if (!evaluator || !path || path[0] != '/')
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    __u64 allowed[LL_EVALUATOR_MAX_LAYERS];
+    memset(allowed, 0, evaluator->layer_count * sizeof(allowed[0]));
+
+    __u32 node = 0;
+    ll_eval_collect(evaluator, node, allowed);
+    const char *cursor = path;
+    for (size_t len; (len = ll_next_component(&cursor)) != 0; cursor += len)
+    {
+        if (len == 2 && cursor[0] == '.' && cursor[1] == '.')
+        {
+            return LL_ERROR_INVALID_ARGUMENT;
+        }
+        if (node == LL_EVAL_NO_NODE)
+        {
+            continue;
+        }
+        node = ll_eval_find_child(evaluator, node, cursor, len);
+        if (node != LL_EVAL_NO_NODE)
+        {
+            ll_eval_collect(evaluator, node, allowed);
+        }
+    }
+
+    for (size_t i = 0; i < evaluator->layer_count; i++)
+    {
+        /* LANDLOCK_ACCESS_FS_REFER is denied by any layer, whether it handles it or not. */
+        const __u64 handled = evaluator->layers[i].handled_access_fs | LANDLOCK_ACCESS_FS_REFER;
+        const __u64 required = access & handled;
+        if ((allowed[i] & required) != required)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int ll_evaluator_check_net_port(const ll_evaluator_t *const evaluator, const __u64 port, const __u64 access)
+{
+    if (!evaluator || port > 65535)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    const __u64 bit = 1ULL << (port % 64);
+    for (size_t i = 0; i < evaluator->layer_count; i++)
+    {
+        const struct ll_eval_layer *layer = &evaluator->layers[i];
+        const __u64 required = access & layer->handled_access_net;
+        if ((required & LANDLOCK_ACCESS_NET_BIND_TCP) && !(layer->bind_ports[port / 64] & bit))
+        {
+            return 0;
+        }
+        if ((required & LANDLOCK_ACCESS_NET_CONNECT_TCP) && !(layer->connect_ports[port / 64] & bit))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+/*
+ * Port sets.
+ */
+
+struct ll_portset
+{
+    __u64 bind_ports[LL_PORT_WORDS];
+    __u64 connect_ports[LL_PORT_WORDS];
+};
+
+#define LL_ACCESS_NET_ALL (LANDLOCK_ACCESS_NET_BIND_TCP | LANDLOCK_ACCESS_NET_CONNECT_TCP)
+
+ll_error_t ll_portset_create(ll_portset_t **const out_set)
+{
+    if (!out_set)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    ll_portset_t *set = calloc(1, sizeof(*set));
+    if (!set)
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    *out_set = set;
+    return LL_ERROR_OK;
+}
+
+void ll_portset_free(ll_portset_t *const set)
+{
+    free(set);
+}
+
+static void ll_bitmap_set_range(__u64 *const words, const size_t first, const size_t last)
+{
+    const size_t first_word = first / 64;
+    const size_t last_word = last / 64;
+    const __u64 head = ~0ULL << (first % 64);
+    const __u64 tail = ~0ULL >> (63 - last % 64);
+
+    if (first_word == last_word)
+    {
+        words[first_word] |= head & tail;
+        return;
+    }
+    words[first_word] |= head;
+    for (size_t w = first_word + 1; w < last_word; w++)
+    {
+        words[w] = ~0ULL;
+    }
+    words[last_word] |= tail;
+}
+
+static void ll_portset_set_range(ll_portset_t *const set, const __u64 first, const __u64 last, const __u64 access)
+{
+    if (access & LANDLOCK_ACCESS_NET_BIND_TCP)
+    {
+        ll_bitmap_set_range(set->bind_ports, (size_t)first, (size_t)last);
+    }
+    if (access & LANDLOCK_ACCESS_NET_CONNECT_TCP)
+    {
+        ll_bitmap_set_range(set->connect_ports, (size_t)first, (size_t)last);
+    }
+}
+
+ll_error_t ll_portset_add_range(ll_portset_t *const set, const __u64 first, const __u64 last, const __u64 access)
+{
+    if (!set || first > last || access == 0 || (access & ~(__u64)LL_ACCESS_NET_ALL) != 0)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    if (last > 65535)
+    {
+        return LL_ERROR_ADD_RULE_PORT_OUT_OF_RANGE;
+    }
+
+    ll_portset_set_range(set, first, last, access);
+    return LL_ERROR_OK;
+}
+
+ll_error_t ll_portset_add_list(ll_portset_t *const set,
+                               const __u64 *const ports,
+                               const size_t count,
+                               const __u64 access,
+                               size_t *const out_invalid)
+{
+    if (!set || (!ports && count > 0) || access == 0 || (access & ~(__u64)LL_ACCESS_NET_ALL) != 0)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (ports[i] > 65535)
+        {
+            if (out_invalid)
+            {
+                *out_invalid = i;
+            }
+            return LL_ERROR_ADD_RULE_PORT_OUT_OF_RANGE;
+        }
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        const __u64 bit = 1ULL << (ports[i] % 64);
+        if (access & LANDLOCK_ACCESS_NET_BIND_TCP)
+        {
+            set->bind_ports[ports[i] / 64] |= bit;
+        }
+        if (access & LANDLOCK_ACCESS_NET_CONNECT_TCP)
+        {
+            set->connect_ports[ports[i] / 64] |= bit;
+        }
+    }
+    return LL_ERROR_OK;
+}
+
+/*
+ * Resolve a TCP service name through the services database; returns -1 if
+ * unknown. Uses the reentrant lookup, since port sets may be built on
+ * several threads at once.
+ */
+static long ll_service_port(const char *const name, const size_t len)
+{
+    char buf[64];
+    if (len == 0 || len >= sizeof(buf))
+    {
+        return -1;
+    }
+    memcpy(buf, name, len);
+    buf[len] = '\0';
+
+    struct servent storage;
+    struct servent *entry = NULL;
+    char strings[1024];
+    if (getservbyname_r(buf, "tcp", &storage, strings, sizeof(strings), &entry) != 0 || !entry)
+    {
+        return -1;
+    }
+    return (long)ntohs((unsigned short)entry->s_port);
+}
+
+ll_error_t ll_portset_add_service(ll_portset_t *const set, const char *const name, const __u64 access)
+{
+    if (!set || !name)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    const long port = ll_service_port(name, strlen(name));
+    if (port < 0)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    return ll_portset_add_range(set, (__u64)port, (__u64)port, access);
+}
+
+/* Parse a decimal port number; returns 0 on success. Values above 65535 are kept for range errors. */
+static int ll_parse_port_number(const char *const s, const size_t len, __u64 *const out)
+{
+    if (len == 0 || len > 10)
+    {
+        return -1;
+    }
+    __u64 value = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (s[i] < '0' || s[i] > '9')
+        {
+            return -1;
+        }
+        value = value * 10 + (__u64)(s[i] - '0');
+    }
+    *out = value;
+    return 0;
+}
+
+/* Parse one item of a port specification into an inclusive range. */
+static ll_error_t ll_parse_port_item(const char *const item, const size_t len, __u64 *const first, __u64 *const last)
+{
+    const char *dash = memchr(item, '-', len);
+    if (dash && ll_parse_port_number(item, (size_t)(dash - item), first) == 0)
+    {
+        if (ll_parse_port_number(dash + 1, len - (size_t)(dash - item) - 1, last) != 0 || *first > *last)
+        {
+            return LL_ERROR_INVALID_ARGUMENT;
+        }
+    }
+    else if (ll_parse_port_number(item, len, first) == 0)
+    {
+        *last = *first;
+    }
+    else
+    {
+        const long port = ll_service_port(item, len);
+        if (port < 0)
+        {
+            return LL_ERROR_INVALID_ARGUMENT;
+        }
+        *first = (__u64)port;
+        *last = (__u64)port;
+    }
+    return (*last > 65535) ? LL_ERROR_ADD_RULE_PORT_OUT_OF_RANGE : LL_ERROR_OK;
+}
+
+ll_error_t ll_portset_parse(ll_portset_t *const set, const char *const spec, const __u64 access, size_t *const out_offset)
+{
+    if (!set || !spec || access == 0 || (access & ~(__u64)LL_ACCESS_NET_ALL) != 0)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    /* Validate everything first so that a bad item leaves the set untouched. */
+    for (int pass = 0; pass < 2; pass++)
+    {
+        const char *item = spec;
+        while (*item)
+        {
+            while (*item == ' ' || *item == ',')
+            {
+                item++;
+            }
+            if (!*item)
+            {
+                break;
+            }
+            size_t len = 0;
+            while (item[len] && item[len] != ',' && item[len] != ' ')
+            {
+                len++;
+            }
+
+            __u64 first = 0;
+            __u64 last = 0;
+            const ll_error_t err = ll_parse_port_item(item, len, &first, &last);
+            if (LL_ERRORED(err))
+            {
+                if (out_offset)
+                {
+                    *out_offset = (size_t)(item - spec);
+                }
+                return err;
+            }
+            if (pass == 1)
+            {
+                ll_portset_set_range(set, first, last, access);
+            }
+            item += len;
+        }
+    }
+    return LL_ERROR_OK;
+}
+
+__u64 ll_portset_access(const ll_portset_t *const set, const __u64 port)
+{
+    if (!set || port > 65535)
+    {
+        return 0;
+    }
+
+    __u64 access = 0;
+    if (set->bind_ports[port / 64] & (1ULL << (port % 64)))
+    {
+        access |= LANDLOCK_ACCESS_NET_BIND_TCP;
+    }
+    if (set->connect_ports[port / 64] & (1ULL << (port % 64)))
+    {
+        access |= LANDLOCK_ACCESS_NET_CONNECT_TCP;
+    }
+    return access;
+}
+
+size_t ll_portset_count(const ll_portset_t *const set)
+{
+    if (!set)
+    {
+        return 0;
+    }
+
+    size_t count = 0;
+    for (size_t w = 0; w < LL_PORT_WORDS; w++)
+    {
+        count += (size_t)__builtin_popcountll(set->bind_ports[w] | set->connect_ports[w]);
+    }
+    return count;
+}
+
+ll_error_t ll_ruleset_add_portset(const ll_ruleset_t *const ruleset,
+                                  const ll_portset_t *const set,
+                                  const __u32 flags,
+                                  size_t *const out_rules)
+{
+    if (!ruleset || !set)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    __u64 bind_mask = ~0ULL;
+    __u64 connect_mask = ~0ULL;
+    if (ruleset->compat_mode == LL_ABI_COMPAT_BEST_EFFORT)
+    {
+        bind_mask = (ruleset->handled_access_net & LANDLOCK_ACCESS_NET_BIND_TCP) ? ~0ULL : 0;
+        connect_mask = (ruleset->handled_access_net & LANDLOCK_ACCESS_NET_CONNECT_TCP) ? ~0ULL : 0;
+    }
+
+    size_t rules = 0;
+    ll_error_t err = LL_ERROR_OK;
+    for (size_t w = 0; w < LL_PORT_WORDS && !LL_ERRORED(err); w++)
+    {
+        const __u64 bind = set->bind_ports[w] & bind_mask;
+        const __u64 connect = set->connect_ports[w] & connect_mask;
+        __u64 any = bind | connect;
+        while (any)
+        {
+            const unsigned int bit = (unsigned int)__builtin_ctzll(any);
+            const __u64 access = (((bind >> bit) & 1) ? LANDLOCK_ACCESS_NET_BIND_TCP : 0) |
+                                 (((connect >> bit) & 1) ? LANDLOCK_ACCESS_NET_CONNECT_TCP : 0);
+            err = ll_ruleset_add_net_port(ruleset, (__u64)(w * 64 + bit), access, flags);
+            if (LL_ERRORED(err))
+            {
+                break;
+            }
+            rules++;
+            any &= any - 1;
+        }
+    }
+
+    if (out_rules)
+    {
+        *out_rules = rules;
+    }
+    return err;
+}
+
+ll_error_t ll_evaluator_add_portset(ll_evaluator_t *const evaluator, const ll_portset_t *const set)
+{
+    if (!evaluator || !set || evaluator->layer_count == 0)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    struct ll_eval_layer *layer = &evaluator->layers[evaluator->layer_count - 1];
+    __u64 used = 0;
+    for (size_t w = 0; w < LL_PORT_WORDS; w++)
+    {
+        if (set->bind_ports[w])
+        {
+            used |= LANDLOCK_ACCESS_NET_BIND_TCP;
+        }
+        if (set->connect_ports[w])
+        {
+            used |= LANDLOCK_ACCESS_NET_CONNECT_TCP;
+        }
+    }
+    if ((used & ~layer->handled_access_net) != 0)
+    {
+        return LL_ERROR_ADD_RULE_INCONSISTENT_ACCESS;
+    }
+    if (used == 0)
+    {
+        return LL_ERROR_OK;
+    }
+
+    for (size_t w = 0; w < LL_PORT_WORDS; w++)
+    {
+        layer->bind_ports[w] |= set->bind_ports[w];
+        layer->connect_ports[w] |= set->connect_ports[w];
+    }
+    return LL_ERROR_OK;
+}
+
+
+/*
+ * Policy stacking.
+ *
+ * Stacking A then B allows right r on x iff every layer handling r grants it
+ * on x or an ancestor. Because two ancestors of x are themselves ordered, a
+ * single layer where each rule of A keeps r only if B does not handle r or
+ * grants it at or above that rule (and symmetrically for B) allows exactly the
+ * same accesses. LANDLOCK_ACCESS_FS_REFER is treated as handled by every layer,
+ * matching the kernel. Scopes can only be unioned, which is stricter than
+ * stacking for processes outside the merged domain.
+ */
+
+static ll_error_t ll_policy_merge_pair(const ll_policy_t *const a, const ll_policy_t *const b, ll_policy_t *const out)
+{
+    ll_error_t err = ll_policy_handle(out, a->handled_access_fs | b->handled_access_fs,
+                                      a->handled_access_net | b->handled_access_net,
+                                      a->handled_access_scope | b->handled_access_scope);
+    const ll_policy_t *sides[2][2] = {{a, b}, {b, a}};
+    for (size_t side = 0; side < 2 && !LL_ERRORED(err); side++)
+    {
+        const ll_policy_t *self = sides[side][0];
+        const ll_policy_t *other = sides[side][1];
+        const __u64 other_fs = other->handled_access_fs | LANDLOCK_ACCESS_FS_REFER;
+
+        for (size_t i = 0; i < self->path_count && !LL_ERRORED(err); i++)
+        {
+            const ll_path_rule_t *rule = &self->paths[i];
+            const __u64 access = rule->access & (~other_fs | ll_policy_beneath_access(other, rule->path, 1));
+            if (access)
+            {
+                err = ll_policy_add_path(out, rule->path, access);
+            }
+        }
+        for (size_t i = 0; i < self->port_count && !LL_ERRORED(err); i++)
+        {
+            const ll_port_rule_t *rule = &self->ports[i];
+            __u64 other_access = 0;
+            for (size_t j = 0; j < other->port_count; j++)
+            {
+                if (other->ports[j].port == rule->port)
+                {
+                    other_access |= other->ports[j].access;
+                }
+            }
+            const __u64 access = rule->access & (~other->handled_access_net | other_access);
+            if (access)
+            {
+                err = ll_policy_add_net_port(out, rule->port, access);
+            }
+        }
+    }
+    return err;
+}
+
+ll_error_t ll_policy_merge(const ll_policy_t *const *const steps,
+                           const size_t count,
+                           ll_policy_t **const out_policy,
+                           int *const out_exact)
+{
+    if (!steps || count == 0 || !out_policy)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!steps[i])
+        {
+            return LL_ERROR_INVALID_ARGUMENT;
+        }
+    }
+
+    ll_policy_t *merged = NULL;
+    ll_error_t err = ll_policy_create(&merged);
+    if (LL_ERRORED(err))
+    {
+        return err;
+    }
+    /* Start from an empty policy that handles nothing, which stacks as a no-op. */
+    int scoped_steps = 0;
+    for (size_t i = 0; i < count && !LL_ERRORED(err); i++)
+    {
+        ll_policy_t *next = NULL;
+        err = ll_policy_create(&next);
+        if (!LL_ERRORED(err))
+        {
+            err = ll_policy_merge_pair(merged, steps[i], next);
+        }
+        ll_policy_free(merged);
+        merged = next;
+        if (steps[i]->handled_access_scope)
+        {
+            scoped_steps++;
+        }
+    }
+
+    if (LL_ERRORED(err))
+    {
+        ll_policy_free(merged);
+        return err;
+    }
+    if (out_exact)
+    {
+        *out_exact = (count == 1 || scoped_steps == 0);
+    }
+    *out_policy = merged;
+    return LL_ERROR_OK;
+}
+
+ll_error_t ll_policy_enforce_stack(const ll_policy_t *const *const steps,
+                                   const size_t count,
+                                   const ll_ruleset_attr_t attr,
+                                   const __u32 flags,
+                                   unsigned int *const out_layers)
+{
+    if (out_layers)
+    {
+        *out_layers = 0;
+    }
+
+    ll_policy_t *merged = NULL;
+    int exact = 0;
+    ll_error_t err = ll_policy_merge(steps, count, &merged, &exact);
+    if (LL_ERRORED(err))
+    {
+        return err;
+    }
+
+    const ll_policy_t *const *layers = steps;
+    size_t layer_count = count;
+    if (exact)
+    {
+        layers = (const ll_policy_t *const *)&merged;
+        layer_count = 1;
+    }
+
+    /* Build every layer before enforcing any, so a build failure leaves the process unchanged. */
+    ll_ruleset_t **rulesets = calloc(layer_count, sizeof(*rulesets));
+    if (!rulesets)
+    {
+        ll_policy_free(merged);
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    /* Any layer built best-effort makes the whole stack partial. */
+    ll_error_t partial = LL_ERROR_OK;
+    for (size_t i = 0; i < layer_count && !LL_ERRORED(err); i++)
+    {
+        ll_ruleset_result_t res = ll_policy_create_ruleset(layers[i], attr);
+        err = res.err;
+        rulesets[i] = res.ruleset;
+        if (err == LL_ERROR_OK_PARTIAL_SANDBOX)
+        {
+            partial = err;
+        }
+    }
+    for (size_t i = 0; i < layer_count && !LL_ERRORED(err); i++)
+    {
+        err = ll_ruleset_enforce(rulesets[i], flags);
+        if (!LL_ERRORED(err) && out_layers)
+        {
+            (*out_layers)++;
+        }
+    }
+    for (size_t i = 0; i < layer_count; i++)
+    {
+        ll_ruleset_close(rulesets[i]);
+    }
+    free(rulesets);
+    ll_policy_free(merged);
+
+    if (LL_ERRORED(err))
+    {
+        return err;
+    }
+    return partial;
+}
+
+
+/*
+ * Phased sandbox. Every phase ruleset is built while the process is still
+ * unrestricted, so a transition is one landlock_restrict_self() call.
+ */
+
+struct ll_phases
+{
+    ll_ruleset_attr_t attr;
+    __u32 flags;
+    int sealed;
+    ll_ruleset_t **rulesets;
+    size_t count;
+    size_t capacity;
+    size_t current;
+    /* What the phases added so far allow when stacked, for the subset checks. */
+    ll_policy_t *cumulative;
+};
+
+/* Non-zero if @p cur grants access that @p prev denies, i.e. part of @p cur is dead once stacked. */
+static int ll_policy_grants_beyond(const ll_policy_t *const cur, const ll_policy_t *const prev)
+{
+    const __u64 prev_fs = prev->handled_access_fs | LANDLOCK_ACCESS_FS_REFER;
+    for (size_t i = 0; i < cur->path_count; i++)
+    {
+        const ll_path_rule_t *rule = &cur->paths[i];
+        if (rule->access & prev_fs & ~ll_policy_beneath_access(prev, rule->path, 1))
+        {
+            return 1;
+        }
+    }
+    for (size_t i = 0; i < cur->port_count; i++)
+    {
+        __u64 prev_access = 0;
+        for (size_t j = 0; j < prev->port_count; j++)
+        {
+            if (prev->ports[j].port == cur->ports[i].port)
+            {
+                prev_access |= prev->ports[j].access;
+            }
+        }
+        if (cur->ports[i].access & prev->handled_access_net & ~prev_access)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Non-zero if stacking @p cur on top of @p prev denies anything @p prev allows. */
+static int ll_policy_restricts(const ll_policy_t *const cur, const ll_policy_t *const prev)
+{
+    if ((cur->handled_access_scope & ~prev->handled_access_scope) != 0 ||
+        (cur->handled_access_net & ~prev->handled_access_net) != 0)
+    {
+        return 1;
+    }
+    /* Rights only @p cur handles are restricted unless granted on the whole tree. */
+    const __u64 new_fs = cur->handled_access_fs & ~prev->handled_access_fs;
+    if ((new_fs & ~ll_policy_beneath_access(cur, "/", 1)) != 0)
+    {
+        return 1;
+    }
+    for (size_t i = 0; i < prev->path_count; i++)
+    {
+        const ll_path_rule_t *rule = &prev->paths[i];
+        const __u64 cur_fs = cur->handled_access_fs | LANDLOCK_ACCESS_FS_REFER;
+        if (rule->access & cur_fs & ~ll_policy_beneath_access(cur, rule->path, 1))
+        {
+            return 1;
+        }
+    }
+    for (size_t i = 0; i < prev->port_count; i++)
+    {
+        __u64 cur_access = 0;
+        for (size_t j = 0; j < cur->port_count; j++)
+        {
+            if (cur->ports[j].port == prev->ports[i].port)
+            {
+                cur_access |= cur->ports[j].access;
+            }
+        }
+        if (prev->ports[i].access & cur->handled_access_net & ~cur_access)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+ll_error_t ll_phases_create(const ll_ruleset_attr_t attr, const __u32 flags, ll_phases_t **const out_phases)
+{
+    if (!out_phases)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    *out_phases = NULL;
+
+    ll_phases_t *phases = calloc(1, sizeof(*phases));
+    if (!phases)
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    phases->attr = attr;
+    phases->flags = flags;
+    *out_phases = phases;
+    return LL_ERROR_OK;
+}
+
+void ll_phases_free(ll_phases_t *const phases)
+{
+    if (!phases)
+    {
+        return;
+    }
+    for (size_t i = 0; i < phases->count; i++)
+    {
+        ll_ruleset_close(phases->rulesets[i]);
+    }
+    free(phases->rulesets);
+    ll_policy_free(phases->cumulative);
+    free(phases);
+}
+
+ll_error_t ll_phases_add(ll_phases_t *const phases, const ll_policy_t *const policy, unsigned int *const out_warnings)
+{
+    if (out_warnings)
+    {
+        *out_warnings = 0;
+    }
+    if (!phases || !policy || phases->sealed)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    unsigned int warnings = 0;
+    if (phases->cumulative)
+    {
+        if (ll_policy_grants_beyond(policy, phases->cumulative))
+        {
+            warnings |= LL_PHASE_WARN_NOT_SUBSET;
+        }
+        if (!ll_policy_restricts(policy, phases->cumulative))
+        {
+            warnings |= LL_PHASE_WARN_NO_EFFECT;
+        }
+    }
+    if (phases->count + 1 > ll_layer_report().remaining)
+    {
+        warnings |= LL_PHASE_WARN_LAYER_BUDGET;
+    }
+
+    if (phases->count == phases->capacity)
+    {
+        const size_t capacity = phases->capacity ? phases->capacity * 2 : 4;
+        ll_ruleset_t **rulesets = realloc(phases->rulesets, capacity * sizeof(*rulesets));
+        if (!rulesets)
+        {
+            return LL_ERROR_OUT_OF_MEMORY;
+        }
+        phases->rulesets = rulesets;
+        phases->capacity = capacity;
+    }
+
+    const ll_policy_t *steps[2] = {phases->cumulative, policy};
+    ll_policy_t *cumulative = NULL;
+    ll_error_t err = phases->cumulative ? ll_policy_merge(steps, 2, &cumulative, NULL)
+                                        : ll_policy_merge(&steps[1], 1, &cumulative, NULL);
+    if (LL_ERRORED(err))
+    {
+        return err;
+    }
+
+    ll_ruleset_result_t res = ll_policy_create_ruleset(policy, phases->attr);
+    if (LL_ERRORED(res.err))
+    {
+        ll_policy_free(cumulative);
+        return res.err;
+    }
+    phases->rulesets[phases->count++] = res.ruleset;
+    ll_policy_free(phases->cumulative);
+    phases->cumulative = cumulative;
+
+    if (out_warnings)
+    {
+        *out_warnings = warnings;
+    }
+    return res.err;
+}
+
+ll_error_t ll_phases_seal(ll_phases_t *const phases)
+{
+    if (!phases || phases->count == 0)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    if (phases->sealed)
+    {
+        return LL_ERROR_OK;
+    }
+
+    /* Resolve the restrict_self flags once, as ll_ruleset_enforce would. */
+    const ll_ruleset_t *first = phases->rulesets[0];
+    if ((phases->flags & ~ll_supported_restrict_self_flags(first->abi)) != 0)
+    {
+        return LL_ERROR_RESTRICT_FLAGS_INVALID;
+    }
+    if (phases->flags != 0 && !ll_audit_supported())
+    {
+        if (first->compat_mode == LL_ABI_COMPAT_STRICT)
+        {
+            return LL_ERROR_RESTRICT_PARTIAL_SANDBOX_STRICT;
+        }
+        phases->flags = 0;
+    }
+
+    if (ll_sys_set_no_new_privs())
+    {
+        return LL_ERROR_SYSTEM;
+    }
+    /* Make sure the lazy environment lookup does not happen during a transition. */
+    (void)ll_layers_get_inherited();
+    phases->sealed = 1;
+    return LL_ERROR_OK;
+}
+
+ll_error_t ll_phases_advance(ll_phases_t *const phases)
+{
+    if (!phases || !phases->sealed || phases->current >= phases->count)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    const int ret = ll_sys_restrict_self(phases->rulesets[phases->current]->ruleset_fd, phases->flags);
+    if (ret < 0)
+    {
+        return ll_error_from_restrict_errno(errno);
+    }
+    phases->current++;
+    ll_layers_note_applied();
+    return LL_ERROR_OK;
+}
+
+size_t ll_phases_current(const ll_phases_t *const phases)
+{
+    return phases ? phases->current : 0;
+}
+
+size_t ll_phases_count(const ll_phases_t *const phases)
+{
+    return phases ? phases->count : 0;
+}
+
+
+/*
+ * Ruleset broker.
+ *
+ * A request is one SOCK_SEQPACKET message holding the ruleset name. The reply
+ * is one message holding struct ll_broker_reply, with the file descriptor of
+ * a ruleset derived for this request attached as SCM_RIGHTS when status is
+ * LL_ERROR_OK. Requests from users that are not allowed are answered with
+ * LL_ERROR_BROKER_DENIED.
+ */
+
+struct ll_broker_reply
+{
+    __s32 status;
+    __s32 abi;
+    __s32 compat_mode;
+    __u32 reserved;
+    __u64 handled_access_fs;
+    __u64 handled_access_net;
+    __u64 handled_access_scope;
+};
+
+struct ll_broker_entry
+{
+    char *name;
+    ll_ruleset_journal_t *journal;
+    /* Bumped when the journal is replaced, invalidating the clients' derived rulesets. */
+    unsigned int generation;
+};
+
+/* Ruleset derived for one connection from entry @p entry at @p generation. */
+struct ll_broker_derived
+{
+    size_t entry;
+    unsigned int generation;
+    ll_ruleset_t *ruleset;
+};
+
+/* Per-connection state, so repeated requests do not replay the journal. */
+struct ll_broker_client
+{
+    struct ll_broker_derived *derived;
+    size_t derived_count;
+};
+
+/* How long a reply may wait for room in a client's socket buffer. */
+#define LL_BROKER_SEND_TIMEOUT_MS 1000
+
+/* Linux struct ucred, declared by glibc only under _GNU_SOURCE. */
+struct ll_ucred
+{
+    pid_t pid;
+    uid_t uid;
+    gid_t gid;
+};
+
+struct ll_broker
+{
+    struct ll_broker_entry *entries;
+    size_t count;
+    size_t capacity;
+    /* pollfds[0] is the listening socket, the rest are client connections described by clients[]. */
+    struct pollfd *pollfds;
+    struct ll_broker_client *clients;
+    size_t pollfd_count;
+    size_t pollfd_capacity;
+    /* Users served besides the broker's effective user. */
+    uid_t *uids;
+    size_t uid_count;
+};
+
+int ll_ruleset_info(const ll_ruleset_t *const ruleset, ll_ruleset_info_t *const out_info)
+{
+    if (!ruleset)
+    {
+        return -1;
+    }
+    if (out_info)
+    {
+        out_info->abi = ruleset->abi;
+        out_info->compat_mode = ruleset->compat_mode;
+        out_info->handled_access_fs = ruleset->handled_access_fs;
+        out_info->handled_access_net = ruleset->handled_access_net;
+        out_info->handled_access_scope = ruleset->handled_access_scope;
+    }
+    return ruleset->ruleset_fd;
+}
+
+ll_ruleset_result_t ll_ruleset_from_fd(const int ruleset_fd, const ll_ruleset_info_t info)
+{
+    ll_ruleset_result_t out = {.err = LL_ERROR_OK, .ruleset = NULL};
+    if (ruleset_fd < 0 || info.abi < 1 ||
+        (info.compat_mode != LL_ABI_COMPAT_STRICT && info.compat_mode != LL_ABI_COMPAT_BEST_EFFORT))
+    {
+        out.err = LL_ERROR_INVALID_ARGUMENT;
+        return out;
+    }
+
+    /* Landlock rulesets are anonymous inodes; reject anything else when /proc can tell. */
+    char link[64];
+    char target[64];
+    snprintf(link, sizeof(link), "/proc/self/fd/%d", ruleset_fd);
+    const ssize_t len = readlink(link, target, sizeof(target) - 1);
+    if (len >= 0)
+    {
+        target[len] = '\0';
+        if (strcmp(target, "anon_inode:[landlock-ruleset]") != 0)
+        {
+            out.err = LL_ERROR_INVALID_ARGUMENT;
+            return out;
+        }
+    }
+
+    ll_ruleset_t *ruleset = malloc(sizeof(*ruleset));
+    if (!ruleset)
+    {
+        out.err = LL_ERROR_OUT_OF_MEMORY;
+        return out;
+    }
+    ruleset->ruleset_fd = ruleset_fd;
+    ruleset->abi = info.abi;
+    ruleset->compat_mode = info.compat_mode;
+    ruleset->handled_access_fs = info.handled_access_fs;
+    ruleset->handled_access_net = info.handled_access_net;
+    ruleset->handled_access_scope = info.handled_access_scope;
+    out.ruleset = ruleset;
+    return out;
+}
+
+static int ll_unix_address(const char *const path, struct sockaddr_un *const addr)
+{
+    const size_t len = strlen(path);
+    if (len == 0 || len >= sizeof(addr->sun_path))
+    {
+        return -1;
+    }
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    memcpy(addr->sun_path, path, len);
+    return 0;
+}
+
+ll_error_t ll_broker_create(ll_broker_t **const out_broker)
+{
+    if (!out_broker)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    *out_broker = NULL;
+
+    ll_broker_t *broker = calloc(1, sizeof(*broker));
+    if (!broker)
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    *out_broker = broker;
+    return LL_ERROR_OK;
+}
+
+static void ll_broker_client_clear(struct ll_broker_client *const client)
+{
+    for (size_t i = 0; i < client->derived_count; i++)
+    {
+        ll_ruleset_close(client->derived[i].ruleset);
+    }
+    free(client->derived);
+    client->derived = NULL;
+    client->derived_count = 0;
+}
+
+void ll_broker_free(ll_broker_t *const broker)
+{
+    if (!broker)
+    {
+        return;
+    }
+    for (size_t i = 0; i < broker->count; i++)
+    {
+        free(broker->entries[i].name);
+        ll_ruleset_journal_free(broker->entries[i].journal);
+    }
+    for (size_t i = 0; i < broker->pollfd_count; i++)
+    {
+        close(broker->pollfds[i].fd);
+        ll_broker_client_clear(&broker->clients[i]);
+    }
+    free(broker->entries);
+    free(broker->pollfds);
+    free(broker->clients);
+    free(broker->uids);
+    free(broker);
+}
+
+static struct ll_broker_entry *ll_broker_find(const ll_broker_t *const broker, const char *const name,
+                                              const size_t len)
+{
+    for (size_t i = 0; i < broker->count; i++)
+    {
+        if (strncmp(broker->entries[i].name, name, len) == 0 && broker->entries[i].name[len] == '\0')
+        {
+            return &broker->entries[i];
+        }
+    }
+    return NULL;
+}
+
+ll_error_t ll_broker_add(ll_broker_t *const broker, const char *const name, ll_ruleset_journal_t *const journal)
+{
+    if (!broker || !name || !journal || name[0] == '\0' || strlen(name) > LL_BROKER_NAME_MAX)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    struct ll_broker_entry *entry = ll_broker_find(broker, name, strlen(name));
+    if (entry)
+    {
+        if (entry->journal != journal)
+        {
+            ll_ruleset_journal_free(entry->journal);
+        }
+        entry->journal = journal;
+        entry->generation++;
+        return LL_ERROR_OK;
+    }
+
+    if (broker->count == broker->capacity)
+    {
+        const size_t capacity = broker->capacity ? broker->capacity * 2 : 8;
+        struct ll_broker_entry *entries = realloc(broker->entries, capacity * sizeof(*entries));
+        if (!entries)
+        {
+            return LL_ERROR_OUT_OF_MEMORY;
+        }
+        broker->entries = entries;
+        broker->capacity = capacity;
+    }
+    char *copy = strdup(name);
+    if (!copy)
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    broker->entries[broker->count].name = copy;
+    broker->entries[broker->count].journal = journal;
+    broker->entries[broker->count].generation = 0;
+    broker->count++;
+    return LL_ERROR_OK;
+}
+
+ll_error_t ll_broker_allow_uid(ll_broker_t *const broker, const __u32 uid)
+{
+    if (!broker)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    uid_t *uids = realloc(broker->uids, (broker->uid_count + 1) * sizeof(*uids));
+    if (!uids)
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    uids[broker->uid_count++] = (uid_t)uid;
+    broker->uids = uids;
+    return LL_ERROR_OK;
+}
+
+static int ll_broker_peer_allowed(const ll_broker_t *const broker, const int conn_fd)
+{
+    struct ll_ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(conn_fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0 || len != sizeof(cred))
+    {
+        return 0;
+    }
+    if (cred.uid == geteuid())
+    {
+        return 1;
+    }
+    for (size_t i = 0; i < broker->uid_count; i++)
+    {
+        if (broker->uids[i] == cred.uid)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static ll_error_t ll_broker_add_pollfd(ll_broker_t *const broker, const int fd)
+{
+    if (broker->pollfd_count == broker->pollfd_capacity)
+    {
+        const size_t capacity = broker->pollfd_capacity ? broker->pollfd_capacity * 2 : 16;
+        struct pollfd *pollfds = realloc(broker->pollfds, capacity * sizeof(*pollfds));
+        if (!pollfds)
+        {
+            return LL_ERROR_OUT_OF_MEMORY;
+        }
+        broker->pollfds = pollfds;
+        struct ll_broker_client *clients = realloc(broker->clients, capacity * sizeof(*clients));
+        if (!clients)
+        {
+            return LL_ERROR_OUT_OF_MEMORY;
+        }
+        broker->clients = clients;
+        broker->pollfd_capacity = capacity;
+    }
+    broker->pollfds[broker->pollfd_count].fd = fd;
+    broker->pollfds[broker->pollfd_count].events = POLLIN;
+    broker->pollfds[broker->pollfd_count].revents = 0;
+    broker->clients[broker->pollfd_count].derived = NULL;
+    broker->clients[broker->pollfd_count].derived_count = 0;
+    broker->pollfd_count++;
+    return LL_ERROR_OK;
+}
+
+ll_error_t ll_broker_listen(ll_broker_t *const broker, const char *const path)
+{
+    struct sockaddr_un addr;
+    if (!broker || !path || broker->pollfd_count != 0 || ll_unix_address(path, &addr) < 0)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    const int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0)
+    {
+        return LL_ERROR_SYSTEM;
+    }
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0)
+    {
+        close(fd);
+        return LL_ERROR_SYSTEM;
+    }
+    const ll_error_t err = ll_broker_add_pollfd(broker, fd);
+    if (LL_ERRORED(err))
+    {
+        close(fd);
+    }
+    return err;
+}
+
+int ll_broker_fd(const ll_broker_t *const broker)
+{
+    return (broker && broker->pollfd_count) ? broker->pollfds[0].fd : -1;
+}
+
+/* The ruleset to hand @p client for @p entry, derived from the journal unless the client already has one. */
+static ll_ruleset_result_t ll_broker_client_ruleset(const ll_broker_t *const broker,
+                                                    struct ll_broker_client *const client,
+                                                    const struct ll_broker_entry *const entry)
+{
+    const size_t index = (size_t)(entry - broker->entries);
+    struct ll_broker_derived *slot = NULL;
+    for (size_t i = 0; client && i < client->derived_count && !slot; i++)
+    {
+        slot = client->derived[i].entry == index ? &client->derived[i] : NULL;
+    }
+    if (slot && slot->generation == entry->generation)
+    {
+        ll_ruleset_result_t cached = {.err = LL_ERROR_OK, .ruleset = slot->ruleset};
+        return cached;
+    }
+
+    ll_ruleset_result_t derived = ll_ruleset_derive(entry->journal, NULL, 0, 0, NULL);
+    if (LL_ERRORED(derived.err) || !client)
+    {
+        return derived;
+    }
+    if (!slot)
+    {
+        struct ll_broker_derived *grown =
+            realloc(client->derived, (client->derived_count + 1) * sizeof(*client->derived));
+        if (!grown)
+        {
+            ll_ruleset_close(derived.ruleset);
+            derived.err = LL_ERROR_OUT_OF_MEMORY;
+            derived.ruleset = NULL;
+            return derived;
+        }
+        client->derived = grown;
+        slot = &client->derived[client->derived_count++];
+        slot->entry = index;
+        slot->ruleset = NULL;
+    }
+    ll_ruleset_close(slot->ruleset);
+    slot->generation = entry->generation;
+    slot->ruleset = derived.ruleset;
+    return derived;
+}
+
+/* Wait until @p fd can take a reply; returns 0 once LL_BROKER_SEND_TIMEOUT_MS elapsed. */
+static int ll_broker_wait_writable(const int fd)
+{
+    struct pollfd pfd = {.fd = fd, .events = POLLOUT, .revents = 0};
+    int ret;
+    do
+    {
+        ret = poll(&pfd, 1, LL_BROKER_SEND_TIMEOUT_MS);
+    } while (ret < 0 && errno == EINTR);
+    return ret > 0;
+}
+
+/*
+ * Answer one request on @p conn_fd. @p client, when known, keeps the rulesets
+ * derived for the connection; without it every request derives a new one.
+ */
+static int ll_broker_serve(ll_broker_t *const broker, const int conn_fd, struct ll_broker_client *const client)
+{
+    char name[LL_BROKER_NAME_MAX + 1];
+    ssize_t len;
+    do
+    {
+        len = recv(conn_fd, name, sizeof(name), MSG_TRUNC);
+    } while (len < 0 && errno == EINTR);
+    if (len == 0)
+    {
+        return 0;
+    }
+    if (len < 0)
+    {
+        return (errno == ECONNRESET) ? 0 : LL_ERROR_SYSTEM;
+    }
+
+    struct ll_broker_reply reply;
+    memset(&reply, 0, sizeof(reply));
+    const struct ll_broker_entry *entry = NULL;
+    ll_ruleset_result_t derived = {.err = LL_ERROR_INVALID_ARGUMENT, .ruleset = NULL};
+    if (!ll_broker_peer_allowed(broker, conn_fd))
+    {
+        reply.status = LL_ERROR_BROKER_DENIED;
+    }
+    else if ((size_t)len > LL_BROKER_NAME_MAX)
+    {
+        reply.status = LL_ERROR_BROKER_PROTOCOL;
+    }
+    else if (!(entry = ll_broker_find(broker, name, (size_t)len)))
+    {
+        reply.status = LL_ERROR_BROKER_NOT_FOUND;
+    }
+    else
+    {
+        /* Each client gets its own ruleset, since the descriptor lets it add rules. */
+        derived = ll_broker_client_ruleset(broker, client, entry);
+        reply.status = LL_ERRORED(derived.err) ? derived.err : LL_ERROR_OK;
+    }
+
+    struct iovec iov = {.iov_base = &reply, .iov_len = sizeof(reply)};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    union
+    {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    if (derived.ruleset)
+    {
+        /* Cleared so that no stack bytes reach the client through padding. */
+        ll_ruleset_info_t info;
+        memset(&info, 0, sizeof(info));
+        const int fd = ll_ruleset_info(derived.ruleset, &info);
+        reply.abi = info.abi;
+        reply.compat_mode = info.compat_mode;
+        reply.handled_access_fs = info.handled_access_fs;
+        reply.handled_access_net = info.handled_access_net;
+        reply.handled_access_scope = info.handled_access_scope;
+
+        memset(&control, 0, sizeof(control));
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &fd, sizeof(fd));
+    }
+
+    ssize_t sent;
+    do
+    {
+        sent = sendmsg(conn_fd, &msg, MSG_NOSIGNAL);
+    } while (sent < 0 &&
+             (errno == EINTR || ((errno == EAGAIN || errno == EWOULDBLOCK) && ll_broker_wait_writable(conn_fd))));
+    if (!client)
+    {
+        ll_ruleset_close(derived.ruleset);
+    }
+    if (sent < 0)
+    {
+        /* A peer that does not take its reply in time is dropped like a closed one. */
+        return (errno == EPIPE || errno == ECONNRESET || errno == EAGAIN || errno == EWOULDBLOCK) ? 0
+                                                                                                : LL_ERROR_SYSTEM;
+    }
+    return 1;
+}
+
+int ll_broker_serve_fd(ll_broker_t *const broker, const int conn_fd)
+{
+    if (!broker || conn_fd < 0)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    struct ll_broker_client *client = NULL;
+    for (size_t i = 1; i < broker->pollfd_count && !client; i++)
+    {
+        client = broker->pollfds[i].fd == conn_fd ? &broker->clients[i] : NULL;
+    }
+    return ll_broker_serve(broker, conn_fd, client);
+}
+
+ll_error_t ll_broker_poll(ll_broker_t *const broker, const int timeout_ms, size_t *const out_served)
+{
+    if (out_served)
+    {
+        *out_served = 0;
+    }
+    if (!broker || broker->pollfd_count == 0)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    int ready;
+    do
+    {
+        ready = poll(broker->pollfds, broker->pollfd_count, timeout_ms);
+    } while (ready < 0 && errno == EINTR);
+    if (ready < 0)
+    {
+        return LL_ERROR_SYSTEM;
+    }
+
+    size_t served = 0;
+    ll_error_t err = LL_ERROR_OK;
+    /* Walk backwards so that dropping a connection only moves already visited entries. */
+    for (size_t i = broker->pollfd_count - 1; i > 0 && ready > 0; i--)
+    {
+        if (broker->pollfds[i].revents == 0)
+        {
+            continue;
+        }
+        ready--;
+        const int ret = (broker->pollfds[i].revents & POLLIN)
+                            ? ll_broker_serve(broker, broker->pollfds[i].fd, &broker->clients[i])
+                            : 0;
+        if (ret > 0)
+        {
+            served++;
+            continue;
+        }
+        if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            /* Woken without a request after all; the next poll retries. */
+            continue;
+        }
+        close(broker->pollfds[i].fd);
+        ll_broker_client_clear(&broker->clients[i]);
+        broker->pollfd_count--;
+        broker->pollfds[i] = broker->pollfds[broker->pollfd_count];
+        broker->clients[i] = broker->clients[broker->pollfd_count];
+    }
+
+    if (broker->pollfds[0].revents & POLLIN)
+    {
+        for (;;)
+        {
+            const int conn = accept(broker->pollfds[0].fd, NULL, NULL);
+            if (conn < 0)
+            {
+                break;
+            }
+            (void)fcntl(conn, F_SETFD, FD_CLOEXEC);
+            (void)fcntl(conn, F_SETFL, O_NONBLOCK);
+            err = ll_broker_add_pollfd(broker, conn);
+            if (LL_ERRORED(err))
+            {
+                close(conn);
+                break;
+            }
+        }
+    }
+
+    if (out_served)
+    {
+        *out_served = served;
+    }
+    return err;
+}
+
+ll_error_t ll_broker_connect(const char *const path, int *const out_fd)
+{
+    struct sockaddr_un addr;
+    if (!path || !out_fd || ll_unix_address(path, &addr) < 0)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    *out_fd = -1;
+
+    const int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return LL_ERROR_SYSTEM;
+    }
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        close(fd);
+        return LL_ERROR_SYSTEM;
+    }
+    *out_fd = fd;
+    return LL_ERROR_OK;
+}
+
+ll_ruleset_result_t ll_broker_fetch(const int conn_fd, const char *const name)
+{
+    ll_ruleset_result_t out = {.err = LL_ERROR_OK, .ruleset = NULL};
+    const size_t name_len = name ? strlen(name) : 0;
+    if (conn_fd < 0 || name_len == 0 || name_len > LL_BROKER_NAME_MAX)
+    {
+        out.err = LL_ERROR_INVALID_ARGUMENT;
+        return out;
+    }
+
+    ssize_t ret;
+    do
+    {
+        ret = send(conn_fd, name, name_len, MSG_NOSIGNAL);
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0)
+    {
+        out.err = LL_ERROR_SYSTEM;
+        return out;
+    }
+
+    struct ll_broker_reply reply;
+    struct iovec iov = {.iov_base = &reply, .iov_len = sizeof(reply)};
+    union
+    {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    do
+    {
+        ret = recvmsg(conn_fd, &msg, MSG_CMSG_CLOEXEC);
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0)
+    {
+        out.err = LL_ERROR_SYSTEM;
+        return out;
+    }
+
+    int fd = -1;
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+            cmsg->cmsg_len == CMSG_LEN(sizeof(int)))
+        {
+            memcpy(&fd, CMSG_DATA(cmsg), sizeof(fd));
+        }
+    }
+
+    if ((size_t)ret != sizeof(reply) || (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)))
+    {
+        out.err = LL_ERROR_BROKER_PROTOCOL;
+    }
+    else if (reply.status != LL_ERROR_OK)
+    {
+        out.err = (reply.status == LL_ERROR_BROKER_NOT_FOUND || reply.status == LL_ERROR_BROKER_DENIED)
+                      ? (ll_error_t)reply.status
+                      : LL_ERROR_BROKER_PROTOCOL;
+    }
+    else if (fd < 0)
+    {
+        out.err = LL_ERROR_BROKER_PROTOCOL;
+    }
+    if (LL_ERRORED(out.err))
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return out;
+    }
+
+    ll_ruleset_info_t info;
+    info.abi = reply.abi;
+    info.compat_mode = (ll_abi_compat_mode_t)reply.compat_mode;
+    info.handled_access_fs = reply.handled_access_fs;
+    info.handled_access_net = reply.handled_access_net;
+    info.handled_access_scope = reply.handled_access_scope;
+    out = ll_ruleset_from_fd(fd, info);
+    if (LL_ERRORED(out.err))
+    {
+        close(fd);
+        out.err = (out.err == LL_ERROR_INVALID_ARGUMENT) ? LL_ERROR_BROKER_PROTOCOL : out.err;
+    }
+    return out;
+}
+
+
+/*
+ * File-open broker.
+ *
+ * The broker shares a single-producer/single-consumer ring with the worker.
+ * The worker fills slots and advances tail, then sends a one-byte flush
+ * message; the broker drains head..tail and answers with one or more
+ * messages, each holding up to LL_OPEN_FDS_PER_MSG results and their
+ * descriptors as SCM_RIGHTS. The ring is writable by the sandboxed worker,
+ * so the broker copies and validates every slot before using it.
+ */
+
+#define LL_OPEN_FDS_PER_MSG 253
+#define LL_OPEN_MAGIC 0x4c4c4f50u
+#define LL_OPEN_ALLOWED_FLAGS                                                                                        \
+    (O_ACCMODE | O_CREAT | O_EXCL | O_TRUNC | O_APPEND | O_DIRECTORY | O_NONBLOCK | O_NOFOLLOW | O_CLOEXEC)
+
+struct ll_open_slot
+{
+    __u32 id;
+    __s32 flags;
+    __u32 mode;
+    __u32 path_len;
+    char path[LL_OPEN_PATH_MAX];
+};
+
+struct ll_open_ring
+{
+    __u32 head;
+    __u32 tail;
+    struct ll_open_slot slots[LL_OPEN_RING_SLOTS];
+};
+
+struct ll_open_hello
+{
+    __u32 magic;
+    __u32 has_ruleset;
+    struct ll_broker_reply ruleset;
+};
+
+struct ll_open_record
+{
+    __u32 id;
+    __s32 error;
+};
+
+struct ll_open_reply
+{
+    __u32 count;
+    __u32 fd_count;
+    struct ll_open_record records[LL_OPEN_FDS_PER_MSG];
+};
+
+struct ll_open_broker
+{
+    const ll_evaluator_t *evaluator;
+    int conn_fd;
+    struct ll_open_ring *ring;
+};
+
+struct ll_open_worker
+{
+    int conn_fd;
+    struct ll_open_ring *ring;
+    __u32 next_id;
+    __u32 flushed;
+};
+
+static int ll_memfd_create(const char *const name)
+{
+#ifdef __NR_memfd_create
+    return (int)syscall(__NR_memfd_create, name, 1U /* MFD_CLOEXEC */);
+#else
+    (void)name;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+static ssize_t ll_sendmsg_fds(const int sock, const void *const data, const size_t len, const int *const fds,
+                              const size_t fd_count)
+{
+    struct iovec iov = {.iov_base = (void *)data, .iov_len = len};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    union
+    {
+        char buf[CMSG_SPACE(sizeof(int) * LL_OPEN_FDS_PER_MSG)];
+        struct cmsghdr align;
+    } control;
+    if (fd_count)
+    {
+        memset(&control, 0, sizeof(control));
+        msg.msg_control = control.buf;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * fd_count);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fd_count);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * fd_count);
+    }
+
+    ssize_t sent;
+    do
+    {
+        sent = sendmsg(sock, &msg, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    return sent;
+}
+
+/* Receive one message; descriptors beyond @p max_fds are closed. Returns the byte count or -1. */
+static ssize_t ll_recvmsg_fds(const int sock, void *const data, const size_t len, int *const fds, const size_t max_fds,
+                              size_t *const out_fd_count, int *const out_truncated)
+{
+    struct iovec iov = {.iov_base = data, .iov_len = len};
+    union
+    {
+        char buf[CMSG_SPACE(sizeof(int) * LL_OPEN_FDS_PER_MSG)];
+        struct cmsghdr align;
+    } control;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    ssize_t ret;
+    do
+    {
+        ret = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    } while (ret < 0 && errno == EINTR);
+
+    size_t fd_count = 0;
+    for (struct cmsghdr *cmsg = ret >= 0 ? CMSG_FIRSTHDR(&msg) : NULL; cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+        {
+            continue;
+        }
+        const size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (size_t i = 0; i < n; i++)
+        {
+            int fd;
+            memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(fd));
+            if (fd_count < max_fds)
+            {
+                fds[fd_count++] = fd;
+            }
+            else
+            {
+                close(fd);
+            }
+        }
+    }
+    *out_fd_count = fd_count;
+    *out_truncated = ret >= 0 && (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) != 0;
+    return ret;
+}
+
+static __u64 ll_open_required_access(const int flags)
+{
+    __u64 access;
+    switch (flags & O_ACCMODE)
+    {
+    case O_RDONLY:
+        access = (flags & O_DIRECTORY) ? LANDLOCK_ACCESS_FS_READ_DIR : LANDLOCK_ACCESS_FS_READ_FILE;
+        break;
+    case O_WRONLY:
+        access = LANDLOCK_ACCESS_FS_WRITE_FILE;
+        break;
+    case O_RDWR:
+        access = LANDLOCK_ACCESS_FS_READ_FILE | LANDLOCK_ACCESS_FS_WRITE_FILE;
+        break;
+    default:
+        return 0;
+    }
+    if (flags & O_TRUNC)
+    {
+        access |= LANDLOCK_ACCESS_FS_TRUNCATE;
+    }
+    if (flags & O_CREAT)
+    {
+        access |= LANDLOCK_ACCESS_FS_MAKE_REG;
+    }
+    return access;
+}
+
+static int ll_open_beneath(const char *const path, const int flags, const unsigned int mode)
+{
+    const int open_flags = flags | O_CLOEXEC | O_NOCTTY;
+#ifdef __NR_openat2
+    struct open_how how;
+    memset(&how, 0, sizeof(how));
+    how.flags = (__u64)open_flags;
+    how.mode = (flags & O_CREAT) ? (mode & 07777) : 0;
+    how.resolve = RESOLVE_NO_SYMLINKS | RESOLVE_NO_MAGICLINKS;
+    const int fd = (int)syscall(__NR_openat2, AT_FDCWD, path, &how, sizeof(how));
+    if (fd >= 0 || errno != ENOSYS)
+    {
+        return fd;
+    }
+#endif
+    /*
+     * Without openat2(), walk the path one component at a time: O_NOFOLLOW
+     * on the final open alone would still follow symlinks planted in the
+     * directories above it.
+     */
+    const size_t len = strlen(path);
+    if (len == 0 || len >= PATH_MAX)
+    {
+        errno = len ? ENAMETOOLONG : ENOENT;
+        return -1;
+    }
+    char buffer[PATH_MAX];
+    memcpy(buffer, path, len + 1);
+    int dir_fd = AT_FDCWD;
+    char *component = buffer;
+    if (buffer[0] == '/')
+    {
+        dir_fd = open("/", O_PATH | O_DIRECTORY | O_CLOEXEC);
+        if (dir_fd < 0)
+        {
+            return -1;
+        }
+        while (*component == '/')
+        {
+            component++;
+        }
+    }
+    for (char *slash = strchr(component, '/'); slash; slash = strchr(component, '/'))
+    {
+        *slash = '\0';
+        if (*component)
+        {
+            /* A symlink is opened as itself here, so the next step fails with ENOTDIR. */
+            const int next = openat(dir_fd, component, O_PATH | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            const int saved = errno;
+            if (dir_fd != AT_FDCWD)
+            {
+                close(dir_fd);
+            }
+            if (next < 0)
+            {
+                errno = saved;
+                return -1;
+            }
+            dir_fd = next;
+        }
+        component = slash + 1;
+    }
+    const int opened = openat(dir_fd, *component ? component : ".", open_flags | O_NOFOLLOW, mode & 07777);
+    const int saved = errno;
+    if (dir_fd != AT_FDCWD)
+    {
+        close(dir_fd);
+    }
+    errno = saved;
+    return opened;
+}
+
+/* Validate and perform one request copied out of the shared ring. */
+static int ll_open_handle(const ll_open_broker_t *const broker, const struct ll_open_slot *const shared,
+                          struct ll_open_record *const record)
+{
+    struct ll_open_slot slot;
+    memcpy(&slot, shared, sizeof(slot));
+    record->id = slot.id;
+
+    const __u64 access = ll_open_required_access(slot.flags);
+    if (slot.path_len == 0 || slot.path_len >= LL_OPEN_PATH_MAX || (slot.flags & ~LL_OPEN_ALLOWED_FLAGS) != 0 ||
+        access == 0)
+    {
+        record->error = EINVAL;
+        return -1;
+    }
+    slot.path[slot.path_len] = '\0';
+    if (strlen(slot.path) != slot.path_len)
+    {
+        record->error = EINVAL;
+        return -1;
+    }
+
+    const int allowed = ll_evaluator_check_path(broker->evaluator, slot.path, access);
+    if (allowed <= 0)
+    {
+        record->error = (allowed == 0) ? EACCES : EINVAL;
+        return -1;
+    }
+
+    const int fd = ll_open_beneath(slot.path, slot.flags, slot.mode);
+    record->error = (fd < 0) ? errno : 0;
+    return fd;
+}
+
+ll_error_t ll_open_broker_create(const ll_evaluator_t *const evaluator,
+                                 const ll_ruleset_t *const worker_ruleset,
+                                 const int conn_fd,
+                                 ll_open_broker_t **const out_broker)
+{
+    if (!evaluator || conn_fd < 0 || !out_broker)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    *out_broker = NULL;
+
+    const int memfd = ll_memfd_create("liblandlock-open-ring");
+    if (memfd < 0 || ftruncate(memfd, sizeof(struct ll_open_ring)) < 0)
+    {
+        if (memfd >= 0)
+        {
+            close(memfd);
+        }
+        return LL_ERROR_SYSTEM;
+    }
+    struct ll_open_ring *ring = mmap(NULL, sizeof(*ring), PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (ring == MAP_FAILED)
+    {
+        close(memfd);
+        return LL_ERROR_SYSTEM;
+    }
+
+    struct ll_open_hello hello;
+    memset(&hello, 0, sizeof(hello));
+    hello.magic = LL_OPEN_MAGIC;
+    int fds[2] = {memfd, -1};
+    if (worker_ruleset)
+    {
+        ll_ruleset_info_t info;
+        fds[1] = ll_ruleset_info(worker_ruleset, &info);
+        hello.has_ruleset = 1;
+        hello.ruleset.abi = info.abi;
+        hello.ruleset.compat_mode = info.compat_mode;
+        hello.ruleset.handled_access_fs = info.handled_access_fs;
+        hello.ruleset.handled_access_net = info.handled_access_net;
+        hello.ruleset.handled_access_scope = info.handled_access_scope;
+    }
+    const ssize_t sent = ll_sendmsg_fds(conn_fd, &hello, sizeof(hello), fds, worker_ruleset ? 2 : 1);
+    close(memfd);
+    if (sent < 0)
+    {
+        munmap(ring, sizeof(*ring));
+        return LL_ERROR_SYSTEM;
+    }
+
+    ll_open_broker_t *broker = calloc(1, sizeof(*broker));
+    if (!broker)
+    {
+        munmap(ring, sizeof(*ring));
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    broker->evaluator = evaluator;
+    broker->conn_fd = conn_fd;
+    broker->ring = ring;
+    *out_broker = broker;
+    return LL_ERROR_OK;
+}
+
+void ll_open_broker_free(ll_open_broker_t *const broker)
+{
+    if (!broker)
+    {
+        return;
+    }
+    munmap(broker->ring, sizeof(*broker->ring));
+    close(broker->conn_fd);
+    free(broker);
+}
+
+int ll_open_broker_fd(const ll_open_broker_t *const broker)
+{
+    return broker ? broker->conn_fd : -1;
+}
+
+int ll_open_broker_serve(ll_open_broker_t *const broker)
+{
+    if (!broker)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    char doorbell;
+    ssize_t len;
+    do
+    {
+        len = recv(broker->conn_fd, &doorbell, sizeof(doorbell), 0);
+    } while (len < 0 && errno == EINTR);
+    if (len == 0 || (len < 0 && errno == ECONNRESET))
+    {
+        return 0;
+    }
+    if (len < 0)
+    {
+        return LL_ERROR_SYSTEM;
+    }
+
+    struct ll_open_ring *ring = broker->ring;
+    __u32 head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    const __u32 tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    /* An out-of-range tail from the worker is clamped rather than trusted. */
+    __u32 pending = tail - head;
+    if (pending > LL_OPEN_RING_SLOTS)
+    {
+        pending = LL_OPEN_RING_SLOTS;
+    }
+
+    struct ll_open_reply reply;
+    int fds[LL_OPEN_FDS_PER_MSG];
+    do
+    {
+        reply.count = 0;
+        reply.fd_count = 0;
+        while (pending > 0 && reply.count < LL_OPEN_FDS_PER_MSG)
+        {
+            const int fd = ll_open_handle(broker, &ring->slots[head % LL_OPEN_RING_SLOTS], &reply.records[reply.count]);
+            if (fd >= 0)
+            {
+                fds[reply.fd_count++] = fd;
+            }
+            reply.count++;
+            head++;
+            pending--;
+        }
+        __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+
+        const size_t size = offsetof(struct ll_open_reply, records) + reply.count * sizeof(reply.records[0]);
+        const ssize_t sent = ll_sendmsg_fds(broker->conn_fd, &reply, size, fds, reply.fd_count);
+        for (size_t i = 0; i < reply.fd_count; i++)
+        {
+            close(fds[i]);
+        }
+        if (sent < 0)
+        {
+            return (errno == EPIPE || errno == ECONNRESET) ? 0 : LL_ERROR_SYSTEM;
+        }
+    } while (pending > 0);
+    return 1;
+}
+
+ll_error_t ll_open_worker_connect(const int conn_fd, const __u32 restrict_flags, ll_open_worker_t **const out_worker)
+{
+    if (conn_fd < 0 || !out_worker)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    *out_worker = NULL;
+
+    struct ll_open_hello hello;
+    int fds[2] = {-1, -1};
+    size_t fd_count = 0;
+    int truncated = 0;
+    const ssize_t len = ll_recvmsg_fds(conn_fd, &hello, sizeof(hello), fds, 2, &fd_count, &truncated);
+    if (len < 0)
+    {
+        return LL_ERROR_SYSTEM;
+    }
+    ll_error_t err = LL_ERROR_OK;
+    if ((size_t)len != sizeof(hello) || truncated || hello.magic != LL_OPEN_MAGIC || fd_count != 1 + !!hello.has_ruleset)
+    {
+        err = LL_ERROR_BROKER_PROTOCOL;
+    }
+
+    struct ll_open_ring *ring = MAP_FAILED;
+    if (!LL_ERRORED(err))
+    {
+        struct stat st;
+        if (fstat(fds[0], &st) < 0 || (size_t)st.st_size < sizeof(*ring))
+        {
+            err = LL_ERROR_BROKER_PROTOCOL;
+        }
+        else
+        {
+            ring = mmap(NULL, sizeof(*ring), PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+            err = (ring == MAP_FAILED) ? LL_ERROR_SYSTEM : LL_ERROR_OK;
+        }
+    }
+    if (fds[0] >= 0)
+    {
+        close(fds[0]);
+    }
+
+    ll_ruleset_t *ruleset = NULL;
+    if (!LL_ERRORED(err) && hello.has_ruleset)
+    {
+        ll_ruleset_info_t info;
+        info.abi = hello.ruleset.abi;
+        info.compat_mode = (ll_abi_compat_mode_t)hello.ruleset.compat_mode;
+        info.handled_access_fs = hello.ruleset.handled_access_fs;
+        info.handled_access_net = hello.ruleset.handled_access_net;
+        info.handled_access_scope = hello.ruleset.handled_access_scope;
+        ll_ruleset_result_t res = ll_ruleset_from_fd(fds[1], info);
+        if (LL_ERRORED(res.err))
+        {
+            err = (res.err == LL_ERROR_INVALID_ARGUMENT) ? LL_ERROR_BROKER_PROTOCOL : res.err;
+        }
+        else
+        {
+            fds[1] = -1;
+            ruleset = res.ruleset;
+        }
+    }
+    if (fds[1] >= 0)
+    {
+        close(fds[1]);
+    }
+
+    ll_open_worker_t *worker = NULL;
+    if (!LL_ERRORED(err))
+    {
+        worker = calloc(1, sizeof(*worker));
+        err = worker ? LL_ERROR_OK : LL_ERROR_OUT_OF_MEMORY;
+    }
+    if (!LL_ERRORED(err) && ruleset)
+    {
+        err = ll_ruleset_enforce(ruleset, restrict_flags);
+    }
+    ll_ruleset_close(ruleset);
+    if (LL_ERRORED(err))
+    {
+        free(worker);
+        if (ring != MAP_FAILED)
+        {
+            munmap(ring, sizeof(*ring));
+        }
+        return err;
+    }
+
+    worker->conn_fd = conn_fd;
+    worker->ring = ring;
+    worker->next_id = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    worker->flushed = worker->next_id;
+    *out_worker = worker;
+    return LL_ERROR_OK;
+}
+
+void ll_open_worker_free(ll_open_worker_t *const worker)
+{
+    if (!worker)
+    {
+        return;
+    }
+    munmap(worker->ring, sizeof(*worker->ring));
+    close(worker->conn_fd);
+    free(worker);
+}
+
+ll_error_t ll_open_worker_submit(ll_open_worker_t *const worker,
+                                 const char *const path,
+                                 const int flags,
+                                 const unsigned int mode,
+                                 unsigned int *const out_id)
+{
+    const size_t len = path ? strlen(path) : 0;
+    if (!worker || len == 0 || len >= LL_OPEN_PATH_MAX)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    struct ll_open_ring *ring = worker->ring;
+    const __u32 tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    if (tail - worker->flushed >= LL_OPEN_RING_SLOTS)
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+
+    struct ll_open_slot *slot = &ring->slots[tail % LL_OPEN_RING_SLOTS];
+    slot->id = tail;
+    slot->flags = flags;
+    slot->mode = mode;
+    slot->path_len = (__u32)len;
+    memcpy(slot->path, path, len + 1);
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    if (out_id)
+    {
+        *out_id = tail;
+    }
+    return LL_ERROR_OK;
+}
+
+size_t ll_open_worker_pending(const ll_open_worker_t *const worker)
+{
+    return worker ? (size_t)(__atomic_load_n(&worker->ring->tail, __ATOMIC_RELAXED) - worker->flushed) : 0;
+}
+
+ll_error_t ll_open_worker_flush(ll_open_worker_t *const worker,
+                                ll_open_result_t *const results,
+                                const size_t capacity,
+                                size_t *const out_count)
+{
+    if (out_count)
+    {
+        *out_count = 0;
+    }
+    const size_t pending = ll_open_worker_pending(worker);
+    if (!worker || (pending && !results) || capacity < pending)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    if (pending == 0)
+    {
+        return LL_ERROR_OK;
+    }
+
+    const char doorbell = 0;
+    ssize_t ret;
+    do
+    {
+        ret = send(worker->conn_fd, &doorbell, sizeof(doorbell), MSG_NOSIGNAL);
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0)
+    {
+        return LL_ERROR_SYSTEM;
+    }
+
+    ll_error_t err = LL_ERROR_OK;
+    size_t received = 0;
+    struct ll_open_reply reply;
+    int fds[LL_OPEN_FDS_PER_MSG];
+    while (received < pending)
+    {
+        size_t fd_count = 0;
+        int truncated = 0;
+        const ssize_t len = ll_recvmsg_fds(worker->conn_fd, &reply, sizeof(reply), fds, LL_OPEN_FDS_PER_MSG,
+                                           &fd_count, &truncated);
+        if (len <= 0)
+        {
+            err = (len < 0) ? LL_ERROR_SYSTEM : LL_ERROR_BROKER_PROTOCOL;
+            break;
+        }
+        size_t expected_fds = 0;
+        const int valid = !truncated && (size_t)len >= offsetof(struct ll_open_reply, records) &&
+                          reply.count <= LL_OPEN_FDS_PER_MSG && reply.count <= pending - received &&
+                          (size_t)len == offsetof(struct ll_open_reply, records) + reply.count * sizeof(reply.records[0]);
+        for (size_t i = 0; valid && i < reply.count; i++)
+        {
+            expected_fds += reply.records[i].error == 0;
+        }
+        if (!valid || expected_fds != fd_count || fd_count != reply.fd_count)
+        {
+            for (size_t i = 0; i < fd_count; i++)
+            {
+                close(fds[i]);
+            }
+            err = LL_ERROR_BROKER_PROTOCOL;
+            break;
+        }
+
+        size_t next_fd = 0;
+        for (size_t i = 0; i < reply.count; i++)
+        {
+            ll_open_result_t *result = &results[received++];
+            result->id = reply.records[i].id;
+            result->error = reply.records[i].error;
+            result->fd = (result->error == 0) ? fds[next_fd++] : -1;
+        }
+    }
+
+    /* The broker consumed the whole queue even if the replies were lost. */
+    worker->flushed += (__u32)pending;
+    if (LL_ERRORED(err))
+    {
+        for (size_t i = 0; i < received; i++)
+        {
+            if (results[i].fd >= 0)
+            {
+                close(results[i].fd);
+            }
+        }
+        return err;
+    }
+    if (out_count)
+    {
+        *out_count = received;
+    }
+    return LL_ERROR_OK;
+}
+
+int ll_open_worker_open(ll_open_worker_t *const worker, const char *const path, const int flags, const unsigned int mode)
+{
+    ll_open_result_t result;
+    size_t count = 0;
+    if (ll_open_worker_pending(worker) != 0 || LL_ERRORED(ll_open_worker_submit(worker, path, flags, mode, NULL)) ||
+        LL_ERRORED(ll_open_worker_flush(worker, &result, 1, &count)) || count != 1)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    if (result.fd < 0)
+    {
+        errno = result.error;
+    }
+    return result.fd;
+}
+
+
+/*
+ * Futex helpers, shared by the plugin host, the path resolver and the
+ * manifest ring.
+ *
+ * A waiter spins on a sequence number before sleeping on it; its sleeping
+ * flag lets the writer skip FUTEX_WAKE while it still spins.
+ */
+
+static inline void ll_cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __asm__ __volatile__("pause");
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+static void ll_futex_wait(__u32 *const addr, const __u32 expected, const int timeout_ms)
+{
+    struct timespec ts;
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (long)(timeout_ms % 1000) * 1000000L;
+    (void)syscall(__NR_futex, addr, FUTEX_WAIT, expected, timeout_ms >= 0 ? &ts : NULL, NULL, 0);
+}
+
+static void ll_futex_wake(__u32 *const addr)
+{
+    (void)syscall(__NR_futex, addr, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+/* Publish @p value in @p seq and wake the peer if it went to sleep on it. */
+static void ll_futex_signal(__u32 *const seq, __u32 *const sleeping, const __u32 value)
+{
+    __atomic_store_n(seq, value, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(sleeping, __ATOMIC_SEQ_CST))
+    {
+        ll_futex_wake(seq);
+    }
+}
+
+/* Wait until @p seq differs from @p old; returns 0, or -1 once @p timeout_ms elapsed while sleeping. */
+static int ll_futex_await(__u32 *const seq, __u32 *const sleeping, const __u32 old, const unsigned int spins,
+                          const int timeout_ms)
+{
+    for (unsigned int i = 0; i < spins; i++)
+    {
+        if (__atomic_load_n(seq, __ATOMIC_ACQUIRE) != old)
+        {
+            return 0;
+        }
+        ll_cpu_relax();
+    }
+    __atomic_store_n(sleeping, 1, __ATOMIC_SEQ_CST);
+    int ret = 0;
+    if (__atomic_load_n(seq, __ATOMIC_SEQ_CST) == old)
+    {
+        ll_futex_wait(seq, old, timeout_ms);
+        ret = (__atomic_load_n(seq, __ATOMIC_ACQUIRE) == old) ? -1 : 0;
+    }
+    __atomic_store_n(sleeping, 0, __ATOMIC_RELAXED);
+    return ret;
+}
+
+
+/*
+ * Plugin host.
+ *
+ * Host and helper share one memfd mapping: a control block followed by the
+ * request and response buffers. A call is a one-slot ring: the host bumps
+ * request_seq, the helper answers by setting response_seq to the same value.
+ * Each side spins on the other's sequence number before sleeping on it as a
+ * futex; the *_sleeping flags let the writer skip FUTEX_WAKE while the reader
+ * is still spinning.
+ */
+
+#define LL_PLUGIN_WAIT_SLICE_MS 50
+
+struct ll_plugin_shared
+{
+    __u32 request_seq;
+    __u32 response_seq;
+    __u32 helper_sleeping;
+    __u32 host_sleeping;
+    __u32 shutdown;
+    __s32 status;
+    __u64 in_len;
+    __u64 out_len;
+};
+
+struct ll_plugin_host
+{
+    struct ll_plugin_shared *shared;
+    size_t map_size;
+    /* Kept out of the shared page, which the sandboxed helper can write. */
+    size_t buffer_size;
+    unsigned char *in;
+    unsigned char *out;
+    pid_t pid;
+    unsigned int spin_iterations;
+    int exited;
+    int wait_status;
+};
+
+/* Close every descriptor from @p lowest up, with close_range() or by listing /proc/self/fd. */
+static void ll_close_fds_from(const int lowest)
+{
+#ifdef __NR_close_range
+    if (syscall(__NR_close_range, (unsigned int)lowest, ~0U, 0U) == 0)
+    {
+        return;
+    }
+#endif
+    DIR *const dir = opendir("/proc/self/fd");
+    if (!dir)
+    {
+        const long max = sysconf(_SC_OPEN_MAX);
+        for (long fd = lowest; fd < (max > 0 ? max : 1024); fd++)
+        {
+            (void)close((int)fd);
+        }
+        return;
+    }
+    const int skip = dirfd(dir);
+    for (const struct dirent *entry = readdir(dir); entry; entry = readdir(dir))
+    {
+        const int fd = atoi(entry->d_name);
+        if (entry->d_name[0] != '.' && fd >= lowest && fd != skip)
+        {
+            (void)close(fd);
+        }
+    }
+    closedir(dir);
+}
+
+static void ll_plugin_helper(const ll_plugin_options_t *const options, const ll_ruleset_t *const ruleset,
+                             ll_plugin_host_t *const host)
+{
+    (void)prctl(PR_SET_PDEATHSIG, SIGKILL, 0, 0, 0);
+    /*
+     * Landlock does not restrict descriptors that are already open, so drop
+     * everything inherited from the host except the standard streams. The
+     * shared mapping needs no descriptor; the ruleset's is moved to 3 and
+     * closed once enforced.
+     */
+    ll_ruleset_t sandbox;
+    if (ruleset)
+    {
+        sandbox = *ruleset;
+        sandbox.ruleset_fd = 3;
+        if (ruleset->ruleset_fd != 3 && dup2(ruleset->ruleset_fd, 3) < 0)
+        {
+            _exit(126);
+        }
+    }
+    ll_close_fds_from(ruleset ? 4 : 3);
+    if (ruleset && LL_ERRORED(ll_ruleset_enforce(&sandbox, options->restrict_flags)))
+    {
+        _exit(126);
+    }
+    if (ruleset)
+    {
+        close(3);
+    }
+
+    ll_plugin_fn_t fn = options->fn;
+    if (options->library)
+    {
+        void *handle = dlopen(options->library, RTLD_NOW | RTLD_LOCAL);
+        void *sym = handle ? dlsym(handle, options->symbol) : NULL;
+        memcpy(&fn, &sym, sizeof(fn));
+    }
+    if (!fn)
+    {
+        _exit(127);
+    }
+
+    struct ll_plugin_shared *shared = host->shared;
+    __u32 seq = 0;
+    /* The first response tells the host that setup succeeded. */
+    ll_futex_signal(&shared->response_seq, &shared->host_sleeping, seq);
+    for (;;)
+    {
+        while (ll_futex_await(&shared->request_seq, &shared->helper_sleeping, seq, host->spin_iterations, -1) < 0)
+        {
+        }
+        seq = __atomic_load_n(&shared->request_seq, __ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&shared->shutdown, __ATOMIC_ACQUIRE))
+        {
+            _exit(0);
+        }
+
+        const size_t buffer_size = host->buffer_size;
+        const size_t in_len = (size_t)shared->in_len;
+        size_t out_len = 0;
+        shared->status = fn(options->ctx, host->in, in_len <= buffer_size ? in_len : buffer_size, host->out,
+                            buffer_size, &out_len);
+        shared->out_len = out_len <= buffer_size ? out_len : buffer_size;
+        ll_futex_signal(&shared->response_seq, &shared->host_sleeping, seq);
+    }
+}
+
+/* Wait for the helper to answer @p seq, checking that it is still alive while asleep. */
+static ll_error_t ll_plugin_host_await(ll_plugin_host_t *const host, const __u32 old)
+{
+    struct ll_plugin_shared *shared = host->shared;
+    while (ll_futex_await(&shared->response_seq, &shared->host_sleeping, old, host->spin_iterations,
+                          LL_PLUGIN_WAIT_SLICE_MS) < 0)
+    {
+        if (waitpid(host->pid, &host->wait_status, WNOHANG) == host->pid)
+        {
+            host->exited = 1;
+            return LL_ERROR_PLUGIN_EXITED;
+        }
+    }
+    return LL_ERROR_OK;
+}
+
+ll_error_t ll_plugin_host_start(const ll_plugin_options_t *const options,
+                                const ll_ruleset_t *const ruleset,
+                                ll_plugin_host_t **const out_host)
+{
+    if (!options || !out_host || options->buffer_size == 0 || (!options->fn && !options->library) ||
+        (options->library && !options->symbol))
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    *out_host = NULL;
+
+    const long page = sysconf(_SC_PAGESIZE);
+    const size_t page_size = page > 0 ? (size_t)page : 4096;
+    const size_t map_size = page_size + 2 * ((options->buffer_size + page_size - 1) / page_size * page_size);
+
+    ll_plugin_host_t *host = calloc(1, sizeof(*host));
+    if (!host)
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    const int memfd = ll_memfd_create("liblandlock-plugin");
+    if (memfd < 0 || ftruncate(memfd, (off_t)map_size) < 0)
+    {
+        if (memfd >= 0)
+        {
+            close(memfd);
+        }
+        free(host);
+        return LL_ERROR_SYSTEM;
+    }
+    void *map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    close(memfd);
+    if (map == MAP_FAILED)
+    {
+        free(host);
+        return LL_ERROR_SYSTEM;
+    }
+
+    host->shared = map;
+    host->map_size = map_size;
+    host->in = (unsigned char *)map + page_size;
+    host->out = host->in + (map_size - page_size) / 2;
+    /* With a single CPU the peer cannot make progress while we spin. */
+    host->spin_iterations = (sysconf(_SC_NPROCESSORS_ONLN) > 1) ? options->spin_iterations : 0;
+    host->buffer_size = options->buffer_size;
+    /* response_seq starts one behind so the helper's ready signal is visible. */
+    host->shared->response_seq = UINT32_MAX;
+
+    host->pid = fork();
+    if (host->pid < 0)
+    {
+        munmap(map, map_size);
+        free(host);
+        return LL_ERROR_SYSTEM;
+    }
+    if (host->pid == 0)
+    {
+        ll_plugin_helper(options, ruleset, host);
+        _exit(127);
+    }
+
+    const ll_error_t err = ll_plugin_host_await(host, UINT32_MAX);
+    if (LL_ERRORED(err))
+    {
+        ll_plugin_host_stop(host, NULL);
+        return err;
+    }
+    *out_host = host;
+    return LL_ERROR_OK;
+}
+
+void *ll_plugin_host_request_buffer(ll_plugin_host_t *const host, size_t *const out_capacity)
+{
+    if (!host)
+    {
+        return NULL;
+    }
+    if (out_capacity)
+    {
+        *out_capacity = host->buffer_size;
+    }
+    return host->in;
+}
+
+ll_error_t ll_plugin_host_call(ll_plugin_host_t *const host,
+                               const size_t in_len,
+                               const void **const out_response,
+                               size_t *const out_len,
+                               int *const out_status)
+{
+    if (!host || in_len > host->buffer_size)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    if (host->exited)
+    {
+        return LL_ERROR_PLUGIN_EXITED;
+    }
+
+    struct ll_plugin_shared *shared = host->shared;
+    const __u32 seq = __atomic_load_n(&shared->request_seq, __ATOMIC_RELAXED) + 1;
+    shared->in_len = in_len;
+    ll_futex_signal(&shared->request_seq, &shared->helper_sleeping, seq);
+
+    const ll_error_t err = ll_plugin_host_await(host, seq - 1);
+    if (LL_ERRORED(err))
+    {
+        return err;
+    }
+    if (out_response)
+    {
+        *out_response = host->out;
+    }
+    if (out_len)
+    {
+        /* The helper is not trusted to bound its own response. */
+        const __u64 len = __atomic_load_n(&shared->out_len, __ATOMIC_RELAXED);
+        *out_len = len <= host->buffer_size ? (size_t)len : host->buffer_size;
+    }
+    if (out_status)
+    {
+        *out_status = shared->status;
+    }
+    return LL_ERROR_OK;
+}
+
+void ll_plugin_host_stop(ll_plugin_host_t *const host, int *const out_wait_status)
+{
+    if (!host)
+    {
+        return;
+    }
+    if (!host->exited)
+    {
+        struct ll_plugin_shared *shared = host->shared;
+        __atomic_store_n(&shared->shutdown, 1, __ATOMIC_RELEASE);
+        ll_futex_signal(&shared->request_seq, &shared->helper_sleeping,
+                         __atomic_load_n(&shared->request_seq, __ATOMIC_RELAXED) + 1);
+        int waited = 0;
+        for (int i = 0; i < 20 && !waited; i++)
+        {
+            waited = waitpid(host->pid, &host->wait_status, WNOHANG) == host->pid;
+            if (!waited)
+            {
+                usleep(1000 * LL_PLUGIN_WAIT_SLICE_MS / 10);
+            }
+        }
+        if (!waited)
+        {
+            kill(host->pid, SIGKILL);
+            while (waitpid(host->pid, &host->wait_status, 0) < 0 && errno == EINTR)
+            {
+            }
+        }
+    }
+    if (out_wait_status)
+    {
+        *out_wait_status = host->wait_status;
+    }
+    munmap(host->shared, host->map_size);
+    free(host);
+}
+
+
+/*
+ * ELF dependency analysis.
+ */
+
+#if __SIZEOF_POINTER__ == 8
+#define LL_ELF_CLASS ELFCLASS64
+typedef Elf64_Ehdr ll_elf_ehdr_t;
+typedef Elf64_Phdr ll_elf_phdr_t;
+typedef Elf64_Dyn ll_elf_dyn_t;
+static const char *const ll_elf_default_dirs[] = {"/lib64", "/usr/lib64", "/lib", "/usr/lib"};
+#else
+#define LL_ELF_CLASS ELFCLASS32
+typedef Elf32_Ehdr ll_elf_ehdr_t;
+typedef Elf32_Phdr ll_elf_phdr_t;
+typedef Elf32_Dyn ll_elf_dyn_t;
+static const char *const ll_elf_default_dirs[] = {"/lib", "/usr/lib"};
+#endif
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define LL_ELF_DATA ELFDATA2LSB
+#else
+#define LL_ELF_DATA ELFDATA2MSB
+#endif
+
+#define LL_ELF_MAX_OBJECTS 4096
+#define LL_ELF_MAX_NEEDED 1024
+#define LL_ELF_CACHE_ENTRIES 64
+#define LL_LDSO_CACHE_PATH "/etc/ld.so.cache"
+#define LL_LDSO_CACHE_MAGIC "glibc-ld.so.cache1.1"
+#define LL_LDSO_CACHE_OLD_MAGIC "ld.so-1.7.0"
+
+struct ll_elf_deps
+{
+    char **paths;
+    size_t count;
+    size_t capacity;
+    char **missing;
+    size_t missing_count;
+    size_t missing_capacity;
+    /* Non-zero if the loader reads LL_LDSO_CACHE_PATH; kept apart since it is only ever read. */
+    int ldso_cache;
+};
+
+/* The fields of one mapped ELF object the resolver needs; strings point into the mapping. */
+struct ll_elf_info
+{
+    unsigned int machine;
+    const char *interp;
+    const char *rpath;
+    const char *runpath;
+    const char *needed[LL_ELF_MAX_NEEDED];
+    size_t needed_count;
+};
+
+struct ll_elf_object
+{
+    dev_t dev;
+    ino_t ino;
+    char *path;
+};
+
+struct ll_ldso_cache
+{
+    const unsigned char *data;
+    size_t size;
+    const unsigned char *entries;
+    size_t entry_count;
+    size_t entry_size;
+    /* Offset that string offsets in the entries are relative to. */
+    size_t string_base;
+};
+
+struct ll_elf_cache_entry
+{
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    ll_elf_deps_t *deps;
+};
+
+static struct ll_elf_cache_entry ll_elf_cache[LL_ELF_CACHE_ENTRIES];
+static size_t ll_elf_cache_next;
+static int ll_elf_cache_lock;
+
+static void ll_elf_cache_acquire(void)
+{
+    while (__atomic_test_and_set(&ll_elf_cache_lock, __ATOMIC_ACQUIRE))
+    {
+        ll_cpu_relax();
+    }
+}
+
+static void ll_elf_cache_release(void)
+{
+    __atomic_clear(&ll_elf_cache_lock, __ATOMIC_RELEASE);
+}
+
+static ll_error_t ll_string_list_push(char ***const list, size_t *const count, size_t *const capacity,
+                                      const char *const value, const size_t len)
+{
+    if (*count == *capacity)
+    {
+        const size_t grown = *capacity ? *capacity * 2 : 16;
+        char **items = realloc(*list, grown * sizeof(*items));
+        if (!items)
+        {
+            return LL_ERROR_OUT_OF_MEMORY;
+        }
+        *list = items;
+        *capacity = grown;
+    }
+    char *copy = malloc(len + 1);
+    if (!copy)
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    memcpy(copy, value, len);
+    copy[len] = '\0';
+    (*list)[(*count)++] = copy;
+    return LL_ERROR_OK;
+}
+
+void ll_elf_deps_free(ll_elf_deps_t *const deps)
+{
+    if (!deps)
+    {
+        return;
+    }
+    for (size_t i = 0; i < deps->count; i++)
+    {
+        free(deps->paths[i]);
+    }
+    for (size_t i = 0; i < deps->missing_count; i++)
+    {
+        free(deps->missing[i]);
+    }
+    free(deps->paths);
+    free(deps->missing);
+    free(deps);
+}
+
+static ll_elf_deps_t *ll_elf_deps_copy(const ll_elf_deps_t *const deps)
+{
+    ll_elf_deps_t *copy = calloc(1, sizeof(*copy));
+    ll_error_t err = copy ? LL_ERROR_OK : LL_ERROR_OUT_OF_MEMORY;
+    if (copy)
+    {
+        copy->ldso_cache = deps->ldso_cache;
+    }
+    for (size_t i = 0; i < deps->count && !LL_ERRORED(err); i++)
+    {
+        err = ll_string_list_push(&copy->paths, &copy->count, &copy->capacity, deps->paths[i],
+                                  strlen(deps->paths[i]));
+    }
+    for (size_t i = 0; i < deps->missing_count && !LL_ERRORED(err); i++)
+    {
+        err = ll_string_list_push(&copy->missing, &copy->missing_count, &copy->missing_capacity, deps->missing[i],
+                                  strlen(deps->missing[i]));
+    }
+    if (LL_ERRORED(err))
+    {
+        ll_elf_deps_free(copy);
+        return NULL;
+    }
+    return copy;
+}
+
+static const void *ll_mmap_file(const int fd, size_t *const out_size)
+{
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0)
+    {
+        return NULL;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        return NULL;
+    }
+    *out_size = (size_t)st.st_size;
+    return map;
+}
+
+/* Translate a virtual address to a file offset through the PT_LOAD segments. */
+static int ll_elf_vaddr_offset(const ll_elf_phdr_t *const phdrs, const size_t phnum, const __u64 vaddr,
+                               size_t *const out_offset)
+{
+    for (size_t i = 0; i < phnum; i++)
+    {
+        if (phdrs[i].p_type == PT_LOAD && vaddr >= phdrs[i].p_vaddr && vaddr - phdrs[i].p_vaddr < phdrs[i].p_filesz)
+        {
+            *out_offset = (size_t)(vaddr - phdrs[i].p_vaddr + phdrs[i].p_offset);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* Return a NUL-terminated string at @p offset within [@p base, @p base + @p size), or NULL. */
+static const char *ll_bounded_string(const unsigned char *const base, const size_t size, const size_t offset)
+{
+    if (offset >= size || !memchr(base + offset, '\0', size - offset))
+    {
+        return NULL;
+    }
+    return (const char *)base + offset;
+}
+
+static int ll_elf_parse(const unsigned char *const data, const size_t size, struct ll_elf_info *const info)
+{
+    memset(info, 0, sizeof(*info));
+    if (size < sizeof(ll_elf_ehdr_t) || memcmp(data, ELFMAG, SELFMAG) != 0 || data[EI_CLASS] != LL_ELF_CLASS ||
+        data[EI_DATA] != LL_ELF_DATA)
+    {
+        return -1;
+    }
+    ll_elf_ehdr_t ehdr;
+    memcpy(&ehdr, data, sizeof(ehdr));
+    if (ehdr.e_phentsize != sizeof(ll_elf_phdr_t) || ehdr.e_phoff > size ||
+        (size - ehdr.e_phoff) / sizeof(ll_elf_phdr_t) < ehdr.e_phnum || (ehdr.e_phoff % sizeof(void *)) != 0)
+    {
+        return -1;
+    }
+    info->machine = ehdr.e_machine;
+    const ll_elf_phdr_t *phdrs = (const ll_elf_phdr_t *)(const void *)(data + ehdr.e_phoff);
+    const size_t phnum = ehdr.e_phnum;
+
+    const ll_elf_phdr_t *dynamic = NULL;
+    for (size_t i = 0; i < phnum; i++)
+    {
+        if (phdrs[i].p_offset > size || phdrs[i].p_filesz > size - phdrs[i].p_offset)
+        {
+            continue;
+        }
+        if (phdrs[i].p_type == PT_INTERP && phdrs[i].p_filesz > 0 &&
+            data[phdrs[i].p_offset + phdrs[i].p_filesz - 1] == '\0')
+        {
+            info->interp = (const char *)data + phdrs[i].p_offset;
+        }
+        else if (phdrs[i].p_type == PT_DYNAMIC && (phdrs[i].p_offset % sizeof(void *)) == 0)
+        {
+            dynamic = &phdrs[i];
+        }
+    }
+    if (!dynamic)
+    {
+        return 0;
+    }
+
+    const ll_elf_dyn_t *dyn = (const ll_elf_dyn_t *)(const void *)(data + dynamic->p_offset);
+    const size_t dyn_count = dynamic->p_filesz / sizeof(ll_elf_dyn_t);
+    __u64 strtab_vaddr = 0;
+    __u64 strtab_size = 0;
+    for (size_t i = 0; i < dyn_count && dyn[i].d_tag != DT_NULL; i++)
+    {
+        if (dyn[i].d_tag == DT_STRTAB)
+        {
+            strtab_vaddr = dyn[i].d_un.d_ptr;
+        }
+        else if (dyn[i].d_tag == DT_STRSZ)
+        {
+            strtab_size = dyn[i].d_un.d_val;
+        }
+    }
+    size_t strtab = 0;
+    if (strtab_size == 0 || ll_elf_vaddr_offset(phdrs, phnum, strtab_vaddr, &strtab) < 0 || strtab >= size)
+    {
+        return 0;
+    }
+    const size_t strtab_len = (strtab_size < size - strtab) ? (size_t)strtab_size : size - strtab;
+
+    for (size_t i = 0; i < dyn_count && dyn[i].d_tag != DT_NULL; i++)
+    {
+        const char *str = NULL;
+        if (dyn[i].d_tag == DT_NEEDED || dyn[i].d_tag == DT_RPATH || dyn[i].d_tag == DT_RUNPATH)
+        {
+            str = ll_bounded_string(data + strtab, strtab_len, (size_t)dyn[i].d_un.d_val);
+        }
+        if (!str)
+        {
+            continue;
+        }
+        if (dyn[i].d_tag == DT_NEEDED && info->needed_count < LL_ELF_MAX_NEEDED)
+        {
+            info->needed[info->needed_count++] = str;
+        }
+        else if (dyn[i].d_tag == DT_RPATH)
+        {
+            info->rpath = str;
+        }
+        else if (dyn[i].d_tag == DT_RUNPATH)
+        {
+            info->runpath = str;
+        }
+    }
+    return 0;
+}
+
+static void ll_ldso_cache_open(struct ll_ldso_cache *const cache)
+{
+    memset(cache, 0, sizeof(*cache));
+    const int fd = open(LL_LDSO_CACHE_PATH, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return;
+    }
+    size_t size = 0;
+    const unsigned char *data = ll_mmap_file(fd, &size);
+    close(fd);
+    if (!data)
+    {
+        return;
+    }
+    cache->data = data;
+    cache->size = size;
+
+    /* Old-format caches carry a new-format cache after their own entries. */
+    size_t offset = 0;
+    if (size >= 16 && memcmp(data, LL_LDSO_CACHE_OLD_MAGIC, sizeof(LL_LDSO_CACHE_OLD_MAGIC) - 1) == 0)
+    {
+        __u32 old_count;
+        memcpy(&old_count, data + 12, sizeof(old_count));
+        offset = (16 + (size_t)old_count * 12 + 7) & ~(size_t)7;
+    }
+    const size_t header_size = 48;
+    if (offset > size || size - offset < header_size ||
+        memcmp(data + offset, LL_LDSO_CACHE_MAGIC, sizeof(LL_LDSO_CACHE_MAGIC) - 1) != 0)
+    {
+        return;
+    }
+    __u32 count;
+    memcpy(&count, data + offset + 20, sizeof(count));
+    cache->entry_size = 24;
+    if ((size - offset - header_size) / cache->entry_size < count)
+    {
+        return;
+    }
+    cache->entries = data + offset + header_size;
+    cache->entry_count = count;
+    /* New-format string offsets are relative to the new header, which is the file start unless embedded. */
+    cache->string_base = offset;
+}
+
+static void ll_ldso_cache_close(struct ll_ldso_cache *const cache)
+{
+    if (cache->data)
+    {
+        munmap((void *)cache->data, cache->size);
+    }
+}
+
+static int ll_elf_candidate_matches(const char *const path, const unsigned int machine, struct stat *const out_st)
+{
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return 0;
+    }
+    ll_elf_ehdr_t ehdr;
+    const ssize_t n = pread(fd, &ehdr, sizeof(ehdr), 0);
+    const int ok = n == (ssize_t)sizeof(ehdr) && memcmp(ehdr.e_ident, ELFMAG, SELFMAG) == 0 &&
+                   ehdr.e_ident[EI_CLASS] == LL_ELF_CLASS && ehdr.e_ident[EI_DATA] == LL_ELF_DATA &&
+                   ehdr.e_machine == machine && fstat(fd, out_st) == 0;
+    close(fd);
+    return ok;
+}
+
+/* Try each directory of a colon-separated search list, expanding $ORIGIN. */
+static int ll_elf_search_dirs(const char *const list, const char *const origin, const char *const name,
+                              const unsigned int machine, char *const out_path, struct stat *const out_st)
+{
+    const char *cursor = list;
+    while (cursor && *cursor)
+    {
+        const char *end = strchr(cursor, ':');
+        const size_t len = end ? (size_t)(end - cursor) : strlen(cursor);
+        char dir[PATH_MAX];
+        size_t dir_len = 0;
+        int usable = len > 0;
+        for (size_t i = 0; i < len && usable;)
+        {
+            const char *token = NULL;
+            size_t skip = 0;
+            if (strncmp(cursor + i, "$ORIGIN", 7) == 0)
+            {
+                token = origin;
+                skip = 7;
+            }
+            else if (strncmp(cursor + i, "${ORIGIN}", 9) == 0)
+            {
+                token = origin;
+                skip = 9;
+            }
+            else if (cursor[i] == '$')
+            {
+                /* $LIB and $PLATFORM depend on the loader build; skip such entries. */
+                usable = 0;
+                break;
+            }
+            const size_t piece = token ? strlen(token) : 1;
+            if (dir_len + piece >= sizeof(dir))
+            {
+                usable = 0;
+                break;
+            }
+            memcpy(dir + dir_len, token ? token : cursor + i, piece);
+            dir_len += piece;
+            i += token ? skip : 1;
+        }
+        if (usable)
+        {
+            dir[dir_len] = '\0';
+            if ((size_t)snprintf(out_path, PATH_MAX, "%s/%s", dir, name) < PATH_MAX &&
+                ll_elf_candidate_matches(out_path, machine, out_st))
+            {
+                return 1;
+            }
+        }
+        cursor = end ? end + 1 : NULL;
+    }
+    return 0;
+}
+
+static int ll_elf_resolve(const char *const name, const struct ll_elf_info *const object, const char *const origin,
+                          const struct ll_elf_info *const exe, const char *const exe_origin,
+                          const struct ll_ldso_cache *const cache, char *const out_path, struct stat *const out_st)
+{
+    if (strchr(name, '/'))
+    {
+        if (strlen(name) >= PATH_MAX)
+        {
+            return 0;
+        }
+        memcpy(out_path, name, strlen(name) + 1);
+        return ll_elf_candidate_matches(out_path, object->machine, out_st);
+    }
+
+    if (!object->runpath)
+    {
+        if (object->rpath && ll_elf_search_dirs(object->rpath, origin, name, object->machine, out_path, out_st))
+        {
+            return 1;
+        }
+        if (exe != object && !exe->runpath && exe->rpath &&
+            ll_elf_search_dirs(exe->rpath, exe_origin, name, object->machine, out_path, out_st))
+        {
+            return 1;
+        }
+    }
+    if (object->runpath && ll_elf_search_dirs(object->runpath, origin, name, object->machine, out_path, out_st))
+    {
+        return 1;
+    }
+
+    for (size_t i = 0; i < cache->entry_count; i++)
+    {
+        const unsigned char *entry = cache->entries + i * cache->entry_size;
+        __u32 key;
+        __u32 value;
+        memcpy(&key, entry + 4, sizeof(key));
+        memcpy(&value, entry + 8, sizeof(value));
+        const char *lib = ll_bounded_string(cache->data, cache->size, cache->string_base + key);
+        const char *path = ll_bounded_string(cache->data, cache->size, cache->string_base + value);
+        if (lib && path && strcmp(lib, name) == 0 && strlen(path) < PATH_MAX)
+        {
+            memcpy(out_path, path, strlen(path) + 1);
+            if (ll_elf_candidate_matches(out_path, object->machine, out_st))
+            {
+                return 1;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < sizeof(ll_elf_default_dirs) / sizeof(ll_elf_default_dirs[0]); i++)
+    {
+        if (ll_elf_search_dirs(ll_elf_default_dirs[i], origin, name, object->machine, out_path, out_st))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Directory of the resolved object, used for $ORIGIN. */
+static void ll_elf_origin(const char *const path, char *const out_origin)
+{
+    char resolved[PATH_MAX];
+    const char *source = realpath(path, resolved) ? resolved : path;
+    const char *slash = strrchr(source, '/');
+    size_t len = slash ? (size_t)(slash - source) : 0;
+    if (slash == source)
+    {
+        len = 1;
+    }
+    if (!slash)
+    {
+        memcpy(out_origin, ".", 2);
+        return;
+    }
+    memcpy(out_origin, source, len);
+    out_origin[len] = '\0';
+}
+
+static ll_error_t ll_elf_walk(const char *const binary, ll_elf_deps_t *const deps)
+{
+    struct ll_elf_object *objects = calloc(LL_ELF_MAX_OBJECTS, sizeof(*objects));
+    if (!objects)
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    struct ll_ldso_cache cache;
+    ll_ldso_cache_open(&cache);
+
+    ll_error_t err = LL_ERROR_OK;
+    size_t object_count = 0;
+    struct stat st;
+    if (stat(binary, &st) < 0)
+    {
+        err = LL_ERROR_SYSTEM;
+    }
+    else
+    {
+        objects[0].dev = st.st_dev;
+        objects[0].ino = st.st_ino;
+        objects[0].path = strdup(binary);
+        object_count = 1;
+        err = objects[0].path ? LL_ERROR_OK : LL_ERROR_OUT_OF_MEMORY;
+    }
+
+    /* The executable's mapping stays open for its DT_RPATH, which applies to every dependency. */
+    const unsigned char *exe_data = NULL;
+    size_t exe_size = 0;
+    struct ll_elf_info *infos = malloc(2 * sizeof(*infos));
+    struct ll_elf_info *exe_info = infos;
+    struct ll_elf_info *info = infos ? infos + 1 : NULL;
+    char exe_origin[PATH_MAX] = ".";
+    if (!infos && !LL_ERRORED(err))
+    {
+        err = LL_ERROR_OUT_OF_MEMORY;
+    }
+
+    for (size_t index = 0; index < object_count && !LL_ERRORED(err); index++)
+    {
+        const char *path = objects[index].path;
+        const int fd = open(path, O_RDONLY | O_CLOEXEC);
+        size_t size = 0;
+        const unsigned char *data = fd >= 0 ? ll_mmap_file(fd, &size) : NULL;
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        struct ll_elf_info *current = (index == 0) ? exe_info : info;
+        if (!data || ll_elf_parse(data, size, current) < 0)
+        {
+            if (data)
+            {
+                munmap((void *)data, size);
+            }
+            if (index == 0)
+            {
+                err = data ? LL_ERROR_INVALID_ARGUMENT : LL_ERROR_SYSTEM;
+                break;
+            }
+            continue;
+        }
+        err = ll_string_list_push(&deps->paths, &deps->count, &deps->capacity, path, strlen(path));
+
+        char origin[PATH_MAX];
+        ll_elf_origin(path, origin);
+        if (index == 0)
+        {
+            memcpy(exe_origin, origin, sizeof(origin));
+            exe_data = data;
+            exe_size = size;
+        }
+
+        const char *names[LL_ELF_MAX_NEEDED + 1];
+        size_t name_count = 0;
+        if (current->interp)
+        {
+            names[name_count++] = current->interp;
+        }
+        for (size_t i = 0; i < current->needed_count; i++)
+        {
+            names[name_count++] = current->needed[i];
+        }
+
+        for (size_t i = 0; i < name_count && !LL_ERRORED(err); i++)
+        {
+            char resolved[PATH_MAX];
+            struct stat lib_st;
+            if (!ll_elf_resolve(names[i], current, origin, exe_info, exe_origin, &cache, resolved, &lib_st))
+            {
+                err = ll_string_list_push(&deps->missing, &deps->missing_count, &deps->missing_capacity, names[i],
+                                          strlen(names[i]));
+                continue;
+            }
+            int seen = 0;
+            for (size_t j = 0; j < object_count && !seen; j++)
+            {
+                seen = objects[j].dev == lib_st.st_dev && objects[j].ino == lib_st.st_ino;
+            }
+            if (seen || object_count == LL_ELF_MAX_OBJECTS)
+            {
+                continue;
+            }
+            objects[object_count].dev = lib_st.st_dev;
+            objects[object_count].ino = lib_st.st_ino;
+            objects[object_count].path = strdup(resolved);
+            if (!objects[object_count].path)
+            {
+                err = LL_ERROR_OUT_OF_MEMORY;
+                break;
+            }
+            object_count++;
+        }
+        if (index != 0)
+        {
+            munmap((void *)data, size);
+        }
+    }
+
+    /* The loader itself reads the cache, so dynamically linked programs need it too. */
+    deps->ldso_cache = !LL_ERRORED(err) && cache.data && exe_info->interp;
+    if (exe_data)
+    {
+        munmap((void *)exe_data, exe_size);
+    }
+    free(infos);
+    for (size_t i = 0; i < object_count; i++)
+    {
+        free(objects[i].path);
+    }
+    free(objects);
+    ll_ldso_cache_close(&cache);
+    return err;
+}
+
+ll_error_t ll_elf_analyze(const char *const binary, ll_elf_deps_t **const out_deps)
+{
+    if (!binary || !out_deps)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    *out_deps = NULL;
+
+    struct stat st;
+    if (stat(binary, &st) < 0)
+    {
+        return LL_ERROR_SYSTEM;
+    }
+
+    ll_elf_cache_acquire();
+    for (size_t i = 0; i < LL_ELF_CACHE_ENTRIES; i++)
+    {
+        const struct ll_elf_cache_entry *entry = &ll_elf_cache[i];
+        if (entry->deps && entry->dev == st.st_dev && entry->ino == st.st_ino && entry->size == st.st_size &&
+            entry->mtime.tv_sec == st.st_mtim.tv_sec && entry->mtime.tv_nsec == st.st_mtim.tv_nsec)
+        {
+            ll_elf_deps_t *copy = ll_elf_deps_copy(entry->deps);
+            ll_elf_cache_release();
+            *out_deps = copy;
+            return copy ? LL_ERROR_OK : LL_ERROR_OUT_OF_MEMORY;
+        }
+    }
+    ll_elf_cache_release();
+
+    ll_elf_deps_t *deps = calloc(1, sizeof(*deps));
+    if (!deps)
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    const ll_error_t err = ll_elf_walk(binary, deps);
+    if (LL_ERRORED(err))
+    {
+        ll_elf_deps_free(deps);
+        return err;
+    }
+
+    ll_elf_deps_t *cached = ll_elf_deps_copy(deps);
+    if (cached)
+    {
+        ll_elf_cache_acquire();
+        struct ll_elf_cache_entry *entry = &ll_elf_cache[ll_elf_cache_next];
+        ll_elf_cache_next = (ll_elf_cache_next + 1) % LL_ELF_CACHE_ENTRIES;
+        ll_elf_deps_t *evicted = entry->deps;
+        entry->dev = st.st_dev;
+        entry->ino = st.st_ino;
+        entry->size = st.st_size;
+        entry->mtime = st.st_mtim;
+        entry->deps = cached;
+        ll_elf_cache_release();
+        ll_elf_deps_free(evicted);
+    }
+    *out_deps = deps;
+    return LL_ERROR_OK;
+}
+
+void ll_elf_cache_clear(void)
+{
+    ll_elf_cache_acquire();
+    ll_elf_deps_t *evicted[LL_ELF_CACHE_ENTRIES];
+    for (size_t i = 0; i < LL_ELF_CACHE_ENTRIES; i++)
+    {
+        evicted[i] = ll_elf_cache[i].deps;
+        ll_elf_cache[i].deps = NULL;
+    }
+    ll_elf_cache_release();
+    for (size_t i = 0; i < LL_ELF_CACHE_ENTRIES; i++)
+    {
+        ll_elf_deps_free(evicted[i]);
+    }
+}
+
+size_t ll_elf_deps_count(const ll_elf_deps_t *const deps)
+{
+    return deps ? deps->count : 0;
+}
+
+const char *ll_elf_deps_path(const ll_elf_deps_t *const deps, const size_t index)
+{
+    return (deps && index < deps->count) ? deps->paths[index] : NULL;
+}
+
+size_t ll_elf_deps_missing_count(const ll_elf_deps_t *const deps)
+{
+    return deps ? deps->missing_count : 0;
+}
+
+const char *ll_elf_deps_missing(const ll_elf_deps_t *const deps, const size_t index)
+{
+    return (deps && index < deps->missing_count) ? deps->missing[index] : NULL;
+}
+
+ll_error_t ll_ruleset_add_elf_deps(const ll_ruleset_t *const ruleset,
+                                   const ll_elf_deps_t *const deps,
+                                   const size_t collapse_threshold,
+                                   const __u32 flags,
+                                   size_t *const out_failed)
+{
+    if (!ruleset || !deps)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    const __u64 access = LANDLOCK_ACCESS_FS_EXECUTE | LANDLOCK_ACCESS_FS_READ_FILE;
+    /* One more rule for the loader cache, which never takes part in collapsing. */
+    ll_path_rule_t *rules = calloc(deps->count + 1, sizeof(*rules));
+    char **dirs = calloc(deps->count ? deps->count : 1, sizeof(*dirs));
+    if (!rules || !dirs)
+    {
+        free(rules);
+        free(dirs);
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+
+    ll_error_t err = LL_ERROR_OK;
+    size_t rule_count = 0;
+    size_t dir_count = 0;
+    for (size_t i = 0; i < deps->count && !LL_ERRORED(err); i++)
+    {
+        const char *path = deps->paths[i];
+        const char *slash = strrchr(path, '/');
+        size_t dir_len = slash ? (size_t)(slash - path) : 0;
+        size_t siblings = 0;
+        for (size_t j = 0; collapse_threshold && dir_len && j < deps->count; j++)
+        {
+            siblings += strncmp(deps->paths[j], path, dir_len) == 0 && deps->paths[j][dir_len] == '/' &&
+                        !strchr(deps->paths[j] + dir_len + 1, '/');
+        }
+        if (!collapse_threshold || siblings < collapse_threshold)
+        {
+            rules[rule_count].path = path;
+            rules[rule_count].access = access;
+            rule_count++;
+            continue;
+        }
+        int emitted = 0;
+        for (size_t j = 0; j < dir_count && !emitted; j++)
+        {
+            emitted = strncmp(dirs[j], path, dir_len) == 0 && dirs[j][dir_len] == '\0';
+        }
+        if (emitted)
+        {
+            continue;
+        }
+        dirs[dir_count] = malloc(dir_len + 1);
+        if (!dirs[dir_count])
+        {
+            err = LL_ERROR_OUT_OF_MEMORY;
+            break;
+        }
+        memcpy(dirs[dir_count], path, dir_len);
+        dirs[dir_count][dir_len] = '\0';
+        rules[rule_count].path = dirs[dir_count];
+        rules[rule_count].access = access;
+        rule_count++;
+        dir_count++;
+    }
+    if (deps->ldso_cache)
+    {
+        rules[rule_count].path = LL_LDSO_CACHE_PATH;
+        rules[rule_count].access = LANDLOCK_ACCESS_FS_READ_FILE;
+        rule_count++;
+    }
+
+    if (!LL_ERRORED(err))
+    {
+        err = ll_ruleset_add_paths(ruleset, rules, rule_count, flags, out_failed);
+    }
+    for (size_t i = 0; i < dir_count; i++)
+    {
+        free(dirs[i]);
+    }
+    free(dirs);
+    free(rules);
+    return err;
+}
+
+
+/*
+ * Rules for mapped and open files.
+ */
+
+struct ll_mapped_file
+{
+    dev_t dev;
+    ino_t ino;
+    __u64 access;
+    const char *path;
+};
+
+struct ll_mapped_set
+{
+    struct ll_mapped_file *files;
+    size_t count;
+    size_t capacity;
+    /* Open-addressing index into files; SIZE_MAX marks an empty slot. */
+    size_t *index;
+    size_t mask;
+};
+
+static size_t ll_mapped_slot(const struct ll_mapped_set *const set, const dev_t dev, const ino_t ino)
+{
+    __u64 hash = ll_hash_bytes(LL_HASH_INIT, &dev, sizeof(dev));
+    hash = ll_hash_bytes(hash, &ino, sizeof(ino));
+    size_t slot = (size_t)hash & set->mask;
+    while (set->index[slot] != SIZE_MAX &&
+           (set->files[set->index[slot]].dev != dev || set->files[set->index[slot]].ino != ino))
+    {
+        slot = (slot + 1) & set->mask;
+    }
+    return slot;
+}
+
+static ll_error_t ll_mapped_add(struct ll_mapped_set *const set, const dev_t dev, const ino_t ino,
+                                const char *const path, const __u64 access)
+{
+    if ((set->count + 1) * 2 > set->mask + 1)
+    {
+        const size_t slots = set->mask ? (set->mask + 1) * 2 : 64;
+        size_t *index = malloc(slots * sizeof(*index));
+        struct ll_mapped_file *files = realloc(set->files, (slots / 2) * sizeof(*files));
+        if (files)
+        {
+            set->files = files;
+        }
+        if (!index || !files)
+        {
+            free(index);
+            return LL_ERROR_OUT_OF_MEMORY;
+        }
+        free(set->index);
+        set->index = index;
+        set->mask = slots - 1;
+        for (size_t i = 0; i < slots; i++)
+        {
+            index[i] = SIZE_MAX;
+        }
+        for (size_t i = 0; i < set->count; i++)
+        {
+            index[ll_mapped_slot(set, set->files[i].dev, set->files[i].ino)] = i;
+        }
+    }
+
+    const size_t slot = ll_mapped_slot(set, dev, ino);
+    if (set->index[slot] != SIZE_MAX)
+    {
+        set->files[set->index[slot]].access |= access;
+        return LL_ERROR_OK;
+    }
+    set->files[set->count].dev = dev;
+    set->files[set->count].ino = ino;
+    set->files[set->count].access = access;
+    set->files[set->count].path = path;
+    set->index[slot] = set->count++;
+    return LL_ERROR_OK;
+}
+
+/* Parse /proc/self/maps in place; paths in @p set point into @p buf. */
+static ll_error_t ll_mapped_parse_maps(char *const buf, struct ll_mapped_set *const set)
+{
+    ll_error_t err = LL_ERROR_OK;
+    char *line = buf;
+    while (*line && !LL_ERRORED(err))
+    {
+        char *end = strchr(line, '\n');
+        if (end)
+        {
+            *end = '\0';
+        }
+        /* start-end perms offset major:minor inode path */
+        const char *cursor = line;
+        const char *fields[5];
+        size_t field = 0;
+        while (field < 5 && *cursor)
+        {
+            fields[field++] = cursor;
+            while (*cursor && *cursor != ' ')
+            {
+                cursor++;
+            }
+            while (*cursor == ' ')
+            {
+                cursor++;
+            }
+        }
+        char *path = (char *)cursor;
+        if (field == 5 && path[0] == '/')
+        {
+            const char *colon = strchr(fields[3], ':');
+            const __u64 ino = ll_parse_u64(fields[4], 10);
+            const size_t len = strlen(path);
+            static const char deleted[] = " (deleted)";
+            if (colon && ino != 0 &&
+                (len <= sizeof(deleted) - 1 || strcmp(path + len - (sizeof(deleted) - 1), deleted) != 0))
+            {
+                const dev_t dev = makedev((unsigned int)ll_parse_u64(fields[3], 16),
+                                          (unsigned int)ll_parse_u64(colon + 1, 16));
+                const __u64 access =
+                    LANDLOCK_ACCESS_FS_READ_FILE | (fields[1][2] == 'x' ? LANDLOCK_ACCESS_FS_EXECUTE : 0);
+                err = ll_mapped_add(set, dev, (ino_t)ino, path, access);
+            }
+        }
+        if (!end)
+        {
+            break;
+        }
+        line = end + 1;
+    }
+    return err;
+}
+
+/* Add regular files open in /proc/self/fd; their link targets are kept in @p names. */
+static ll_error_t ll_mapped_collect_fds(struct ll_mapped_set *const set, struct ll_strbuf *const names)
+{
+    DIR *dir = opendir("/proc/self/fd");
+    if (!dir)
+    {
+        return LL_ERROR_OK;
+    }
+    struct
+    {
+        dev_t dev;
+        ino_t ino;
+        __u64 access;
+        size_t name;
+    } *found = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    ll_error_t err = LL_ERROR_OK;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (entry->d_name[0] < '0' || entry->d_name[0] > '9')
+        {
+            continue;
+        }
+        const int fd = (int)ll_parse_u64(entry->d_name, 10);
+        struct stat st;
+        const int mode = fcntl(fd, F_GETFL);
+        if (fd == dirfd(dir) || mode < 0 || (O_PATH && (mode & O_PATH) == O_PATH) || fstat(fd, &st) < 0 ||
+            !S_ISREG(st.st_mode))
+        {
+            continue;
+        }
+        char link[64];
+        char target[PATH_MAX];
+        snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+        const ssize_t len = readlink(link, target, sizeof(target) - 1);
+        if (len <= 0 || target[0] != '/')
+        {
+            continue;
+        }
+        target[len] = '\0';
+
+        if (count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 16;
+            void *grown = realloc(found, capacity * sizeof(*found));
+            if (!grown)
+            {
+                err = LL_ERROR_OUT_OF_MEMORY;
+                break;
+            }
+            found = grown;
+        }
+        found[count].dev = st.st_dev;
+        found[count].ino = st.st_ino;
+        found[count].access = ((mode & O_ACCMODE) != O_WRONLY ? LANDLOCK_ACCESS_FS_READ_FILE : 0) |
+                              ((mode & O_ACCMODE) != O_RDONLY ? LANDLOCK_ACCESS_FS_WRITE_FILE : 0);
+        /* Names are referenced by offset until the buffer stops moving. */
+        found[count].name = names->len;
+        ll_strbuf_append(names, target, (size_t)len + 1);
+        count++;
+    }
+    closedir(dir);
+
+    if (names->failed)
+    {
+        err = LL_ERROR_OUT_OF_MEMORY;
+    }
+    for (size_t i = 0; i < count && !LL_ERRORED(err); i++)
+    {
+        err = ll_mapped_add(set, found[i].dev, found[i].ino, names->data + found[i].name,
+                            found[i].access);
+    }
+    free(found);
+    return err;
+}
+
+ll_error_t ll_ruleset_add_mapped_files(const ll_ruleset_t *const ruleset,
+                                       const unsigned int options,
+                                       const __u32 flags,
+                                       size_t *const out_added)
+{
+    if (out_added)
+    {
+        *out_added = 0;
+    }
+    if (!ruleset || (options & ~LL_MAPPED_FILES_OPEN_FDS) != 0)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    size_t len = 0;
+    char *maps = ll_read_file("/proc/self/maps", &len);
+    if (!maps)
+    {
+        return LL_ERROR_SYSTEM;
+    }
+
+    struct ll_mapped_set set;
+    memset(&set, 0, sizeof(set));
+    struct ll_strbuf names;
+    memset(&names, 0, sizeof(names));
+    ll_error_t err = ll_mapped_parse_maps(maps, &set);
+    if (!LL_ERRORED(err) && (options & LL_MAPPED_FILES_OPEN_FDS))
+    {
+        err = ll_mapped_collect_fds(&set, &names);
+    }
+
+    size_t added = 0;
+    for (size_t i = 0; i < set.count && !LL_ERRORED(err); i++)
+    {
+        const __u64 access = set.files[i].access & ruleset->handled_access_fs;
+        if (access == 0)
+        {
+            continue;
+        }
+        const int fd = open(set.files[i].path, O_PATH | O_CLOEXEC);
+        struct stat st;
+        if (fd < 0)
+        {
+            continue;
+        }
+        if (fstat(fd, &st) == 0 && st.st_dev == set.files[i].dev && st.st_ino == set.files[i].ino)
+        {
+            err = ll_ruleset_add_path_fd(ruleset, fd, access, flags);
+            added += !LL_ERRORED(err);
+        }
+        close(fd);
+    }
+
+    if (out_added)
+    {
+        *out_added = added;
+    }
+    free(names.data);
+    free(set.files);
+    free(set.index);
+    free(maps);
+    return err;
+}
+
+
+/*
+ * Mount-topology-aware rule planning.
+ */
+
+struct ll_mount_key
+{
+    const char *point;
+    size_t index;
+};
+
+struct ll_mount_dev
+{
+    __u64 dev;
+    size_t index;
+};
+
+struct ll_mount_table
+{
+    char *data;
+    ll_mount_info_t *mounts;
+    size_t count;
+    /* Open-addressing index from mount point to its topmost mount; SIZE_MAX marks an empty slot. */
+    size_t *index;
+    size_t mask;
+    /* Mount points in strcmp() order, for submount lookups. */
+    struct ll_mount_key *by_point;
+    /* Mounts grouped by device, for bind mount lookups. */
+    struct ll_mount_dev *by_dev;
+};
+
+/* Decode the octal escapes mountinfo uses for space, tab, newline and backslash. */
+static void ll_mount_unescape(char *const field)
+{
+    char *out = field;
+    for (const char *in = field; *in; out++)
+    {
+        if (in[0] == '\\' && in[1] >= '0' && in[1] <= '3' && in[2] >= '0' && in[2] <= '7' && in[3] >= '0' &&
+            in[3] <= '7')
+        {
+            *out = (char)(((in[1] - '0') << 6) | ((in[2] - '0') << 3) | (in[3] - '0'));
+            in += 4;
+        }
+        else
+        {
+            *out = *in++;
+        }
+    }
+    *out = '\0';
+}
+
+static size_t ll_mount_slot(const struct ll_mount_table *const table, const char *const point, const size_t len)
+{
+    size_t slot = (size_t)ll_hash_bytes(LL_HASH_INIT, point, len) & table->mask;
+    while (table->index[slot] != SIZE_MAX)
+    {
+        const char *other = table->mounts[table->index[slot]].mount_point;
+        if (strncmp(other, point, len) == 0 && other[len] == '\0')
+        {
+            break;
+        }
+        slot = (slot + 1) & table->mask;
+    }
+    return slot;
+}
+
+static int ll_mount_key_compare(const void *const a, const void *const b)
+{
+    const struct ll_mount_key *const ka = a;
+    const struct ll_mount_key *const kb = b;
+    const int order = strcmp(ka->point, kb->point);
+    return order ? order : (ka->index > kb->index) - (ka->index < kb->index);
+}
+
+static int ll_mount_dev_compare(const void *const a, const void *const b)
+{
+    const struct ll_mount_dev *const da = a;
+    const struct ll_mount_dev *const db = b;
+    if (da->dev != db->dev)
+    {
+        return da->dev < db->dev ? -1 : 1;
+    }
+    return (da->index > db->index) - (da->index < db->index);
+}
+
+/* Split one mountinfo line into an entry; returns -1 if it is malformed. */
+static int ll_mount_parse_line(char *line, ll_mount_info_t *const info)
+{
+    char *fields[6];
+    size_t field_count = 0;
+    char *fs_type = NULL;
+    char *source = NULL;
+    int after_separator = 0;
+    for (char *save = NULL, *tok = strtok_r(line, " ", &save); tok; tok = strtok_r(NULL, " ", &save))
+    {
+        if (field_count < 6)
+        {
+            fields[field_count++] = tok;
+        }
+        else if (!after_separator)
+        {
+            after_separator = strcmp(tok, "-") == 0;
+        }
+        else if (!fs_type)
+        {
+            fs_type = tok;
+        }
+        else if (!source)
+        {
+            source = tok;
+        }
+    }
+    if (field_count < 6 || !fs_type)
+    {
+        return -1;
+    }
+    char *colon = strchr(fields[2], ':');
+    if (!colon)
+    {
+        return -1;
+    }
+    *colon = '\0';
+    info->mount_id = (unsigned int)ll_parse_u64(fields[0], 10);
+    info->parent_id = (unsigned int)ll_parse_u64(fields[1], 10);
+    info->dev = makedev(ll_parse_u64(fields[2], 10), ll_parse_u64(colon + 1, 10));
+    ll_mount_unescape(fields[3]);
+    ll_mount_unescape(fields[4]);
+    ll_mount_unescape(fs_type);
+    info->root = fields[3];
+    info->mount_point = fields[4];
+    info->fs_type = fs_type;
+    if (source)
+    {
+        ll_mount_unescape(source);
+    }
+    info->source = source ? source : "";
+    return info->mount_point[0] == '/' && info->root[0] == '/' ? 0 : -1;
+}
+
+ll_error_t ll_mount_table_load(ll_mount_table_t **const out_table)
+{
+    if (!out_table)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    *out_table = NULL;
+
+    ll_mount_table_t *table = calloc(1, sizeof(*table));
+    if (!table)
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    size_t len = 0;
+    table->data = ll_read_file("/proc/self/mountinfo", &len);
+    if (!table->data)
+    {
+        const ll_error_t err = errno == ENOMEM ? LL_ERROR_OUT_OF_MEMORY : LL_ERROR_SYSTEM;
+        free(table);
+        return err;
+    }
+
+    size_t lines = 1;
+    for (size_t i = 0; i < len; i++)
+    {
+        lines += table->data[i] == '\n';
+    }
+    table->mask = ll_round_pow2(lines * 2) - 1;
+    table->mounts = malloc(lines * sizeof(*table->mounts));
+    table->index = malloc((table->mask + 1) * sizeof(*table->index));
+    table->by_point = malloc(lines * sizeof(*table->by_point));
+    table->by_dev = malloc(lines * sizeof(*table->by_dev));
+    if (!table->mounts || !table->index || !table->by_point || !table->by_dev)
+    {
+        ll_mount_table_free(table);
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    for (size_t i = 0; i <= table->mask; i++)
+    {
+        table->index[i] = SIZE_MAX;
+    }
+
+    for (char *line = table->data; *line;)
+    {
+        char *end = strchr(line, '\n');
+        if (end)
+        {
+            *end = '\0';
+        }
+        ll_mount_info_t *const info = &table->mounts[table->count];
+        if (ll_mount_parse_line(line, info) == 0)
+        {
+            /* Later entries are mounted on top of earlier ones at the same point. */
+            const size_t slot = ll_mount_slot(table, info->mount_point, strlen(info->mount_point));
+            table->index[slot] = table->count;
+            table->by_point[table->count].point = info->mount_point;
+            table->by_point[table->count].index = table->count;
+            table->by_dev[table->count].dev = info->dev;
+            table->by_dev[table->count].index = table->count;
+            table->count++;
+        }
+        if (!end)
+        {
+            break;
+        }
+        line = end + 1;
+    }
+    qsort(table->by_point, table->count, sizeof(*table->by_point), ll_mount_key_compare);
+    qsort(table->by_dev, table->count, sizeof(*table->by_dev), ll_mount_dev_compare);
+
+    *out_table = table;
+    return LL_ERROR_OK;
+}
+
+void ll_mount_table_free(ll_mount_table_t *const table)
+{
+    if (!table)
+    {
+        return;
+    }
+    free(table->by_dev);
+    free(table->by_point);
+    free(table->index);
+    free(table->mounts);
+    free(table->data);
+    free(table);
+}
+
+size_t ll_mount_table_count(const ll_mount_table_t *const table)
+{
+    return table ? table->count : 0;
+}
+
+int ll_mount_table_get(const ll_mount_table_t *const table, const size_t index, ll_mount_info_t *const out_info)
+{
+    if (!table || !out_info || index >= table->count)
+    {
+        return -1;
+    }
+    *out_info = table->mounts[index];
+    return 0;
+}
+
+/* Normalise an absolute path into out (strlen(path) + 2 bytes); returns its length, or 0 if it is not absolute or contains "..". */
+static size_t ll_mount_normalize(const char *const path, char *const out)
+{
+    if (path[0] != '/')
+    {
+        return 0;
+    }
+    size_t len = 0;
+    const char *cursor = path;
+    for (size_t n; (n = ll_next_component(&cursor)) != 0; cursor += n)
+    {
+        if (n == 2 && cursor[0] == '.' && cursor[1] == '.')
+        {
+            return 0;
+        }
+        out[len++] = '/';
+        memcpy(out + len, cursor, n);
+        len += n;
+    }
+    if (len == 0)
+    {
+        out[len++] = '/';
+    }
+    out[len] = '\0';
+    return len;
+}
+
+/* Topmost mount whose mount point is the longest prefix of a normalised path. */
+static long ll_mount_lookup(const ll_mount_table_t *const table, const char *const path, const size_t len)
+{
+    long found = -1;
+    for (size_t end = 1; end <= len; end++)
+    {
+        if (end == len || path[end] == '/' || end == 1)
+        {
+            const size_t slot = ll_mount_slot(table, path, end);
+            if (table->index[slot] != SIZE_MAX)
+            {
+                found = (long)table->index[slot];
+            }
+        }
+    }
+    return found;
+}
+
+long ll_mount_table_find(const ll_mount_table_t *const table, const char *const path)
+{
+    if (!table || !path)
+    {
+        return -1;
+    }
+    char *norm = malloc(strlen(path) + 2);
+    if (!norm)
+    {
+        return -1;
+    }
+    const size_t len = ll_mount_normalize(path, norm);
+    const long found = len ? ll_mount_lookup(table, norm, len) : -1;
+    free(norm);
+    return found;
+}
+
+/* Whether normalised path a is b or lies beneath it. */
+static int ll_mount_path_within(const char *const a, const char *const b)
+{
+    const size_t b_len = strlen(b);
+    if (b_len == 1)
+    {
+        return 1;
+    }
+    return strncmp(a, b, b_len) == 0 && (a[b_len] == '\0' || a[b_len] == '/');
+}
+
+static int ll_mount_is_slow(const char *const fs_type, const char *const *const slow_types)
+{
+    static const char *const defaults[] = {"nfs",   "nfs4", "cifs", "smb3",      "fuse.", "fuseblk",
+                                           "sshfs", "9p",   "ceph", "glusterfs", NULL};
+    for (const char *const *type = slow_types ? slow_types : defaults; *type; type++)
+    {
+        const size_t len = strlen(*type);
+        if (len && (*type)[len - 1] == '.' ? strncmp(fs_type, *type, len) == 0 : strcmp(fs_type, *type) == 0)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Internal marker for rules folded into a collapsed rule. */
+#define LL_PLAN_DROPPED (1u << 31)
+
+/* Annotate one rule; norm is its normalised path. */
+static ll_error_t ll_mount_annotate(const ll_mount_table_t *const table, const char *const norm, const size_t len,
+                                    const ll_plan_options_t *const options, ll_plan_rule_t *const rule)
+{
+    rule->mount_index = ll_mount_lookup(table, norm, len);
+    rule->flags = 0;
+    if (rule->mount_index < 0)
+    {
+        return LL_ERROR_OK;
+    }
+    const ll_mount_info_t *const mount = &table->mounts[rule->mount_index];
+
+    /* The rule's directory as seen from the root of its filesystem. */
+    const size_t point_len = strlen(mount->mount_point);
+    const char *const rest = point_len == 1 ? norm : norm + point_len;
+    const size_t root_len = strcmp(mount->root, "/") == 0 ? 0 : strlen(mount->root);
+    char *fs_path = malloc(root_len + strlen(rest) + 2);
+    if (!fs_path)
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    memcpy(fs_path, mount->root, root_len);
+    strcpy(fs_path + root_len, rest);
+    if (fs_path[0] == '\0')
+    {
+        strcpy(fs_path, "/");
+    }
+
+    size_t first = 0;
+    size_t last = table->count;
+    while (first < last)
+    {
+        const size_t mid = first + (last - first) / 2;
+        if (table->by_dev[mid].dev < mount->dev)
+        {
+            first = mid + 1;
+        }
+        else
+        {
+            last = mid;
+        }
+    }
+    for (size_t i = first; i < table->count && table->by_dev[i].dev == mount->dev; i++)
+    {
+        const ll_mount_info_t *const other = &table->mounts[table->by_dev[i].index];
+        if (other == mount || ll_mount_path_within(other->mount_point, norm))
+        {
+            continue;
+        }
+        if (ll_mount_path_within(fs_path, other->root))
+        {
+            rule->flags |= LL_PLAN_WIDER;
+        }
+        else if (ll_mount_path_within(other->root, fs_path))
+        {
+            rule->flags |= LL_PLAN_NARROWER;
+        }
+    }
+    free(fs_path);
+
+    /* Mount points beneath the path sort right after "<path>/". */
+    first = 0;
+    last = table->count;
+    while (first < last)
+    {
+        const size_t mid = first + (last - first) / 2;
+        if (strcmp(table->by_point[mid].point, norm) <= 0)
+        {
+            first = mid + 1;
+        }
+        else
+        {
+            last = mid;
+        }
+    }
+    for (size_t i = first; i < table->count && !(rule->flags & LL_PLAN_SUBMOUNTS); i++)
+    {
+        const char *const point = table->by_point[i].point;
+        if (len == 1 || (strncmp(point, norm, len) == 0 && point[len] == '/'))
+        {
+            rule->flags |= LL_PLAN_SUBMOUNTS;
+        }
+        else if (strncmp(point, norm, len) != 0)
+        {
+            break;
+        }
+    }
+
+    if (strcmp(mount->fs_type, "overlay") == 0)
+    {
+        rule->flags |= LL_PLAN_OVERLAY;
+    }
+    if (ll_mount_is_slow(mount->fs_type, options->slow_fs_types))
+    {
+        rule->flags |= LL_PLAN_SLOW;
+        if (options->slow_action == LL_PLAN_SLOW_SKIP)
+        {
+            rule->flags |= LL_PLAN_SKIPPED;
+        }
+        else if (options->slow_action == LL_PLAN_SLOW_DEFER)
+        {
+            rule->flags |= LL_PLAN_DEFERRED;
+        }
+    }
+    return LL_ERROR_OK;
+}
+
+ll_error_t ll_mount_plan(const ll_mount_table_t *const table,
+                         const ll_path_rule_t *const rules,
+                         const size_t count,
+                         const ll_plan_options_t *const options,
+                         ll_plan_rule_t *const out_plan,
+                         size_t *const out_count)
+{
+    if (!table || (count && (!rules || !out_plan)) || !out_count)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    *out_count = 0;
+    const ll_plan_options_t defaults = ll_plan_options_defaults();
+    const ll_plan_options_t *const opts = options ? options : &defaults;
+
+    ll_plan_rule_t *planned = malloc((count ? count : 1) * sizeof(*planned));
+    if (!planned)
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    ll_error_t err = LL_ERROR_OK;
+    for (size_t i = 0; i < count && !LL_ERRORED(err); i++)
+    {
+        planned[i].path = rules[i].path;
+        planned[i].access = rules[i].access;
+        planned[i].mount_index = -1;
+        planned[i].flags = 0;
+        char *norm = rules[i].path ? malloc(strlen(rules[i].path) + 2) : NULL;
+        if (rules[i].path && !norm)
+        {
+            err = LL_ERROR_OUT_OF_MEMORY;
+            break;
+        }
+        const size_t len = norm ? ll_mount_normalize(rules[i].path, norm) : 0;
+        if (len)
+        {
+            err = ll_mount_annotate(table, norm, len, opts, &planned[i]);
+        }
+        free(norm);
+    }
+
+    /* Replace large groups of rules sharing a mount and access with one mount-point rule. */
+    for (size_t i = 0; opts->collapse_threshold && i < count && !LL_ERRORED(err); i++)
+    {
+        const long mount_index = planned[i].mount_index;
+        if (mount_index < 0 || (planned[i].flags & (LL_PLAN_SKIPPED | LL_PLAN_DROPPED)) ||
+            strcmp(table->mounts[mount_index].mount_point, "/") == 0)
+        {
+            continue;
+        }
+        const __u64 access = planned[i].access;
+        size_t members = 0;
+        for (size_t j = i; j < count; j++)
+        {
+            members += planned[j].mount_index == mount_index && planned[j].access == access &&
+                       !(planned[j].flags & (LL_PLAN_SKIPPED | LL_PLAN_DROPPED));
+        }
+        if (members < opts->collapse_threshold)
+        {
+            continue;
+        }
+        for (size_t j = i + 1; j < count; j++)
+        {
+            if (planned[j].mount_index == mount_index && planned[j].access == access &&
+                !(planned[j].flags & (LL_PLAN_SKIPPED | LL_PLAN_DROPPED)))
+            {
+                planned[j].flags |= LL_PLAN_DROPPED;
+            }
+        }
+        const char *const point = table->mounts[mount_index].mount_point;
+        planned[i].path = point;
+        err = ll_mount_annotate(table, point, strlen(point), opts, &planned[i]);
+        planned[i].flags |= LL_PLAN_COLLAPSED;
+    }
+
+    if (!LL_ERRORED(err))
+    {
+        /* Deferred rules go last, in their original order. */
+        size_t n = 0;
+        for (unsigned int deferred = 0; deferred <= LL_PLAN_DEFERRED; deferred += LL_PLAN_DEFERRED)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                if (!(planned[i].flags & LL_PLAN_DROPPED) && (planned[i].flags & LL_PLAN_DEFERRED) == deferred)
+                {
+                    out_plan[n++] = planned[i];
+                }
+            }
+        }
+        *out_count = n;
+    }
+    free(planned);
+    return err;
+}
+
+ll_error_t ll_ruleset_add_plan(const ll_ruleset_t *const ruleset,
+                               const ll_plan_rule_t *const plan,
+                               const size_t count,
+                               const int include_deferred,
+                               const __u32 flags,
+                               size_t *const out_failed)
+{
+    if (!ruleset || (count && !plan))
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    ll_path_rule_t *rules = malloc((count ? count : 1) * sizeof(*rules));
+    size_t *origin = malloc((count ? count : 1) * sizeof(*origin));
+    if (!rules || !origin)
+    {
+        free(rules);
+        free(origin);
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    size_t rule_count = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (plan[i].mount_index < 0 || (plan[i].flags & LL_PLAN_SKIPPED) ||
+            ((plan[i].flags & LL_PLAN_DEFERRED) && !include_deferred))
+        {
+            continue;
+        }
+        rules[rule_count].path = plan[i].path;
+        rules[rule_count].access = plan[i].access;
+        origin[rule_count] = i;
+        rule_count++;
+    }
+    size_t failed = 0;
+    const ll_error_t err = rule_count ? ll_ruleset_add_paths(ruleset, rules, rule_count, flags, &failed) : LL_ERROR_OK;
+    if (LL_ERRORED(err) && out_failed && failed < rule_count)
+    {
+        *out_failed = origin[failed];
+    }
+    free(origin);
+    free(rules);
+    return err;
+}
+
+
+/*
+ * Deadline-bounded path resolution.
+ */
+
+enum
+{
+    LL_RESOLVE_PENDING = 0,
+    LL_RESOLVE_RUNNING = 1,
+    LL_RESOLVE_DONE = 2,
+    LL_RESOLVE_ABANDONED = 3,
+};
+
+struct ll_resolve_job
+{
+    const char *path;
+    int state;
+    int fd;
+    __u64 start_ms;
+};
+
+/* Shared with the helper threads, which may outlive the call when stuck in open(). */
+struct ll_resolve_pool
+{
+    unsigned int refs;
+    size_t next;
+    size_t count;
+    __u32 done_seq;
+    __u32 sleeping;
+    /*
+     * Threads only run ahead of the caller by window jobs: this bounds the
+     * descriptors held at once, and keeps the descriptor table from growing
+     * (which costs an RCU grace period once it is shared between threads).
+     */
+    size_t consumed;
+    size_t window;
+    __u32 consumed_seq;
+    __u32 threads_sleeping;
+    struct ll_resolve_job *jobs;
+    char *paths;
+    int (*open_path)(void *ctx, const char *path);
+    void *open_ctx;
+};
+
+static void ll_resolve_unref(struct ll_resolve_pool *const pool)
+{
+    if (__atomic_sub_fetch(&pool->refs, 1, __ATOMIC_ACQ_REL) == 0)
+    {
+        free(pool->jobs);
+        free(pool->paths);
+        free(pool);
+    }
+}
+
+static void *ll_resolve_thread(void *const arg)
+{
+    struct ll_resolve_pool *const pool = arg;
+    for (;;)
+    {
+        const size_t i = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED);
+        if (i >= pool->count)
+        {
+            break;
+        }
+        struct ll_resolve_job *const job = &pool->jobs[i];
+        while (i >= __atomic_load_n(&pool->consumed, __ATOMIC_ACQUIRE) + pool->window &&
+               __atomic_load_n(&job->state, __ATOMIC_ACQUIRE) == LL_RESOLVE_PENDING)
+        {
+            const __u32 seq = __atomic_load_n(&pool->consumed_seq, __ATOMIC_SEQ_CST);
+            __atomic_add_fetch(&pool->threads_sleeping, 1, __ATOMIC_SEQ_CST);
+            if (i >= __atomic_load_n(&pool->consumed, __ATOMIC_SEQ_CST) + pool->window)
+            {
+                ll_futex_wait(&pool->consumed_seq, seq, -1);
+            }
+            __atomic_sub_fetch(&pool->threads_sleeping, 1, __ATOMIC_SEQ_CST);
+        }
+        __atomic_store_n(&job->start_ms, ll_monotonic_ms(), __ATOMIC_RELAXED);
+        int expected = LL_RESOLVE_PENDING;
+        if (!__atomic_compare_exchange_n(&job->state, &expected, LL_RESOLVE_RUNNING, 0, __ATOMIC_ACQ_REL,
+                                         __ATOMIC_ACQUIRE))
+        {
+            continue;
+        }
+        job->fd = pool->open_path ? pool->open_path(pool->open_ctx, job->path) : open(job->path, O_PATH | O_CLOEXEC);
+        expected = LL_RESOLVE_RUNNING;
+        if (!__atomic_compare_exchange_n(&job->state, &expected, LL_RESOLVE_DONE, 0, __ATOMIC_ACQ_REL,
+                                         __ATOMIC_ACQUIRE))
+        {
+            /* Given up on while blocked; a replacement thread has taken over. */
+            if (job->fd >= 0)
+            {
+                close(job->fd);
+            }
+            break;
+        }
+        __atomic_add_fetch(&pool->done_seq, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&pool->sleeping, __ATOMIC_SEQ_CST))
+        {
+            ll_futex_wake(&pool->done_seq);
+        }
+    }
+    ll_resolve_unref(pool);
+    return NULL;
+}
+
+static int ll_resolve_spawn(struct ll_resolve_pool *const pool)
+{
+    pthread_attr_t attr;
+    if (pthread_attr_init(&attr) != 0)
+    {
+        return -1;
+    }
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_attr_setstacksize(&attr, 64 * 1024);
+    __atomic_add_fetch(&pool->refs, 1, __ATOMIC_ACQ_REL);
+    pthread_t thread;
+    const int ret = pthread_create(&thread, &attr, ll_resolve_thread, pool);
+    pthread_attr_destroy(&attr);
+    if (ret != 0)
+    {
+        __atomic_sub_fetch(&pool->refs, 1, __ATOMIC_ACQ_REL);
+        return -1;
+    }
+    return 0;
+}
+
+/* Let the threads run up to window jobs past @p consumed. */
+static void ll_resolve_advance(struct ll_resolve_pool *const pool, const size_t consumed)
+{
+    __atomic_store_n(&pool->consumed, consumed, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&pool->consumed_seq, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&pool->threads_sleeping, __ATOMIC_SEQ_CST))
+    {
+        (void)syscall(__NR_futex, &pool->consumed_seq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+    }
+}
+
+/* Give up on a pending or running job; returns 1 if it had not finished. */
+static int ll_resolve_abandon(struct ll_resolve_job *const job)
+{
+    int expected = __atomic_load_n(&job->state, __ATOMIC_ACQUIRE);
+    while (expected == LL_RESOLVE_PENDING || expected == LL_RESOLVE_RUNNING)
+    {
+        if (__atomic_compare_exchange_n(&job->state, &expected, LL_RESOLVE_ABANDONED, 0, __ATOMIC_ACQ_REL,
+                                        __ATOMIC_ACQUIRE))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Wait until job @p index is done or abandoned, expiring stalled jobs on the way. */
+static void ll_resolve_wait(struct ll_resolve_pool *const pool, const size_t index,
+                            const ll_resolve_options_t *const options, const __u64 total_deadline,
+                            unsigned int *const live_threads)
+{
+    for (;;)
+    {
+        const __u32 seq = __atomic_load_n(&pool->done_seq, __ATOMIC_ACQUIRE);
+        const int state = __atomic_load_n(&pool->jobs[index].state, __ATOMIC_ACQUIRE);
+        if (state == LL_RESOLVE_DONE || state == LL_RESOLVE_ABANDONED)
+        {
+            return;
+        }
+        const __u64 now = ll_monotonic_ms();
+        if (total_deadline && now >= total_deadline)
+        {
+            for (size_t i = index; i < pool->count; i++)
+            {
+                ll_resolve_abandon(&pool->jobs[i]);
+            }
+            ll_resolve_advance(pool, pool->count);
+            return;
+        }
+
+        /* Running jobs all lie between index and the next unclaimed one. */
+        __u64 wake = total_deadline ? total_deadline : now + options->path_timeout_ms;
+        size_t claimed = __atomic_load_n(&pool->next, __ATOMIC_RELAXED);
+        for (size_t i = index; i < pool->count && i < claimed; i++)
+        {
+            struct ll_resolve_job *const job = &pool->jobs[i];
+            if (__atomic_load_n(&job->state, __ATOMIC_ACQUIRE) != LL_RESOLVE_RUNNING)
+            {
+                continue;
+            }
+            const __u64 deadline = __atomic_load_n(&job->start_ms, __ATOMIC_RELAXED) + options->path_timeout_ms;
+            if (now < deadline)
+            {
+                wake = deadline < wake ? deadline : wake;
+            }
+            else if (ll_resolve_abandon(job))
+            {
+                (*live_threads)--;
+                if (ll_resolve_spawn(pool) == 0)
+                {
+                    (*live_threads)++;
+                }
+            }
+        }
+        if (*live_threads == 0)
+        {
+            /* No thread left to open the remaining paths. */
+            for (size_t i = index; i < pool->count; i++)
+            {
+                ll_resolve_abandon(&pool->jobs[i]);
+            }
+            ll_resolve_advance(pool, pool->count);
+            return;
+        }
+        if (wake > now && __atomic_load_n(&pool->done_seq, __ATOMIC_ACQUIRE) == seq)
+        {
+            (void)ll_futex_await(&pool->done_seq, &pool->sleeping, seq, 0, (int)(wake - now));
+        }
+    }
+}
+
+ll_error_t ll_ruleset_add_paths_bounded(const ll_ruleset_t *const ruleset,
+                                        const ll_path_rule_t *const rules,
+                                        const size_t count,
+                                        const ll_resolve_options_t *const options,
+                                        const __u32 flags,
+                                        ll_error_t *const out_results,
+                                        size_t *const out_failed)
+{
+    const ll_resolve_options_t defaults = ll_resolve_options_defaults();
+    const ll_resolve_options_t *const opts = options ? options : &defaults;
+    if (!ruleset || (count && !rules) || opts->threads == 0 || opts->path_timeout_ms == 0 ||
+        opts->path_timeout_ms > INT_MAX)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    if (count == 0)
+    {
+        return LL_ERROR_OK;
+    }
+
+    /* Paths are copied: stalled threads may still read them after we return. */
+    size_t paths_len = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!rules[i].path)
+        {
+            return LL_ERROR_INVALID_ARGUMENT;
+        }
+        paths_len += strlen(rules[i].path) + 1;
+    }
+    struct ll_resolve_pool *pool = calloc(1, sizeof(*pool));
+    if (!pool)
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    pool->refs = 1;
+    pool->count = count;
+    pool->window = opts->threads > 8 ? (size_t)opts->threads * 2 : 16;
+    pool->open_path = opts->open_path;
+    pool->open_ctx = opts->open_ctx;
+    pool->jobs = calloc(count, sizeof(*pool->jobs));
+    pool->paths = malloc(paths_len);
+    if (!pool->jobs || !pool->paths)
+    {
+        ll_resolve_unref(pool);
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    char *cursor = pool->paths;
+    for (size_t i = 0; i < count; i++)
+    {
+        const size_t len = strlen(rules[i].path) + 1;
+        memcpy(cursor, rules[i].path, len);
+        pool->jobs[i].path = cursor;
+        pool->jobs[i].fd = -1;
+        cursor += len;
+    }
+
+    unsigned int live_threads = 0;
+    for (unsigned int i = 0; i < opts->threads && i < count; i++)
+    {
+        live_threads += ll_resolve_spawn(pool) == 0;
+    }
+    if (live_threads == 0)
+    {
+        ll_resolve_unref(pool);
+        return LL_ERROR_SYSTEM;
+    }
+
+    const __u64 total_deadline = opts->total_timeout_ms ? ll_monotonic_ms() + opts->total_timeout_ms : 0;
+    ll_error_t err = LL_ERROR_OK;
+    for (size_t i = 0; i < count; i++)
+    {
+        ll_resolve_wait(pool, i, opts, total_deadline, &live_threads);
+        struct ll_resolve_job *const job = &pool->jobs[i];
+        ll_error_t result = LL_ERROR_TIMEOUT;
+        if (__atomic_load_n(&job->state, __ATOMIC_ACQUIRE) == LL_RESOLVE_DONE)
+        {
+            result = ll_ruleset_add_path_fd(ruleset, job->fd, rules[i].access, flags);
+            if (job->fd >= 0)
+            {
+                close(job->fd);
+            }
+        }
+        if (out_results)
+        {
+            out_results[i] = result;
+        }
+        if (LL_ERRORED(result) && (err == LL_ERROR_OK || result != LL_ERROR_TIMEOUT))
+        {
+            if (out_failed)
+            {
+                *out_failed = i;
+            }
+            err = result;
+        }
+        if (LL_ERRORED(err) && err != LL_ERROR_TIMEOUT)
+        {
+            /* Stop the remaining opens and release what already finished. */
+            for (size_t j = i + 1; j < count; j++)
+            {
+                if (!ll_resolve_abandon(&pool->jobs[j]) &&
+                    __atomic_load_n(&pool->jobs[j].state, __ATOMIC_ACQUIRE) == LL_RESOLVE_DONE &&
+                    pool->jobs[j].fd >= 0)
+                {
+                    close(pool->jobs[j].fd);
+                }
+            }
+            ll_resolve_advance(pool, count);
+            break;
+        }
+        if ((i + 1) % (pool->window / 2) == 0)
+        {
+            ll_resolve_advance(pool, i + 1);
+        }
+    }
+    ll_resolve_unref(pool);
+    return err;
+}
+
+
+/*
+ * Policy fingerprints and the resolved-policy cache.
+ */
+
+#define LL_POLICY_CACHE_MAGIC "LLPCACHE"
+#define LL_POLICY_CACHE_VERSION 2
+
+struct ll_policy_cache_header
+{
+    char magic[8];
+    __u32 version;
+    __u32 reserved;
+    __u64 fingerprint;
+    __u64 handled_access_fs;
+    __u64 handled_access_net;
+    __u64 handled_access_scope;
+    __u64 count;
+};
+
+/* Followed by path_len bytes of path, without a terminator. */
+struct ll_policy_cache_entry
+{
+    __u64 access;
+    __u64 dev;
+    __u64 ino;
+    __s64 mtime_sec;
+    __s64 mtime_nsec;
+    __u32 path_len;
+    __u32 mode;
+    /* Index of the policy rule the entry was resolved from. */
+    __u32 rule;
+    __u32 reserved;
+};
+
+ll_error_t ll_policy_fingerprint(const ll_policy_t *const policy,
+                                 const ll_ruleset_attr_t attr,
+                                 __u64 *const out_fingerprint)
+{
+    if (!policy || !out_fingerprint)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    ll_abi_t kernel_abi = 0;
+    const ll_error_t err = ll_get_abi_version(&kernel_abi);
+    if (LL_ERRORED(err))
+    {
+        return err;
+    }
+    int errata = 0;
+    if (LL_ERRORED(ll_get_errata(&errata)))
+    {
+        errata = -1;
+    }
+
+    const __u64 header[] = {
+        LL_POLICY_CACHE_VERSION,
+        (__u64)kernel_abi,
+        (__u64)(__s64)errata,
+        (__u64)ll_resolve_abi(attr.abi),
+        (__u64)attr.compat_mode,
+        attr.flags,
+        policy->handled_access_fs,
+        policy->handled_access_net,
+        policy->handled_access_scope,
+        policy->path_count,
+        policy->port_count,
+    };
+    __u64 hash = ll_hash_bytes(LL_HASH_INIT, header, sizeof(header));
+
+    /* Rules are combined with a sum so that their order does not matter. */
+    __u64 rules = 0;
+    for (size_t i = 0; i < policy->path_count; i++)
+    {
+        const __u64 rule = ll_hash_bytes(LL_HASH_INIT, policy->paths[i].path, strlen(policy->paths[i].path) + 1);
+        rules += ll_hash_bytes(rule, &policy->paths[i].access, sizeof(policy->paths[i].access));
+    }
+    for (size_t i = 0; i < policy->port_count; i++)
+    {
+        rules += ll_hash_bytes(LL_HASH_INIT ^ 1, &policy->ports[i], sizeof(policy->ports[i]));
+    }
+    *out_fingerprint = ll_hash_bytes(hash, &rules, sizeof(rules));
+    return LL_ERROR_OK;
+}
+
+/*
+ * Add the cached rules after checking each against its validators; returns 1
+ * if one is stale. The fingerprint only identifies the policy, so each entry
+ * must also name a rule of @p policy by path and grant no more than it.
+ */
+static int ll_policy_cache_replay(const char *const data, const size_t len, const __u64 fingerprint,
+                                  const ll_policy_t *const policy, const ll_ruleset_t *const ruleset,
+                                  ll_error_t *const out_err)
+{
+    struct ll_policy_cache_header header;
+    if (len < sizeof(header))
+    {
+        return 1;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, LL_POLICY_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != LL_POLICY_CACHE_VERSION || header.fingerprint != fingerprint ||
+        header.handled_access_fs != ruleset->handled_access_fs ||
+        header.handled_access_net != ruleset->handled_access_net ||
+        header.handled_access_scope != ruleset->handled_access_scope || header.count > policy->path_count)
+    {
+        return 1;
+    }
+
+    size_t offset = sizeof(header);
+    char path[PATH_MAX];
+    for (__u64 i = 0; i < header.count; i++)
+    {
+        struct ll_policy_cache_entry entry;
+        if (len - offset < sizeof(entry))
+        {
+            return 1;
+        }
+        memcpy(&entry, data + offset, sizeof(entry));
+        offset += sizeof(entry);
+        if (entry.path_len >= sizeof(path) || len - offset < entry.path_len)
+        {
+            return 1;
+        }
+        memcpy(path, data + offset, entry.path_len);
+        path[entry.path_len] = '\0';
+        offset += entry.path_len;
+        if (entry.rule >= policy->path_count || strcmp(path, policy->paths[entry.rule].path) != 0 ||
+            (entry.access & ~(policy->paths[entry.rule].access & ruleset->handled_access_fs)) != 0)
+        {
+            return 1;
+        }
+
+        const int fd = open(path, O_PATH | O_CLOEXEC);
+        struct stat st;
+        /* A directory's mtime moves with its entries, which do not change what its rule covers. */
+        if (fd < 0 || fstat(fd, &st) < 0 || (__u64)st.st_dev != entry.dev || (__u64)st.st_ino != entry.ino ||
+            (__u32)(st.st_mode & S_IFMT) != entry.mode ||
+            (!S_ISDIR(st.st_mode) &&
+             ((__s64)st.st_mtim.tv_sec != entry.mtime_sec || (__s64)st.st_mtim.tv_nsec != entry.mtime_nsec)))
+        {
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            return 1;
+        }
+        *out_err = ll_ruleset_add_path_fd(ruleset, fd, entry.access, 0);
+        close(fd);
+        if (LL_ERRORED(*out_err))
+        {
+            return 0;
+        }
+    }
+    return offset == len ? 0 : 1;
+}
+
+/* Resolve and add the policy's path rules, recording them in cache format. */
+static ll_error_t ll_policy_resolve(const ll_policy_t *const policy, const ll_ruleset_t *const ruleset,
+                                    struct ll_strbuf *const cache, __u64 *const out_count)
+{
+    for (size_t i = 0; i < policy->path_count; i++)
+    {
+        __u64 access = policy->paths[i].access;
+        if (ruleset->compat_mode == LL_ABI_COMPAT_BEST_EFFORT)
+        {
+            access &= ruleset->handled_access_fs;
+            if (access == 0)
+            {
+                continue;
+            }
+        }
+        const int fd = open(policy->paths[i].path, O_PATH | O_CLOEXEC);
+        struct stat st;
+        const int have_stat = fd >= 0 && fstat(fd, &st) == 0;
+        if (have_stat && !S_ISDIR(st.st_mode))
+        {
+            access &= ~(__u64)LL_ACCESS_FS_DIR_ONLY;
+        }
+        const ll_error_t err = access ? ll_ruleset_add_path_fd(ruleset, fd, access, 0) : LL_ERROR_OK;
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        if (LL_ERRORED(err))
+        {
+            return err;
+        }
+        const size_t path_len = strlen(policy->paths[i].path);
+        if (access == 0)
+        {
+            continue;
+        }
+        if (!have_stat || path_len >= PATH_MAX)
+        {
+            /* A cache missing this rule would silently drop it. */
+            cache->failed = 1;
+            continue;
+        }
+        struct ll_policy_cache_entry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.access = access;
+        entry.dev = (__u64)st.st_dev;
+        entry.ino = (__u64)st.st_ino;
+        entry.mtime_sec = (__s64)st.st_mtim.tv_sec;
+        entry.mtime_nsec = (__s64)st.st_mtim.tv_nsec;
+        entry.path_len = (__u32)path_len;
+        entry.mode = (__u32)(st.st_mode & S_IFMT);
+        entry.rule = (__u32)i;
+        ll_strbuf_append(cache, (const char *)&entry, sizeof(entry));
+        ll_strbuf_append(cache, policy->paths[i].path, path_len);
+        (*out_count)++;
+    }
+    return LL_ERROR_OK;
+}
+
+/* Write the cache to a temporary file next to @p cache_path and rename it into place. */
+static void ll_policy_cache_store(const char *const cache_path, const char *const data, const size_t len)
+{
+    const size_t path_len = strlen(cache_path);
+    char *tmp = malloc(path_len + sizeof(".XXXXXX"));
+    if (!tmp)
+    {
+        return;
+    }
+    memcpy(tmp, cache_path, path_len);
+    memcpy(tmp + path_len, ".XXXXXX", sizeof(".XXXXXX"));
+    const int fd = mkstemp(tmp);
+    if (fd < 0)
+    {
+        free(tmp);
+        return;
+    }
+    size_t written = 0;
+    while (written < len)
+    {
+        const ssize_t ret = write(fd, data + written, len - written);
+        if (ret < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (ret <= 0)
+        {
+            break;
+        }
+        written += (size_t)ret;
+    }
+    if (close(fd) != 0 || written != len || rename(tmp, cache_path) != 0)
+    {
+        unlink(tmp);
+    }
+    free(tmp);
+}
+
+ll_ruleset_result_t ll_policy_create_ruleset_cached(const ll_policy_t *const policy,
+                                                    const ll_ruleset_attr_t attr,
+                                                    const char *const cache_path,
+                                                    ll_policy_cache_status_t *const out_status)
+{
+    ll_ruleset_result_t out = {.err = LL_ERROR_INVALID_ARGUMENT, .ruleset = NULL};
+    ll_policy_cache_status_t status = LL_POLICY_CACHE_MISS;
+    if (out_status)
+    {
+        *out_status = status;
+    }
+    __u64 fingerprint = 0;
+    if (!policy || !cache_path)
+    {
+        return out;
+    }
+    out.err = ll_policy_fingerprint(policy, attr, &fingerprint);
+    if (LL_ERRORED(out.err))
+    {
+        return out;
+    }
+
+    const ll_ruleset_attr_t policy_attr = ll_policy_attr(policy, attr);
+    out = ll_ruleset_create_result(policy_attr);
+    if (LL_ERRORED(out.err))
+    {
+        return out;
+    }
+    const ll_error_t created = out.err;
+
+    ll_error_t err = LL_ERROR_OK;
+    const int cache_fd = open(cache_path, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    if (cache_fd >= 0)
+    {
+        /* Only a file that no one else could have written is trusted. */
+        struct stat st;
+        size_t len = 0;
+        char *const data = fstat(cache_fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_uid == geteuid() &&
+                                   (st.st_mode & (S_IWGRP | S_IWOTH)) == 0
+                               ? ll_read_fd(cache_fd, &len)
+                               : NULL;
+        close(cache_fd);
+        status = !data || ll_policy_cache_replay(data, len, fingerprint, policy, out.ruleset, &err)
+                     ? LL_POLICY_CACHE_STALE
+                     : LL_POLICY_CACHE_HIT;
+        free(data);
+    }
+    if (status == LL_POLICY_CACHE_STALE)
+    {
+        /* Rules may already have been added from the stale entry: start over. */
+        ll_ruleset_close(out.ruleset);
+        out = ll_ruleset_create_result(policy_attr);
+        if (LL_ERRORED(out.err))
+        {
+            return out;
+        }
+    }
+
+    if (status == LL_POLICY_CACHE_HIT)
+    {
+        if (!LL_ERRORED(err))
+        {
+            err = ll_policy_apply_ports(policy, out.ruleset, NULL);
+        }
+    }
+    else
+    {
+        struct ll_policy_cache_header header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, LL_POLICY_CACHE_MAGIC, sizeof(header.magic));
+        header.version = LL_POLICY_CACHE_VERSION;
+        header.fingerprint = fingerprint;
+        header.handled_access_fs = out.ruleset->handled_access_fs;
+        header.handled_access_net = out.ruleset->handled_access_net;
+        header.handled_access_scope = out.ruleset->handled_access_scope;
+        struct ll_strbuf cache = {0};
+        ll_strbuf_append(&cache, (const char *)&header, sizeof(header));
+
+        err = ll_policy_resolve(policy, out.ruleset, &cache, &header.count);
+        if (!LL_ERRORED(err))
+        {
+            err = ll_policy_apply_ports(policy, out.ruleset, NULL);
+        }
+        if (!LL_ERRORED(err) && !cache.failed)
+        {
+            memcpy(cache.data, &header, sizeof(header));
+            ll_policy_cache_store(cache_path, cache.data, cache.len);
+        }
+        free(cache.data);
+    }
+
+    if (out_status)
+    {
+        *out_status = status;
+    }
+    if (LL_ERRORED(err))
+    {
+        ll_ruleset_close(out.ruleset);
+        out.ruleset = NULL;
+        out.err = err;
+        return out;
+    }
+    out.err = created;
+    return out;
+}
+
+
+/*
+ * Fake kernel.
+ */
+
+struct ll_fake_ruleset
+{
+    int fd;
+    dev_t dev;
+    ino_t ino;
+    __u64 handled_access_fs;
+    __u64 handled_access_net;
+    __u64 handled_access_scope;
+};
+
+struct ll_fake_kernel
+{
+    ll_backend_t backend;
+    ll_abi_t abi;
+    int errata;
+    int disabled;
+    int audit;
+    int no_new_privs;
+    char lock;
+    ll_fake_kernel_stats_t stats;
+    struct ll_fake_ruleset *rulesets;
+    size_t ruleset_count;
+    size_t ruleset_capacity;
+};
+
+static void ll_fake_lock(ll_fake_kernel_t *const kernel)
+{
+    while (__atomic_test_and_set(&kernel->lock, __ATOMIC_ACQUIRE))
+    {
+        ll_cpu_relax();
+    }
+}
+
+static void ll_fake_unlock(ll_fake_kernel_t *const kernel)
+{
+    __atomic_clear(&kernel->lock, __ATOMIC_RELEASE);
+}
+
+/* Finish a call under the lock: count a failure and set errno. */
+static int ll_fake_return(ll_fake_kernel_t *const kernel, const int ret, const int err)
+{
+    if (ret < 0)
+    {
+        kernel->stats.failed_calls++;
+    }
+    ll_fake_unlock(kernel);
+    if (ret < 0)
+    {
+        errno = err;
+    }
+    return ret;
+}
+
+/* Size of struct landlock_ruleset_attr as known to a kernel with this ABI. */
+static size_t ll_fake_attr_size(const ll_abi_t abi)
+{
+    if (abi < 4)
+    {
+        return offsetof(struct landlock_ruleset_attr, handled_access_net);
+    }
+    if (abi < 6)
+    {
+        return offsetof(struct landlock_ruleset_attr, scoped);
+    }
+    return sizeof(struct landlock_ruleset_attr);
+}
+
+/* Ruleset behind a descriptor; sets *out_errno to EBADF or EBADFD when there is none. */
+static struct ll_fake_ruleset *ll_fake_lookup(ll_fake_kernel_t *const kernel, const int fd, int *const out_errno)
+{
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0)
+    {
+        *out_errno = EBADF;
+        return NULL;
+    }
+    for (size_t i = 0; i < kernel->ruleset_count; i++)
+    {
+        struct ll_fake_ruleset *const ruleset = &kernel->rulesets[i];
+        if (ruleset->fd == fd && ruleset->dev == st.st_dev && ruleset->ino == st.st_ino)
+        {
+            return ruleset;
+        }
+    }
+    *out_errno = EBADFD;
+    return NULL;
+}
+
+static int ll_fake_create_ruleset(void *const ctx, const struct landlock_ruleset_attr *const attr,
+                                  const size_t size, const __u32 flags)
+{
+    ll_fake_kernel_t *const kernel = ctx;
+    ll_fake_lock(kernel);
+    kernel->stats.create_ruleset_calls++;
+    if (kernel->disabled)
+    {
+        return ll_fake_return(kernel, -1, EOPNOTSUPP);
+    }
+    if (flags == LANDLOCK_CREATE_RULESET_VERSION || (flags == LANDLOCK_CREATE_RULESET_ERRATA && kernel->abi >= 7))
+    {
+        if (attr || size)
+        {
+            return ll_fake_return(kernel, -1, EINVAL);
+        }
+        return ll_fake_return(kernel, flags == LANDLOCK_CREATE_RULESET_VERSION ? kernel->abi : kernel->errata, 0);
+    }
+    if (flags)
+    {
+        return ll_fake_return(kernel, -1, EINVAL);
+    }
+    if (!attr)
+    {
+        return ll_fake_return(kernel, -1, EFAULT);
+    }
+    if (size < sizeof(attr->handled_access_fs))
+    {
+        return ll_fake_return(kernel, -1, EINVAL);
+    }
+
+    /* Fields this ABI does not know must be zero, as copy_struct_from_user() requires. */
+    struct landlock_ruleset_attr known;
+    memset(&known, 0, sizeof(known));
+    const size_t known_size = ll_fake_attr_size(kernel->abi);
+    memcpy(&known, attr, size < known_size ? size : known_size);
+    for (size_t i = known_size; i < size; i++)
+    {
+        if (((const unsigned char *)attr)[i] != 0)
+        {
+            return ll_fake_return(kernel, -1, E2BIG);
+        }
+    }
+    if ((known.handled_access_fs & ~ll_supported_access_fs(kernel->abi)) ||
+        (known.handled_access_net & ~ll_supported_access_net(kernel->abi)) ||
+        (known.scoped & ~ll_supported_scopes(kernel->abi)))
+    {
+        return ll_fake_return(kernel, -1, EINVAL);
+    }
+    if (!known.handled_access_fs && !known.handled_access_net && !known.scoped)
+    {
+        return ll_fake_return(kernel, -1, ENOMSG);
+    }
+
+    if (kernel->ruleset_count == kernel->ruleset_capacity)
+    {
+        const size_t capacity = kernel->ruleset_capacity ? kernel->ruleset_capacity * 2 : 16;
+        struct ll_fake_ruleset *grown = realloc(kernel->rulesets, capacity * sizeof(*grown));
+        if (!grown)
+        {
+            return ll_fake_return(kernel, -1, ENOMEM);
+        }
+        kernel->rulesets = grown;
+        kernel->ruleset_capacity = capacity;
+    }
+    const int fd = ll_memfd_create("landlock-ruleset");
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0)
+    {
+        const int err = errno;
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return ll_fake_return(kernel, -1, err);
+    }
+    /* Drop entries whose descriptor was closed and reused. */
+    for (size_t i = 0; i < kernel->ruleset_count; i++)
+    {
+        if (kernel->rulesets[i].fd == fd)
+        {
+            kernel->rulesets[i] = kernel->rulesets[--kernel->ruleset_count];
+            break;
+        }
+    }
+    struct ll_fake_ruleset *const ruleset = &kernel->rulesets[kernel->ruleset_count++];
+    ruleset->fd = fd;
+    ruleset->dev = st.st_dev;
+    ruleset->ino = st.st_ino;
+    ruleset->handled_access_fs = known.handled_access_fs;
+    ruleset->handled_access_net = known.handled_access_net;
+    ruleset->handled_access_scope = known.scoped;
+    return ll_fake_return(kernel, fd, 0);
+}
+
+static int ll_fake_add_rule(void *const ctx, const int ruleset_fd, const enum landlock_rule_type rule_type,
+                            const void *const rule_attr, const __u32 flags)
+{
+    ll_fake_kernel_t *const kernel = ctx;
+    ll_fake_lock(kernel);
+    kernel->stats.add_rule_calls++;
+    if (kernel->disabled)
+    {
+        return ll_fake_return(kernel, -1, EOPNOTSUPP);
+    }
+    if (flags)
+    {
+        return ll_fake_return(kernel, -1, EINVAL);
+    }
+    int err = 0;
+    const struct ll_fake_ruleset *const ruleset = ll_fake_lookup(kernel, ruleset_fd, &err);
+    if (!ruleset)
+    {
+        return ll_fake_return(kernel, -1, err);
+    }
+    if (!rule_attr)
+    {
+        return ll_fake_return(kernel, -1, EFAULT);
+    }
+
+    if (rule_type == LANDLOCK_RULE_PATH_BENEATH)
+    {
+        struct landlock_path_beneath_attr path_attr;
+        memcpy(&path_attr, rule_attr, sizeof(path_attr));
+        if (!path_attr.allowed_access)
+        {
+            return ll_fake_return(kernel, -1, ENOMSG);
+        }
+        if (path_attr.allowed_access & ~ruleset->handled_access_fs)
+        {
+            return ll_fake_return(kernel, -1, EINVAL);
+        }
+        struct stat st;
+        if (fstat(path_attr.parent_fd, &st) < 0)
+        {
+            return ll_fake_return(kernel, -1, EBADF);
+        }
+        if (!S_ISDIR(st.st_mode) && (path_attr.allowed_access & LL_ACCESS_FS_DIR_ONLY))
+        {
+            return ll_fake_return(kernel, -1, EINVAL);
+        }
+    }
+    else if (rule_type == LANDLOCK_RULE_NET_PORT && kernel->abi >= 4)
+    {
+        struct landlock_net_port_attr net_attr;
+        memcpy(&net_attr, rule_attr, sizeof(net_attr));
+        if (!net_attr.allowed_access)
+        {
+            return ll_fake_return(kernel, -1, ENOMSG);
+        }
+        if ((net_attr.allowed_access & ~ruleset->handled_access_net) || net_attr.port > 65535)
+        {
+            return ll_fake_return(kernel, -1, EINVAL);
+        }
+    }
+    else
+    {
+        return ll_fake_return(kernel, -1, EINVAL);
+    }
+    kernel->stats.rules++;
+    return ll_fake_return(kernel, 0, 0);
+}
+
+static int ll_fake_restrict_self(void *const ctx, const int ruleset_fd, const __u32 flags)
+{
+    ll_fake_kernel_t *const kernel = ctx;
+    ll_fake_lock(kernel);
+    kernel->stats.restrict_self_calls++;
+    if (kernel->disabled)
+    {
+        return ll_fake_return(kernel, -1, EOPNOTSUPP);
+    }
+    if (flags & ~ll_supported_restrict_self_flags(kernel->abi))
+    {
+        return ll_fake_return(kernel, -1, EINVAL);
+    }
+    if (ruleset_fd == -1 && flags == LANDLOCK_RESTRICT_SELF_LOG_SUBDOMAINS_OFF)
+    {
+        return ll_fake_return(kernel, 0, 0);
+    }
+    if (!kernel->no_new_privs)
+    {
+        return ll_fake_return(kernel, -1, EPERM);
+    }
+    int err = 0;
+    if (!ll_fake_lookup(kernel, ruleset_fd, &err))
+    {
+        return ll_fake_return(kernel, -1, err);
+    }
+    if (kernel->stats.layers >= LL_MAX_LAYERS)
+    {
+        return ll_fake_return(kernel, -1, E2BIG);
+    }
+    kernel->stats.layers++;
+    return ll_fake_return(kernel, 0, 0);
+}
+
+static int ll_fake_set_no_new_privs(void *const ctx)
+{
+    ll_fake_kernel_t *const kernel = ctx;
+    __atomic_store_n(&kernel->no_new_privs, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static int ll_fake_audit_supported(void *const ctx)
+{
+    ll_fake_kernel_t *const kernel = ctx;
+    return __atomic_load_n(&kernel->audit, __ATOMIC_ACQUIRE);
+}
+
+ll_error_t ll_fake_kernel_create(const ll_abi_t abi, ll_fake_kernel_t **const out_kernel)
+{
+    if (!out_kernel || abi < 1)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    *out_kernel = NULL;
+    ll_fake_kernel_t *kernel = calloc(1, sizeof(*kernel));
+    if (!kernel)
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    kernel->abi = abi;
+    kernel->audit = 1;
+    kernel->backend.ctx = kernel;
+    kernel->backend.create_ruleset = ll_fake_create_ruleset;
+    kernel->backend.add_rule = ll_fake_add_rule;
+    kernel->backend.restrict_self = ll_fake_restrict_self;
+    kernel->backend.set_no_new_privs = ll_fake_set_no_new_privs;
+    kernel->backend.audit_supported = ll_fake_audit_supported;
+    *out_kernel = kernel;
+    return LL_ERROR_OK;
+}
+
+void ll_fake_kernel_free(ll_fake_kernel_t *const kernel)
+{
+    if (!kernel)
+    {
+        return;
+    }
+    free(kernel->rulesets);
+    free(kernel);
+}
+
+const ll_backend_t *ll_fake_kernel_backend(ll_fake_kernel_t *const kernel)
+{
+    return kernel ? &kernel->backend : NULL;
+}
+
+void ll_fake_kernel_set_errata(ll_fake_kernel_t *const kernel, const int errata)
+{
+    if (kernel)
+    {
+        ll_fake_lock(kernel);
+        kernel->errata = errata;
+        ll_fake_unlock(kernel);
+    }
+}
+
+void ll_fake_kernel_set_disabled(ll_fake_kernel_t *const kernel, const int disabled)
+{
+    if (kernel)
+    {
+        ll_fake_lock(kernel);
+        kernel->disabled = disabled;
+        ll_fake_unlock(kernel);
+    }
+}
+
+void ll_fake_kernel_set_audit(ll_fake_kernel_t *const kernel, const int supported)
+{
+    if (kernel)
+    {
+        __atomic_store_n(&kernel->audit, supported, __ATOMIC_RELEASE);
+    }
+}
+
+void ll_fake_kernel_stats(ll_fake_kernel_t *const kernel, ll_fake_kernel_stats_t *const out_stats)
+{
+    if (!kernel || !out_stats)
+    {
+        return;
+    }
+    ll_fake_lock(kernel);
+    *out_stats = kernel->stats;
+    ll_fake_unlock(kernel);
+}
+
+
+/*
+ * Conformance prober.
+ */
+
+static int ll_probe_addr_unix(const char *const name, struct sockaddr_un *const addr, socklen_t *const out_len)
+{
+    const size_t len = strlen(name);
+    if (len + 1 > sizeof(addr->sun_path))
+    {
+        return -1;
+    }
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    memcpy(addr->sun_path + 1, name, len);
+    *out_len = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + 1 + len);
+    return 0;
+}
+
+static void ll_probe_addr_tcp(const __u16 port, struct sockaddr_in *const addr)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(port);
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+}
+
+/* Start a program and report whether execve() succeeded; returns 0 or an errno value. */
+static int ll_probe_exec(const char *const path)
+{
+    int pipe_fds[2];
+    if (pipe(pipe_fds) < 0 || fcntl(pipe_fds[1], F_SETFD, FD_CLOEXEC) < 0)
+    {
+        return errno;
+    }
+    const pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(pipe_fds[0]);
+        const int null_fd = open("/dev/null", O_RDWR);
+        if (null_fd >= 0)
+        {
+            dup2(null_fd, STDIN_FILENO);
+            dup2(null_fd, STDOUT_FILENO);
+            dup2(null_fd, STDERR_FILENO);
+        }
+        char *const argv[] = {(char *)path, NULL};
+        char *const envp[] = {NULL};
+        execve(path, argv, envp);
+        const int err = errno;
+        (void)!write(pipe_fds[1], &err, sizeof(err));
+        _exit(127);
+    }
+    close(pipe_fds[1]);
+    int err = pid < 0 ? errno : 0;
+    if (pid > 0)
+    {
+        /* EOF without an errno means the exec went through. */
+        ssize_t got;
+        while ((got = read(pipe_fds[0], &err, sizeof(err))) < 0 && errno == EINTR)
+        {
+        }
+        if (got != (ssize_t)sizeof(err))
+        {
+            err = 0;
+        }
+        kill(pid, SIGKILL);
+        while (waitpid(pid, NULL, 0) < 0 && errno == EINTR)
+        {
+        }
+    }
+    close(pipe_fds[0]);
+    return err;
+}
+
+/* Attempt one probe; returns 0 on success or an errno value. */
+static int ll_probe_attempt(const ll_probe_t *const probe, const pid_t prober)
+{
+    int fd = -1;
+    int ret = -1;
+    switch (probe->op)
+    {
+    case LL_PROBE_READ:
+    case LL_PROBE_WRITE:
+        if (!probe->target)
+        {
+            return EINVAL;
+        }
+        /* O_NONBLOCK keeps FIFOs from blocking the probe. */
+        fd = open(probe->target, (probe->op == LL_PROBE_READ ? O_RDONLY : O_WRONLY) | O_NONBLOCK | O_CLOEXEC);
+        ret = fd;
+        break;
+    case LL_PROBE_MKDIR:
+        if (!probe->target)
+        {
+            return EINVAL;
+        }
+        ret = mkdir(probe->target, 0700);
+        if (ret == 0)
+        {
+            rmdir(probe->target);
+        }
+        break;
+    case LL_PROBE_EXEC:
+        return probe->target ? ll_probe_exec(probe->target) : EINVAL;
+    case LL_PROBE_BIND_TCP:
+    case LL_PROBE_CONNECT_TCP:
+    {
+        struct sockaddr_in addr;
+        ll_probe_addr_tcp(probe->port, &addr);
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        const int one = 1;
+        if (fd >= 0)
+        {
+            (void)setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        }
+        ret = fd < 0 ? -1
+              : probe->op == LL_PROBE_BIND_TCP ? bind(fd, (const struct sockaddr *)&addr, sizeof(addr))
+                                               : connect(fd, (const struct sockaddr *)&addr, sizeof(addr));
+        break;
+    }
+    case LL_PROBE_SIGNAL:
+        ret = kill(prober, 0);
+        break;
+    case LL_PROBE_ABSTRACT_UNIX:
+    {
+        struct sockaddr_un addr;
+        socklen_t len = 0;
+        if (!probe->target || ll_probe_addr_unix(probe->target, &addr, &len) < 0)
+        {
+            return EINVAL;
+        }
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        ret = fd < 0 ? -1 : connect(fd, (const struct sockaddr *)&addr, len);
+        break;
+    }
+    default:
+        return EINVAL;
+    }
+    const int err = ret < 0 ? errno : 0;
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    return err;
+}
+
+/* Open the listeners that connect probes talk to; returns the number opened into fds. */
+static size_t ll_probe_listen(const ll_probe_t *const probes, const size_t count, int *const fds)
+{
+    size_t opened = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        int duplicate = 0;
+        for (size_t j = 0; j < i && !duplicate; j++)
+        {
+            duplicate = probes[j].op == probes[i].op &&
+                        (probes[i].op == LL_PROBE_CONNECT_TCP
+                             ? probes[j].port == probes[i].port
+                             : probes[j].target && probes[i].target && strcmp(probes[j].target, probes[i].target) == 0);
+        }
+        if (duplicate)
+        {
+            continue;
+        }
+        int fd = -1;
+        if (probes[i].op == LL_PROBE_CONNECT_TCP)
+        {
+            struct sockaddr_in addr;
+            ll_probe_addr_tcp(probes[i].port, &addr);
+            fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (fd >= 0 && (bind(fd, (const struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 128) < 0))
+            {
+                close(fd);
+                fd = -1;
+            }
+        }
+        else if (probes[i].op == LL_PROBE_ABSTRACT_UNIX && probes[i].target)
+        {
+            struct sockaddr_un addr;
+            socklen_t len = 0;
+            fd = ll_probe_addr_unix(probes[i].target, &addr, &len) == 0
+                     ? socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)
+                     : -1;
+            if (fd >= 0 && (bind(fd, (const struct sockaddr *)&addr, len) < 0 || listen(fd, 128) < 0))
+            {
+                close(fd);
+                fd = -1;
+            }
+        }
+        if (fd >= 0)
+        {
+            fds[opened++] = fd;
+        }
+    }
+    return opened;
+}
+
+ll_error_t ll_probe_run(const ll_ruleset_t *const ruleset,
+                        const __u32 restrict_flags,
+                        const ll_probe_t *const probes,
+                        const size_t count,
+                        const unsigned int workers,
+                        ll_probe_result_t *const out_results,
+                        size_t *const out_failed)
+{
+    if (!ruleset || (count && (!probes || !out_results)))
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    if (out_failed)
+    {
+        *out_failed = 0;
+    }
+    if (count == 0)
+    {
+        return LL_ERROR_OK;
+    }
+
+    size_t worker_count = workers;
+    if (worker_count == 0)
+    {
+        const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        worker_count = cpus > 0 ? (size_t)cpus : 1;
+    }
+    worker_count = worker_count < count ? worker_count : count;
+
+    /* Children report into shared memory; a child that dies leaves its probes inconclusive. */
+    const size_t shared_size = count * sizeof(ll_probe_result_t);
+    ll_probe_result_t *shared = mmap(NULL, shared_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED)
+    {
+        return LL_ERROR_SYSTEM;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        shared[i].outcome = LL_PROBE_INCONCLUSIVE;
+        shared[i].passed = 0;
+        shared[i].error = ECHILD;
+    }
+
+    int *listeners = malloc(count * sizeof(*listeners));
+    const size_t listener_count = listeners ? ll_probe_listen(probes, count, listeners) : 0;
+    pid_t *pids = malloc(worker_count * sizeof(*pids));
+    if (!listeners || !pids)
+    {
+        free(pids);
+        free(listeners);
+        munmap(shared, shared_size);
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+
+    const pid_t prober = getpid();
+    size_t started = 0;
+    for (; started < worker_count; started++)
+    {
+        const pid_t pid = fork();
+        if (pid < 0)
+        {
+            break;
+        }
+        if (pid == 0)
+        {
+            for (size_t i = 0; i < listener_count; i++)
+            {
+                close(listeners[i]);
+            }
+            if (LL_ERRORED(ll_ruleset_enforce(ruleset, restrict_flags)))
+            {
+                _exit(1);
+            }
+            for (size_t i = started; i < count; i += worker_count)
+            {
+                const int err = ll_probe_attempt(&probes[i], prober);
+                shared[i].error = err;
+                shared[i].outcome = err == 0                       ? LL_PROBE_ALLOWED
+                                    : (err == EACCES || err == EPERM) ? LL_PROBE_DENIED
+                                                                      : LL_PROBE_INCONCLUSIVE;
+            }
+            _exit(0);
+        }
+        pids[started] = pid;
+    }
+    for (size_t i = 0; i < started; i++)
+    {
+        while (waitpid(pids[i], NULL, 0) < 0 && errno == EINTR)
+        {
+        }
+    }
+    for (size_t i = 0; i < listener_count; i++)
+    {
+        close(listeners[i]);
+    }
+
+    size_t failed = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        out_results[i] = shared[i];
+        out_results[i].passed = out_results[i].outcome == (probes[i].expect_allowed ? LL_PROBE_ALLOWED : LL_PROBE_DENIED);
+        failed += !out_results[i].passed;
+    }
+    if (out_failed)
+    {
+        *out_failed = failed;
+    }
+    munmap(shared, shared_size);
+    free(pids);
+    free(listeners);
+    return started == worker_count ? LL_ERROR_OK : LL_ERROR_SYSTEM;
+}
+
+
+/*
+ * Reloadable policies.
+ */
+
+struct ll_policy_watch_file
+{
+    char *path;
+    const char *name; /* Basename within path. */
+    int wd;
+};
+
+struct ll_policy_watch_retired
+{
+    ll_ruleset_t *ruleset;
+    unsigned long epoch;
+};
+
+struct ll_policy_watch
+{
+    ll_ruleset_t *current;
+    unsigned long generation;
+    /* Readers count themselves in readers[epoch & 1]; see ll_policy_watch_pin. */
+    unsigned long epoch;
+    unsigned long readers[2];
+    struct ll_policy_watch_retired *retired;
+    size_t retired_count;
+    size_t retired_capacity;
+    struct ll_policy_watch_file *files;
+    size_t file_count;
+    ll_ruleset_attr_t attr;
+    int inotify_fd;
+};
+
+static ll_error_t ll_policy_watch_compile(const ll_policy_watch_t *const watch,
+                                          ll_ruleset_t **const out_ruleset,
+                                          size_t *const out_line)
+{
+    ll_policy_t *policy = NULL;
+    ll_error_t err = ll_policy_create(&policy);
+    for (size_t i = 0; i < watch->file_count && !LL_ERRORED(err); i++)
+    {
+        err = ll_policy_load_file(policy, watch->files[i].path, out_line);
+    }
+    if (!LL_ERRORED(err))
+    {
+        const ll_ruleset_result_t res = ll_policy_create_ruleset(policy, watch->attr);
+        err = res.err;
+        *out_ruleset = res.ruleset;
+    }
+    ll_policy_free(policy);
+    return err;
+}
+
+/*
+ * A ruleset replaced during epoch E may be held by readers of epoch E or
+ * earlier. Flipping the epoch from E to E+1 requires the slot of epoch E-1
+ * to be empty, so once the epoch reaches E+2 no reader can hold it.
+ */
+static void ll_policy_watch_reclaim(ll_policy_watch_t *const watch)
+{
+    for (int step = 0; step < 2; step++)
+    {
+        const unsigned long epoch = __atomic_load_n(&watch->epoch, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&watch->readers[(epoch + 1) & 1], __ATOMIC_SEQ_CST) != 0)
+        {
+            break;
+        }
+        __atomic_store_n(&watch->epoch, epoch + 1, __ATOMIC_SEQ_CST);
+    }
+
+    const unsigned long epoch = __atomic_load_n(&watch->epoch, __ATOMIC_SEQ_CST);
+    size_t kept = 0;
+    for (size_t i = 0; i < watch->retired_count; i++)
+    {
+        if (epoch - watch->retired[i].epoch >= 2)
+        {
+            ll_ruleset_close(watch->retired[i].ruleset);
+        }
+        else
+        {
+            watch->retired[kept++] = watch->retired[i];
+        }
+    }
+    watch->retired_count = kept;
+}
+
+ll_error_t ll_policy_watch_reload(ll_policy_watch_t *const watch, size_t *const out_line)
+{
+    if (!watch)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    if (watch->retired_count == watch->retired_capacity)
+    {
+        const size_t capacity = watch->retired_capacity ? watch->retired_capacity * 2 : 4;
+        struct ll_policy_watch_retired *const retired = realloc(watch->retired, capacity * sizeof(*retired));
+        if (!retired)
+        {
+            return LL_ERROR_OUT_OF_MEMORY;
+        }
+        watch->retired = retired;
+        watch->retired_capacity = capacity;
+    }
+
+    ll_ruleset_t *ruleset = NULL;
+    const ll_error_t err = ll_policy_watch_compile(watch, &ruleset, out_line);
+    if (LL_ERRORED(err))
+    {
+        ll_policy_watch_reclaim(watch);
+        return err;
+    }
+
+    /* The ruleset is fully populated before it becomes visible. */
+    ll_ruleset_t *const old = __atomic_exchange_n(&watch->current, ruleset, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&watch->generation, 1, __ATOMIC_RELEASE);
+    watch->retired[watch->retired_count].ruleset = old;
+    watch->retired[watch->retired_count].epoch = __atomic_load_n(&watch->epoch, __ATOMIC_SEQ_CST);
+    watch->retired_count++;
+    ll_policy_watch_reclaim(watch);
+    return LL_ERROR_OK;
+}
+
+ll_error_t ll_policy_watch_create(const char *const *const paths,
+                                  const size_t count,
+                                  const ll_ruleset_attr_t attr,
+                                  ll_policy_watch_t **const out_watch,
+                                  size_t *const out_line)
+{
+    if (!paths || count == 0 || !out_watch)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    *out_watch = NULL;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!paths[i] || paths[i][0] == '\0')
+        {
+            return LL_ERROR_INVALID_ARGUMENT;
+        }
+    }
+
+    ll_policy_watch_t *const watch = calloc(1, sizeof(*watch));
+    if (!watch)
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    watch->attr = attr;
+    watch->inotify_fd = -1;
+    watch->files = calloc(count, sizeof(*watch->files));
+    if (!watch->files)
+    {
+        free(watch);
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    watch->file_count = count;
+
+    ll_error_t err = LL_ERROR_OK;
+    for (size_t i = 0; i < count && !LL_ERRORED(err); i++)
+    {
+        watch->files[i].path = strdup(paths[i]);
+        watch->files[i].wd = -1;
+        if (!watch->files[i].path)
+        {
+            err = LL_ERROR_OUT_OF_MEMORY;
+            break;
+        }
+        const char *const slash = strrchr(watch->files[i].path, '/');
+        watch->files[i].name = slash ? slash + 1 : watch->files[i].path;
+    }
+
+    if (!LL_ERRORED(err))
+    {
+        watch->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        err = watch->inotify_fd < 0 ? LL_ERROR_SYSTEM : LL_ERROR_OK;
+    }
+    for (size_t i = 0; i < count && !LL_ERRORED(err); i++)
+    {
+        /* Watch the directory: rename-over replaces the inode a file watch would follow. */
+        struct ll_policy_watch_file *const file = &watch->files[i];
+        const size_t dir_len = (size_t)(file->name - file->path);
+        char *const dir = dir_len ? strndup(file->path, dir_len) : strdup(".");
+        if (!dir)
+        {
+            err = LL_ERROR_OUT_OF_MEMORY;
+            break;
+        }
+        file->wd = inotify_add_watch(watch->inotify_fd, dir,
+                                     IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE |
+                                         IN_ATTRIB | IN_ONLYDIR);
+        err = file->wd < 0 ? LL_ERROR_SYSTEM : LL_ERROR_OK;
+        free(dir);
+    }
+    if (!LL_ERRORED(err))
+    {
+        err = ll_policy_watch_compile(watch, &watch->current, out_line);
+    }
+    if (LL_ERRORED(err))
+    {
+        ll_policy_watch_free(watch);
+        return err;
+    }
+    watch->generation = 1;
+    *out_watch = watch;
+    return LL_ERROR_OK;
+}
+
+void ll_policy_watch_free(ll_policy_watch_t *const watch)
+{
+    if (!watch)
+    {
+        return;
+    }
+    ll_ruleset_close(watch->current);
+    for (size_t i = 0; i < watch->retired_count; i++)
+    {
+        ll_ruleset_close(watch->retired[i].ruleset);
+    }
+    for (size_t i = 0; i < watch->file_count; i++)
+    {
+        free(watch->files[i].path);
+    }
+    if (watch->inotify_fd >= 0)
+    {
+        close(watch->inotify_fd);
+    }
+    free(watch->retired);
+    free(watch->files);
+    free(watch);
+}
+
+int ll_policy_watch_fd(const ll_policy_watch_t *const watch)
+{
+    return watch ? watch->inotify_fd : -1;
+}
+
+unsigned long ll_policy_watch_generation(const ll_policy_watch_t *const watch)
+{
+    return watch ? __atomic_load_n(&watch->generation, __ATOMIC_ACQUIRE) : 0;
+}
+
+ll_error_t ll_policy_watch_process(ll_policy_watch_t *const watch,
+                                   const int timeout_ms,
+                                   int *const out_reloaded,
+                                   size_t *const out_line)
+{
+    if (out_reloaded)
+    {
+        *out_reloaded = 0;
+    }
+    if (!watch)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    if (timeout_ms != 0)
+    {
+        struct pollfd pfd = {.fd = watch->inotify_fd, .events = POLLIN};
+        if (poll(&pfd, 1, timeout_ms) < 0 && errno != EINTR)
+        {
+            return LL_ERROR_SYSTEM;
+        }
+    }
+
+    int changed = 0;
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    for (;;)
+    {
+        const ssize_t len = read(watch->inotify_fd, buf, sizeof(buf));
+        if (len < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                break;
+            }
+            return LL_ERROR_SYSTEM;
+        }
+        for (ssize_t off = 0; off < len;)
+        {
+            const struct inotify_event *const event = (const struct inotify_event *)(buf + off);
+            off += (ssize_t)(sizeof(*event) + event->len);
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                changed = 1;
+                continue;
+            }
+            for (size_t i = 0; i < watch->file_count && !changed && event->len; i++)
+            {
+                changed = watch->files[i].wd == event->wd && strcmp(watch->files[i].name, event->name) == 0;
+            }
+        }
+    }
+    if (!changed)
+    {
+        ll_policy_watch_reclaim(watch);
+        return LL_ERROR_OK;
+    }
+
+    const ll_error_t err = ll_policy_watch_reload(watch, out_line);
+    if (out_reloaded)
+    {
+        *out_reloaded = !LL_ERRORED(err);
+    }
+    return err;
+}
+
+const ll_ruleset_t *ll_policy_watch_pin(ll_policy_watch_t *const watch, unsigned long *const out_token)
+{
+    if (!watch || !out_token)
+    {
+        return NULL;
+    }
+    /* Retry if the epoch moved between reading it and registering in its slot. */
+    for (;;)
+    {
+        const unsigned long epoch = __atomic_load_n(&watch->epoch, __ATOMIC_SEQ_CST);
+        __atomic_add_fetch(&watch->readers[epoch & 1], 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&watch->epoch, __ATOMIC_SEQ_CST) == epoch)
+        {
+            *out_token = epoch;
+            return __atomic_load_n(&watch->current, __ATOMIC_SEQ_CST);
+        }
+        __atomic_sub_fetch(&watch->readers[epoch & 1], 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+void ll_policy_watch_unpin(ll_policy_watch_t *const watch, const unsigned long token)
+{
+    if (watch)
+    {
+        __atomic_sub_fetch(&watch->readers[token & 1], 1, __ATOMIC_RELEASE);
+    }
+}
+
+ll_error_t ll_policy_watch_fork(ll_policy_watch_t *const watch, const __u32 restrict_flags, int *const out_pid)
+{
+    if (!watch || !out_pid)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    unsigned long token = 0;
+    const ll_ruleset_t *const ruleset = ll_policy_watch_pin(watch, &token);
+    const pid_t pid = fork();
+    if (pid == 0)
+    {
+        *out_pid = 0;
+        return ll_ruleset_enforce(ruleset, restrict_flags);
+    }
+    const int err = errno;
+    ll_policy_watch_unpin(watch, token);
+    if (pid < 0)
+    {
+        errno = err;
+        return LL_ERROR_SYSTEM;
+    }
+    *out_pid = pid;
+    return LL_ERROR_OK;
+}
+
+
+/*
+ * Asynchronous ruleset builds.
+ */
+
+/* Paths added between two checks for cancellation. */
+#define LL_BUILD_BATCH 32
+
+struct ll_ruleset_build
+{
+    /* One reference for the caller and one for the worker. */
+    int refs;
+    int canceled;
+    int done;
+    int collected;
+    int event_fd;
+    ll_policy_t *policy;
+    ll_ruleset_attr_t attr;
+    ll_ruleset_result_t result;
+    size_t failed;
+};
+
+static ll_policy_t *ll_policy_copy(const ll_policy_t *const policy)
+{
+    ll_policy_t *copy = NULL;
+    if (LL_ERRORED(ll_policy_create(&copy)))
+    {
+        return NULL;
+    }
+    ll_error_t err = ll_policy_handle(copy, policy->handled_access_fs, policy->handled_access_net,
+                                      policy->handled_access_scope);
+    for (size_t i = 0; i < policy->path_count && !LL_ERRORED(err); i++)
+    {
+        err = ll_policy_add_path(copy, policy->paths[i].path, policy->paths[i].access);
+    }
+    for (size_t i = 0; i < policy->port_count && !LL_ERRORED(err); i++)
+    {
+        err = ll_policy_add_net_port(copy, policy->ports[i].port, policy->ports[i].access);
+    }
+    if (LL_ERRORED(err))
+    {
+        ll_policy_free(copy);
+        return NULL;
+    }
+    return copy;
+}
+
+static void ll_ruleset_build_release(ll_ruleset_build_t *const build)
+{
+    if (__atomic_sub_fetch(&build->refs, 1, __ATOMIC_ACQ_REL) != 0)
+    {
+        return;
+    }
+    if (!build->collected)
+    {
+        ll_ruleset_close(build->result.ruleset);
+    }
+    ll_policy_free(build->policy);
+    close(build->event_fd);
+    free(build);
+}
+
+static void *ll_ruleset_build_worker(void *const arg)
+{
+    ll_ruleset_build_t *const build = arg;
+    const ll_policy_t *const policy = build->policy;
+    ll_ruleset_result_t res = ll_ruleset_create_result(ll_policy_attr(policy, build->attr));
+    /* A best-effort downgrade at creation is reported unless a later step fails. */
+    const ll_error_t created = res.err;
+    for (size_t offset = 0; offset < policy->path_count && !LL_ERRORED(res.err); offset += LL_BUILD_BATCH)
+    {
+        if (__atomic_load_n(&build->canceled, __ATOMIC_RELAXED))
+        {
+            res.err = LL_ERROR_CANCELED;
+            break;
+        }
+        const size_t remaining = policy->path_count - offset;
+        size_t failed = 0;
+        res.err = ll_ruleset_add_paths(res.ruleset, policy->paths + offset,
+                                       remaining < LL_BUILD_BATCH ? remaining : LL_BUILD_BATCH, 0, &failed);
+        build->failed = offset + failed;
+    }
+    if (!LL_ERRORED(res.err))
+    {
+        res.err = ll_policy_apply_ports(policy, res.ruleset, &build->failed);
+    }
+    if (LL_ERRORED(res.err))
+    {
+        ll_ruleset_close(res.ruleset);
+        res.ruleset = NULL;
+    }
+    else if (created == LL_ERROR_OK_PARTIAL_SANDBOX)
+    {
+        res.err = created;
+    }
+
+    build->result = res;
+    __atomic_store_n(&build->done, 1, __ATOMIC_RELEASE);
+    const uint64_t one = 1;
+    (void)!write(build->event_fd, &one, sizeof(one));
+    ll_ruleset_build_release(build);
+    return NULL;
+}
+
+ll_error_t ll_ruleset_build_start(const ll_policy_t *const policy,
+                                  const ll_ruleset_attr_t attr,
+                                  ll_ruleset_build_t **const out_build)
+{
+    if (!policy || !out_build)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    *out_build = NULL;
+
+    ll_ruleset_build_t *const build = calloc(1, sizeof(*build));
+    if (!build)
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    build->refs = 2;
+    build->attr = attr;
+    build->result.err = LL_ERROR_INVALID_ARGUMENT;
+    build->policy = ll_policy_copy(policy);
+    build->event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    ll_error_t err = !build->policy ? LL_ERROR_OUT_OF_MEMORY : build->event_fd < 0 ? LL_ERROR_SYSTEM : LL_ERROR_OK;
+
+    pthread_attr_t thread_attr;
+    pthread_t thread;
+    if (!LL_ERRORED(err))
+    {
+        err = LL_ERROR_SYSTEM;
+        if (pthread_attr_init(&thread_attr) == 0)
+        {
+            if (pthread_attr_setdetachstate(&thread_attr, PTHREAD_CREATE_DETACHED) == 0 &&
+                pthread_create(&thread, &thread_attr, ll_ruleset_build_worker, build) == 0)
+            {
+                err = LL_ERROR_OK;
+            }
+            pthread_attr_destroy(&thread_attr);
+        }
+    }
+    if (LL_ERRORED(err))
+    {
+        ll_policy_free(build->policy);
+        if (build->event_fd >= 0)
+        {
+            close(build->event_fd);
+        }
+        free(build);
+        return err;
+    }
+    *out_build = build;
+    return LL_ERROR_OK;
+}
+
+int ll_ruleset_build_fd(const ll_ruleset_build_t *const build)
+{
+    return build ? build->event_fd : -1;
+}
+
+int ll_ruleset_build_done(const ll_ruleset_build_t *const build)
+{
+    return build ? __atomic_load_n(&build->done, __ATOMIC_ACQUIRE) : 0;
+}
+
+void ll_ruleset_build_cancel(ll_ruleset_build_t *const build)
+{
+    if (build)
+    {
+        __atomic_store_n(&build->canceled, 1, __ATOMIC_RELAXED);
+    }
+}
+
+ll_ruleset_result_t ll_ruleset_build_collect(ll_ruleset_build_t *const build, size_t *const out_failed)
+{
+    ll_ruleset_result_t out = {.err = LL_ERROR_INVALID_ARGUMENT, .ruleset = NULL};
+    if (!build || build->collected)
+    {
+        return out;
+    }
+
+    while (!__atomic_load_n(&build->done, __ATOMIC_ACQUIRE))
+    {
+        struct pollfd pfd = {.fd = build->event_fd, .events = POLLIN};
+        if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+        {
+            out.err = LL_ERROR_SYSTEM;
+            return out;
+        }
+    }
+    uint64_t count = 0;
+    (void)!read(build->event_fd, &count, sizeof(count));
+
+    build->collected = 1;
+    out = build->result;
+    if (out_failed && LL_ERRORED(out.err) && out.err != LL_ERROR_CANCELED)
+    {
+        *out_failed = build->failed;
+    }
+    return out;
+}
+
+void ll_ruleset_build_free(ll_ruleset_build_t *const build)
+{
+    if (!build)
+    {
+        return;
+    }
+    ll_ruleset_build_cancel(build);
+    ll_ruleset_build_release(build);
+}
+
+
+/*
+ * Seccomp filter generation.
+ */
+
+#if defined(__x86_64__)
+#define LL_SECCOMP_ARCH AUDIT_ARCH_X86_64
+#elif defined(__i386__)
+#define LL_SECCOMP_ARCH AUDIT_ARCH_I386
+#elif defined(__aarch64__)
+#define LL_SECCOMP_ARCH AUDIT_ARCH_AARCH64
+#elif defined(__arm__)
+#define LL_SECCOMP_ARCH AUDIT_ARCH_ARM
+#elif defined(__riscv) && __riscv_xlen == 64
+#define LL_SECCOMP_ARCH AUDIT_ARCH_RISCV64
+#elif defined(__powerpc64__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define LL_SECCOMP_ARCH AUDIT_ARCH_PPC64LE
+#elif defined(__s390x__)
+#define LL_SECCOMP_ARCH AUDIT_ARCH_S390X
+#endif
+
+/* Jump offsets in classic BPF are 8 bits wide; longer ones go through BPF_JA. */
+#define LL_BPF_MAX_JUMP 255
+
+struct ll_syscall_entry
+{
+    __u32 nr;
+    __u32 action;
+};
+
+struct ll_syscall_filter
+{
+    __u32 default_action;
+    struct ll_syscall_entry *entries;
+    size_t count;
+    size_t capacity;
+};
+
+/* Syscalls whose effects are all checked by Landlock once the listed rights are handled. */
+struct ll_governed_syscall
+{
+    int nr;
+    __u64 access_fs;
+};
+
+#define LL_FS_MAKE_NON_DIR                                                                                   \
+    (LANDLOCK_ACCESS_FS_MAKE_CHAR | LANDLOCK_ACCESS_FS_MAKE_REG | LANDLOCK_ACCESS_FS_MAKE_SOCK |             \
+     LANDLOCK_ACCESS_FS_MAKE_FIFO | LANDLOCK_ACCESS_FS_MAKE_BLOCK | LANDLOCK_ACCESS_FS_MAKE_SYM)
+#define LL_FS_OPEN                                                                                            \
+    (LANDLOCK_ACCESS_FS_READ_FILE | LANDLOCK_ACCESS_FS_WRITE_FILE | LANDLOCK_ACCESS_FS_READ_DIR |            \
+     LANDLOCK_ACCESS_FS_TRUNCATE | LANDLOCK_ACCESS_FS_MAKE_REG)
+#define LL_FS_REFER                                                                                           \
+    (LANDLOCK_ACCESS_FS_REFER | LL_FS_MAKE_NON_DIR | LANDLOCK_ACCESS_FS_MAKE_DIR |                           \
+     LANDLOCK_ACCESS_FS_REMOVE_FILE | LANDLOCK_ACCESS_FS_REMOVE_DIR)
+
+static const struct ll_governed_syscall ll_governed_syscalls[] = {
+#ifdef SYS_open
+    {SYS_open, LL_FS_OPEN},
+#endif
+#ifdef SYS_creat
+    {SYS_creat, LL_FS_OPEN},
+#endif
+    {SYS_openat, LL_FS_OPEN},
+#ifdef SYS_openat2
+    {SYS_openat2, LL_FS_OPEN},
+#endif
+#ifdef SYS_mkdir
+    {SYS_mkdir, LANDLOCK_ACCESS_FS_MAKE_DIR},
+#endif
+    {SYS_mkdirat, LANDLOCK_ACCESS_FS_MAKE_DIR},
+#ifdef SYS_rmdir
+    {SYS_rmdir, LANDLOCK_ACCESS_FS_REMOVE_DIR},
+#endif
+#ifdef SYS_unlink
+    {SYS_unlink, LANDLOCK_ACCESS_FS_REMOVE_FILE},
+#endif
+    {SYS_unlinkat, LANDLOCK_ACCESS_FS_REMOVE_FILE | LANDLOCK_ACCESS_FS_REMOVE_DIR},
+#ifdef SYS_mknod
+    {SYS_mknod, LL_FS_MAKE_NON_DIR},
+#endif
+    {SYS_mknodat, LL_FS_MAKE_NON_DIR},
+#ifdef SYS_symlink
+    {SYS_symlink, LANDLOCK_ACCESS_FS_MAKE_SYM},
+#endif
+    {SYS_symlinkat, LANDLOCK_ACCESS_FS_MAKE_SYM},
+#ifdef SYS_link
+    {SYS_link, LANDLOCK_ACCESS_FS_REFER | LL_FS_MAKE_NON_DIR},
+#endif
+    {SYS_linkat, LANDLOCK_ACCESS_FS_REFER | LL_FS_MAKE_NON_DIR},
+#ifdef SYS_rename
+    {SYS_rename, LL_FS_REFER},
+#endif
+#ifdef SYS_renameat
+    {SYS_renameat, LL_FS_REFER},
+#endif
+#ifdef SYS_renameat2
+    {SYS_renameat2, LL_FS_REFER},
+#endif
+    {SYS_truncate, LANDLOCK_ACCESS_FS_TRUNCATE},
+    {SYS_execve, LANDLOCK_ACCESS_FS_EXECUTE},
+#ifdef SYS_execveat
+    {SYS_execveat, LANDLOCK_ACCESS_FS_EXECUTE},
+#endif
+};
+
+ll_error_t ll_syscall_filter_create(const __u32 default_action, ll_syscall_filter_t **const out_filter)
+{
+    if (!out_filter)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    ll_syscall_filter_t *const filter = calloc(1, sizeof(*filter));
+    if (!filter)
+    {
+        *out_filter = NULL;
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    filter->default_action = default_action;
+    *out_filter = filter;
+    return LL_ERROR_OK;
+}
+
+void ll_syscall_filter_free(ll_syscall_filter_t *const filter)
+{
+    if (!filter)
+    {
+        return;
+    }
+    free(filter->entries);
+    free(filter);
+}
+
+ll_error_t ll_syscall_filter_add(ll_syscall_filter_t *const filter, const int nr, const __u32 action)
+{
+    if (!filter || nr < 0)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    for (size_t i = 0; i < filter->count; i++)
+    {
+        if (filter->entries[i].nr == (__u32)nr)
+        {
+            filter->entries[i].action = action;
+            return LL_ERROR_OK;
+        }
+    }
+    if (filter->count == filter->capacity)
+    {
+        const size_t capacity = filter->capacity ? filter->capacity * 2 : 32;
+        struct ll_syscall_entry *const entries = realloc(filter->entries, capacity * sizeof(*entries));
+        if (!entries)
+        {
+            return LL_ERROR_OUT_OF_MEMORY;
+        }
+        filter->entries = entries;
+        filter->capacity = capacity;
+    }
+    filter->entries[filter->count].nr = (__u32)nr;
+    filter->entries[filter->count].action = action;
+    filter->count++;
+    return LL_ERROR_OK;
+}
+
+static int ll_syscall_entry_cmp(const void *const a, const void *const b)
+{
+    const __u32 left = ((const struct ll_syscall_entry *)a)->nr;
+    const __u32 right = ((const struct ll_syscall_entry *)b)->nr;
+    return (left > right) - (left < right);
+}
+
+/* Size of the search tree over ranges[lo..hi]; each range starts at its entry's nr. */
+static size_t ll_bpf_tree_size(const size_t lo, const size_t hi)
+{
+    if (lo == hi)
+    {
+        return 1;
+    }
+    const size_t mid = lo + (hi - lo + 1) / 2;
+    const size_t left = ll_bpf_tree_size(lo, mid - 1);
+    return 1 + (left > LL_BPF_MAX_JUMP) + left + ll_bpf_tree_size(mid, hi);
+}
+
+/* The left subtree follows its comparison directly, so only the right branch needs a jump. */
+static void ll_bpf_tree_emit(const struct ll_syscall_entry *const ranges,
+                             const size_t lo,
+                             const size_t hi,
+                             struct sock_filter *const program,
+                             size_t *const pos)
+{
+    if (lo == hi)
+    {
+        program[(*pos)++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, ranges[lo].action);
+        return;
+    }
+    const size_t mid = lo + (hi - lo + 1) / 2;
+    const size_t left = ll_bpf_tree_size(lo, mid - 1);
+    if (left > LL_BPF_MAX_JUMP)
+    {
+        program[(*pos)++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, ranges[mid].nr, 0, 1);
+        program[(*pos)++] = (struct sock_filter)BPF_STMT(BPF_JMP | BPF_JA, (__u32)left);
+    }
+    else
+    {
+        program[(*pos)++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, ranges[mid].nr, (__u8)left, 0);
+    }
+    ll_bpf_tree_emit(ranges, lo, mid - 1, program, pos);
+    ll_bpf_tree_emit(ranges, mid, hi, program, pos);
+}
+
+static int ll_syscall_governed(const ll_ruleset_t *const ruleset, const __u32 nr)
+{
+    if (!ruleset)
+    {
+        return 0;
+    }
+    for (size_t i = 0; i < sizeof(ll_governed_syscalls) / sizeof(ll_governed_syscalls[0]); i++)
+    {
+        if ((__u32)ll_governed_syscalls[i].nr == nr)
+        {
+            const __u64 access = ll_governed_syscalls[i].access_fs;
+            return (ruleset->handled_access_fs & access) == access;
+        }
+    }
+    return 0;
+}
+
+ll_error_t ll_syscall_filter_compile(const ll_syscall_filter_t *const filter,
+                                     const ll_ruleset_t *const ruleset,
+                                     struct sock_filter **const out_program,
+                                     size_t *const out_len)
+{
+    if (!filter || !out_program || !out_len)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    *out_program = NULL;
+    *out_len = 0;
+#ifndef LL_SECCOMP_ARCH
+    return LL_ERROR_UNSUPPORTED_SYSCALL;
+#else
+    const size_t governed_count = sizeof(ll_governed_syscalls) / sizeof(ll_governed_syscalls[0]);
+    struct ll_syscall_entry *const entries = malloc((filter->count + governed_count) * sizeof(*entries));
+    /* Every entry opens at most two ranges (itself and the gap before it), plus the tail. */
+    struct ll_syscall_entry *const ranges = malloc((2 * (filter->count + governed_count) + 1) * sizeof(*ranges));
+    if (!entries || !ranges)
+    {
+        free(entries);
+        free(ranges);
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+
+    /* Explicit entries win; only governed syscalls the caller left to the default are allowed. */
+    size_t count = 0;
+    for (size_t i = 0; i < filter->count; i++)
+    {
+        entries[count++] = filter->entries[i];
+    }
+    for (size_t i = 0; i < governed_count && ruleset; i++)
+    {
+        const __u32 nr = (__u32)ll_governed_syscalls[i].nr;
+        int listed = 0;
+        for (size_t j = 0; j < filter->count && !listed; j++)
+        {
+            listed = filter->entries[j].nr == nr;
+        }
+        if (!listed && ll_syscall_governed(ruleset, nr))
+        {
+            entries[count].nr = nr;
+            entries[count].action = SECCOMP_RET_ALLOW;
+            count++;
+        }
+    }
+    qsort(entries, count, sizeof(*entries), ll_syscall_entry_cmp);
+
+    /* Turn the entries into ranges covering every syscall number, merging equal neighbours. */
+    size_t range_count = 0;
+    __u32 next = 0;
+    for (size_t i = 0; i <= count; i++)
+    {
+        const int tail = i == count;
+        if (tail || entries[i].nr > next)
+        {
+            if (range_count == 0 || ranges[range_count - 1].action != filter->default_action)
+            {
+                ranges[range_count].nr = next;
+                ranges[range_count].action = filter->default_action;
+                range_count++;
+            }
+        }
+        if (tail)
+        {
+            break;
+        }
+        if (range_count == 0 || ranges[range_count - 1].action != entries[i].action)
+        {
+            ranges[range_count].nr = entries[i].nr;
+            ranges[range_count].action = entries[i].action;
+            range_count++;
+        }
+        next = entries[i].nr + 1;
+    }
+    free(entries);
+
+#if defined(__x86_64__)
+    const size_t prologue = 6;
+#else
+    const size_t prologue = 4;
+#endif
+    const size_t len = prologue + ll_bpf_tree_size(0, range_count - 1);
+    struct sock_filter *const program = len <= BPF_MAXINSNS ? malloc(len * sizeof(*program)) : NULL;
+    if (!program)
+    {
+        free(ranges);
+        return len <= BPF_MAXINSNS ? LL_ERROR_OUT_OF_MEMORY : LL_ERROR_INVALID_ARGUMENT;
+    }
+    size_t pos = 0;
+    program[pos++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, arch));
+    program[pos++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, LL_SECCOMP_ARCH, 1, 0);
+    program[pos++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_KILL_PROCESS);
+    program[pos++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr));
+#if defined(__x86_64__)
+    /* x32 syscalls share the architecture but set bit 30 of the number. */
+    program[pos++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0x40000000, 0, 1);
+    program[pos++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_KILL_PROCESS);
+#endif
+    ll_bpf_tree_emit(ranges, 0, range_count - 1, program, &pos);
+    free(ranges);
+
+    *out_program = program;
+    *out_len = pos;
+    return LL_ERROR_OK;
+#endif
+}
+
+static ll_error_t ll_syscall_filter_load(const struct sock_filter *const program, const size_t len)
+{
+    struct sock_fprog prog = {.len = (unsigned short)len, .filter = (struct sock_filter *)program};
+    if (ll_sys_set_no_new_privs() || prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog, 0, 0) < 0)
+    {
+        return LL_ERROR_SYSTEM;
+    }
+    return LL_ERROR_OK;
+}
+
+ll_error_t ll_syscall_filter_install(const ll_syscall_filter_t *const filter, const ll_ruleset_t *const ruleset)
+{
+    struct sock_filter *program = NULL;
+    size_t len = 0;
+    const ll_error_t err = ll_syscall_filter_compile(filter, ruleset, &program, &len);
+    if (LL_ERRORED(err))
+    {
+        return err;
+    }
+    const ll_error_t ret = ll_syscall_filter_load(program, len);
+    free(program);
+    return ret;
+}
+
+ll_error_t ll_ruleset_enforce_filtered(const ll_ruleset_t *const ruleset,
+                                       const __u32 flags,
+                                       const ll_syscall_filter_t *const filter)
+{
+    if (!ruleset || !filter)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    struct sock_filter *program = NULL;
+    size_t len = 0;
+    ll_error_t err = ll_syscall_filter_compile(filter, ruleset, &program, &len);
+    if (!LL_ERRORED(err))
+    {
+        err = ll_ruleset_enforce(ruleset, flags);
+    }
+    if (!LL_ERRORED(err))
+    {
+        const ll_error_t load_err = ll_syscall_filter_load(program, len);
+        err = LL_ERRORED(load_err) ? load_err : err;
+    }
+    free(program);
+    return err;
+}
+
+
+/*
+ * Built-in profiles.
+ */
+
+#define LL_PROFILE_READ LL_ACCESS_GROUP_FS_READ
+#define LL_PROFILE_EXEC LL_ACCESS_GROUP_FS_EXECUTE
+#define LL_PROFILE_DEVICE                                                                                    \
+    (LANDLOCK_ACCESS_FS_READ_FILE | LANDLOCK_ACCESS_FS_WRITE_FILE | LANDLOCK_ACCESS_FS_TRUNCATE |            \
+     LANDLOCK_ACCESS_FS_IOCTL_DEV)
+
+static const ll_path_rule_t ll_profile_dynamic_c_paths[] = {
+    {"/lib", LL_PROFILE_EXEC},
+    {"/lib32", LL_PROFILE_EXEC},
+    {"/lib64", LL_PROFILE_EXEC},
+    {"/usr/lib", LL_PROFILE_EXEC},
+    {"/usr/lib32", LL_PROFILE_EXEC},
+    {"/usr/lib64", LL_PROFILE_EXEC},
+    {"/usr/local/lib", LL_PROFILE_EXEC},
+    {"/etc/ld.so.cache", LL_PROFILE_READ},
+    {"/etc/ld.so.preload", LL_PROFILE_READ},
+    {"/etc/localtime", LL_PROFILE_READ},
+    {"/usr/share/zoneinfo", LL_PROFILE_READ},
+    {"/usr/share/locale", LL_PROFILE_READ},
+    {"/usr/lib/locale", LL_PROFILE_READ},
+    {"/dev/null", LL_PROFILE_DEVICE},
+    {"/dev/zero", LL_PROFILE_DEVICE},
+    {"/dev/urandom", LANDLOCK_ACCESS_FS_READ_FILE},
+};
+
+static const ll_path_rule_t ll_profile_python_paths[] = {
+    {"/usr/bin/python3", LL_PROFILE_EXEC},
+    {"/usr/local/bin/python3", LL_PROFILE_EXEC},
+    {"/usr/share/python3", LL_PROFILE_READ},
+    {"/etc/python3", LL_PROFILE_READ},
+};
+
+static const ll_path_rule_t ll_profile_jvm_paths[] = {
+    {"/usr/lib/jvm", LL_PROFILE_EXEC},
+    {"/etc/java", LL_PROFILE_READ},
+    {"/sys/devices/system/cpu", LL_PROFILE_READ},
+    {"/sys/fs/cgroup", LL_PROFILE_READ},
+    {"/proc/cpuinfo", LL_PROFILE_READ},
+    {"/proc/meminfo", LL_PROFILE_READ},
+    {"/proc/stat", LL_PROFILE_READ},
+};
+
+static const ll_path_rule_t ll_profile_tls_client_paths[] = {
+    {"/etc/ssl", LL_PROFILE_READ},
+    {"/etc/pki", LL_PROFILE_READ},
+    {"/etc/ca-certificates", LL_PROFILE_READ},
+    {"/etc/crypto-policies", LL_PROFILE_READ},
+    {"/usr/share/ca-certificates", LL_PROFILE_READ},
+    {"/usr/lib/ssl", LL_PROFILE_READ},
+};
+
+static const ll_port_rule_t ll_profile_tls_client_ports[] = {
+    {443, LANDLOCK_ACCESS_NET_CONNECT_TCP},
+};
+
+static const ll_path_rule_t ll_profile_dns_resolver_paths[] = {
+    {"/etc/resolv.conf", LL_PROFILE_READ},
+    {"/etc/hosts", LL_PROFILE_READ},
+    {"/etc/host.conf", LL_PROFILE_READ},
+    {"/etc/nsswitch.conf", LL_PROFILE_READ},
+    {"/etc/gai.conf", LL_PROFILE_READ},
+    {"/etc/services", LL_PROFILE_READ},
+    {"/etc/protocols", LL_PROFILE_READ},
+};
+
+static const ll_port_rule_t ll_profile_dns_resolver_ports[] = {
+    {53, LANDLOCK_ACCESS_NET_CONNECT_TCP},
+};
+
+struct ll_profile
+{
+    const char *name;
+    ll_profile_t profile;
+    unsigned int requires;
+    const ll_path_rule_t *paths;
+    size_t path_count;
+    const ll_port_rule_t *ports;
+    size_t port_count;
+};
+
+#define LL_TABLE(table) table, sizeof(table) / sizeof((table)[0])
+
+static const struct ll_profile ll_profiles[] = {
+    {"dynamic-c", LL_PROFILE_DYNAMIC_C, 0, LL_TABLE(ll_profile_dynamic_c_paths), NULL, 0},
+    {"python", LL_PROFILE_PYTHON, LL_PROFILE_DYNAMIC_C, LL_TABLE(ll_profile_python_paths), NULL, 0},
+    {"jvm", LL_PROFILE_JVM, LL_PROFILE_DYNAMIC_C, LL_TABLE(ll_profile_jvm_paths), NULL, 0},
+    {"tls-client", LL_PROFILE_TLS_CLIENT, 0, LL_TABLE(ll_profile_tls_client_paths),
+     LL_TABLE(ll_profile_tls_client_ports)},
+    {"dns-resolver", LL_PROFILE_DNS_RESOLVER, 0, LL_TABLE(ll_profile_dns_resolver_paths),
+     LL_TABLE(ll_profile_dns_resolver_ports)},
+};
+
+#define LL_PROFILE_COUNT (sizeof(ll_profiles) / sizeof(ll_profiles[0]))
+#define LL_PROFILE_ALL ((1U << LL_PROFILE_COUNT) - 1)
+
+static const struct ll_profile *ll_profile_find(const ll_profile_t profile)
+{
+    for (size_t i = 0; i < LL_PROFILE_COUNT; i++)
+    {
+        if (ll_profiles[i].profile == profile)
+        {
+            return &ll_profiles[i];
+        }
+    }
+    return NULL;
+}
+
+unsigned int ll_profile_from_name(const char *const name)
+{
+    for (size_t i = 0; name && i < LL_PROFILE_COUNT; i++)
+    {
+        if (strcmp(ll_profiles[i].name, name) == 0)
+        {
+            return ll_profiles[i].profile;
+        }
+    }
+    return 0;
+}
+
+const ll_path_rule_t *ll_profile_paths(const ll_profile_t profile, size_t *const out_count)
+{
+    const struct ll_profile *const entry = ll_profile_find(profile);
+    if (out_count)
+    {
+        *out_count = entry ? entry->path_count : 0;
+    }
+    return entry ? entry->paths : NULL;
+}
+
+const ll_port_rule_t *ll_profile_ports(const ll_profile_t profile, size_t *const out_count)
+{
+    const struct ll_profile *const entry = ll_profile_find(profile);
+    if (out_count)
+    {
+        *out_count = entry ? entry->port_count : 0;
+    }
+    return entry ? entry->ports : NULL;
+}
+
+ll_error_t ll_ruleset_add_profiles(const ll_ruleset_t *const ruleset,
+                                   const unsigned int profiles,
+                                   const ll_path_rule_t *const extra,
+                                   const size_t extra_count,
+                                   size_t *const out_failed)
+{
+    if (!ruleset || (profiles & ~LL_PROFILE_ALL) || (!extra && extra_count > 0))
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    unsigned int selected = profiles;
+    for (size_t i = 0; i < LL_PROFILE_COUNT; i++)
+    {
+        if (selected & ll_profiles[i].profile)
+        {
+            selected |= ll_profiles[i].requires;
+        }
+    }
+
+    const __u32 flags = LL_ADD_RULE_TRIM_DIR_ONLY | LL_ADD_RULE_SKIP_MISSING;
+    for (size_t i = 0; i < LL_PROFILE_COUNT; i++)
+    {
+        const struct ll_profile *const entry = &ll_profiles[i];
+        if (!(selected & entry->profile))
+        {
+            continue;
+        }
+        ll_error_t err = ll_ruleset_add_paths(ruleset, entry->paths, entry->path_count, flags, NULL);
+        for (size_t j = 0; j < entry->port_count && !LL_ERRORED(err); j++)
+        {
+            __u64 access = entry->ports[j].access;
+            if (ruleset->compat_mode == LL_ABI_COMPAT_BEST_EFFORT)
+            {
+                access &= ruleset->handled_access_net;
+            }
+            if (access != 0)
+            {
+                err = ll_ruleset_add_net_port(ruleset, entry->ports[j].port, access, 0);
+            }
+        }
+        if (LL_ERRORED(err))
+        {
+            return err;
+        }
+    }
+    return ll_ruleset_add_paths(ruleset, extra, extra_count, flags, out_failed);
+}
+
+ll_ruleset_result_t ll_profile_create_ruleset(const unsigned int profiles,
+                                              ll_ruleset_attr_t attr,
+                                              const ll_path_rule_t *const extra,
+                                              const size_t extra_count)
+{
+    ll_ruleset_result_t out = {.err = LL_ERROR_INVALID_ARGUMENT, .ruleset = NULL};
+    if ((profiles & ~LL_PROFILE_ALL) || (!extra && extra_count > 0))
+    {
+        return out;
+    }
+
+    /* Handle everything the targeted ABI knows; best-effort creation trims it to the kernel's. */
+    const ll_abi_t abi = ll_resolve_abi(attr.abi);
+    if (attr.access.handled_access_fs == 0)
+    {
+        attr.access.handled_access_fs = ll_supported_access_fs(abi);
+    }
+    if (attr.access.handled_access_net == 0)
+    {
+        attr.access.handled_access_net = ll_supported_access_net(abi);
+    }
+
+    out = ll_ruleset_create_result(attr);
+    if (LL_ERRORED(out.err))
+    {
+        return out;
+    }
+    const ll_error_t err = ll_ruleset_add_profiles(out.ruleset, profiles, extra, extra_count, NULL);
+    if (LL_ERRORED(err))
+    {
+        ll_ruleset_close(out.ruleset);
+        out.ruleset = NULL;
+        out.err = err;
+    }
+    return out;
+}
+
+
+/*
+ * Path rule canonicalisation.
+ */
+
+/* Copy n bytes with at most two overlapping fixed-size moves; path components are mostly short. */
+static inline void ll_copy_short(char *const dst, const char *const src, const size_t n)
+{
+    if (n >= 16)
+    {
+        memcpy(dst, src, n);
+    }
+    else if (n >= 8)
+    {
+        __u64 head, tail;
+        memcpy(&head, src, 8);
+        memcpy(&tail, src + n - 8, 8);
+        memcpy(dst, &head, 8);
+        memcpy(dst + n - 8, &tail, 8);
+    }
+    else if (n >= 4)
+    {
+        __u32 head, tail;
+        memcpy(&head, src, 4);
+        memcpy(&tail, src + n - 4, 4);
+        memcpy(dst, &head, 4);
+        memcpy(dst + n - 4, &tail, 4);
+    }
+    else
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            dst[i] = src[i];
+        }
+    }
+}
+
+/* Append the component path[start, end) to out unless it is empty or ".". */
+static inline void ll_canonical_append(const char *const path,
+                                       const size_t start,
+                                       const size_t end,
+                                       char *const out,
+                                       size_t *const out_len)
+{
+    const size_t n = end - start;
+    if (n == 0 || (n == 1 && path[start] == '.'))
+    {
+        return;
+    }
+    if (*out_len > 0 && out[*out_len - 1] != '/')
+    {
+        out[(*out_len)++] = '/';
+    }
+    ll_copy_short(out + *out_len, path + start, n);
+    *out_len += n;
+}
+
+/*
+ * Canonicalise path (len bytes) into out, which holds len + 2 bytes; returns
+ * the canonical length. Separators are located a block at a time: with SSE2
+ * each 16-byte block yields a bitmask of '/' positions that is walked with
+ * ctz, so components are cut without a per-byte loop.
+ */
+static size_t ll_canonicalize_path(const char *const path, const size_t len, char *const out)
+{
+    size_t out_len = 0;
+    if (len > 0 && path[0] == '/')
+    {
+        out[out_len++] = '/';
+    }
+    size_t start = 0;
+    size_t pos = 0;
+#if defined(__SSE2__)
+    const __m128i slash = _mm_set1_epi8('/');
+    for (; pos + 16 <= len; pos += 16)
+    {
+        const __m128i block = _mm_loadu_si128((const __m128i *)(const void *)(path + pos));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(block, slash));
+        while (mask != 0)
+        {
+            const size_t end = pos + (size_t)__builtin_ctz(mask);
+            ll_canonical_append(path, start, end, out, &out_len);
+            start = end + 1;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    /* The last partial block (or, without SSE2, the whole path) is scanned bytewise. */
+    for (; pos < len; pos++)
+    {
+        if (path[pos] == '/')
+        {
+            ll_canonical_append(path, start, pos, out, &out_len);
+            start = pos + 1;
+        }
+    }
+    if (start < len)
+    {
+        ll_canonical_append(path, start, len, out, &out_len);
+    }
+    if (out_len == 0 && len > 0)
+    {
+        out[out_len++] = '.';
+    }
+    out[out_len] = '\0';
+    return out_len;
+}
+
+#define LL_FAST_HASH_K0 0x9e3779b97f4a7c15ULL
+#define LL_FAST_HASH_K1 0xc2b2ae3d27d4eb4fULL
+
+static __u64 ll_hash_mix(__u64 hash)
+{
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+/*
+ * Hash 16-byte blocks into two 64-bit lanes: each lane adds the product of
+ * the halves of its keyed word plus the other lane's raw word (the SSE2
+ * accumulate step of XXH3). The last block overlaps the one before it, or
+ * is zero-padded for inputs shorter than 16 bytes. The scalar loop
+ * computes the same value.
+ */
+static __u64 ll_hash_fast(const void *const data, const size_t len)
+{
+    const unsigned char *const bytes = data;
+    unsigned char padded[16] = {0};
+    const unsigned char *last = padded;
+    size_t blocks = 0;
+    if (len >= 16)
+    {
+        blocks = (len - 1) / 16;
+        last = bytes + len - 16;
+    }
+    else
+    {
+        memcpy(padded, bytes, len);
+    }
+    __u64 lanes[2];
+#if defined(__SSE2__)
+    const __m128i key = _mm_set_epi64x((long long)LL_FAST_HASH_K1, (long long)LL_FAST_HASH_K0);
+    __m128i acc = _mm_set_epi64x((long long)len, (long long)LL_HASH_INIT);
+    for (size_t i = 0; i <= blocks; i++)
+    {
+        const void *const src = i < blocks ? (const void *)(bytes + i * 16) : (const void *)last;
+        const __m128i block = _mm_loadu_si128((const __m128i *)src);
+        const __m128i keyed = _mm_xor_si128(block, key);
+        acc = _mm_add_epi64(acc, _mm_mul_epu32(keyed, _mm_shuffle_epi32(keyed, 0x31)));
+        acc = _mm_add_epi64(acc, _mm_shuffle_epi32(block, 0x4e));
+    }
+    _mm_storeu_si128((__m128i *)(void *)lanes, acc);
+#else
+    lanes[0] = LL_HASH_INIT;
+    lanes[1] = len;
+    for (size_t i = 0; i <= blocks; i++)
+    {
+        __u64 words[2];
+        memcpy(words, i < blocks ? bytes + i * 16 : last, sizeof(words));
+        const __u64 keyed0 = words[0] ^ LL_FAST_HASH_K0;
+        const __u64 keyed1 = words[1] ^ LL_FAST_HASH_K1;
+        lanes[0] += (keyed0 & 0xffffffffULL) * (keyed0 >> 32) + words[1];
+        lanes[1] += (keyed1 & 0xffffffffULL) * (keyed1 >> 32) + words[0];
+    }
+#endif
+    return ll_hash_mix(lanes[0] ^ ((lanes[1] << 31) | (lanes[1] >> 33)));
+}
+
+struct ll_canonical_slot
+{
+    __u64 hash;
+    __u32 len;
+    /* Index of the rule plus one; 0 marks an empty slot. */
+    __u32 rule;
+};
+
+static int ll_canonical_grow(struct ll_canonical_slot **const table, size_t *const table_size)
+{
+    const size_t size = *table_size * 2;
+    struct ll_canonical_slot *const grown = calloc(size, sizeof(*grown));
+    if (!grown)
+    {
+        return 0;
+    }
+    for (size_t i = 0; i < *table_size; i++)
+    {
+        if ((*table)[i].rule != 0)
+        {
+            size_t slot = (size_t)(*table)[i].hash & (size - 1);
+            while (grown[slot].rule != 0)
+            {
+                slot = (slot + 1) & (size - 1);
+            }
+            grown[slot] = (*table)[i];
+        }
+    }
+    free(*table);
+    *table = grown;
+    *table_size = size;
+    return 1;
+}
+
+ll_error_t ll_path_rules_canonicalize(const ll_path_rule_t *const rules,
+                                      const size_t count,
+                                      ll_path_rule_t **const out_rules,
+                                      size_t *const out_count)
+{
+    if ((!rules && count > 0) || !out_rules || !out_count)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    *out_rules = NULL;
+    *out_count = 0;
+    if (count == 0)
+    {
+        return LL_ERROR_OK;
+    }
+    if (count >= UINT32_MAX)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+
+    size_t text_size = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const size_t len = rules[i].path ? strlen(rules[i].path) : UINT32_MAX;
+        if (len >= UINT32_MAX)
+        {
+            return LL_ERROR_INVALID_ARGUMENT;
+        }
+        text_size += len + 2;
+    }
+
+    /* Rules and their strings share one block; the strings of merged duplicates are overwritten. */
+    ll_path_rule_t *const out = malloc(count * sizeof(*out) + text_size);
+    /* Slots carry the hash and length so most probes stay within the table; it grows with the distinct count. */
+    size_t table_size = 1024;
+    struct ll_canonical_slot *table = malloc(table_size * sizeof(*table));
+    if (!out || !table)
+    {
+        free(out);
+        free(table);
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    memset(table, 0, table_size * sizeof(*table));
+
+    char *text = (char *)(out + count);
+    size_t unique = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const size_t len = ll_canonicalize_path(rules[i].path, strlen(rules[i].path), text);
+        const __u64 hash = ll_hash_fast(text, len);
+        size_t slot = (size_t)hash & (table_size - 1);
+        for (; table[slot].rule != 0; slot = (slot + 1) & (table_size - 1))
+        {
+            const struct ll_canonical_slot *const entry = &table[slot];
+            if (entry->hash == hash && entry->len == len && memcmp(out[entry->rule - 1].path, text, len) == 0)
+            {
+                break;
+            }
+        }
+        if (table[slot].rule != 0)
+        {
+            out[table[slot].rule - 1].access |= rules[i].access;
+            continue;
+        }
+
+        out[unique].path = text;
+        out[unique].access = rules[i].access;
+        table[slot].hash = hash;
+        table[slot].len = (__u32)len;
+        table[slot].rule = (__u32)++unique;
+        text += len + 1;
+        if (unique * 2 > table_size && !ll_canonical_grow(&table, &table_size))
+        {
+            free(out);
+            free(table);
+            return LL_ERROR_OUT_OF_MEMORY;
+        }
+    }
+
+    free(table);
+    *out_rules = out;
+    *out_count = unique;
+    return LL_ERROR_OK;
+}
+
+/*
+ * Streaming manifests.
+ *
+ * A producer thread reads, splits, canonicalises and opens paths, passing
+ * the descriptors to the calling thread through a single-producer/
+ * single-consumer ring whose capacity caps the descriptors in flight.
+ */
+
+#define LL_MANIFEST_INFLIGHT 64
+#define LL_MANIFEST_SPINS 128
+
+struct ll_manifest_slot
+{
+    int fd;
+    /* errno of a failed open. */
+    int err;
+    size_t line;
+    /* Set on the last slot, which carries the producer's status. */
+    int end;
+    ll_error_t status;
+};
+
+struct ll_manifest
+{
+    int fd;
+    const char *data;
+    size_t len;
+    size_t chunk_size;
+    __u32 capacity;
+    struct ll_manifest_slot *slots;
+    /* Slots produced and consumed; each side sleeps on the other's counter. */
+    __u32 head;
+    __u32 tail;
+    __u32 head_sleeping;
+    __u32 tail_sleeping;
+    int stop;
+    size_t lines;
+    unsigned int peak;
+    char path[PATH_MAX + 2];
+};
+
+/* Half of the descriptors left under RLIMIT_NOFILE, so the caller keeps room for its own. */
+static unsigned int ll_manifest_inflight_limit(const unsigned int requested)
+{
+    unsigned int limit = requested ? requested : LL_MANIFEST_INFLIGHT;
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0 || rl.rlim_cur == RLIM_INFINITY)
+    {
+        return limit;
+    }
+    rlim_t used = 3;
+    DIR *const dir = opendir("/proc/self/fd");
+    if (dir)
+    {
+        used = 0;
+        for (const struct dirent *entry = readdir(dir); entry; entry = readdir(dir))
+        {
+            used += entry->d_name[0] != '.';
+        }
+        closedir(dir);
+    }
+    const rlim_t spare = rl.rlim_cur > used ? (rl.rlim_cur - used) / 2 : 0;
+    if (spare < limit)
+    {
+        limit = spare > 0 ? (unsigned int)spare : 1;
+    }
+    return limit;
+}
+
+/* Queue a slot, waiting for room; returns -1 (closing fd) once the consumer asked to stop. */
+static int ll_manifest_push(struct ll_manifest *const m, const struct ll_manifest_slot *const slot)
+{
+    const __u32 head = m->head;
+    __u32 tail = __atomic_load_n(&m->tail, __ATOMIC_ACQUIRE);
+    /* The last slot always waits for room: the consumer drains the ring until it sees it. */
+    while (head - tail >= m->capacity && (slot->end || !__atomic_load_n(&m->stop, __ATOMIC_RELAXED)))
+    {
+        (void)ll_futex_await(&m->tail, &m->tail_sleeping, tail, LL_MANIFEST_SPINS, -1);
+        tail = __atomic_load_n(&m->tail, __ATOMIC_ACQUIRE);
+    }
+    if (!slot->end && __atomic_load_n(&m->stop, __ATOMIC_RELAXED))
+    {
+        if (slot->fd >= 0)
+        {
+            close(slot->fd);
+        }
+        return -1;
+    }
+    m->slots[head % m->capacity] = *slot;
+    if (head + 1 - tail > m->peak)
+    {
+        m->peak = head + 1 - tail;
+    }
+    ll_futex_signal(&m->head, &m->head_sleeping, head + 1);
+    return 0;
+}
+
+static ll_error_t ll_manifest_line(struct ll_manifest *const m, const char *const text, size_t len)
+{
+    m->lines++;
+    if (len > 0 && text[len - 1] == '\r')
+    {
+        len--;
+    }
+    if (len == 0 || text[0] == '#')
+    {
+        return LL_ERROR_OK;
+    }
+    if (len >= PATH_MAX)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    (void)ll_canonicalize_path(text, len, m->path);
+    struct ll_manifest_slot slot = {.fd = open(m->path, O_PATH | O_CLOEXEC), .line = m->lines};
+    slot.err = slot.fd < 0 ? errno : 0;
+    return ll_manifest_push(m, &slot) == 0 ? LL_ERROR_OK : LL_ERROR_CANCELED;
+}
+
+/* Handle the complete lines of @p text (and the rest too when @p at_eof); @p out_used receives the bytes handled. */
+static ll_error_t ll_manifest_parse(struct ll_manifest *const m,
+                                    const char *const text,
+                                    const size_t len,
+                                    const int at_eof,
+                                    size_t *const out_used)
+{
+    size_t pos = 0;
+    ll_error_t err = LL_ERROR_OK;
+    while (pos < len && !LL_ERRORED(err))
+    {
+        const char *const newline = memchr(text + pos, '\n', len - pos);
+        if (!newline && !at_eof)
+        {
+            break;
+        }
+        const size_t end = newline ? (size_t)(newline - text) : len;
+        err = ll_manifest_line(m, text + pos, end - pos);
+        pos = newline ? end + 1 : len;
+    }
+    if (!LL_ERRORED(err) && len - pos >= PATH_MAX)
+    {
+        /* A partial line that can no longer be a valid path. */
+        m->lines++;
+        err = LL_ERROR_INVALID_ARGUMENT;
+    }
+    *out_used = pos;
+    return err;
+}
+
+static ll_error_t ll_manifest_read(struct ll_manifest *const m)
+{
+    /* Room for a chunk after the longest partial line that can be carried over. */
+    const size_t size = m->chunk_size + PATH_MAX;
+    char *const buffer = malloc(size);
+    if (!buffer)
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    ll_error_t err = LL_ERROR_OK;
+    size_t have = 0;
+    int at_eof = 0;
+    while (!at_eof && !LL_ERRORED(err))
+    {
+        const ssize_t n = read(m->fd, buffer + have, size - have < m->chunk_size ? size - have : m->chunk_size);
+        if (n < 0)
+        {
+            if (errno != EINTR)
+            {
+                err = LL_ERROR_SYSTEM;
+            }
+            continue;
+        }
+        at_eof = n == 0;
+        have += (size_t)n;
+        size_t used = 0;
+        err = ll_manifest_parse(m, buffer, have, at_eof, &used);
+        memmove(buffer, buffer + used, have - used);
+        have -= used;
+    }
+    free(buffer);
+    return err;
+}
+
+static void *ll_manifest_producer(void *const arg)
+{
+    struct ll_manifest *const m = arg;
+    ll_error_t err = LL_ERROR_OK;
+    if (m->data)
+    {
+        size_t used = 0;
+        err = ll_manifest_parse(m, m->data, m->len, 1, &used);
+    }
+    else
+    {
+        err = ll_manifest_read(m);
+    }
+    const struct ll_manifest_slot end = {.fd = -1, .line = m->lines, .end = 1, .status = err};
+    (void)ll_manifest_push(m, &end);
+    return NULL;
+}
+
+static ll_error_t ll_manifest_ingest(const ll_ruleset_t *const ruleset,
+                                     struct ll_manifest *const m,
+                                     const __u64 access,
+                                     const __u32 flags,
+                                     const ll_manifest_options_t *const options,
+                                     ll_manifest_stats_t *const out_stats,
+                                     size_t *const out_line)
+{
+    const ll_manifest_options_t defaults = ll_manifest_options_defaults();
+    const ll_manifest_options_t opts = options ? *options : defaults;
+    if (!ruleset || ruleset->ruleset_fd < 0)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    m->chunk_size = opts.chunk_size ? opts.chunk_size : defaults.chunk_size;
+    m->capacity = ll_manifest_inflight_limit(opts.max_inflight);
+    m->slots = malloc(m->capacity * sizeof(*m->slots));
+    if (!m->slots)
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+
+    /* As in ll_ruleset_add_paths(), best-effort rulesets drop the rights they do not handle. */
+    const int best_effort = ruleset->compat_mode == LL_ABI_COMPAT_BEST_EFFORT;
+    const __u64 rule_access = best_effort ? access & ruleset->handled_access_fs : access;
+
+    const __u64 start = ll_monotonic_ms();
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, ll_manifest_producer, m) != 0)
+    {
+        free(m->slots);
+        return LL_ERROR_SYSTEM;
+    }
+
+    ll_manifest_stats_t stats = {.inflight_limit = m->capacity};
+    ll_error_t err = LL_ERROR_OK;
+    size_t failed_line = 0;
+    for (__u32 tail = 0;; tail++)
+    {
+        while (__atomic_load_n(&m->head, __ATOMIC_ACQUIRE) == tail)
+        {
+            (void)ll_futex_await(&m->head, &m->head_sleeping, tail, LL_MANIFEST_SPINS, -1);
+        }
+        const struct ll_manifest_slot slot = m->slots[tail % m->capacity];
+        if (slot.end)
+        {
+            if (LL_ERRORED(slot.status) && slot.status != LL_ERROR_CANCELED)
+            {
+                err = slot.status;
+                failed_line = slot.line;
+            }
+            break;
+        }
+        if (!LL_ERRORED(err))
+        {
+            errno = slot.err;
+            ll_error_t result = LL_ERROR_OK;
+            if ((slot.fd < 0 && ll_path_missing(flags)) || (best_effort && rule_access == 0))
+            {
+                stats.skipped++;
+            }
+            else if (LL_ERRORED(result = ll_ruleset_add_path_fd(ruleset, slot.fd, rule_access, flags)))
+            {
+                /* Let the producer wind down; the slots still queued are drained below. */
+                err = result;
+                failed_line = slot.line;
+                __atomic_store_n(&m->stop, 1, __ATOMIC_RELAXED);
+            }
+            else
+            {
+                stats.rules++;
+            }
+        }
+        if (slot.fd >= 0)
+        {
+            close(slot.fd);
+        }
+        ll_futex_signal(&m->tail, &m->tail_sleeping, tail + 1);
+    }
+    pthread_join(thread, NULL);
+    free(m->slots);
+
+    const __u64 elapsed = ll_monotonic_ms() - start;
+    stats.lines = m->lines;
+    stats.peak_inflight = m->peak;
+    stats.rules_per_second = (double)stats.rules * 1000.0 / (double)(elapsed ? elapsed : 1);
+    if (out_stats)
+    {
+        *out_stats = stats;
+    }
+    if (out_line && LL_ERRORED(err))
+    {
+        *out_line = failed_line;
+    }
+    return err;
+}
+
+ll_error_t ll_ruleset_add_manifest_fd(const ll_ruleset_t *const ruleset,
+                                      const int fd,
+                                      const __u64 access,
+                                      const __u32 flags,
+                                      const ll_manifest_options_t *const options,
+                                      ll_manifest_stats_t *const out_stats,
+                                      size_t *const out_line)
+{
+    if (fd < 0)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    struct ll_manifest *const m = calloc(1, sizeof(*m));
+    if (!m)
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    m->fd = fd;
+    const ll_error_t err = ll_manifest_ingest(ruleset, m, access, flags, options, out_stats, out_line);
+    free(m);
+    return err;
+}
+
+ll_error_t ll_ruleset_add_manifest_buffer(const ll_ruleset_t *const ruleset,
+                                          const void *const data,
+                                          const size_t len,
+                                          const __u64 access,
+                                          const __u32 flags,
+                                          const ll_manifest_options_t *const options,
+                                          ll_manifest_stats_t *const out_stats,
+                                          size_t *const out_line)
+{
+    if (!data && len > 0)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    struct ll_manifest *const m = calloc(1, sizeof(*m));
+    if (!m)
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    m->fd = -1;
+    m->data = data ? data : "";
+    m->len = len;
+    const ll_error_t err = ll_manifest_ingest(ruleset, m, access, flags, options, out_stats, out_line);
+    free(m);
+    return err;
+}
+
+/*
+ * Ruleset journals.
+ */
+
+struct ll_journal_entry
+{
+    enum landlock_rule_type type;
+    int fd;
+    __u64 access;
+    __u64 port;
+    __u32 flags;
+};
+
+struct ll_ruleset_journal
+{
+    ll_ruleset_t *base;
+    __u32 create_flags;
+    ll_error_t create_status;
+    struct ll_journal_entry *entries;
+    size_t count;
+    size_t capacity;
+};
+
+static int ll_journal_reserve(ll_ruleset_journal_t *const journal)
+{
+    if (journal->count < journal->capacity)
+    {
+        return 1;
+    }
+    const size_t capacity = journal->capacity ? journal->capacity * 2 : 16;
+    struct ll_journal_entry *const entries = realloc(journal->entries, capacity * sizeof(*entries));
+    if (!entries)
+    {
+        return 0;
+    }
+    journal->entries = entries;
+    journal->capacity = capacity;
+    return 1;
+}
+
+ll_error_t ll_ruleset_journal_create(const ll_ruleset_attr_t attr, ll_ruleset_journal_t **const out_journal)
+{
+    if (!out_journal)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    *out_journal = NULL;
+
+    ll_ruleset_journal_t *const journal = calloc(1, sizeof(*journal));
+    if (!journal)
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    const ll_ruleset_result_t res = ll_ruleset_create_result(attr);
+    if (LL_ERRORED(res.err))
+    {
+        free(journal);
+        return res.err;
+    }
+    journal->base = res.ruleset;
+    journal->create_flags = attr.flags;
+    journal->create_status = res.err;
+    *out_journal = journal;
+    return res.err;
+}
+
+void ll_ruleset_journal_free(ll_ruleset_journal_t *const journal)
+{
+    if (!journal)
+    {
+        return;
+    }
+    for (size_t i = 0; i < journal->count; i++)
+    {
+        if (journal->entries[i].fd >= 0)
+        {
+            close(journal->entries[i].fd);
+        }
+    }
+    free(journal->entries);
+    ll_ruleset_close(journal->base);
+    free(journal);
+}
+
+const ll_ruleset_t *ll_ruleset_journal_base(const ll_ruleset_journal_t *const journal)
+{
+    return journal ? journal->base : NULL;
+}
+
+ll_error_t ll_ruleset_journal_add_path(ll_ruleset_journal_t *const journal,
+                                       const char *const path,
+                                       const __u64 access,
+                                       const __u32 flags)
+{
+    if (!journal || !path)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    if (!ll_journal_reserve(journal))
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+
+    const int fd = open(path, O_PATH | O_CLOEXEC);
+    if (fd < 0 && ll_path_missing(flags))
+    {
+        return LL_ERROR_OK;
+    }
+    __u64 trimmed = 0;
+    const ll_error_t err = ll_ruleset_add_path_fd_trim(journal->base, fd, access, flags, &trimmed);
+    if (LL_ERRORED(err) || (access & ~trimmed) == 0)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return err;
+    }
+    struct ll_journal_entry *const entry = &journal->entries[journal->count++];
+    entry->type = LANDLOCK_RULE_PATH_BENEATH;
+    entry->fd = fd;
+    entry->access = access & ~trimmed;
+    entry->port = 0;
+    entry->flags = flags & ~LL_ADD_RULE_LIBRARY_FLAGS;
+    return LL_ERROR_OK;
+}
+
+ll_error_t ll_ruleset_journal_add_paths(ll_ruleset_journal_t *const journal,
+                                        const ll_path_rule_t *const rules,
+                                        const size_t count,
+                                        const __u32 flags,
+                                        size_t *const out_failed)
+{
+    if (!journal || (!rules && count > 0))
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        const ll_error_t err = ll_ruleset_journal_add_path(journal, rules[i].path, rules[i].access, flags);
+        if (LL_ERRORED(err))
+        {
+            if (out_failed)
+            {
+                *out_failed = i;
+            }
+            return err;
+        }
+    }
+    return LL_ERROR_OK;
+}
+
+ll_error_t ll_ruleset_journal_add_net_port(ll_ruleset_journal_t *const journal,
+                                           const __u64 port,
+                                           const __u64 access)
+{
+    if (!journal)
+    {
+        return LL_ERROR_INVALID_ARGUMENT;
+    }
+    if (!ll_journal_reserve(journal))
+    {
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+    const ll_error_t err = ll_ruleset_add_net_port(journal->base, port, access, 0);
+    if (LL_ERRORED(err))
+    {
+        return err;
+    }
+    struct ll_journal_entry *const entry = &journal->entries[journal->count++];
+    entry->type = LANDLOCK_RULE_NET_PORT;
+    entry->fd = -1;
+    entry->access = access;
+    entry->port = port;
+    entry->flags = 0;
+    return LL_ERROR_OK;
+}
+
+ll_ruleset_result_t ll_ruleset_derive(const ll_ruleset_journal_t *const journal,
+                                      const ll_path_rule_t *const delta,
+                                      const size_t delta_count,
+                                      const __u32 flags,
+                                      size_t *const out_failed)
+{
+    ll_ruleset_result_t out = {.err = LL_ERROR_INVALID_ARGUMENT, .ruleset = NULL};
+    if (!journal || (!delta && delta_count > 0))
+    {
+        return out;
+    }
+
+    const ll_ruleset_t *const base = journal->base;
+    struct landlock_ruleset_attr attr = {
+        .handled_access_fs = base->handled_access_fs,
+        .handled_access_net = base->handled_access_net,
+        .scoped = base->handled_access_scope,
+    };
+    ll_ruleset_t *const ruleset = malloc(sizeof(*ruleset));
+    if (!ruleset)
+    {
+        out.err = LL_ERROR_OUT_OF_MEMORY;
+        return out;
+    }
+    *ruleset = *base;
+    ruleset->ruleset_fd = ll_sys_create_ruleset(&attr, sizeof(attr), journal->create_flags);
+    if (ruleset->ruleset_fd < 0)
+    {
+        out.err = ll_error_from_create_ruleset_errno(errno);
+        free(ruleset);
+        return out;
+    }
+
+    /* The base already accepted every entry, so only the kernel's own limits can fail here. */
+    ll_error_t err = LL_ERROR_OK;
+    for (size_t i = 0; i < journal->count && !LL_ERRORED(err); i++)
+    {
+        const struct ll_journal_entry *const entry = &journal->entries[i];
+        struct landlock_path_beneath_attr path_attr = {.allowed_access = entry->access, .parent_fd = entry->fd};
+        struct landlock_net_port_attr net_attr = {.allowed_access = entry->access, .port = entry->port};
+        const void *const rule_attr =
+            entry->type == LANDLOCK_RULE_PATH_BENEATH ? (const void *)&path_attr : (const void *)&net_attr;
+        if (ll_sys_add_rule(ruleset->ruleset_fd, entry->type, rule_attr, entry->flags) < 0)
+        {
+            err = ll_error_from_add_rule_errno(errno);
+        }
+    }
+    if (!LL_ERRORED(err))
+    {
+        err = ll_ruleset_add_paths(ruleset, delta, delta_count, flags, out_failed);
+    }
+    if (LL_ERRORED(err))
+    {
+        ll_ruleset_close(ruleset);
+        out.err = err;
+        return out;
+    }
+    out.ruleset = ruleset;
+    out.err = journal->create_status;
+    return out;
+}
+
+/*
+ * Descriptor cache.
+ *
+ * Nodes are allocated individually so that a descriptor lent to a caller
+ * outlives its eviction: a node removed from the table while pinned is
+ * closed by the last ll_path_close().
+ */
+
+struct ll_fd_cache_node
+{
+    char *path;
+    int fd;
+    dev_t dev;
+    ino_t ino;
+    unsigned int pins;
+    int detached;
+    __u64 used;
+    struct ll_fd_cache_node *next;
+};
+
+static struct
+{
+    int lock;
+    int enabled;
+    int directories_only;
+    unsigned int capacity;
+    unsigned int count;
+    /* Parallel arrays, so a lookup scans the hashes alone. */
+    __u64 *hashes;
+    struct ll_fd_cache_node **nodes;
+    __u64 tick;
+    __u64 lookups;
+    __u64 hits;
+    __u64 stale;
+    __u64 evictions;
+} ll_fd_cache;
+
+static void ll_fd_cache_acquire(void)
+{
+    while (__atomic_test_and_set(&ll_fd_cache.lock, __ATOMIC_ACQUIRE))
+    {
+        ll_cpu_relax();
+    }
+}
+
+static void ll_fd_cache_release(void)
+{
+    __atomic_clear(&ll_fd_cache.lock, __ATOMIC_RELEASE);
+}
+
+static void ll_fd_cache_free_nodes(struct ll_fd_cache_node *node)
+{
+    while (node)
+    {
+        struct ll_fd_cache_node *const next = node->next;
+        close(node->fd);
+        free(node->path);
+        free(node);
+        node = next;
+    }
+}
+
+/* Detach entry @p i (lock held); an unpinned node is chained onto @p garbage for freeing after unlocking. */
+static void ll_fd_cache_remove(const unsigned int i, struct ll_fd_cache_node **const garbage)
+{
+    struct ll_fd_cache_node *const node = ll_fd_cache.nodes[i];
+    ll_fd_cache.count--;
+    ll_fd_cache.nodes[i] = ll_fd_cache.nodes[ll_fd_cache.count];
+    ll_fd_cache.hashes[i] = ll_fd_cache.hashes[ll_fd_cache.count];
+    node->detached = 1;
+    if (node->pins == 0)
+    {
+        node->next = *garbage;
+        *garbage = node;
+    }
+}
+
+/* Evict least recently used entries (lock held) until @p limit remain; returns 0 if pinned entries prevent it. */
+static int ll_fd_cache_shrink(const unsigned int limit, struct ll_fd_cache_node **const garbage)
+{
+    while (ll_fd_cache.count > limit)
+    {
+        unsigned int victim = UINT_MAX;
+        for (unsigned int i = 0; i < ll_fd_cache.count; i++)
+        {
+            if (ll_fd_cache.nodes[i]->pins == 0 &&
+                (victim == UINT_MAX || ll_fd_cache.nodes[i]->used < ll_fd_cache.nodes[victim]->used))
+            {
+                victim = i;
+            }
+        }
+        if (victim == UINT_MAX)
+        {
+            return 0;
+        }
+        ll_fd_cache_remove(victim, garbage);
+        ll_fd_cache.evictions++;
+    }
+    return 1;
+}
+
+/*
+ * Open @p path O_PATH, through the cache when it is enabled. A descriptor
+ * lent by the cache comes with @p out_node set and must be returned with
+ * ll_path_close(), like any other.
+ */
+static int ll_path_open(const char *const path, struct ll_fd_cache_node **const out_node)
+{
+    *out_node = NULL;
+    if (!__atomic_load_n(&ll_fd_cache.enabled, __ATOMIC_RELAXED))
+    {
+        return open(path, O_PATH | O_CLOEXEC);
+    }
+
+    struct stat st;
+    if (stat(path, &st) < 0)
+    {
+        return -1;
+    }
+    const size_t len = strlen(path);
+    const __u64 hash = ll_hash_fast(path, len);
+    struct ll_fd_cache_node *garbage = NULL;
+    ll_fd_cache_acquire();
+    ll_fd_cache.lookups++;
+    for (unsigned int i = 0; i < ll_fd_cache.count; i++)
+    {
+        struct ll_fd_cache_node *const node = ll_fd_cache.nodes[i];
+        if (ll_fd_cache.hashes[i] != hash || strcmp(node->path, path) != 0)
+        {
+            continue;
+        }
+        if (node->dev == st.st_dev && node->ino == st.st_ino)
+        {
+            node->pins++;
+            node->used = ++ll_fd_cache.tick;
+            ll_fd_cache.hits++;
+            ll_fd_cache_release();
+            *out_node = node;
+            return node->fd;
+        }
+        ll_fd_cache_remove(i, &garbage);
+        ll_fd_cache.stale++;
+        break;
+    }
+    const int directories_only = ll_fd_cache.directories_only;
+    ll_fd_cache_release();
+    ll_fd_cache_free_nodes(garbage);
+    garbage = NULL;
+
+    const int fd = open(path, O_PATH | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &st) < 0 || (directories_only && !S_ISDIR(st.st_mode)))
+    {
+        return fd;
+    }
+    struct ll_fd_cache_node *const node = calloc(1, sizeof(*node));
+    char *const copy = node ? malloc(len + 1) : NULL;
+    if (!copy)
+    {
+        free(node);
+        return fd;
+    }
+    memcpy(copy, path, len + 1);
+    node->path = copy;
+    node->fd = fd;
+    node->dev = st.st_dev;
+    node->ino = st.st_ino;
+    node->pins = 1;
+
+    ll_fd_cache_acquire();
+    int inserted = 0;
+    int present = 0;
+    for (unsigned int i = 0; i < ll_fd_cache.count && !present; i++)
+    {
+        /* Another thread may have cached the path meanwhile. */
+        present = ll_fd_cache.hashes[i] == hash && strcmp(ll_fd_cache.nodes[i]->path, path) == 0;
+    }
+    if (ll_fd_cache.enabled && !present && ll_fd_cache_shrink(ll_fd_cache.capacity - 1, &garbage))
+    {
+        node->used = ++ll_fd_cache.tick;
+        ll_fd_cache.hashes[ll_fd_cache.count] = hash;
+        ll_fd_cache.nodes[ll_fd_cache.count++] = node;
+        inserted = 1;
+    }
+    ll_fd_cache_release();
+    ll_fd_cache_free_nodes(garbage);
+    if (!inserted)
+    {
+        free(copy);
+        free(node);
+        return fd;
+    }
+    *out_node = node;
+    return fd;
+}
+
+static void ll_path_close(const int fd, struct ll_fd_cache_node *const node)
+{
+    if (!node)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return;
+    }
+    ll_fd_cache_acquire();
+    const int orphaned = --node->pins == 0 && node->detached;
+    ll_fd_cache_release();
+    if (orphaned)
+    {
+        node->next = NULL;
+        ll_fd_cache_free_nodes(node);
+    }
+}
+
+ll_error_t ll_fd_cache_enable(const ll_fd_cache_options_t *const options)
+{
+    const ll_fd_cache_options_t opts = options ? *options : ll_fd_cache_options_defaults();
+    if (opts.max_fds == 0)
+    {
+        ll_fd_cache_disable();
+        return LL_ERROR_OK;
+    }
+    __u64 *hashes = malloc(opts.max_fds * sizeof(*hashes));
+    struct ll_fd_cache_node **nodes = malloc(opts.max_fds * sizeof(*nodes));
+    if (!hashes || !nodes)
+    {
+        free(hashes);
+        free(nodes);
+        return LL_ERROR_OUT_OF_MEMORY;
+    }
+
+    struct ll_fd_cache_node *garbage = NULL;
+    ll_fd_cache_acquire();
+    /* Entries still lent out beyond the new budget are detached; their last user closes them. */
+    if (!ll_fd_cache_shrink(opts.max_fds, &garbage))
+    {
+        while (ll_fd_cache.count > opts.max_fds)
+        {
+            ll_fd_cache_remove(ll_fd_cache.count - 1, &garbage);
+            ll_fd_cache.evictions++;
+        }
+    }
+    if (ll_fd_cache.count > 0)
+    {
+        memcpy(hashes, ll_fd_cache.hashes, ll_fd_cache.count * sizeof(*hashes));
+        memcpy(nodes, ll_fd_cache.nodes, ll_fd_cache.count * sizeof(*nodes));
+    }
+    __u64 *const old_hashes = ll_fd_cache.hashes;
+    struct ll_fd_cache_node **const old_nodes = ll_fd_cache.nodes;
+    ll_fd_cache.hashes = hashes;
+    ll_fd_cache.nodes = nodes;
+    ll_fd_cache.capacity = opts.max_fds;
+    ll_fd_cache.directories_only = opts.directories_only;
+    __atomic_store_n(&ll_fd_cache.enabled, 1, __ATOMIC_RELAXED);
+    ll_fd_cache_release();
+    free(old_hashes);
+    free(old_nodes);
+    ll_fd_cache_free_nodes(garbage);
+    return LL_ERROR_OK;
+}
+
+void ll_fd_cache_disable(void)
+{
+    struct ll_fd_cache_node *garbage = NULL;
+    ll_fd_cache_acquire();
+    __atomic_store_n(&ll_fd_cache.enabled, 0, __ATOMIC_RELAXED);
+    while (ll_fd_cache.count > 0)
+    {
+        ll_fd_cache_remove(ll_fd_cache.count - 1, &garbage);
+    }
+    __u64 *const hashes = ll_fd_cache.hashes;
+    struct ll_fd_cache_node **const nodes = ll_fd_cache.nodes;
+    ll_fd_cache.hashes = NULL;
+    ll_fd_cache.nodes = NULL;
+    ll_fd_cache.capacity = 0;
+    ll_fd_cache_release();
+    free(hashes);
+    free(nodes);
+    ll_fd_cache_free_nodes(garbage);
+}
+
+void ll_fd_cache_stats(ll_fd_cache_stats_t *const out_stats)
+{
+    if (!out_stats)
+    {
+        return;
+    }
+    ll_fd_cache_acquire();
+    out_stats->lookups = ll_fd_cache.lookups;
+    out_stats->hits = ll_fd_cache.hits;
+    out_stats->stale = ll_fd_cache.stale;
+    out_stats->evictions = ll_fd_cache.evictions;
+    out_stats->cached_fds = ll_fd_cache.count;
+    ll_fd_cache_release();
+    out_stats->hit_rate = out_stats->lookups ? (double)out_stats->hits / (double)out_stats->lookups : 0.0;
+}
@@ -59,6 +59,38 @@ typedef enum
      * @brief Ruleset cannot be created due to compatibility checks.
      */
     LL_ERROR_RULESET_INCOMPATIBLE = -6,
+    /**
+     * @brief The audit subsystem cannot be read (no netlink audit support or missing CAP_AUDIT_READ).
+     */
+    LL_ERROR_AUDIT_UNAVAILABLE = -7,
+    /**
+     * @brief Policy text could not be parsed.
+     */
+    LL_ERROR_POLICY_SYNTAX = -8,
+    /**
+     * @brief The ruleset broker has no ruleset under the requested name.
+     */
+    LL_ERROR_BROKER_NOT_FOUND = -9,
+    /**
+     * @brief Malformed or unexpected ruleset broker message.
+     */
+    LL_ERROR_BROKER_PROTOCOL = -10,
+    /**
+     * @brief The plugin helper process exited or was killed.
+     */
+    LL_ERROR_PLUGIN_EXITED = -11,
+    /**
+     * @brief A path could not be opened before its deadline and was skipped.
+     */
+    LL_ERROR_TIMEOUT = -12,
+    /**
+     * @brief The operation was cancelled before it completed.
+     */
+    LL_ERROR_CANCELED = -13,
+    /**
+     * @brief The ruleset broker does not serve the requesting peer's user.
+     */
+    LL_ERROR_BROKER_DENIED = -14,
 
     /**
      * @brief Landlock is supported by the kernel but disabled at boot time.
@@ -215,6 +247,37 @@ typedef enum
  */
 #define LL_ACCESS_GROUP_FS_ALL (LL_ACCESS_GROUP_FS_READ | LL_ACCESS_GROUP_FS_WRITE | LL_ACCESS_GROUP_FS_EXECUTE)
 
+/**
+ * @brief Filesystem access rights that only apply to directories.
+ *
+ * The kernel rejects a path-beneath rule carrying any of these on a
+ * non-directory with EINVAL, reported as LL_ERROR_ADD_RULE_INCONSISTENT_ACCESS.
+ */
+#define LL_ACCESS_FS_DIR_ONLY (LANDLOCK_ACCESS_FS_READ_DIR | LANDLOCK_ACCESS_FS_REMOVE_DIR |          \
+                               LANDLOCK_ACCESS_FS_REMOVE_FILE | LANDLOCK_ACCESS_FS_MAKE_CHAR |       \
+                               LANDLOCK_ACCESS_FS_MAKE_DIR | LANDLOCK_ACCESS_FS_MAKE_REG |           \
+                               LANDLOCK_ACCESS_FS_MAKE_SOCK | LANDLOCK_ACCESS_FS_MAKE_FIFO |         \
+                               LANDLOCK_ACCESS_FS_MAKE_BLOCK | LANDLOCK_ACCESS_FS_MAKE_SYM |         \
+                               LANDLOCK_ACCESS_FS_REFER)
+
+/**
+ * @brief Library flag for the path rule APIs: drop @ref LL_ACCESS_FS_DIR_ONLY rights when the path is not a directory.
+ *
+ * The file type is read from the opened descriptor with fstat(), and only
+ * when the access mask carries directory-only rights. A rule left without
+ * rights is skipped. The flag is removed before calling landlock_add_rule().
+ */
+#define LL_ADD_RULE_TRIM_DIR_ONLY (1U << 31)
+
+/**
+ * @brief Library flag for the path rule APIs: skip rules whose path does not exist.
+ *
+ * A path that fails to open with ENOENT or ENOTDIR adds no rule and is not
+ * an error, which suits rules for files that only some systems have. The
+ * flag is removed before calling landlock_add_rule().
+ */
+#define LL_ADD_RULE_SKIP_MISSING (1U << 30)
+
 /**
  * @brief Convenience network connect access group.
  */
@@ -369,7 +432,8 @@ void ll_ruleset_close(ll_ruleset_t *const ruleset);
  * @param ruleset Ruleset handle.
  * @param path Path to the directory to grant access to.
  * @param access_masks Access mask for the path.
- * @param flags Flags passed to landlock_add_rule().
+ * @param flags Flags passed to landlock_add_rule(), plus optionally @ref LL_ADD_RULE_TRIM_DIR_ONLY
+ *              and @ref LL_ADD_RULE_SKIP_MISSING.
  * @return LL_ERROR_OK on success, negative error code on failure.
  *
  * @retval LL_ERROR_OK Success.
@@ -427,7 +491,7 @@ static inline ll_error_t ll_ruleset_add_path_rw(const ll_ruleset_t *const rulese
  * @param ruleset Ruleset handle.
  * @param dir_fd Directory file descriptor (e.g., opened with O_PATH).
  * @param access_masks Access mask for the path.
- * @param flags Flags passed to landlock_add_rule().
+ * @param flags Flags passed to landlock_add_rule(), plus optionally @ref LL_ADD_RULE_TRIM_DIR_ONLY.
  * @return LL_ERROR_OK on success, negative error code on failure.
  *
  * @retval LL_ERROR_OK Success.
@@ -498,4 +562,3016 @@ __attribute__((warn_unused_result)) ll_error_t ll_ruleset_add_net_port(const ll_
  * @retval LL_ERROR_SYSTEM Other system error.
  */
 __attribute__((warn_unused_result)) ll_error_t ll_ruleset_enforce(const ll_ruleset_t *const ruleset,
-                                                                  const __u32 flags);
\ No newline at end of file
+                                                                  const __u32 flags);
+
+/**
+ * @brief Audit record type of a Landlock access denial (AUDIT_LANDLOCK_ACCESS).
+ */
+#define LL_AUDIT_LANDLOCK_ACCESS 1423
+
+/**
+ * @brief Audit record type of a Landlock domain status change (AUDIT_LANDLOCK_DOMAIN).
+ */
+#define LL_AUDIT_LANDLOCK_DOMAIN 1424
+
+/**
+ * @brief Opaque Landlock audit record reader.
+ */
+typedef struct ll_audit_reader ll_audit_reader_t;
+
+/**
+ * @brief Parsed Landlock audit record.
+ *
+ * String members point into the reader's ring buffer and are only valid for
+ * the duration of the callback that received the record.
+ */
+typedef struct
+{
+    /**
+     * @brief LL_AUDIT_LANDLOCK_ACCESS or LL_AUDIT_LANDLOCK_DOMAIN.
+     */
+    int type;
+    /**
+     * @brief Event time in milliseconds since the epoch.
+     */
+    __u64 timestamp_ms;
+    /**
+     * @brief Audit event serial number.
+     */
+    __u64 serial;
+    /**
+     * @brief Landlock domain ID.
+     */
+    __u64 domain;
+    /**
+     * @brief Denied filesystem access rights (LANDLOCK_ACCESS_FS_*).
+     */
+    __u64 access_fs;
+    /**
+     * @brief Denied network access rights (LANDLOCK_ACCESS_NET_*).
+     */
+    __u64 access_net;
+    /**
+     * @brief Denied scopes (LANDLOCK_SCOPE_*).
+     */
+    __u64 access_scope;
+    /**
+     * @brief Raw comma-separated blockers list, or NULL.
+     */
+    const char *blockers;
+    /**
+     * @brief Decoded object path, or NULL.
+     */
+    const char *path;
+    /**
+     * @brief TCP port of a network denial, or 0.
+     */
+    __u64 port;
+    /**
+     * @brief Domain status ("allocated" or "deallocated"), or NULL.
+     */
+    const char *status;
+    /**
+     * @brief PID that caused the domain allocation, or 0.
+     */
+    int pid;
+    /**
+     * @brief Total denials reported when a domain is deallocated, or 0.
+     */
+    __u64 denials;
+} ll_audit_record_t;
+
+/**
+ * @brief Aggregated denial counter, keyed by domain, path prefix and access right.
+ */
+typedef struct
+{
+    __u64 domain;
+    /**
+     * @brief Access class of @ref access.
+     */
+    ll_ruleset_access_class_t access_class;
+    /**
+     * @brief Single denied access right.
+     */
+    __u64 access;
+    /**
+     * @brief Path prefix (NUL-terminated, empty for non-filesystem denials).
+     */
+    char prefix[192];
+    /**
+     * @brief TCP port for network denials, 0 otherwise.
+     */
+    __u64 port;
+    __u64 count;
+    __u64 first_ms;
+    __u64 last_ms;
+} ll_audit_summary_entry_t;
+
+/**
+ * @brief Callback invoked for each parsed record.
+ */
+typedef void (*ll_audit_record_cb)(const ll_audit_record_t *record, void *ctx);
+
+/**
+ * @brief Callback invoked with the aggregated denial counters.
+ */
+typedef void (*ll_audit_summary_cb)(const ll_audit_summary_entry_t *entries, size_t count, void *ctx);
+
+/**
+ * @brief Audit reader configuration.
+ */
+typedef struct
+{
+    /**
+     * @brief Number of preallocated receive slots (rounded up to a power of two).
+     */
+    size_t ring_slots;
+    /**
+     * @brief Maximum number of distinct aggregation keys.
+     */
+    size_t aggregate_capacity;
+    /**
+     * @brief Number of leading path components kept in aggregation keys (0 keeps the full path).
+     */
+    unsigned int path_prefix_depth;
+    /**
+     * @brief Requested netlink socket receive buffer size in bytes.
+     */
+    int socket_rcvbuf;
+    /**
+     * @brief Interval between automatic summaries in milliseconds (0 disables them).
+     */
+    unsigned int summary_interval_ms;
+    ll_audit_record_cb on_record;
+    ll_audit_summary_cb on_summary;
+    void *ctx;
+} ll_audit_reader_config_t;
+
+/**
+ * @brief Audit reader counters.
+ */
+typedef struct
+{
+    /**
+     * @brief Messages received from the socket or a fixture.
+     */
+    __u64 received;
+    /**
+     * @brief Landlock records parsed.
+     */
+    __u64 records;
+    /**
+     * @brief Access denial records parsed.
+     */
+    __u64 denials;
+    /**
+     * @brief Non-Landlock or malformed messages skipped.
+     */
+    __u64 skipped;
+    /**
+     * @brief Kernel-side overruns reported by the socket (ENOBUFS).
+     */
+    __u64 overruns;
+    /**
+     * @brief Denials not aggregated because the aggregation table was full.
+     */
+    __u64 aggregate_overflows;
+    /**
+     * @brief Highest number of ring slots pending at once.
+     */
+    __u64 ring_high_water;
+} ll_audit_reader_stats_t;
+
+/**
+ * @brief Default audit reader configuration.
+ */
+static inline ll_audit_reader_config_t ll_audit_reader_config_defaults(void)
+{
+    ll_audit_reader_config_t config = {
+        .ring_slots = 256,
+        .aggregate_capacity = 4096,
+        .path_prefix_depth = 2,
+        .socket_rcvbuf = 8 * 1024 * 1024,
+        .summary_interval_ms = 0,
+        .on_record = NULL,
+        .on_summary = NULL,
+        .ctx = NULL,
+    };
+    return config;
+}
+
+/**
+ * @brief Create an audit reader; all buffers are allocated up front.
+ *
+ * @param config Reader configuration.
+ * @param out_reader Output reader on success.
+ * @return LL_ERROR_OK on success, negative error code on failure.
+ *
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument (e.g., NULL pointer or zero capacity).
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_audit_reader_create(const ll_audit_reader_config_t *const config,
+                                                                      ll_audit_reader_t **const out_reader);
+
+/**
+ * @brief Close and free an audit reader.
+ *
+ * @param reader Reader to close (may be NULL).
+ */
+void ll_audit_reader_close(ll_audit_reader_t *const reader);
+
+/**
+ * @brief Subscribe the reader to the kernel audit multicast group.
+ *
+ * @param reader Reader handle.
+ * @return LL_ERROR_OK on success, negative error code on failure.
+ *
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument.
+ * @retval LL_ERROR_AUDIT_UNAVAILABLE Netlink audit is unavailable or not permitted.
+ * @retval LL_ERROR_SYSTEM Other system error.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_audit_reader_open_netlink(ll_audit_reader_t *const reader);
+
+/**
+ * @brief Get the reader's netlink socket for use with poll/epoll.
+ *
+ * @return Socket FD, or -1 if the reader is not connected.
+ */
+int ll_audit_reader_fd(const ll_audit_reader_t *const reader);
+
+/**
+ * @brief Drain pending netlink messages into the ring and process them.
+ *
+ * @param reader Reader handle.
+ * @param timeout_ms Time to wait for the first message (-1 blocks, 0 does not wait).
+ * @param out_count Optional output number of messages processed.
+ * @return LL_ERROR_OK on success, negative error code on failure.
+ *
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument (e.g., reader not connected).
+ * @retval LL_ERROR_SYSTEM Socket error.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_audit_reader_poll(ll_audit_reader_t *const reader,
+                                                                    const int timeout_ms,
+                                                                    size_t *const out_count);
+
+/**
+ * @brief Process one audit message.
+ *
+ * Accepts either a raw netlink payload ("audit(...): domain=...") with its
+ * record type, or an audit.log line ("type=LANDLOCK_ACCESS msg=audit(...): ...")
+ * with @p type set to 0.
+ *
+ * @param reader Reader handle.
+ * @param type Audit record type (within the audit message range, 1000 to 2999), or 0 to read it from the line.
+ * @param text Message text (need not be NUL-terminated).
+ * @param len Length of @p text in bytes.
+ * @return LL_ERROR_OK on success, negative error code on failure.
+ *
+ * @retval LL_ERROR_OK Success (including skipped non-Landlock messages).
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument, including a negative or out-of-range @p type.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_audit_reader_feed(ll_audit_reader_t *const reader,
+                                                                    const int type,
+                                                                    const char *const text,
+                                                                    const size_t len);
+
+/**
+ * @brief Replay a recorded audit log (audit.log format) from a file.
+ *
+ * @param reader Reader handle.
+ * @param path Path of the recorded log.
+ * @return LL_ERROR_OK on success, negative error code on failure.
+ *
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument.
+ * @retval LL_ERROR_SYSTEM The file could not be read.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_audit_reader_replay_file(ll_audit_reader_t *const reader,
+                                                                           const char *const path);
+
+/**
+ * @brief Report the aggregated counters to the summary callback and reset them.
+ *
+ * @param reader Reader handle.
+ * @param cb Callback (NULL uses the configured one).
+ * @param ctx Callback context (ignored when @p cb is NULL).
+ */
+void ll_audit_reader_summarize(ll_audit_reader_t *const reader, ll_audit_summary_cb cb, void *ctx);
+
+/**
+ * @brief Get the reader counters.
+ */
+ll_audit_reader_stats_t ll_audit_reader_stats(const ll_audit_reader_t *const reader);
+
+/**
+ * @brief Path-beneath rule description used by the batch APIs.
+ */
+typedef struct
+{
+    const char *path;
+    __u64 access;
+} ll_path_rule_t;
+
+/**
+ * @brief Network port rule description used by the batch APIs.
+ */
+typedef struct
+{
+    __u64 port;
+    __u64 access;
+} ll_port_rule_t;
+
+/**
+ * @brief Add several path-beneath rules to a ruleset.
+ *
+ * In best-effort mode each rule's access is first masked to the access rights
+ * the ruleset handles (after ABI downgrade), and rules left empty are skipped.
+ * In strict mode rules are passed to the kernel unchanged.
+ *
+ * @param ruleset Ruleset handle.
+ * @param rules Rules to add.
+ * @param count Number of rules.
+ * @param flags Flags passed to landlock_add_rule(), plus optionally @ref LL_ADD_RULE_TRIM_DIR_ONLY
+ *              and @ref LL_ADD_RULE_SKIP_MISSING.
+ * @param out_failed Optional output index of the failing rule on error.
+ * @return LL_ERROR_OK on success, or the error of the first failing rule (see @ref ll_ruleset_add_path).
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_ruleset_add_paths(const ll_ruleset_t *const ruleset,
+                                                                    const ll_path_rule_t *const rules,
+                                                                    const size_t count,
+                                                                    const __u32 flags,
+                                                                    size_t *const out_failed);
+
+/**
+ * @brief Add several path-beneath rules, dropping directory-only rights on non-directories.
+ *
+ * Behaves like @ref ll_ruleset_add_paths with @ref LL_ADD_RULE_TRIM_DIR_ONLY,
+ * and reports what was dropped, so every rule costs at most one kernel call
+ * that does not fail for lack of a directory.
+ *
+ * @param ruleset Ruleset handle.
+ * @param rules Rules to add.
+ * @param count Number of rules.
+ * @param flags Flags passed to landlock_add_rule().
+ * @param out_trimmed Optional per-rule output of the rights dropped (0 when none); entries after a failing rule are left untouched.
+ * @param out_failed Optional output index of the failing rule on error.
+ * @return LL_ERROR_OK on success, or the error of the first failing rule (see @ref ll_ruleset_add_path).
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_ruleset_add_paths_trimmed(const ll_ruleset_t *const ruleset,
+                                                                            const ll_path_rule_t *const rules,
+                                                                            const size_t count,
+                                                                            const __u32 flags,
+                                                                            __u64 *const out_trimmed,
+                                                                            size_t *const out_failed);
+
+/**
+ * @brief Opaque in-memory policy: handled access masks plus path and port rules.
+ *
+ * Policies have a line-based text form:
+ *
+ *     # comment
+ *     handle fs.read_file,fs.read_dir,net.connect_tcp
+ *     path fs.read_file,fs.read_dir /usr/share
+ *     port net.connect_tcp 443
+ *
+ * Access rights use the names of the kernel audit "blockers" field.
+ */
+typedef struct ll_policy ll_policy_t;
+
+/**
+ * @brief Create an empty policy.
+ *
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT NULL output pointer.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_policy_create(ll_policy_t **const out_policy);
+
+/**
+ * @brief Free a policy (may be NULL).
+ */
+void ll_policy_free(ll_policy_t *const policy);
+
+/**
+ * @brief Add access rights to the policy's handled masks.
+ */
+ll_error_t ll_policy_handle(ll_policy_t *const policy,
+                            const __u64 fs_mask,
+                            const __u64 net_mask,
+                            const __u64 scope_mask);
+
+/**
+ * @brief Add a path rule; access for an existing identical path is merged.
+ *
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument (e.g., NULL or empty path).
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_policy_add_path(ll_policy_t *const policy,
+                                                                  const char *const path,
+                                                                  const __u64 access);
+
+/**
+ * @brief Add a network port rule; access for an existing identical port is merged.
+ *
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument.
+ * @retval LL_ERROR_ADD_RULE_PORT_OUT_OF_RANGE Port is greater than 65535.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_policy_add_net_port(ll_policy_t *const policy,
+                                                                      const __u64 port,
+                                                                      const __u64 access);
+
+/**
+ * @brief Get the policy's path rules.
+ */
+const ll_path_rule_t *ll_policy_paths(const ll_policy_t *const policy, size_t *const out_count);
+
+/**
+ * @brief Get the policy's network port rules.
+ */
+const ll_port_rule_t *ll_policy_ports(const ll_policy_t *const policy, size_t *const out_count);
+
+/**
+ * @brief Return @p attr with the policy's handled access masks.
+ */
+ll_ruleset_attr_t ll_policy_attr(const ll_policy_t *const policy, ll_ruleset_attr_t attr);
+
+/**
+ * @brief Parse policy text and add its contents to @p policy.
+ *
+ * @param policy Policy to extend.
+ * @param text Policy text (need not be NUL-terminated).
+ * @param len Length of @p text.
+ * @param out_line Optional output line number of the first error.
+ * @return LL_ERROR_OK on success, negative error code on failure.
+ *
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument.
+ * @retval LL_ERROR_POLICY_SYNTAX Unknown directive or access name.
+ * @retval LL_ERROR_ADD_RULE_PORT_OUT_OF_RANGE Port is greater than 65535.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_policy_parse(ll_policy_t *const policy,
+                                                               const char *const text,
+                                                               const size_t len,
+                                                               size_t *const out_line);
+
+/**
+ * @brief Parse a policy file and add its contents to @p policy.
+ *
+ * @retval LL_ERROR_SYSTEM The file could not be read.
+ * @see ll_policy_parse
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_policy_load_file(ll_policy_t *const policy,
+                                                                   const char *const path,
+                                                                   size_t *const out_line);
+
+/**
+ * @brief Render a policy in its text form.
+ *
+ * @return Newly allocated NUL-terminated string to release with free(), or NULL on allocation failure.
+ */
+char *ll_policy_format(const ll_policy_t *const policy);
+
+/**
+ * @brief Add the policy's rules to an existing ruleset through the batch path.
+ *
+ * @param out_failed Optional output index of the failing rule (path rules first, then ports).
+ * @see ll_ruleset_add_paths
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_policy_apply(const ll_policy_t *const policy,
+                                                               const ll_ruleset_t *const ruleset,
+                                                               size_t *const out_failed);
+
+/**
+ * @brief Create a ruleset handling the policy's access masks and populated with its rules.
+ *
+ * @param policy Policy.
+ * @param attr ABI, compatibility mode and flags to use; its access masks are replaced by the policy's.
+ * @see ll_ruleset_create_result
+ * @see ll_policy_apply
+ */
+__attribute__((warn_unused_result)) ll_ruleset_result_t ll_policy_create_ruleset(const ll_policy_t *const policy,
+                                                                                 const ll_ruleset_attr_t attr);
+
+/**
+ * @brief Opaque policy learner that derives rules from observed denials.
+ */
+typedef struct ll_learner ll_learner_t;
+
+/**
+ * @brief Options for learning runs and policy minimisation.
+ */
+typedef struct
+{
+    /**
+     * @brief Maximum number of workload runs.
+     */
+    unsigned int max_iterations;
+    /**
+     * @brief Time to keep draining audit records after the workload exits.
+     */
+    unsigned int settle_ms;
+    /**
+     * @brief Replace this many or more file rules in one directory by a directory rule (0 disables).
+     */
+    unsigned int collapse_threshold;
+} ll_learn_options_t;
+
+/**
+ * @brief Outcome of a learning run.
+ */
+typedef struct
+{
+    unsigned int iterations;
+    /**
+     * @brief Denial records attributed to the workload.
+     */
+    __u64 denials;
+    /**
+     * @brief Denials that no rule can allow (e.g., scopes).
+     */
+    __u64 unresolved;
+    /**
+     * @brief Non-zero if the last run produced no new denials.
+     */
+    int clean;
+    /**
+     * @brief waitpid() status of the last workload run.
+     */
+    int exit_status;
+} ll_learn_report_t;
+
+/**
+ * @brief Default learning options.
+ */
+static inline ll_learn_options_t ll_learn_options_defaults(void)
+{
+    ll_learn_options_t options = {.max_iterations = 8, .settle_ms = 200, .collapse_threshold = 0};
+    return options;
+}
+
+/**
+ * @brief Create a learner.
+ *
+ * @param attr Attributes of the rulesets to learn; the handled masks set which denials are collected.
+ * @param out_learner Output learner on success.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_learner_create(const ll_ruleset_attr_t attr,
+                                                                 ll_learner_t **const out_learner);
+
+/**
+ * @brief Free a learner (may be NULL).
+ */
+void ll_learner_free(ll_learner_t *const learner);
+
+/**
+ * @brief Record one audit record; usable as an @ref ll_audit_record_cb with the learner as context.
+ */
+void ll_learner_record_cb(const ll_audit_record_t *record, void *learner);
+
+/**
+ * @brief Learn from a recorded audit log (audit.log format).
+ *
+ * @see ll_audit_reader_replay_file
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_learner_ingest_file(ll_learner_t *const learner,
+                                                                      const char *const path);
+
+/**
+ * @brief Run a workload repeatedly under the learned ruleset until it produces no new denials.
+ *
+ * Each run forks, enforces the rules learned so far with
+ * LANDLOCK_RESTRICT_SELF_LOG_NEW_EXEC_ON and executes @p argv, so a denied
+ * execve() of the workload itself is learned like any other denial. A run
+ * whose workload could not be executed is never clean. Denials are read from
+ * the audit multicast group, which requires CAP_AUDIT_READ and audit to be
+ * enabled.
+ *
+ * @param learner Learner.
+ * @param argv NULL-terminated workload command line (argv[0] is looked up in PATH).
+ * @param options Options (NULL uses the defaults).
+ * @param out_report Optional output report.
+ * @return LL_ERROR_OK on success, negative error code on failure.
+ *
+ * @retval LL_ERROR_OK Success (check @ref ll_learn_report_t::clean).
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument.
+ * @retval LL_ERROR_AUDIT_UNAVAILABLE Audit records cannot be read.
+ * @retval LL_ERROR_SYSTEM fork failed, the ruleset could not be enforced, or exec failed without a new denial to learn.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_learner_run(ll_learner_t *const learner,
+                                                              char *const argv[],
+                                                              const ll_learn_options_t *const options,
+                                                              ll_learn_report_t *const out_report);
+
+/**
+ * @brief Emit a minimised policy from the learned denials.
+ *
+ * Rules covered by an ancestor rule with a superset of rights are dropped.
+ *
+ * @param learner Learner.
+ * @param options Options (NULL uses the defaults).
+ * @param out_policy Output policy on success, to release with @ref ll_policy_free.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_learner_emit(const ll_learner_t *const learner,
+                                                               const ll_learn_options_t *const options,
+                                                               ll_policy_t **const out_policy);
+
+/**
+ * @brief Opaque userspace model of stacked rulesets for "would this be allowed" queries.
+ *
+ * Paths are matched lexically: queries and rules must be absolute, and
+ * symlinks, bind mounts and ".." are not resolved. Query paths containing ".."
+ * are rejected.
+ */
+typedef struct ll_evaluator ll_evaluator_t;
+
+/**
+ * @brief Maximum number of layers an evaluator models (the kernel limit).
+ */
+#define LL_EVALUATOR_MAX_LAYERS 64
+
+/**
+ * @brief Create an evaluator with no layers (everything is allowed).
+ *
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT NULL output pointer.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_evaluator_create(ll_evaluator_t **const out_evaluator);
+
+/**
+ * @brief Free an evaluator (may be NULL).
+ */
+void ll_evaluator_free(ll_evaluator_t *const evaluator);
+
+/**
+ * @brief Start a new layer handling the same access rights as @p ruleset.
+ *
+ * Subsequent rules are added to this layer.
+ *
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument.
+ * @retval LL_ERROR_RESTRICT_LIMIT_REACHED The evaluator already models LL_EVALUATOR_MAX_LAYERS layers.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_evaluator_push_layer(ll_evaluator_t *const evaluator,
+                                                                       const ll_ruleset_t *const ruleset);
+
+/**
+ * @brief Start a new layer with explicit handled access masks.
+ *
+ * @see ll_evaluator_push_layer
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_evaluator_push_layer_masks(ll_evaluator_t *const evaluator,
+                                                                             const __u64 fs_mask,
+                                                                             const __u64 net_mask,
+                                                                             const __u64 scope_mask);
+
+/**
+ * @brief Start a new layer from a policy's handled masks and rules.
+ *
+ * The layer is only kept if every rule could be added; on error the
+ * evaluator is left as it was before the call.
+ *
+ * @see ll_evaluator_push_layer
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_evaluator_push_policy(ll_evaluator_t *const evaluator,
+                                                                        const ll_policy_t *const policy);
+
+/**
+ * @brief Mirror @ref ll_ruleset_add_path on the top layer.
+ *
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument (e.g., no layer or relative path).
+ * @retval LL_ERROR_ADD_RULE_INCONSISTENT_ACCESS Access not covered by the layer's handled accesses.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_evaluator_add_path(ll_evaluator_t *const evaluator,
+                                                                     const char *const path,
+                                                                     const __u64 access_masks);
+
+/**
+ * @brief Mirror @ref ll_ruleset_add_net_port on the top layer.
+ *
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument (e.g., no layer).
+ * @retval LL_ERROR_ADD_RULE_PORT_OUT_OF_RANGE Port is greater than 65535.
+ * @retval LL_ERROR_ADD_RULE_INCONSISTENT_ACCESS Access not covered by the layer's handled accesses.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_evaluator_add_net_port(ll_evaluator_t *const evaluator,
+                                                                         const __u64 port,
+                                                                         const __u64 access_masks);
+
+/**
+ * @brief Check whether filesystem access to @p path would be allowed by every layer.
+ *
+ * @return 1 if allowed, 0 if denied, or a negative @ref ll_error_t for an invalid query.
+ */
+int ll_evaluator_check_path(const ll_evaluator_t *const evaluator, const char *const path, const __u64 access);
+
+/**
+ * @brief Check whether network access to @p port would be allowed by every layer.
+ *
+ * @return 1 if allowed, 0 if denied, or a negative @ref ll_error_t for an invalid query.
+ */
+int ll_evaluator_check_net_port(const ll_evaluator_t *const evaluator, const __u64 port, const __u64 access);
+
+/**
+ * @brief Opaque set of TCP ports, stored as one 65536-bit bitmap per network access right.
+ */
+typedef struct ll_portset ll_portset_t;
+
+/**
+ * @brief Create an empty port set.
+ *
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT NULL output pointer.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_portset_create(ll_portset_t **const out_set);
+
+/**
+ * @brief Free a port set (may be NULL).
+ */
+void ll_portset_free(ll_portset_t *const set);
+
+/**
+ * @brief Allow @p access on every port in [@p first, @p last].
+ *
+ * The set is left unchanged on error.
+ *
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument (e.g., @p first > @p last or non-network access).
+ * @retval LL_ERROR_ADD_RULE_PORT_OUT_OF_RANGE A port is greater than 65535.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_portset_add_range(ll_portset_t *const set,
+                                                                    const __u64 first,
+                                                                    const __u64 last,
+                                                                    const __u64 access);
+
+/**
+ * @brief Allow @p access on each listed port.
+ *
+ * All ports are validated before any is added.
+ *
+ * @param out_invalid Optional output index of the first out-of-range port.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument.
+ * @retval LL_ERROR_ADD_RULE_PORT_OUT_OF_RANGE A port is greater than 65535.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_portset_add_list(ll_portset_t *const set,
+                                                                   const __u64 *const ports,
+                                                                   const size_t count,
+                                                                   const __u64 access,
+                                                                   size_t *const out_invalid);
+
+/**
+ * @brief Allow @p access on the TCP port of a service from the services database (e.g., "https").
+ *
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument or unknown service.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_portset_add_service(ll_portset_t *const set,
+                                                                      const char *const name,
+                                                                      const __u64 access);
+
+/**
+ * @brief Parse and add a port specification such as "https,8080,32768-60999".
+ *
+ * Items are comma-separated ports, inclusive ranges or service names. The
+ * whole specification is validated before anything is added.
+ *
+ * @param out_offset Optional output byte offset of the first invalid item.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument, malformed item or unknown service.
+ * @retval LL_ERROR_ADD_RULE_PORT_OUT_OF_RANGE A port is greater than 65535.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_portset_parse(ll_portset_t *const set,
+                                                                const char *const spec,
+                                                                const __u64 access,
+                                                                size_t *const out_offset);
+
+/**
+ * @brief Get the network access rights allowed on @p port (0 if none or out of range).
+ */
+__u64 ll_portset_access(const ll_portset_t *const set, const __u64 port);
+
+/**
+ * @brief Count the ports with at least one allowed access right.
+ */
+size_t ll_portset_count(const ll_portset_t *const set);
+
+/**
+ * @brief Add the port set to a ruleset, one LANDLOCK_RULE_NET_PORT rule per port.
+ *
+ * The kernel has no range rules, so each port carrying any right costs one
+ * rule; rights on the same port are combined into a single rule. In
+ * best-effort mode rights the ruleset does not handle are dropped first.
+ *
+ * @param ruleset Ruleset handle.
+ * @param set Port set.
+ * @param flags Flags passed to landlock_add_rule().
+ * @param out_rules Optional output number of rules added.
+ * @return LL_ERROR_OK on success, or the error of the first failing rule (see @ref ll_ruleset_add_net_port).
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_ruleset_add_portset(const ll_ruleset_t *const ruleset,
+                                                                      const ll_portset_t *const set,
+                                                                      const __u32 flags,
+                                                                      size_t *const out_rules);
+
+/**
+ * @brief Mirror @ref ll_ruleset_add_portset on the evaluator's top layer.
+ *
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument (e.g., no layer).
+ * @retval LL_ERROR_ADD_RULE_INCONSISTENT_ACCESS Access not covered by the layer's handled accesses.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_evaluator_add_portset(ll_evaluator_t *const evaluator,
+                                                                        const ll_portset_t *const set);
+
+/**
+ * @brief Maximum number of stacked Landlock layers per thread (kernel limit).
+ */
+#define LL_MAX_LAYERS 64
+
+/**
+ * @brief Layer accounting for the calling process.
+ */
+typedef struct
+{
+    /**
+     * @brief Layers inherited across execve(), from the LIBLANDLOCK_LAYERS environment variable at startup.
+     */
+    unsigned int inherited;
+    /**
+     * @brief Layers applied through @ref ll_ruleset_enforce by this process (and its parents before fork), on any thread.
+     */
+    unsigned int applied;
+    /**
+     * @brief inherited + applied.
+     */
+    unsigned int total;
+    /**
+     * @brief Layers left before LL_ERROR_RESTRICT_LIMIT_REACHED.
+     */
+    unsigned int remaining;
+} ll_layer_report_t;
+
+/**
+ * @brief Report how many Landlock layers the process is carrying.
+ *
+ * Layers applied in this process are counted by @ref ll_ruleset_enforce;
+ * programs executed afterwards only inherit the count if @ref ll_layer_export
+ * was called first. Layers applied without this library, or lost by
+ * replacing the environment on exec, are not seen.
+ *
+ * The count is kept per process, while the kernel's LL_MAX_LAYERS limit
+ * applies to each thread's own domain. It is only accurate when every
+ * enforcement happens on one thread and other threads are created after it,
+ * or not at all; with several threads enforcing, each thread carries fewer
+ * layers than reported.
+ */
+ll_layer_report_t ll_layer_report(void);
+
+/**
+ * @brief Write the current layer total to the LIBLANDLOCK_LAYERS environment variable.
+ *
+ * Enforcing never modifies the environment, since setenv() is not
+ * thread-safe and allocates. Call this before executing another program
+ * that should account for the layers applied here.
+ */
+void ll_layer_export(void);
+
+/**
+ * @brief Merge pending restriction steps into one policy.
+ *
+ * The merged policy, enforced as a single layer, allows exactly what
+ * enforcing each step in turn would allow, assuming canonical paths (no
+ * symlinks or bind-mount aliases). When steps handle scopes the merged layer
+ * is stricter than stacking them, and @p out_exact is set to 0.
+ *
+ * @param steps Policies in enforcement order.
+ * @param count Number of steps.
+ * @param out_policy Output merged policy, to release with @ref ll_policy_free.
+ * @param out_exact Optional output: non-zero if the merge preserves stacking semantics exactly.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_policy_merge(const ll_policy_t *const *const steps,
+                                                               const size_t count,
+                                                               ll_policy_t **const out_policy,
+                                                               int *const out_exact);
+
+/**
+ * @brief Enforce pending restriction steps, as a single layer when the merge is exact.
+ *
+ * All rulesets are built before any is enforced. Steps that cannot be merged
+ * exactly are enforced one layer each.
+ *
+ * @param steps Policies in enforcement order.
+ * @param count Number of steps.
+ * @param attr ABI, compatibility mode and creation flags for the rulesets.
+ * @param flags Flags passed to landlock_restrict_self().
+ * @param out_layers Optional output number of layers enforced.
+ * @return LL_ERROR_OK or LL_ERROR_OK_PARTIAL_SANDBOX on success, negative error code on failure.
+ * @see ll_policy_create_ruleset
+ * @see ll_ruleset_enforce
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_policy_enforce_stack(const ll_policy_t *const *const steps,
+                                                                       const size_t count,
+                                                                       const ll_ruleset_attr_t attr,
+                                                                       const __u32 flags,
+                                                                       unsigned int *const out_layers);
+
+/**
+ * @brief Opaque phased sandbox handle.
+ */
+typedef struct ll_phases ll_phases_t;
+
+/**
+ * @brief Warnings reported by @ref ll_phases_add.
+ */
+typedef enum
+{
+    /**
+     * @brief The phase grants access that earlier phases already deny; that part has no effect.
+     */
+    LL_PHASE_WARN_NOT_SUBSET = 1 << 0,
+    /**
+     * @brief The phase denies nothing that earlier phases allow, so it only uses up a layer.
+     */
+    LL_PHASE_WARN_NO_EFFECT = 1 << 1,
+    /**
+     * @brief Entering every phase would exceed the remaining layer budget (see @ref ll_layer_report).
+     */
+    LL_PHASE_WARN_LAYER_BUDGET = 1 << 2,
+} ll_phase_warning_t;
+
+/**
+ * @brief Create a phased sandbox.
+ *
+ * Phases are added at startup with @ref ll_phases_add, which builds each
+ * ruleset immediately. @ref ll_phases_seal then sets no_new_privs, after which
+ * each @ref ll_phases_advance is a single landlock_restrict_self() call with
+ * no allocation or path resolution.
+ *
+ * @param attr ABI, compatibility mode and creation flags for every phase ruleset.
+ * @param flags Flags passed to landlock_restrict_self() on every transition.
+ * @param out_phases Output phased sandbox handle.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_phases_create(const ll_ruleset_attr_t attr,
+                                                                const __u32 flags,
+                                                                ll_phases_t **const out_phases);
+
+/**
+ * @brief Release a phased sandbox. Phases already entered stay enforced.
+ *
+ * @param phases Phased sandbox handle (may be NULL).
+ */
+void ll_phases_free(ll_phases_t *const phases);
+
+/**
+ * @brief Build the ruleset for the next phase.
+ *
+ * The phase is compared with everything added before it (assuming canonical
+ * paths), and problems are reported as @ref ll_phase_warning_t bits. Warnings
+ * do not prevent the phase from being added.
+ *
+ * @param phases Phased sandbox handle, not yet sealed.
+ * @param policy Policy for the phase.
+ * @param out_warnings Optional output bitmask of @ref ll_phase_warning_t.
+ * @return LL_ERROR_OK or LL_ERROR_OK_PARTIAL_SANDBOX on success, negative error code on failure.
+ * @see ll_policy_create_ruleset
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_phases_add(ll_phases_t *const phases,
+                                                             const ll_policy_t *const policy,
+                                                             unsigned int *const out_warnings);
+
+/**
+ * @brief Finish setup: validate the restrict flags and set no_new_privs.
+ *
+ * @param phases Phased sandbox handle with at least one phase.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument or no phases.
+ * @retval LL_ERROR_RESTRICT_FLAGS_INVALID Unknown flags set.
+ * @retval LL_ERROR_RESTRICT_PARTIAL_SANDBOX_STRICT Requested flags not supported in strict mode.
+ * @retval LL_ERROR_SYSTEM prctl() failed.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_phases_seal(ll_phases_t *const phases);
+
+/**
+ * @brief Enter the next phase.
+ *
+ * @param phases Sealed phased sandbox handle.
+ * @return LL_ERROR_OK on success, negative error code on failure.
+ * @retval LL_ERROR_INVALID_ARGUMENT Not sealed, or every phase was already entered.
+ * @see ll_ruleset_enforce for the landlock_restrict_self() error codes.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_phases_advance(ll_phases_t *const phases);
+
+/**
+ * @brief Number of phases entered so far.
+ */
+size_t ll_phases_current(const ll_phases_t *const phases);
+
+/**
+ * @brief Number of phases added.
+ */
+size_t ll_phases_count(const ll_phases_t *const phases);
+
+/**
+ * @brief Description of a ruleset, as needed to enforce it.
+ */
+typedef struct
+{
+    /**
+     * @brief Effective ABI the ruleset was created for.
+     */
+    ll_abi_t abi;
+    /**
+     * @brief Compatibility mode the ruleset was created with.
+     */
+    ll_abi_compat_mode_t compat_mode;
+    /**
+     * @brief Handled filesystem access mask.
+     */
+    __u64 handled_access_fs;
+    /**
+     * @brief Handled network access mask.
+     */
+    __u64 handled_access_net;
+    /**
+     * @brief Handled scope mask.
+     */
+    __u64 handled_access_scope;
+} ll_ruleset_info_t;
+
+/**
+ * @brief Describe a ruleset.
+ *
+ * @param ruleset Ruleset handle.
+ * @param out_info Output description.
+ * @return File descriptor of the ruleset (still owned by @p ruleset), or -1 if @p ruleset is NULL.
+ */
+int ll_ruleset_info(const ll_ruleset_t *const ruleset, ll_ruleset_info_t *const out_info);
+
+/**
+ * @brief Wrap an existing Landlock ruleset file descriptor.
+ *
+ * The descriptor must refer to a Landlock ruleset; ownership passes to the
+ * returned handle on success.
+ *
+ * @param ruleset_fd Ruleset file descriptor, e.g. received from another process.
+ * @param info ABI, compatibility mode and handled masks of the ruleset.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument, or the descriptor is not a Landlock ruleset.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ */
+__attribute__((warn_unused_result)) ll_ruleset_result_t ll_ruleset_from_fd(const int ruleset_fd,
+                                                                           const ll_ruleset_info_t info);
+
+/**
+ * @brief Journal of resolved base rules, replayed into derived rulesets.
+ *
+ * A journal owns a base ruleset together with the O_PATH descriptor and
+ * access rights of every path rule added to it, and the port rules. Each
+ * @ref ll_ruleset_derive creates a fresh ruleset with the base's handled
+ * access and replays the journal with add_rule() alone, so the base's
+ * paths are never looked up again; only the per-ruleset delta is resolved.
+ *
+ * Several threads may derive from one journal concurrently, provided no
+ * rule is added to it meanwhile.
+ */
+typedef struct ll_ruleset_journal ll_ruleset_journal_t;
+
+/**
+ * @brief Opaque ruleset broker handle.
+ */
+typedef struct ll_broker ll_broker_t;
+
+/**
+ * @brief Maximum length of a broker ruleset name.
+ */
+#define LL_BROKER_NAME_MAX 255
+
+/**
+ * @brief Create a ruleset broker.
+ *
+ * A broker keeps journals of resolved rules under names (for example a
+ * policy name or a hash of the policy) and hands rulesets to clients over a
+ * Unix SOCK_SEQPACKET socket with SCM_RIGHTS, so that a client's setup is one
+ * request and one recvmsg().
+ *
+ * Trust model: the broker runs unsandboxed and serves only peers whose user,
+ * as reported by SO_PEERCRED, is the broker's effective user or was allowed
+ * with @ref ll_broker_allow_uid. A ruleset descriptor is writable, so each
+ * connection gets its own ruleset derived from the journal (see
+ * @ref ll_ruleset_derive): rules a client adds to its copy cannot reach
+ * other clients. The derived ruleset is kept with the connection and handed
+ * out again for later requests of the same name until @ref ll_broker_add
+ * replaces the journal, so repeated requests do not replay every rule, and
+ * rules a client added are seen by its own later requests on that
+ * connection. A client can always widen its own ruleset before
+ * enforcing it, so the broker saves clients work but does not constrain
+ * them; whatever must hold has to be enforced by the client's trusted code.
+ *
+ * @param out_broker Output broker handle.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_broker_create(ll_broker_t **const out_broker);
+
+/**
+ * @brief Close the listening socket and client connections, and release the rulesets.
+ *
+ * @param broker Broker handle (may be NULL).
+ */
+void ll_broker_free(ll_broker_t *const broker);
+
+/**
+ * @brief Publish the rules of a journal under @p name, replacing any previous ones.
+ *
+ * @param broker Broker handle.
+ * @param name Ruleset name, at most LL_BROKER_NAME_MAX bytes.
+ * @param journal Journal the clients' rulesets are derived from; the broker takes ownership on success.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_broker_add(ll_broker_t *const broker,
+                                                             const char *const name,
+                                                             ll_ruleset_journal_t *const journal);
+
+/**
+ * @brief Serve peers running as @p uid in addition to the broker's effective user.
+ *
+ * @param broker Broker handle.
+ * @param uid User to allow.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_broker_allow_uid(ll_broker_t *const broker, const __u32 uid);
+
+/**
+ * @brief Listen for clients on a Unix socket path.
+ *
+ * The path must not exist yet.
+ *
+ * @param broker Broker handle.
+ * @param path Socket path.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument, path too long, or already listening.
+ * @retval LL_ERROR_SYSTEM socket(), bind() or listen() failed.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_broker_listen(ll_broker_t *const broker, const char *const path);
+
+/**
+ * @brief Listening socket file descriptor, for integration in an event loop.
+ *
+ * @param broker Broker handle.
+ * @return File descriptor, or -1 when not listening.
+ */
+int ll_broker_fd(const ll_broker_t *const broker);
+
+/**
+ * @brief Wait for clients and answer pending requests.
+ *
+ * Accepts new connections, answers one request per readable connection and
+ * drops connections closed by their peer or not taking their reply within a
+ * second. A connection woken without a pending request (EAGAIN) is kept.
+ *
+ * @param broker Listening broker handle.
+ * @param timeout_ms poll() timeout in milliseconds (-1 blocks).
+ * @param out_served Optional output number of requests answered.
+ * @retval LL_ERROR_OK Success (including timeout).
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument or not listening.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ * @retval LL_ERROR_SYSTEM poll() failed.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_broker_poll(ll_broker_t *const broker,
+                                                              const int timeout_ms,
+                                                              size_t *const out_served);
+
+/**
+ * @brief Answer one request on an already connected socket.
+ *
+ * Rulesets are derived again for every request unless @p conn_fd is one of
+ * the connections accepted by @ref ll_broker_poll, which reuse theirs.
+ *
+ * @param broker Broker handle.
+ * @param conn_fd Connected SOCK_SEQPACKET socket (e.g. one end of a socketpair()).
+ * @return 1 if a request was answered, 0 if the peer closed the connection, negative ll_error_t on failure
+ *         (LL_ERROR_SYSTEM with errno EAGAIN when a non-blocking @p conn_fd has no pending request).
+ */
+int ll_broker_serve_fd(ll_broker_t *const broker, const int conn_fd);
+
+/**
+ * @brief Connect to a ruleset broker.
+ *
+ * @param path Socket path the broker listens on.
+ * @param out_fd Output connected socket, close-on-exec.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument or path too long.
+ * @retval LL_ERROR_SYSTEM socket() or connect() failed.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_broker_connect(const char *const path, int *const out_fd);
+
+/**
+ * @brief Fetch a ruleset from a broker.
+ *
+ * The returned ruleset is ready for @ref ll_ruleset_enforce; as with
+ * @ref ll_ruleset_create_result, it must be closed with @ref ll_ruleset_close.
+ *
+ * @param conn_fd Socket connected to the broker.
+ * @param name Ruleset name.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument.
+ * @retval LL_ERROR_BROKER_NOT_FOUND No ruleset under @p name.
+ * @retval LL_ERROR_BROKER_DENIED The broker does not serve this process's user.
+ * @retval LL_ERROR_BROKER_PROTOCOL Malformed reply.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ * @retval LL_ERROR_SYSTEM sendmsg() or recvmsg() failed.
+ */
+__attribute__((warn_unused_result)) ll_ruleset_result_t ll_broker_fetch(const int conn_fd, const char *const name);
+
+/**
+ * @brief Number of request slots in a file-open broker ring.
+ */
+#define LL_OPEN_RING_SLOTS 256
+
+/**
+ * @brief Maximum path length (including the terminating NUL) in a file-open request.
+ */
+#define LL_OPEN_PATH_MAX 4096
+
+/**
+ * @brief Opaque file-open broker (unsandboxed side) handle.
+ */
+typedef struct ll_open_broker ll_open_broker_t;
+
+/**
+ * @brief Opaque file-open worker (sandboxed side) handle.
+ */
+typedef struct ll_open_worker ll_open_worker_t;
+
+/**
+ * @brief Outcome of one file-open request.
+ */
+typedef struct
+{
+    /**
+     * @brief Request identifier returned by @ref ll_open_worker_submit.
+     */
+    unsigned int id;
+    /**
+     * @brief Opened file descriptor (close-on-exec, owned by the caller), or -1.
+     */
+    int fd;
+    /**
+     * @brief 0 on success, otherwise an errno value (EACCES when the policy denies the request).
+     */
+    int error;
+} ll_open_result_t;
+
+/**
+ * @brief Set up the broker end of a connection to a worker.
+ *
+ * The broker creates a shared-memory request ring and sends it to the worker
+ * over @p conn_fd, together with @p worker_ruleset if given. Requests are
+ * checked against @p evaluator: the open flags are mapped to
+ * LANDLOCK_ACCESS_FS_READ_FILE, WRITE_FILE, TRUNCATE, READ_DIR and MAKE_REG,
+ * and paths must be absolute without "..". Symbolic links are not followed
+ * where openat2() is available; otherwise only the last component is
+ * protected (O_NOFOLLOW).
+ *
+ * @param evaluator Policy the requests are checked against; must outlive the broker.
+ * @param worker_ruleset Optional ruleset for the worker to enforce (still owned by the caller).
+ * @param conn_fd Connected SOCK_SEQPACKET socket; the broker takes ownership on success.
+ * @param out_broker Output broker handle.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ * @retval LL_ERROR_SYSTEM memfd_create(), mmap() or sendmsg() failed.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_open_broker_create(const ll_evaluator_t *const evaluator,
+                                                                     const ll_ruleset_t *const worker_ruleset,
+                                                                     const int conn_fd,
+                                                                     ll_open_broker_t **const out_broker);
+
+/**
+ * @brief Release a file-open broker and close its connection.
+ *
+ * @param broker Broker handle (may be NULL).
+ */
+void ll_open_broker_free(ll_open_broker_t *const broker);
+
+/**
+ * @brief Connection file descriptor, for integration in an event loop.
+ */
+int ll_open_broker_fd(const ll_open_broker_t *const broker);
+
+/**
+ * @brief Wait for the worker's next flush and answer every queued request.
+ *
+ * @param broker Broker handle.
+ * @return 1 if a flush was answered, 0 if the worker closed the connection, negative ll_error_t on failure.
+ */
+int ll_open_broker_serve(ll_open_broker_t *const broker);
+
+/**
+ * @brief Set up the worker end of a connection and enforce the broker-provided ruleset.
+ *
+ * @param conn_fd Connected SOCK_SEQPACKET socket; the worker takes ownership on success.
+ * @param restrict_flags Flags passed to landlock_restrict_self() if the broker sent a ruleset.
+ * @param out_worker Output worker handle.
+ * @retval LL_ERROR_OK Success (the ruleset, if any, is enforced).
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument.
+ * @retval LL_ERROR_BROKER_PROTOCOL Malformed handshake.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ * @retval LL_ERROR_SYSTEM recvmsg() or mmap() failed.
+ * @see ll_ruleset_enforce for enforcement errors.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_open_worker_connect(const int conn_fd,
+                                                                      const __u32 restrict_flags,
+                                                                      ll_open_worker_t **const out_worker);
+
+/**
+ * @brief Release a worker and close its connection.
+ *
+ * @param worker Worker handle (may be NULL).
+ */
+void ll_open_worker_free(ll_open_worker_t *const worker);
+
+/**
+ * @brief Queue an open request without contacting the broker.
+ *
+ * @param worker Worker handle.
+ * @param path Absolute path.
+ * @param flags open() flags (O_CLOEXEC is always added).
+ * @param mode File mode for O_CREAT.
+ * @param out_id Optional output request identifier.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument or path too long.
+ * @retval LL_ERROR_OUT_OF_MEMORY The request ring is full; flush first.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_open_worker_submit(ll_open_worker_t *const worker,
+                                                                     const char *const path,
+                                                                     const int flags,
+                                                                     const unsigned int mode,
+                                                                     unsigned int *const out_id);
+
+/**
+ * @brief Number of queued requests not yet flushed.
+ */
+size_t ll_open_worker_pending(const ll_open_worker_t *const worker);
+
+/**
+ * @brief Ask the broker to process every queued request and collect the results.
+ *
+ * One round trip serves the whole queue; descriptors arrive in batches of up
+ * to 253 per message.
+ *
+ * @param worker Worker handle.
+ * @param results Output results, in submission order.
+ * @param capacity Capacity of @p results; must be at least @ref ll_open_worker_pending.
+ * @param out_count Output number of results.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument or @p capacity too small.
+ * @retval LL_ERROR_BROKER_PROTOCOL Malformed reply.
+ * @retval LL_ERROR_SYSTEM sendmsg() or recvmsg() failed.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_open_worker_flush(ll_open_worker_t *const worker,
+                                                                    ll_open_result_t *const results,
+                                                                    const size_t capacity,
+                                                                    size_t *const out_count);
+
+/**
+ * @brief Open one file through the broker (submit and flush).
+ *
+ * @param worker Worker handle.
+ * @param path Absolute path.
+ * @param flags open() flags.
+ * @param mode File mode for O_CREAT.
+ * @return File descriptor, or -1 with errno set.
+ */
+int ll_open_worker_open(ll_open_worker_t *const worker, const char *const path, const int flags, const unsigned int mode);
+
+/**
+ * @brief Plugin entry point, called in the sandboxed helper for each request.
+ *
+ * @param ctx Context pointer from @ref ll_plugin_options_t.
+ * @param in Request bytes.
+ * @param in_len Request length.
+ * @param out Response buffer.
+ * @param out_capacity Response buffer capacity.
+ * @param out_len Output response length (at most @p out_capacity).
+ * @return Status passed back to the caller of @ref ll_plugin_host_call.
+ */
+typedef int (*ll_plugin_fn_t)(void *ctx, const void *in, size_t in_len, void *out, size_t out_capacity, size_t *out_len);
+
+/**
+ * @brief Plugin host options.
+ */
+typedef struct
+{
+    /**
+     * @brief Shared library to dlopen() in the helper after the ruleset is enforced, or NULL to use @ref fn.
+     */
+    const char *library;
+    /**
+     * @brief Symbol with the @ref ll_plugin_fn_t signature in @ref library.
+     */
+    const char *symbol;
+    /**
+     * @brief Entry point used when @ref library is NULL (already linked into the process).
+     */
+    ll_plugin_fn_t fn;
+    /**
+     * @brief Context passed to the entry point.
+     */
+    void *ctx;
+    /**
+     * @brief Size of each of the request and response buffers.
+     */
+    size_t buffer_size;
+    /**
+     * @brief Polls of the shared sequence number before sleeping on a futex (ignored on single-CPU systems).
+     */
+    unsigned int spin_iterations;
+    /**
+     * @brief Flags passed to landlock_restrict_self() in the helper.
+     */
+    __u32 restrict_flags;
+} ll_plugin_options_t;
+
+/**
+ * @brief Default plugin host options (64 KiB buffers, 2000 spins).
+ */
+static inline ll_plugin_options_t ll_plugin_options_defaults(void)
+{
+    ll_plugin_options_t options;
+    options.library = NULL;
+    options.symbol = NULL;
+    options.fn = NULL;
+    options.ctx = NULL;
+    options.buffer_size = 64 * 1024;
+    options.spin_iterations = 2000;
+    options.restrict_flags = 0;
+    return options;
+}
+
+/**
+ * @brief Opaque plugin host handle.
+ */
+typedef struct ll_plugin_host ll_plugin_host_t;
+
+/**
+ * @brief Start a sandboxed helper process for a plugin.
+ *
+ * The helper is forked, enforces @p ruleset, and only then loads the plugin,
+ * so library constructors already run sandboxed; the ruleset must therefore
+ * allow reading and executing the plugin and its dependencies. Scoping the
+ * ruleset with LANDLOCK_SCOPE_SIGNAL and LANDLOCK_SCOPE_ABSTRACT_UNIX_SOCKET
+ * (see @ref ll_ruleset_attr_scope) keeps the plugin from signalling or
+ * connecting back to the host. Calls travel through memfd-backed shared
+ * buffers; each side spins briefly on a sequence number before sleeping on
+ * a futex. The helper is forked without exec, so start hosts before the
+ * process creates threads. Before enforcing, the helper closes every
+ * descriptor inherited from the host except standard input, output and
+ * error, since Landlock does not restrict descriptors opened earlier;
+ * redirect those first if the plugin must not reach them either.
+ *
+ * @param options Plugin host options.
+ * @param ruleset Ruleset to enforce in the helper (still owned by the caller).
+ * @param out_host Output plugin host handle.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ * @retval LL_ERROR_SYSTEM memfd_create(), mmap() or fork() failed.
+ * @retval LL_ERROR_PLUGIN_EXITED The helper failed to enforce the ruleset or load the plugin.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_plugin_host_start(const ll_plugin_options_t *const options,
+                                                                    const ll_ruleset_t *const ruleset,
+                                                                    ll_plugin_host_t **const out_host);
+
+/**
+ * @brief Shared request buffer; write the request here before @ref ll_plugin_host_call.
+ *
+ * @param host Plugin host handle.
+ * @param out_capacity Optional output buffer size.
+ * @return Buffer pointer, or NULL if @p host is NULL.
+ */
+void *ll_plugin_host_request_buffer(ll_plugin_host_t *const host, size_t *const out_capacity);
+
+/**
+ * @brief Call the plugin with the request already in the shared request buffer.
+ *
+ * @param host Plugin host handle.
+ * @param in_len Request length.
+ * @param out_response Optional output pointer to the response in the shared buffer, valid until the next call.
+ * @param out_len Optional output response length.
+ * @param out_status Optional output status returned by the plugin.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument or @p in_len too large.
+ * @retval LL_ERROR_PLUGIN_EXITED The helper exited; see @ref ll_plugin_host_stop.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_plugin_host_call(ll_plugin_host_t *const host,
+                                                                   const size_t in_len,
+                                                                   const void **const out_response,
+                                                                   size_t *const out_len,
+                                                                   int *const out_status);
+
+/**
+ * @brief Stop the helper and release the host.
+ *
+ * @param host Plugin host handle (may be NULL).
+ * @param out_wait_status Optional output waitpid() status of the helper.
+ */
+void ll_plugin_host_stop(ll_plugin_host_t *const host, int *const out_wait_status);
+
+/**
+ * @brief Opaque result of an ELF dependency analysis.
+ */
+typedef struct ll_elf_deps ll_elf_deps_t;
+
+/**
+ * @brief Compute the files a dynamically linked binary loads at startup.
+ *
+ * The binary and every shared object are parsed through mmap(). The result
+ * holds the binary, its PT_INTERP loader and the transitive closure of its
+ * DT_NEEDED libraries, resolved like the glibc loader: DT_RPATH (when there
+ * is no DT_RUNPATH), DT_RUNPATH, /etc/ld.so.cache, then the default
+ * directories, with $ORIGIN expanded. /etc/ld.so.cache itself, which the
+ * loader only reads, is not listed (see @ref ll_ruleset_add_elf_deps).
+ * LD_LIBRARY_PATH, LD_PRELOAD and dlopen() calls are not seen. Only objects
+ * of the library's native ELF class are analysed.
+ *
+ * Results are cached per binary, keyed by device, inode, size and
+ * modification time, so repeated calls skip the analysis.
+ *
+ * @param binary Path of the executable or shared object.
+ * @param out_deps Output analysis, to release with @ref ll_elf_deps_free.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument, or @p binary is not an ELF object of the native class.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ * @retval LL_ERROR_SYSTEM @p binary cannot be opened or mapped.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_elf_analyze(const char *const binary, ll_elf_deps_t **const out_deps);
+
+/**
+ * @brief Release an analysis result.
+ *
+ * @param deps Analysis result (may be NULL).
+ */
+void ll_elf_deps_free(ll_elf_deps_t *const deps);
+
+/**
+ * @brief Number of files in the analysis (binary, loader and libraries).
+ */
+size_t ll_elf_deps_count(const ll_elf_deps_t *const deps);
+
+/**
+ * @brief Path of file @p index, or NULL if out of range.
+ */
+const char *ll_elf_deps_path(const ll_elf_deps_t *const deps, const size_t index);
+
+/**
+ * @brief Number of DT_NEEDED names that could not be resolved.
+ */
+size_t ll_elf_deps_missing_count(const ll_elf_deps_t *const deps);
+
+/**
+ * @brief DT_NEEDED name @p index that could not be resolved, or NULL if out of range.
+ */
+const char *ll_elf_deps_missing(const ll_elf_deps_t *const deps, const size_t index);
+
+/**
+ * @brief Drop every cached analysis.
+ */
+void ll_elf_cache_clear(void);
+
+/**
+ * @brief Allow executing and reading the files of an analysis.
+ *
+ * Adds LANDLOCK_ACCESS_FS_EXECUTE | LANDLOCK_ACCESS_FS_READ_FILE rules through
+ * @ref ll_ruleset_add_paths, one per file, or one per directory holding at
+ * least @p collapse_threshold of the files. When the loader reads
+ * /etc/ld.so.cache, a LANDLOCK_ACCESS_FS_READ_FILE rule is added for it on
+ * its own; it is never collapsed into its directory.
+ *
+ * @param ruleset Ruleset handle.
+ * @param deps Analysis result.
+ * @param collapse_threshold Files per directory from which the directory is allowed instead (0 disables).
+ * @param flags Flags passed to landlock_add_rule().
+ * @param out_failed Optional output index of the failing rule.
+ * @return LL_ERROR_OK on success, negative error code on failure.
+ * @see ll_ruleset_add_paths
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_ruleset_add_elf_deps(const ll_ruleset_t *const ruleset,
+                                                                       const ll_elf_deps_t *const deps,
+                                                                       const size_t collapse_threshold,
+                                                                       const __u32 flags,
+                                                                       size_t *const out_failed);
+
+/**
+ * @brief Also cover regular files open in /proc/self/fd (see @ref ll_ruleset_add_mapped_files).
+ */
+#define LL_MAPPED_FILES_OPEN_FDS (1U << 0)
+
+/**
+ * @brief Allow the files the process currently maps, so they keep working after enforcement.
+ *
+ * Reads /proc/self/maps in one pass, deduplicates backing files by device and
+ * inode, and adds one rule per file: LANDLOCK_ACCESS_FS_READ_FILE, plus
+ * LANDLOCK_ACCESS_FS_EXECUTE for files with an executable mapping. With
+ * LL_MAPPED_FILES_OPEN_FDS, regular files open in /proc/self/fd are added too,
+ * with READ_FILE and/or WRITE_FILE following their open mode. Each path is
+ * reopened and checked against the recorded device and inode, so replaced or
+ * deleted files are skipped. Access is masked to the ruleset's handled rights.
+ *
+ * @param ruleset Ruleset handle.
+ * @param options Bitmask of LL_MAPPED_FILES_* options.
+ * @param flags Flags passed to landlock_add_rule().
+ * @param out_added Optional output number of rules added.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ * @retval LL_ERROR_SYSTEM /proc/self/maps cannot be read.
+ * @see ll_ruleset_add_path_fd for rule errors.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_ruleset_add_mapped_files(const ll_ruleset_t *const ruleset,
+                                                                           const unsigned int options,
+                                                                           const __u32 flags,
+                                                                           size_t *const out_added);
+
+/**
+ * @brief Opaque snapshot of the mount table.
+ */
+typedef struct ll_mount_table ll_mount_table_t;
+
+/**
+ * @brief One entry of /proc/self/mountinfo. Strings are owned by the table.
+ */
+typedef struct
+{
+    /**
+     * @brief Mount identifier.
+     */
+    unsigned int mount_id;
+    /**
+     * @brief Parent mount identifier.
+     */
+    unsigned int parent_id;
+    /**
+     * @brief Device number of the mounted filesystem, as makedev(major, minor).
+     */
+    __u64 dev;
+    /**
+     * @brief Directory of the filesystem mounted here ("/" unless it is a bind mount or subvolume).
+     */
+    const char *root;
+    /**
+     * @brief Mount point.
+     */
+    const char *mount_point;
+    /**
+     * @brief Filesystem type, e.g. "ext4" or "fuse.sshfs".
+     */
+    const char *fs_type;
+    /**
+     * @brief Mount source.
+     */
+    const char *source;
+} ll_mount_info_t;
+
+/**
+ * @brief Read /proc/self/mountinfo once into an indexed table.
+ *
+ * @param out_table Output table, to release with @ref ll_mount_table_free.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ * @retval LL_ERROR_SYSTEM /proc/self/mountinfo cannot be read.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_mount_table_load(ll_mount_table_t **const out_table);
+
+/**
+ * @brief Release a mount table.
+ *
+ * @param table Mount table (may be NULL).
+ */
+void ll_mount_table_free(ll_mount_table_t *const table);
+
+/**
+ * @brief Number of mounts in the table.
+ */
+size_t ll_mount_table_count(const ll_mount_table_t *const table);
+
+/**
+ * @brief Describe mount @p index.
+ *
+ * @return 0 on success, -1 if @p index is out of range.
+ */
+int ll_mount_table_get(const ll_mount_table_t *const table, const size_t index, ll_mount_info_t *const out_info);
+
+/**
+ * @brief Find the mount holding an absolute path, without touching the filesystem.
+ *
+ * The path is normalised lexically; symbolic links are not followed.
+ *
+ * @return Mount index, or -1 if @p path is not absolute or contains "..".
+ */
+long ll_mount_table_find(const ll_mount_table_t *const table, const char *const path);
+
+/**
+ * @brief Findings attached to a planned rule.
+ */
+typedef enum
+{
+    /**
+     * @brief The rule's directory is also reachable through another mount of the same filesystem, which the rule covers too.
+     */
+    LL_PLAN_WIDER = 1 << 0,
+    /**
+     * @brief Part of the tree under the rule is mounted elsewhere; access through that mount is not covered.
+     */
+    LL_PLAN_NARROWER = 1 << 1,
+    /**
+     * @brief The path is on an overlay filesystem; its lower and upper layers are not covered directly.
+     */
+    LL_PLAN_OVERLAY = 1 << 2,
+    /**
+     * @brief Other filesystems are mounted under the path; the rule covers them as well.
+     */
+    LL_PLAN_SUBMOUNTS = 1 << 3,
+    /**
+     * @brief The path is on a filesystem type listed as slow.
+     */
+    LL_PLAN_SLOW = 1 << 4,
+    /**
+     * @brief The rule replaces several rules and sits at a mount point.
+     */
+    LL_PLAN_COLLAPSED = 1 << 5,
+    /**
+     * @brief The rule is left out of @ref ll_ruleset_add_plan.
+     */
+    LL_PLAN_SKIPPED = 1 << 6,
+    /**
+     * @brief The rule is only added by @ref ll_ruleset_add_plan when deferred rules are requested.
+     */
+    LL_PLAN_DEFERRED = 1 << 7,
+} ll_plan_flag_t;
+
+/**
+ * @brief What to do with rules on slow filesystems.
+ */
+typedef enum
+{
+    /**
+     * @brief Add them like any other rule.
+     */
+    LL_PLAN_SLOW_KEEP = 0,
+    /**
+     * @brief Mark them LL_PLAN_SKIPPED.
+     */
+    LL_PLAN_SLOW_SKIP = 1,
+    /**
+     * @brief Mark them LL_PLAN_DEFERRED and move them after the other rules.
+     */
+    LL_PLAN_SLOW_DEFER = 2,
+} ll_plan_slow_action_t;
+
+/**
+ * @brief Rule planning options.
+ */
+typedef struct
+{
+    /**
+     * @brief Rules with the same access on one mount (other than "/") from which a single mount-point rule replaces them (0 disables).
+     */
+    size_t collapse_threshold;
+    /**
+     * @brief NULL-terminated list of slow filesystem types; "fuse." matches every FUSE type. NULL selects the defaults (NFS, SMB, FUSE, 9p, Ceph, ...).
+     */
+    const char *const *slow_fs_types;
+    /**
+     * @brief Handling of rules on slow filesystems.
+     */
+    ll_plan_slow_action_t slow_action;
+} ll_plan_options_t;
+
+/**
+ * @brief Default planning options: no collapsing, default slow types, keep slow rules.
+ */
+static inline ll_plan_options_t ll_plan_options_defaults(void)
+{
+    ll_plan_options_t options;
+    options.collapse_threshold = 0;
+    options.slow_fs_types = NULL;
+    options.slow_action = LL_PLAN_SLOW_KEEP;
+    return options;
+}
+
+/**
+ * @brief A planned path rule.
+ */
+typedef struct
+{
+    /**
+     * @brief Path: the input rule's path, or a mount point owned by the table when collapsed.
+     */
+    const char *path;
+    /**
+     * @brief Access rights.
+     */
+    __u64 access;
+    /**
+     * @brief Index of the mount holding @ref path, or -1 if the path is invalid.
+     */
+    long mount_index;
+    /**
+     * @brief Bitmask of @ref ll_plan_flag_t.
+     */
+    unsigned int flags;
+} ll_plan_rule_t;
+
+/**
+ * @brief Annotate path rules with their mounts, without touching the filesystem.
+ *
+ * @param table Mount table.
+ * @param rules Input rules with absolute paths.
+ * @param count Number of input rules.
+ * @param options Planning options, or NULL for the defaults.
+ * @param out_plan Output rules; room for @p count entries.
+ * @param out_count Output number of planned rules (fewer than @p count when collapsed).
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_mount_plan(const ll_mount_table_t *const table,
+                                                             const ll_path_rule_t *const rules,
+                                                             const size_t count,
+                                                             const ll_plan_options_t *const options,
+                                                             ll_plan_rule_t *const out_plan,
+                                                             size_t *const out_count);
+
+/**
+ * @brief Add planned rules through @ref ll_ruleset_add_paths.
+ *
+ * Rules marked LL_PLAN_SKIPPED or with an invalid path are left out, and so
+ * are LL_PLAN_DEFERRED rules unless @p include_deferred is set.
+ *
+ * @param ruleset Ruleset handle.
+ * @param plan Planned rules.
+ * @param count Number of planned rules.
+ * @param include_deferred Non-zero to add deferred rules too.
+ * @param flags Flags passed to landlock_add_rule().
+ * @param out_failed Optional output index (into @p plan) of the failing rule.
+ * @return LL_ERROR_OK on success, negative error code on failure.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_ruleset_add_plan(const ll_ruleset_t *const ruleset,
+                                                                   const ll_plan_rule_t *const plan,
+                                                                   const size_t count,
+                                                                   const int include_deferred,
+                                                                   const __u32 flags,
+                                                                   size_t *const out_failed);
+
+/**
+ * @brief Deadlines for @ref ll_ruleset_add_paths_bounded.
+ */
+typedef struct
+{
+    /**
+     * @brief Time allowed to open one path, in milliseconds.
+     */
+    unsigned int path_timeout_ms;
+    /**
+     * @brief Time allowed for the whole batch, in milliseconds (0 for no limit).
+     */
+    unsigned int total_timeout_ms;
+    /**
+     * @brief Helper threads opening paths concurrently (at least 1).
+     */
+    unsigned int threads;
+    /**
+     * @brief Opens a path on a helper thread, or NULL for open(path, O_PATH | O_CLOEXEC).
+     *
+     * Lets callers resolve paths their own way, e.g. with openat() relative
+     * to a directory they hold, through a broker, or with a stand-in that
+     * stalls to test deadlines. It is called concurrently from up to
+     * @ref threads helper threads and must return a descriptor usable with
+     * landlock_add_rule(), which the library closes, or -1 with errno set.
+     * A call that outlives its deadline keeps running after
+     * @ref ll_ruleset_add_paths_bounded returns, so @ref open_ctx must stay
+     * valid until it does.
+     */
+    int (*open_path)(void *ctx, const char *path);
+    /**
+     * @brief Opaque pointer passed to @ref open_path.
+     */
+    void *open_ctx;
+} ll_resolve_options_t;
+
+/**
+ * @brief Default deadlines: 2 s per path, no total limit, 4 threads.
+ */
+static inline ll_resolve_options_t ll_resolve_options_defaults(void)
+{
+    ll_resolve_options_t options;
+    options.path_timeout_ms = 2000;
+    options.total_timeout_ms = 0;
+    options.threads = 4;
+    options.open_path = NULL;
+    options.open_ctx = NULL;
+    return options;
+}
+
+/**
+ * @brief Add path rules like @ref ll_ruleset_add_paths, opening the paths on helper threads under deadlines.
+ *
+ * Paths are opened concurrently and added in order with
+ * @ref ll_ruleset_add_path_fd. A path whose open outlives its deadline is
+ * skipped and reported as LL_ERROR_TIMEOUT; the stalled thread is left behind
+ * and closes its descriptor if the open ever returns, while a fresh thread
+ * takes over the remaining paths. Any other failure stops the batch.
+ *
+ * @param ruleset Ruleset handle.
+ * @param rules Rules to add.
+ * @param count Number of rules.
+ * @param options Deadlines, or NULL for the defaults.
+ * @param flags Flags passed to landlock_add_rule().
+ * @param out_results Optional per-rule status (LL_ERROR_OK, LL_ERROR_TIMEOUT or the failure); entries after a failing rule are left untouched.
+ * @param out_failed Optional output index of the failing rule, or of the first skipped one.
+ * @retval LL_ERROR_OK Every rule was added.
+ * @retval LL_ERROR_TIMEOUT Some paths were skipped; every other rule was added.
+ * @retval LL_ERROR_SYSTEM No helper thread could be started.
+ * @return Other negative error codes as for @ref ll_ruleset_add_path_fd.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_ruleset_add_paths_bounded(const ll_ruleset_t *const ruleset,
+                                                                            const ll_path_rule_t *const rules,
+                                                                            const size_t count,
+                                                                            const ll_resolve_options_t *const options,
+                                                                            const __u32 flags,
+                                                                            ll_error_t *const out_results,
+                                                                            size_t *const out_failed);
+
+/**
+ * @brief Compute a stable fingerprint of a policy for a given kernel.
+ *
+ * The fingerprint covers the policy's handled masks and rules (independently
+ * of insertion order), the requested ABI, compatibility mode and flags of
+ * @p attr, and the running kernel's ABI version and errata.
+ *
+ * @param policy Policy.
+ * @param attr ABI, compatibility mode and flags that will be used to create the ruleset.
+ * @param out_fingerprint Output fingerprint.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument.
+ * @return Other negative error codes as for @ref ll_get_abi_version.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_policy_fingerprint(const ll_policy_t *const policy,
+                                                                     const ll_ruleset_attr_t attr,
+                                                                     __u64 *const out_fingerprint);
+
+/**
+ * @brief Outcome of a cached policy resolution.
+ */
+typedef enum
+{
+    /**
+     * @brief No cache file could be read; the policy was resolved in full.
+     */
+    LL_POLICY_CACHE_MISS = 0,
+    /**
+     * @brief The cached rules were still valid and were used.
+     */
+    LL_POLICY_CACHE_HIT = 1,
+    /**
+     * @brief The cache file was for another fingerprint, did not match the policy's rules, could be written by another user, or a cached path no longer matched its validators; the policy was resolved in full.
+     */
+    LL_POLICY_CACHE_STALE = 2,
+} ll_policy_cache_status_t;
+
+/**
+ * @brief Create a ruleset from a policy, reusing a previous resolution stored in a cache file.
+ *
+ * Full resolution masks each path rule to the access the ruleset handles
+ * (best-effort mode), opens it, drops directory-only rights on
+ * non-directories and records the (dev, ino, mtime) of what was opened. The
+ * resulting rule list is written to @p cache_path under the policy's
+ * fingerprint. Later calls with the same fingerprint only check each cached
+ * path against its validators with fstat() on the descriptor they add (the
+ * mtime of directories is not compared, as it changes with their entries);
+ * any mismatch discards the partial ruleset and falls back to full resolution.
+ * Each cached rule must name one of the policy's paths and grant no more than
+ * that rule does, and the cache file is ignored unless it is a regular file
+ * owned by the effective user and not writable by group or others.
+ * Failing to write the cache is not an error.
+ *
+ * @param policy Policy.
+ * @param attr ABI, compatibility mode and flags to use; its access masks are replaced by the policy's.
+ * @param cache_path Cache file path; it is replaced atomically.
+ * @param out_status Optional output cache outcome.
+ * @see ll_policy_create_ruleset
+ * @see ll_policy_fingerprint
+ */
+__attribute__((warn_unused_result)) ll_ruleset_result_t ll_policy_create_ruleset_cached(const ll_policy_t *const policy,
+                                                                                        const ll_ruleset_attr_t attr,
+                                                                                        const char *const cache_path,
+                                                                                        ll_policy_cache_status_t *const out_status);
+
+/**
+ * @brief Kernel interface used by the library.
+ *
+ * Every Landlock syscall, the no_new_privs prctl() and the audit probe go
+ * through the installed backend. Functions follow the syscall convention:
+ * they return -1 and set errno on failure.
+ */
+typedef struct
+{
+    /**
+     * @brief Opaque pointer passed to every function.
+     */
+    void *ctx;
+    /**
+     * @brief landlock_create_ruleset(2).
+     */
+    int (*create_ruleset)(void *ctx, const struct landlock_ruleset_attr *attr, size_t size, __u32 flags);
+    /**
+     * @brief landlock_add_rule(2).
+     */
+    int (*add_rule)(void *ctx, int ruleset_fd, enum landlock_rule_type rule_type, const void *rule_attr,
+                    __u32 flags);
+    /**
+     * @brief landlock_restrict_self(2).
+     */
+    int (*restrict_self)(void *ctx, int ruleset_fd, __u32 flags);
+    /**
+     * @brief prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0).
+     */
+    int (*set_no_new_privs)(void *ctx);
+    /**
+     * @brief Whether audit records can be emitted (1) or not (0).
+     */
+    int (*audit_supported)(void *ctx);
+} ll_backend_t;
+
+/**
+ * @brief Install a backend for the whole process.
+ *
+ * Building with -DLL_BACKEND_FAKE_ABI=n makes a fake kernel with ABI n the
+ * default instead of the running kernel.
+ *
+ * @param backend Backend, which must outlive its use, or NULL for the default.
+ */
+void ll_backend_set(const ll_backend_t *const backend);
+
+/**
+ * @brief Get the backend currently in use.
+ */
+const ll_backend_t *ll_backend_get(void);
+
+/**
+ * @brief Opaque in-process model of the Landlock syscalls.
+ *
+ * The fake kernel validates arguments like the real one for its ABI: access
+ * masks, restrict_self() flags, per-ABI error codes, rule types, the
+ * directory-only rights and the 64-layer limit. Rulesets are memfd
+ * descriptors; restrict_self() only counts layers and restricts nothing.
+ */
+typedef struct ll_fake_kernel ll_fake_kernel_t;
+
+/**
+ * @brief Counters kept by a fake kernel.
+ */
+typedef struct
+{
+    /**
+     * @brief create_ruleset() calls, including version and errata queries.
+     */
+    __u64 create_ruleset_calls;
+    /**
+     * @brief add_rule() calls.
+     */
+    __u64 add_rule_calls;
+    /**
+     * @brief restrict_self() calls.
+     */
+    __u64 restrict_self_calls;
+    /**
+     * @brief Calls that failed.
+     */
+    __u64 failed_calls;
+    /**
+     * @brief Rules accepted.
+     */
+    __u64 rules;
+    /**
+     * @brief Layers enforced so far.
+     */
+    unsigned int layers;
+} ll_fake_kernel_stats_t;
+
+/**
+ * @brief Create a fake kernel.
+ *
+ * @param abi Landlock ABI version to model (1 or later).
+ * @param out_kernel Output fake kernel.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_fake_kernel_create(const ll_abi_t abi,
+                                                                     ll_fake_kernel_t **const out_kernel);
+
+/**
+ * @brief Free a fake kernel (may be NULL); it must no longer be installed.
+ */
+void ll_fake_kernel_free(ll_fake_kernel_t *const kernel);
+
+/**
+ * @brief Backend serving calls from the fake kernel, for @ref ll_backend_set.
+ */
+const ll_backend_t *ll_fake_kernel_backend(ll_fake_kernel_t *const kernel);
+
+/**
+ * @brief Set the errata bitmask reported by the fake kernel (ABI 7 and later).
+ */
+void ll_fake_kernel_set_errata(ll_fake_kernel_t *const kernel, const int errata);
+
+/**
+ * @brief Model Landlock being disabled at boot (every call fails with EOPNOTSUPP) or not.
+ */
+void ll_fake_kernel_set_disabled(ll_fake_kernel_t *const kernel, const int disabled);
+
+/**
+ * @brief Model whether audit records are supported.
+ */
+void ll_fake_kernel_set_audit(ll_fake_kernel_t *const kernel, const int supported);
+
+/**
+ * @brief Read the fake kernel's counters.
+ */
+void ll_fake_kernel_stats(ll_fake_kernel_t *const kernel, ll_fake_kernel_stats_t *const out_stats);
+
+/**
+ * @brief Operation attempted by a conformance probe.
+ */
+typedef enum
+{
+    /**
+     * @brief open(target, O_RDONLY); covers files (read_file) and directories (read_dir).
+     */
+    LL_PROBE_READ = 0,
+    /**
+     * @brief open(target, O_WRONLY) on an existing file.
+     */
+    LL_PROBE_WRITE = 1,
+    /**
+     * @brief mkdir(target), removed again when it succeeds.
+     */
+    LL_PROBE_MKDIR = 2,
+    /**
+     * @brief execve(target) with no arguments; the new program is killed as soon as it starts.
+     */
+    LL_PROBE_EXEC = 3,
+    /**
+     * @brief bind() a TCP socket to 127.0.0.1:port.
+     */
+    LL_PROBE_BIND_TCP = 4,
+    /**
+     * @brief connect() to 127.0.0.1:port; the prober listens there when the port is free.
+     */
+    LL_PROBE_CONNECT_TCP = 5,
+    /**
+     * @brief kill(prober, 0), i.e. signal a process outside the sandbox.
+     */
+    LL_PROBE_SIGNAL = 6,
+    /**
+     * @brief connect() to the abstract unix socket named target, served by the prober.
+     */
+    LL_PROBE_ABSTRACT_UNIX = 7,
+} ll_probe_op_t;
+
+/**
+ * @brief One expected-allow or expected-deny operation.
+ */
+typedef struct
+{
+    /**
+     * @brief Operation.
+     */
+    ll_probe_op_t op;
+    /**
+     * @brief Path, or abstract socket name (unused for TCP and signal probes).
+     */
+    const char *target;
+    /**
+     * @brief TCP port for LL_PROBE_BIND_TCP and LL_PROBE_CONNECT_TCP.
+     */
+    __u16 port;
+    /**
+     * @brief Non-zero if the sandbox must allow the operation, zero if it must deny it.
+     */
+    int expect_allowed;
+} ll_probe_t;
+
+/**
+ * @brief Probe outcome.
+ */
+typedef enum
+{
+    /**
+     * @brief The operation succeeded.
+     */
+    LL_PROBE_ALLOWED = 0,
+    /**
+     * @brief The operation failed with EACCES or EPERM.
+     */
+    LL_PROBE_DENIED = 1,
+    /**
+     * @brief The operation failed for another reason (e.g. ENOENT), or its sandbox died.
+     */
+    LL_PROBE_INCONCLUSIVE = 2,
+} ll_probe_outcome_t;
+
+/**
+ * @brief Result of one probe.
+ */
+typedef struct
+{
+    /**
+     * @brief Outcome (@ref ll_probe_outcome_t).
+     */
+    unsigned char outcome;
+    /**
+     * @brief Non-zero if the outcome matches the expectation.
+     */
+    unsigned char passed;
+    /**
+     * @brief errno of the failed operation, or 0.
+     */
+    int error;
+} ll_probe_result_t;
+
+/**
+ * @brief Run probes in sandboxed child processes.
+ *
+ * Probes are spread over @p workers forked children, each of which enforces
+ * @p ruleset on itself and writes its results into shared memory. The
+ * calling process is not restricted.
+ *
+ * @param ruleset Ruleset to test.
+ * @param restrict_flags Flags for @ref ll_ruleset_enforce in the children.
+ * @param probes Probes.
+ * @param count Number of probes.
+ * @param workers Number of children, or 0 for one per online CPU.
+ * @param out_results Output results; room for @p count entries.
+ * @param out_failed Optional output number of probes that did not pass.
+ * @retval LL_ERROR_OK The probes were run; see @p out_results.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument.
+ * @retval LL_ERROR_OUT_OF_MEMORY Memory allocation failed.
+ * @retval LL_ERROR_SYSTEM Shared memory or children could not be set up.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_probe_run(const ll_ruleset_t *const ruleset,
+                                                            const __u32 restrict_flags,
+                                                            const ll_probe_t *const probes,
+                                                            const size_t count,
+                                                            const unsigned int workers,
+                                                            ll_probe_result_t *const out_results,
+                                                            size_t *const out_failed);
+
+/**
+ * @brief Opaque reloadable policy: policy files compiled into a ruleset that is swapped on change.
+ *
+ * The files are watched with inotify (through their directories, so
+ * editors that replace files by renaming are seen). Reloads happen in
+ * @ref ll_policy_watch_process, off the fork path; a new ruleset is
+ * built and populated completely before it is published with a single
+ * atomic pointer exchange. Readers never lock: @ref ll_policy_watch_pin
+ * and @ref ll_policy_watch_fork only touch two atomic counters, and a
+ * replaced ruleset is closed only once every reader that could have seen
+ * it has unpinned (epoch-based reclamation). If a reload fails, the
+ * previous ruleset stays in place.
+ *
+ * @ref ll_policy_watch_process and @ref ll_policy_watch_reload must not
+ * be called concurrently with each other or with @ref ll_policy_watch_free;
+ * pinning and forking are safe from any thread.
+ */
+typedef struct ll_policy_watch ll_policy_watch_t;
+
+/**
+ * @brief Load policy files, build the first ruleset and start watching the files.
+ *
+ * The files are concatenated into one policy (see @ref ll_policy_load_file).
+ *
+ * @param paths Policy files.
+ * @param count Number of files.
+ * @param attr ABI, compatibility mode and flags for the rulesets; access masks come from the policy.
+ * @param out_watch Output handle, released with @ref ll_policy_watch_free.
+ * @param out_line Optional output line number of the first syntax error.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ * @retval LL_ERROR_SYSTEM A file could not be read, or inotify could not be set up.
+ * @see ll_policy_create_ruleset for the other errors.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_policy_watch_create(const char *const *const paths,
+                                                                      const size_t count,
+                                                                      const ll_ruleset_attr_t attr,
+                                                                      ll_policy_watch_t **const out_watch,
+                                                                      size_t *const out_line);
+
+/**
+ * @brief Stop watching and close every ruleset (may be NULL).
+ *
+ * No ruleset may still be pinned.
+ */
+void ll_policy_watch_free(ll_policy_watch_t *const watch);
+
+/**
+ * @brief Get the inotify descriptor, for use with poll() or epoll in an event loop.
+ */
+int ll_policy_watch_fd(const ll_policy_watch_t *const watch);
+
+/**
+ * @brief Get the number of rulesets published so far (1 after creation).
+ */
+unsigned long ll_policy_watch_generation(const ll_policy_watch_t *const watch);
+
+/**
+ * @brief Wait for changes to the policy files and reload if any were seen.
+ *
+ * @param watch Handle.
+ * @param timeout_ms Time to wait for events: 0 to only drain pending events, negative to wait indefinitely.
+ * @param out_reloaded Optional output set to 1 when a new ruleset was published, 0 otherwise.
+ * @param out_line Optional output line number of the first syntax error.
+ * @retval LL_ERROR_OK No change, or the reload succeeded.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument.
+ * @retval LL_ERROR_SYSTEM Reading inotify events or a policy file failed.
+ * @see ll_policy_watch_reload for reload errors; the previous ruleset is kept.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_policy_watch_process(ll_policy_watch_t *const watch,
+                                                                       const int timeout_ms,
+                                                                       int *const out_reloaded,
+                                                                       size_t *const out_line);
+
+/**
+ * @brief Recompile the policy files now and publish the result.
+ *
+ * Also closes replaced rulesets that no reader can still hold.
+ *
+ * @see ll_policy_watch_create for the error codes; on error the previous ruleset is kept.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_policy_watch_reload(ll_policy_watch_t *const watch,
+                                                                      size_t *const out_line);
+
+/**
+ * @brief Pin the newest ruleset so that it stays open until @ref ll_policy_watch_unpin.
+ *
+ * @param watch Handle.
+ * @param out_token Output token to pass to @ref ll_policy_watch_unpin.
+ * @return The newest ruleset, or NULL for invalid arguments.
+ */
+const ll_ruleset_t *ll_policy_watch_pin(ll_policy_watch_t *const watch, unsigned long *const out_token);
+
+/**
+ * @brief Release a ruleset pinned with @ref ll_policy_watch_pin.
+ */
+void ll_policy_watch_unpin(ll_policy_watch_t *const watch, const unsigned long token);
+
+/**
+ * @brief Fork a worker that enforces the newest ruleset.
+ *
+ * The ruleset is pinned across fork() so a concurrent reload cannot close
+ * it before the child has inherited its descriptor. Like fork(), this
+ * returns in both processes: @p out_pid is 0 in the child, which has
+ * already enforced the ruleset when the call returns LL_ERROR_OK.
+ *
+ * @param watch Handle.
+ * @param restrict_flags Flags for @ref ll_ruleset_enforce.
+ * @param out_pid Output child pid in the parent, 0 in the child.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument.
+ * @retval LL_ERROR_SYSTEM fork() failed.
+ * @see ll_ruleset_enforce for the errors returned in the child.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_policy_watch_fork(ll_policy_watch_t *const watch,
+                                                                    const __u32 restrict_flags,
+                                                                    int *const out_pid);
+
+/**
+ * @brief Opaque ruleset build running on a worker thread.
+ *
+ * Lets event loops build a policy's ruleset without blocking on path
+ * resolution: @ref ll_ruleset_build_start returns immediately, and the
+ * descriptor from @ref ll_ruleset_build_fd (an eventfd) becomes readable
+ * once the worker has finished. It can be registered with epoll, poll()
+ * or an io_uring poll/read request; afterwards @ref ll_ruleset_build_collect
+ * returns the result without blocking.
+ */
+typedef struct ll_ruleset_build ll_ruleset_build_t;
+
+/**
+ * @brief Start building a ruleset for @p policy on a worker thread.
+ *
+ * The policy is copied, so it may be modified or freed once this returns.
+ *
+ * @param policy Policy.
+ * @param attr ABI, compatibility mode and flags to use; its access masks are replaced by the policy's.
+ * @param out_build Output handle, released with @ref ll_ruleset_build_free.
+ * @retval LL_ERROR_OK The build is running.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ * @retval LL_ERROR_SYSTEM The eventfd or the worker thread could not be created.
+ * @see ll_policy_create_ruleset
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_ruleset_build_start(const ll_policy_t *const policy,
+                                                                      const ll_ruleset_attr_t attr,
+                                                                      ll_ruleset_build_t **const out_build);
+
+/**
+ * @brief Get the eventfd that becomes readable when the build has finished.
+ *
+ * The descriptor stays readable until @ref ll_ruleset_build_collect drains it.
+ */
+int ll_ruleset_build_fd(const ll_ruleset_build_t *const build);
+
+/**
+ * @brief Return non-zero once the build has finished (successfully, with an error, or cancelled).
+ */
+int ll_ruleset_build_done(const ll_ruleset_build_t *const build);
+
+/**
+ * @brief Ask the worker to stop.
+ *
+ * The worker checks between batches of rules; a build that stops early
+ * finishes with LL_ERROR_CANCELED and still signals its eventfd. A build
+ * that already finished is not affected.
+ */
+void ll_ruleset_build_cancel(ll_ruleset_build_t *const build);
+
+/**
+ * @brief Take the build's result, waiting for the worker if it has not finished.
+ *
+ * The ruleset is handed over to the caller and must be closed with
+ * @ref ll_ruleset_close; collecting again yields LL_ERROR_INVALID_ARGUMENT.
+ *
+ * @param build Handle.
+ * @param out_failed Optional output index of the failing rule (path rules first, then ports).
+ * @return The ruleset, or LL_ERROR_CANCELED if the build was cancelled.
+ * @see ll_policy_create_ruleset for the other errors.
+ */
+__attribute__((warn_unused_result)) ll_ruleset_result_t ll_ruleset_build_collect(ll_ruleset_build_t *const build,
+                                                                                 size_t *const out_failed);
+
+/**
+ * @brief Release a build (may be NULL).
+ *
+ * A build still running is cancelled and its worker cleans up on its own;
+ * an uncollected ruleset is closed.
+ */
+void ll_ruleset_build_free(ll_ruleset_build_t *const build);
+
+/**
+ * @brief Opaque seccomp filter description: a default action plus per-syscall actions.
+ *
+ * Filters compile to a classic BPF program that checks the architecture
+ * and then finds the syscall's action with a binary search over syscall
+ * number ranges, so evaluation costs O(log n) comparisons instead of the
+ * O(n) of a linear list of checks. Actions are SECCOMP_RET_* values from
+ * <linux/seccomp.h>, e.g. `SECCOMP_RET_ERRNO | EPERM`. Calls from another
+ * architecture (and x32 calls on x86-64) kill the process.
+ */
+typedef struct ll_syscall_filter ll_syscall_filter_t;
+
+struct sock_filter;
+
+/**
+ * @brief Create a syscall filter.
+ *
+ * @param default_action Action for syscalls without their own entry.
+ * @param out_filter Output filter, released with @ref ll_syscall_filter_free.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT NULL output pointer.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_syscall_filter_create(const __u32 default_action,
+                                                                        ll_syscall_filter_t **const out_filter);
+
+/**
+ * @brief Free a syscall filter (may be NULL).
+ */
+void ll_syscall_filter_free(ll_syscall_filter_t *const filter);
+
+/**
+ * @brief Set the action for one syscall, replacing any previous one.
+ *
+ * @param filter Filter.
+ * @param nr Native syscall number (e.g. SYS_ptrace).
+ * @param action SECCOMP_RET_* action.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument (e.g., negative @p nr).
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_syscall_filter_add(ll_syscall_filter_t *const filter,
+                                                                     const int nr,
+                                                                     const __u32 action);
+
+/**
+ * @brief Compile a filter to a BPF program.
+ *
+ * When @p ruleset is given, syscalls whose every effect is covered by the
+ * ruleset's handled filesystem access rights (e.g. mkdir() and mkdirat()
+ * when LANDLOCK_ACCESS_FS_MAKE_DIR is handled, or the open() family when
+ * all of read, write, readdir, truncate and regular-file creation are) are
+ * left to Landlock: unless the filter has an entry for them, they are
+ * allowed instead of taking the default action. An explicit entry is
+ * always kept, so a governed syscall can still be denied. ftruncate() is
+ * never excluded, because Landlock checks truncation when the file is
+ * opened, not on descriptors opened before the ruleset. Network and signal
+ * syscalls are never excluded, because Landlock only governs TCP and
+ * cross-domain signals.
+ *
+ * @param filter Filter.
+ * @param ruleset Optional ruleset whose governed syscalls are excluded.
+ * @param out_program Output program to release with free().
+ * @param out_len Output number of instructions.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument, or the program exceeds BPF_MAXINSNS.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ * @retval LL_ERROR_UNSUPPORTED_SYSCALL The architecture is not known to the generator.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_syscall_filter_compile(const ll_syscall_filter_t *const filter,
+                                                                         const ll_ruleset_t *const ruleset,
+                                                                         struct sock_filter **const out_program,
+                                                                         size_t *const out_len);
+
+/**
+ * @brief Compile a filter and install it on the calling thread.
+ *
+ * Sets PR_SET_NO_NEW_PRIVS first, as seccomp requires.
+ *
+ * @param filter Filter.
+ * @param ruleset Optional ruleset whose governed syscalls are excluded (see @ref ll_syscall_filter_compile).
+ * @retval LL_ERROR_SYSTEM The kernel refused the filter.
+ * @see ll_syscall_filter_compile for the other error codes.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_syscall_filter_install(const ll_syscall_filter_t *const filter,
+                                                                         const ll_ruleset_t *const ruleset);
+
+/**
+ * @brief Enforce a ruleset and install a syscall filter in the same step.
+ *
+ * The filter is compiled with @p ruleset's governed syscalls excluded
+ * before anything is enforced, then installed right after
+ * landlock_restrict_self(), so a filter that cannot be built never leaves
+ * a half-applied sandbox.
+ *
+ * @param ruleset Ruleset to enforce.
+ * @param flags Flags for @ref ll_ruleset_enforce.
+ * @param filter Filter to install.
+ * @see ll_ruleset_enforce
+ * @see ll_syscall_filter_install
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_ruleset_enforce_filtered(const ll_ruleset_t *const ruleset,
+                                                                           const __u32 flags,
+                                                                           const ll_syscall_filter_t *const filter);
+
+/**
+ * @brief Built-in profiles: static rule tables for common runtimes, combinable as a bitmask.
+ *
+ * Profiles are applied through the batch path with
+ * @ref LL_ADD_RULE_TRIM_DIR_ONLY and @ref LL_ADD_RULE_SKIP_MISSING, so
+ * their paths may name files and may be absent on some distributions.
+ * A profile pulls in the profiles it depends on.
+ */
+typedef enum
+{
+    /**
+     * @brief Dynamically linked C program: loader, shared libraries, locale and time zone data, /dev/null and
+     * /dev/urandom.
+     */
+    LL_PROFILE_DYNAMIC_C = 1U << 0,
+    /**
+     * @brief Python interpreter and its standard library (includes @ref LL_PROFILE_DYNAMIC_C).
+     */
+    LL_PROFILE_PYTHON = 1U << 1,
+    /**
+     * @brief Java virtual machine, with the CPU and cgroup data it sizes itself from (includes @ref LL_PROFILE_DYNAMIC_C).
+     */
+    LL_PROFILE_JVM = 1U << 2,
+    /**
+     * @brief TLS client: CA certificates, OpenSSL configuration and TCP connections to port 443.
+     */
+    LL_PROFILE_TLS_CLIENT = 1U << 3,
+    /**
+     * @brief Name resolution through the C library: resolver and NSS configuration and TCP connections to port 53.
+     */
+    LL_PROFILE_DNS_RESOLVER = 1U << 4,
+} ll_profile_t;
+
+/**
+ * @brief Look up a profile by name ("dynamic-c", "python", "jvm", "tls-client" or "dns-resolver").
+ *
+ * @return The profile, or 0 if the name is unknown.
+ */
+unsigned int ll_profile_from_name(const char *const name);
+
+/**
+ * @brief Get one profile's own path rules, without those of the profiles it depends on.
+ *
+ * @param profile A single @ref ll_profile_t value.
+ * @param out_count Output number of rules.
+ * @return Static table, or NULL (with a count of 0) for an unknown profile.
+ */
+const ll_path_rule_t *ll_profile_paths(const ll_profile_t profile, size_t *const out_count);
+
+/**
+ * @brief Get one profile's own network port rules.
+ *
+ * @see ll_profile_paths
+ */
+const ll_port_rule_t *ll_profile_ports(const ll_profile_t profile, size_t *const out_count);
+
+/**
+ * @brief Add the rules of several profiles, plus application rules, to a ruleset.
+ *
+ * In best-effort mode, rights the ruleset does not handle are dropped
+ * from every rule (see @ref ll_ruleset_add_paths). No memory is allocated.
+ *
+ * @param ruleset Ruleset handle.
+ * @param profiles Bitwise OR of @ref ll_profile_t values.
+ * @param extra Optional application path rules, added after the profiles' with the same flags.
+ * @param extra_count Number of application rules.
+ * @param out_failed Optional output index into @p extra of the failing rule, when one failed.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument (e.g., an unknown profile bit).
+ * @return Other negative error codes as for @ref ll_ruleset_add_paths and @ref ll_ruleset_add_net_port.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_ruleset_add_profiles(const ll_ruleset_t *const ruleset,
+                                                                       const unsigned int profiles,
+                                                                       const ll_path_rule_t *const extra,
+                                                                       const size_t extra_count,
+                                                                       size_t *const out_failed);
+
+/**
+ * @brief Create a ruleset populated with profiles and application rules in one call.
+ *
+ * Access classes left empty in @p attr are filled in to handle every
+ * filesystem and TCP right, so anything the profiles and @p extra do not
+ * grant is denied.
+ *
+ * @param profiles Bitwise OR of @ref ll_profile_t values.
+ * @param attr ABI, compatibility mode, flags and optionally handled access masks.
+ * @param extra Optional application path rules.
+ * @param extra_count Number of application rules.
+ * @see ll_ruleset_create_result
+ * @see ll_ruleset_add_profiles
+ */
+__attribute__((warn_unused_result)) ll_ruleset_result_t ll_profile_create_ruleset(const unsigned int profiles,
+                                                                                  ll_ruleset_attr_t attr,
+                                                                                  const ll_path_rule_t *const extra,
+                                                                                  const size_t extra_count);
+
+/**
+ * @brief Canonicalise path rules lexically and merge the access rights of duplicates.
+ *
+ * Repeated separators, "." components and trailing separators are
+ * removed ("/usr//lib/./" becomes "/usr/lib", "./a/" becomes "a"); ".."
+ * components are kept, since resolving them would need the filesystem.
+ * Rules whose canonical paths are equal are merged into the first one by
+ * OR-ing their access rights, keeping first-occurrence order. Separators
+ * are found and paths hashed 16 bytes at a time with SSE2 where available.
+ *
+ * The result can be passed directly to @ref ll_ruleset_add_paths and the
+ * other batch APIs, so each distinct path is opened only once.
+ *
+ * @param rules Rules to canonicalise.
+ * @param count Number of rules.
+ * @param out_rules Output rules, in one allocation (strings included) to release with free().
+ * @param out_count Output number of distinct rules.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument (e.g., a NULL path).
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_path_rules_canonicalize(const ll_path_rule_t *const rules,
+                                                                          const size_t count,
+                                                                          ll_path_rule_t **const out_rules,
+                                                                          size_t *const out_count);
+
+/**
+ * @brief Tuning for @ref ll_ruleset_add_manifest_fd and @ref ll_ruleset_add_manifest_buffer.
+ */
+typedef struct
+{
+    /**
+     * @brief Bytes read from the manifest at a time.
+     */
+    size_t chunk_size;
+    /**
+     * @brief Opened paths queued for add_rule() at most (0 to derive from RLIMIT_NOFILE).
+     */
+    unsigned int max_inflight;
+} ll_manifest_options_t;
+
+/**
+ * @brief Default tuning: 64 KiB chunks and an in-flight limit derived from RLIMIT_NOFILE.
+ */
+static inline ll_manifest_options_t ll_manifest_options_defaults(void)
+{
+    ll_manifest_options_t options;
+    options.chunk_size = 64 * 1024;
+    options.max_inflight = 0;
+    return options;
+}
+
+/**
+ * @brief Counters of a manifest ingestion.
+ */
+typedef struct
+{
+    /**
+     * @brief Lines read, including blank lines and comments.
+     */
+    size_t lines;
+    /**
+     * @brief Rules added.
+     */
+    size_t rules;
+    /**
+     * @brief Missing paths skipped under LL_ADD_RULE_SKIP_MISSING.
+     */
+    size_t skipped;
+    /**
+     * @brief Limit on opened paths queued for add_rule().
+     */
+    unsigned int inflight_limit;
+    /**
+     * @brief Largest number of opened paths that were queued at once.
+     */
+    unsigned int peak_inflight;
+    /**
+     * @brief Rules added per second, over the whole ingestion.
+     */
+    double rules_per_second;
+} ll_manifest_stats_t;
+
+/**
+ * @brief Add a path rule for every line of a manifest read from a descriptor.
+ *
+ * The manifest holds one path per line; blank lines and lines starting
+ * with '#' are ignored, and a trailing '\\r' is stripped. A helper thread
+ * reads the manifest @p options->chunk_size bytes at a time, canonicalises
+ * each path as @ref ll_path_rules_canonicalize does and opens it, while the
+ * calling thread adds the opened paths to the ruleset, so reading, opening
+ * and add_rule() overlap. Memory use is bounded by the chunk size and
+ * in-flight limit whatever the manifest's size, and at most
+ * inflight_limit + 1 descriptors are open at once. The default limit is
+ * 64, lowered to half of the descriptors left under RLIMIT_NOFILE.
+ *
+ * Duplicate paths are not detected across the stream; the kernel merges
+ * their rules.
+ *
+ * @param ruleset Ruleset handle.
+ * @param fd Descriptor to read the manifest from until end of file (a file, pipe or socket).
+ * @param access Access rights granted beneath every path.
+ * @param flags Flags for add_rule(), including LL_ADD_RULE_SKIP_MISSING and LL_ADD_RULE_TRIM_DIR_ONLY.
+ * @param options Optional tuning (NULL for @ref ll_manifest_options_defaults).
+ * @param out_stats Optional output counters, filled in on failure as well.
+ * @param out_line Optional output 1-based line number of the failing entry, when one failed.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument (e.g., a line of PATH_MAX bytes or more).
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ * @retval LL_ERROR_SYSTEM Reading the manifest or starting the helper thread failed.
+ * @return Other negative error codes as for @ref ll_ruleset_add_path.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_ruleset_add_manifest_fd(const ll_ruleset_t *const ruleset,
+                                                                          const int fd,
+                                                                          const __u64 access,
+                                                                          const __u32 flags,
+                                                                          const ll_manifest_options_t *const options,
+                                                                          ll_manifest_stats_t *const out_stats,
+                                                                          size_t *const out_line);
+
+/**
+ * @brief Add a path rule for every line of a manifest held in memory, such as a mapped file.
+ *
+ * Behaves like @ref ll_ruleset_add_manifest_fd without copying the manifest.
+ *
+ * @param ruleset Ruleset handle.
+ * @param data Manifest text, which need not be NUL-terminated.
+ * @param len Length of @p data in bytes.
+ * @param access Access rights granted beneath every path.
+ * @param flags Flags for add_rule(), including LL_ADD_RULE_SKIP_MISSING and LL_ADD_RULE_TRIM_DIR_ONLY.
+ * @param options Optional tuning (NULL for @ref ll_manifest_options_defaults).
+ * @param out_stats Optional output counters, filled in on failure as well.
+ * @param out_line Optional output 1-based line number of the failing entry, when one failed.
+ * @see ll_ruleset_add_manifest_fd
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_ruleset_add_manifest_buffer(const ll_ruleset_t *const ruleset,
+                                                                              const void *const data,
+                                                                              const size_t len,
+                                                                              const __u64 access,
+                                                                              const __u32 flags,
+                                                                              const ll_manifest_options_t *const options,
+                                                                              ll_manifest_stats_t *const out_stats,
+                                                                              size_t *const out_line);
+
+/**
+ * @brief Create an empty journal and its base ruleset.
+ *
+ * @param attr Attributes for the base ruleset, shared by every derived ruleset.
+ * @param out_journal Output journal.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_OK_PARTIAL_SANDBOX Created in best-effort mode with some access unsupported.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ * @return Other negative error codes as for @ref ll_ruleset_create_result.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_ruleset_journal_create(const ll_ruleset_attr_t attr,
+                                                                         ll_ruleset_journal_t **const out_journal);
+
+/**
+ * @brief Free a journal (may be NULL), closing its descriptors and base ruleset.
+ */
+void ll_ruleset_journal_free(ll_ruleset_journal_t *const journal);
+
+/**
+ * @brief Base ruleset of a journal, holding every rule recorded so far; owned by the journal.
+ */
+const ll_ruleset_t *ll_ruleset_journal_base(const ll_ruleset_journal_t *const journal);
+
+/**
+ * @brief Open a path, add it to the base ruleset and record it in the journal.
+ *
+ * Rights dropped under LL_ADD_RULE_TRIM_DIR_ONLY are dropped from the
+ * record too, and a path skipped under LL_ADD_RULE_SKIP_MISSING is not
+ * recorded.
+ *
+ * @param journal Journal.
+ * @param path Path to grant access beneath.
+ * @param access Access rights.
+ * @param flags Flags as for @ref ll_ruleset_add_path.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ * @return Other negative error codes as for @ref ll_ruleset_add_path.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_ruleset_journal_add_path(ll_ruleset_journal_t *const journal,
+                                                                           const char *const path,
+                                                                           const __u64 access,
+                                                                           const __u32 flags);
+
+/**
+ * @brief Record several path rules, in order, as @ref ll_ruleset_journal_add_path does.
+ *
+ * @param journal Journal.
+ * @param rules Rules to add.
+ * @param count Number of rules.
+ * @param flags Flags as for @ref ll_ruleset_add_path.
+ * @param out_failed Optional output index of the failing rule, when one failed.
+ * @see ll_ruleset_journal_add_path
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_ruleset_journal_add_paths(ll_ruleset_journal_t *const journal,
+                                                                            const ll_path_rule_t *const rules,
+                                                                            const size_t count,
+                                                                            const __u32 flags,
+                                                                            size_t *const out_failed);
+
+/**
+ * @brief Add a TCP port rule to the base ruleset and record it in the journal.
+ *
+ * @param journal Journal.
+ * @param port TCP port.
+ * @param access Network access rights.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_INVALID_ARGUMENT Invalid argument.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ * @return Other negative error codes as for @ref ll_ruleset_add_net_port.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_ruleset_journal_add_net_port(ll_ruleset_journal_t *const journal,
+                                                                               const __u64 port,
+                                                                               const __u64 access);
+
+/**
+ * @brief Create a ruleset holding a journal's rules plus a delta of path rules.
+ *
+ * The ruleset is created with the base's effective ABI and handled
+ * access, without querying the kernel's ABI again, and the journal is
+ * replayed from its descriptors: the time taken is proportional to the
+ * number of rules, and only the paths in @p delta are resolved.
+ *
+ * @param journal Journal.
+ * @param delta Optional path rules to add after the journal's.
+ * @param delta_count Number of delta rules.
+ * @param flags Flags for the delta as for @ref ll_ruleset_add_paths.
+ * @param out_failed Optional output index into @p delta of the failing rule, when one failed.
+ * @return The ruleset, with the status @ref ll_ruleset_journal_create returned when it succeeds.
+ * @see ll_ruleset_create_result
+ */
+__attribute__((warn_unused_result)) ll_ruleset_result_t ll_ruleset_derive(const ll_ruleset_journal_t *const journal,
+                                                                          const ll_path_rule_t *const delta,
+                                                                          const size_t delta_count,
+                                                                          const __u32 flags,
+                                                                          size_t *const out_failed);
+
+/**
+ * @brief Settings of the process-wide descriptor cache, for @ref ll_fd_cache_enable.
+ */
+typedef struct
+{
+    /**
+     * @brief Descriptors kept at most; the least recently used one is evicted beyond it.
+     */
+    unsigned int max_fds;
+    /**
+     * @brief Cache directories only (non-zero), or every path opened.
+     */
+    int directories_only;
+} ll_fd_cache_options_t;
+
+/**
+ * @brief Default settings: at most 256 descriptors, directories only.
+ */
+static inline ll_fd_cache_options_t ll_fd_cache_options_defaults(void)
+{
+    ll_fd_cache_options_t options;
+    options.max_fds = 256;
+    options.directories_only = 1;
+    return options;
+}
+
+/**
+ * @brief Counters of the descriptor cache, accumulated since the process started.
+ */
+typedef struct
+{
+    /**
+     * @brief Paths looked up while the cache was enabled.
+     */
+    __u64 lookups;
+    /**
+     * @brief Lookups served from the cache.
+     */
+    __u64 hits;
+    /**
+     * @brief Cached entries dropped because the path now names another (dev, ino).
+     */
+    __u64 stale;
+    /**
+     * @brief Entries evicted to stay within the descriptor budget.
+     */
+    __u64 evictions;
+    /**
+     * @brief Descriptors currently cached.
+     */
+    unsigned int cached_fds;
+    /**
+     * @brief hits / lookups, or 0 before the first lookup.
+     */
+    double hit_rate;
+} ll_fd_cache_stats_t;
+
+/**
+ * @brief Enable, or resize, the process-wide cache of O_PATH descriptors.
+ *
+ * While enabled, @ref ll_ruleset_add_path and the batch path APIs (@ref
+ * ll_ruleset_add_paths and those built on it) take descriptors from the
+ * cache, keyed by path, instead of opening every path. Each lookup
+ * stat()s the path and reuses the cached descriptor only if it still
+ * refers to the same (dev, ino), so a directory replaced or renamed over
+ * is opened afresh. Shrinking the budget evicts the least recently used
+ * entries. The cache is shared by all threads and rulesets.
+ *
+ * @param options Settings (NULL for @ref ll_fd_cache_options_defaults); a budget of 0 disables the cache.
+ * @retval LL_ERROR_OK Success.
+ * @retval LL_ERROR_OUT_OF_MEMORY Allocation failed.
+ */
+__attribute__((warn_unused_result)) ll_error_t ll_fd_cache_enable(const ll_fd_cache_options_t *const options);
+
+/**
+ * @brief Disable the descriptor cache and close the descriptors it holds.
+ */
+void ll_fd_cache_disable(void);
+
+/**
+ * @brief Read the descriptor cache's counters, including its hit rate.
+ */
+void ll_fd_cache_stats(ll_fd_cache_stats_t *const out_stats);
@@ -7,11 +7,17 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <linux/seccomp.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <poll.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
@@ -354,6 +360,2572 @@ static void test_errata_query(void)
     (void)errata;
 }
 
+static const char audit_fixture[] =
+    "type=LANDLOCK_DOMAIN msg=audit(1729738800.268:30): domain=195ba459b status=allocated mode=enforcing pid=286 uid=0 exe=\"/root/sandboxer\" comm=\"sandboxer\"\n"
+    "type=LANDLOCK_ACCESS msg=audit(1729738800.268:30): domain=195ba459b blockers=fs.read_file path=\"/etc/passwd\" dev=\"vda2\" ino=9\n"
+    "type=SYSCALL msg=audit(1729738800.268:30): arch=c000003e syscall=257 success=no exit=-13\n"
+    "type=LANDLOCK_ACCESS msg=audit(1729738800.270:31): domain=195ba459b blockers=fs.read_file path=\"/etc/shadow\" dev=\"vda2\" ino=12\n"
+    "type=LANDLOCK_ACCESS msg=audit(1729738800.271:32): domain=195ba459b blockers=fs.make_reg,fs.write_file path=2F746D702F6D7920646972 dev=\"tmpfs\" ino=3\n"
+    "type=UNKNOWN[1423] msg=audit(1729738800.272:33): domain=195ba459b blockers=net.connect_tcp daddr=127.0.0.1 dest=443\n"
+    "type=LANDLOCK_DOMAIN msg=audit(1729738800.300:34): domain=195ba459b status=deallocated denials=4\n";
+
+struct audit_test_ctx
+{
+    int records;
+    int domains;
+    int hex_path_seen;
+    int port_seen;
+    size_t summary_entries;
+    __u64 etc_read_count;
+};
+
+static void audit_test_record(const ll_audit_record_t *record, void *ctx)
+{
+    struct audit_test_ctx *t = ctx;
+    t->records++;
+    if (record->type == LL_AUDIT_LANDLOCK_DOMAIN)
+    {
+        t->domains++;
+    }
+    if (record->path && strcmp(record->path, "/tmp/my dir") == 0 &&
+        record->access_fs == (LANDLOCK_ACCESS_FS_MAKE_REG | LANDLOCK_ACCESS_FS_WRITE_FILE))
+    {
+        t->hex_path_seen = 1;
+    }
+    if (record->access_net == LANDLOCK_ACCESS_NET_CONNECT_TCP && record->port == 443)
+    {
+        t->port_seen = 1;
+    }
+}
+
+static void audit_test_summary(const ll_audit_summary_entry_t *entries, size_t count, void *ctx)
+{
+    struct audit_test_ctx *t = ctx;
+    t->summary_entries = count;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (entries[i].domain == 0x195ba459bULL && strcmp(entries[i].prefix, "/etc") == 0 &&
+            entries[i].access == LANDLOCK_ACCESS_FS_READ_FILE)
+        {
+            t->etc_read_count = entries[i].count;
+        }
+    }
+}
+
+static void test_audit_reader_replay(void)
+{
+    char template[] = "/tmp/liblandlock-audit-XXXXXX";
+    int fd = mkstemp(template);
+    if (fd < 0)
+    {
+        fail("failed to create audit fixture");
+        return;
+    }
+    if (write(fd, audit_fixture, strlen(audit_fixture)) != (ssize_t)strlen(audit_fixture))
+    {
+        fail("failed to write audit fixture");
+        close(fd);
+        unlink(template);
+        return;
+    }
+    close(fd);
+
+    struct audit_test_ctx t;
+    memset(&t, 0, sizeof(t));
+    ll_audit_reader_config_t config = ll_audit_reader_config_defaults();
+    config.ring_slots = 4;
+    config.path_prefix_depth = 1;
+    config.on_record = audit_test_record;
+    config.on_summary = audit_test_summary;
+    config.ctx = &t;
+
+    ll_audit_reader_t *reader = NULL;
+    if (ll_audit_reader_create(&config, &reader) != LL_ERROR_OK)
+    {
+        fail("failed to create audit reader");
+        unlink(template);
+        return;
+    }
+
+    if (ll_audit_reader_replay_file(reader, template) != LL_ERROR_OK)
+    {
+        fail("audit fixture replay failed");
+    }
+    unlink(template);
+
+    /* Raw netlink payloads carry the type out of band. */
+    const char payload[] = "audit(1729738800.400:35): domain=195ba459b blockers=fs.read_file path=\"/etc/group\"";
+    if (ll_audit_reader_feed(reader, LL_AUDIT_LANDLOCK_ACCESS, payload, strlen(payload)) != LL_ERROR_OK)
+    {
+        fail("audit feed failed");
+    }
+    if (ll_audit_reader_feed(reader, -1, payload, strlen(payload)) != LL_ERROR_INVALID_ARGUMENT ||
+        ll_audit_reader_feed(reader, 70000, payload, strlen(payload)) != LL_ERROR_INVALID_ARGUMENT)
+    {
+        fail("audit feed should reject record types outside the audit range");
+    }
+
+    ll_audit_reader_stats_t stats = ll_audit_reader_stats(reader);
+    if (t.records != 7 || t.domains != 2 || stats.denials != 5 || stats.skipped != 1)
+    {
+        fail("audit replay did not parse the expected records");
+    }
+    if (!t.hex_path_seen)
+    {
+        fail("audit replay did not decode hex-encoded path");
+    }
+    if (!t.port_seen)
+    {
+        fail("audit replay did not parse network denial");
+    }
+
+    ll_audit_reader_summarize(reader, NULL, NULL);
+    if (t.etc_read_count != 3 || t.summary_entries != 4)
+    {
+        fail("audit aggregation did not group denials by prefix and access");
+    }
+
+    ll_audit_reader_close(reader);
+}
+
+static void test_policy_parse_format(void)
+{
+    const char text[] = "# sample\n"
+                        "handle fs.read_file,fs.read_dir,net.connect_tcp\n"
+                        "path fs.read_file,fs.read_dir /usr\n"
+                        "path fs.read_file /usr\n"
+                        "path fs.read_dir /tmp/with space\n"
+                        "port net.connect_tcp 443\n";
+    ll_policy_t *policy = NULL;
+    if (ll_policy_create(&policy) != LL_ERROR_OK)
+    {
+        fail("failed to create policy");
+        return;
+    }
+    size_t line = 0;
+    if (ll_policy_parse(policy, text, strlen(text), &line) != LL_ERROR_OK)
+    {
+        fail("failed to parse policy text");
+    }
+
+    size_t path_count = 0;
+    size_t port_count = 0;
+    const ll_path_rule_t *paths = ll_policy_paths(policy, &path_count);
+    const ll_port_rule_t *ports = ll_policy_ports(policy, &port_count);
+    if (path_count != 2 || strcmp(paths[0].path, "/usr") != 0 || paths[0].access != LL_ACCESS_GROUP_FS_READ ||
+        strcmp(paths[1].path, "/tmp/with space") != 0)
+    {
+        fail("policy path rules were not merged as expected");
+    }
+    if (port_count != 1 || ports[0].port != 443 || ports[0].access != LANDLOCK_ACCESS_NET_CONNECT_TCP)
+    {
+        fail("policy port rule was not parsed");
+    }
+
+    char *formatted = ll_policy_format(policy);
+    ll_policy_t *reparsed = NULL;
+    if (!formatted || ll_policy_create(&reparsed) != LL_ERROR_OK ||
+        ll_policy_parse(reparsed, formatted, strlen(formatted), NULL) != LL_ERROR_OK)
+    {
+        fail("formatted policy did not parse back");
+    }
+    else
+    {
+        char *again = ll_policy_format(reparsed);
+        if (!again || strcmp(again, formatted) != 0)
+        {
+            fail("policy format is not stable across a round trip");
+        }
+        free(again);
+    }
+    free(formatted);
+    ll_policy_free(reparsed);
+
+    const char bad[] = "handle fs.read_file\npath fs.bogus /usr\n";
+    if (ll_policy_parse(policy, bad, strlen(bad), &line) != LL_ERROR_POLICY_SYNTAX || line != 2)
+    {
+        fail("policy syntax error was not reported with its line");
+    }
+    ll_policy_free(policy);
+}
+
+static void test_learner_offline(void)
+{
+    char template[] = "/tmp/liblandlock-learn-XXXXXX";
+    int fd = mkstemp(template);
+    if (fd < 0)
+    {
+        fail("failed to create learner fixture");
+        return;
+    }
+    if (write(fd, audit_fixture, strlen(audit_fixture)) != (ssize_t)strlen(audit_fixture))
+    {
+        fail("failed to write learner fixture");
+    }
+    close(fd);
+
+    ll_ruleset_attr_t attr = ll_ruleset_attr_create(LL_ABI_LATEST, LL_ABI_COMPAT_BEST_EFFORT);
+    attr = ll_ruleset_attr_fs(attr, LL_ACCESS_GROUP_FS_READ | LL_ACCESS_GROUP_FS_WRITE);
+    attr = ll_ruleset_attr_net(attr, LL_ACCESS_GROUP_NET_CONNECT);
+
+    ll_learner_t *learner = NULL;
+    ll_policy_t *policy = NULL;
+    if (ll_learner_create(attr, &learner) != LL_ERROR_OK)
+    {
+        fail("failed to create learner");
+        unlink(template);
+        return;
+    }
+    if (ll_learner_ingest_file(learner, template) != LL_ERROR_OK ||
+        ll_learner_emit(learner, NULL, &policy) != LL_ERROR_OK)
+    {
+        fail("learner could not derive a policy from recorded denials");
+        ll_learner_free(learner);
+        unlink(template);
+        return;
+    }
+    unlink(template);
+
+    int passwd = 0;
+    int tmp = 0;
+    size_t count = 0;
+    const ll_path_rule_t *paths = ll_policy_paths(policy, &count);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (strcmp(paths[i].path, "/etc/passwd") == 0 && paths[i].access == LANDLOCK_ACCESS_FS_READ_FILE)
+        {
+            passwd = 1;
+        }
+        /* "/tmp/my dir" does not exist, so the rule moves to its parent directory. */
+        if (strcmp(paths[i].path, "/tmp") == 0 &&
+            paths[i].access == (LANDLOCK_ACCESS_FS_MAKE_REG | LANDLOCK_ACCESS_FS_WRITE_FILE))
+        {
+            tmp = 1;
+        }
+    }
+    size_t port_count = 0;
+    const ll_port_rule_t *ports = ll_policy_ports(policy, &port_count);
+    if (!passwd || !tmp || port_count != 1 || ports[0].port != 443)
+    {
+        fail("learned policy does not contain the observed rules");
+    }
+
+    ll_ruleset_result_t res = ll_policy_create_ruleset(policy, attr);
+    if (LL_ERRORED(res.err) &&
+        res.err != LL_ERROR_UNSUPPORTED_SYSCALL &&
+        res.err != LL_ERROR_RULESET_CREATE_DISABLED &&
+        res.err != LL_ERROR_SYSTEM)
+    {
+        fail("learned policy could not be loaded into a ruleset");
+    }
+    ll_ruleset_close(res.ruleset);
+
+    ll_policy_free(policy);
+    ll_learner_free(learner);
+}
+
+static void test_learner_collapse(void)
+{
+    char dir[] = "/tmp/liblandlock-collapse-XXXXXX";
+    if (!mkdtemp(dir))
+    {
+        fail("failed to create learner directory");
+        return;
+    }
+    /* "m/y" sorts between "a" and "z", splitting the directory's files in path order. */
+    static const char *const names[] = {"a", "m", "m/y", "z"};
+    char paths[4][sizeof(dir) + 8];
+    for (size_t i = 0; i < 4; i++)
+    {
+        snprintf(paths[i], sizeof(paths[i]), "%s/%s", dir, names[i]);
+    }
+    char fixture[1024];
+    snprintf(fixture, sizeof(fixture),
+             "type=LANDLOCK_ACCESS msg=audit(1729738800.268:30): domain=195ba459b blockers=fs.read_file path=\"%s\" dev=\"tmpfs\" ino=1\n"
+             "type=LANDLOCK_ACCESS msg=audit(1729738800.268:31): domain=195ba459b blockers=fs.read_file path=\"%s\" dev=\"tmpfs\" ino=2\n"
+             "type=LANDLOCK_ACCESS msg=audit(1729738800.268:32): domain=195ba459b blockers=fs.read_file path=\"%s\" dev=\"tmpfs\" ino=3\n",
+             paths[0], paths[2], paths[3]);
+    char template[] = "/tmp/liblandlock-learn-XXXXXX";
+    const int fd = mkstemp(template);
+    int ok = fd >= 0 && mkdir(paths[1], 0700) == 0;
+    for (size_t i = 0; i < 4 && ok; i++)
+    {
+        const int file = i == 1 ? 0 : open(paths[i], O_WRONLY | O_CREAT | O_CLOEXEC, 0600);
+        ok = file >= 0 && (i == 1 || close(file) == 0);
+    }
+    ok = ok && write(fd, fixture, strlen(fixture)) == (ssize_t)strlen(fixture);
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+
+    ll_ruleset_attr_t attr = ll_ruleset_attr_create(LL_ABI_LATEST, LL_ABI_COMPAT_BEST_EFFORT);
+    attr = ll_ruleset_attr_fs(attr, LL_ACCESS_GROUP_FS_READ);
+    ll_learner_t *learner = NULL;
+    ll_policy_t *policy = NULL;
+    ll_learn_options_t options = ll_learn_options_defaults();
+    options.collapse_threshold = 2;
+    if (!ok || ll_learner_create(attr, &learner) != LL_ERROR_OK ||
+        ll_learner_ingest_file(learner, template) != LL_ERROR_OK ||
+        ll_learner_emit(learner, &options, &policy) != LL_ERROR_OK)
+    {
+        fail("learner could not derive a policy for the collapse test");
+    }
+    else
+    {
+        size_t count = 0;
+        const ll_path_rule_t *rules = ll_policy_paths(policy, &count);
+        if (count != 1 || strcmp(rules[0].path, dir) != 0 || rules[0].access != LANDLOCK_ACCESS_FS_READ_FILE)
+        {
+            fail("files of one directory should collapse across a subdirectory entry");
+        }
+    }
+    ll_policy_free(policy);
+    ll_learner_free(learner);
+    unlink(template);
+    unlink(paths[3]);
+    unlink(paths[2]);
+    rmdir(paths[1]);
+    unlink(paths[0]);
+    rmdir(dir);
+}
+
+static void test_learner_run_exec(void)
+{
+    /* Only execution is handled, so the first run denies the workload's own execve(). */
+    ll_ruleset_attr_t attr = ll_ruleset_attr_create(LL_ABI_LATEST, LL_ABI_COMPAT_BEST_EFFORT);
+    attr = ll_ruleset_attr_fs(attr, LANDLOCK_ACCESS_FS_EXECUTE);
+    ll_learner_t *learner = NULL;
+    if (ll_learner_create(attr, &learner) != LL_ERROR_OK)
+    {
+        fail("failed to create learner");
+        return;
+    }
+    char *const argv[] = {"/bin/true", NULL};
+    ll_learn_report_t report;
+    const ll_error_t err = ll_learner_run(learner, argv, NULL, &report);
+    if (err == LL_ERROR_AUDIT_UNAVAILABLE)
+    {
+        ll_learner_free(learner);
+        return;
+    }
+    /* Without audit records the denial cannot be learned, and the failed exec must surface as an error. */
+    const int ran = WIFEXITED(report.exit_status) && WEXITSTATUS(report.exit_status) == 0;
+    if (err == LL_ERROR_OK ? report.clean && (!ran || report.iterations < 2) : err != LL_ERROR_SYSTEM)
+    {
+        fail("a workload outside the learned policy should be learned, not reported clean");
+    }
+    ll_learner_free(learner);
+}
+
+static void test_evaluator_layers(void)
+{
+    ll_evaluator_t *evaluator = NULL;
+    if (ll_evaluator_create(&evaluator) != LL_ERROR_OK)
+    {
+        fail("failed to create evaluator");
+        return;
+    }
+
+    if (ll_evaluator_check_path(evaluator, "/etc/passwd", LL_ACCESS_GROUP_FS_READ) != 1)
+    {
+        fail("evaluator without layers should allow everything");
+    }
+
+    int ok = ll_evaluator_push_layer_masks(evaluator, LL_ACCESS_GROUP_FS_READ | LL_ACCESS_GROUP_FS_WRITE,
+                                           LL_ACCESS_GROUP_NET_ALL, 0) == LL_ERROR_OK &&
+             ll_evaluator_add_path(evaluator, "/usr", LL_ACCESS_GROUP_FS_READ) == LL_ERROR_OK &&
+             ll_evaluator_add_path(evaluator, "/tmp//work/", LL_ACCESS_GROUP_FS_READ | LL_ACCESS_GROUP_FS_WRITE) ==
+                 LL_ERROR_OK &&
+             ll_evaluator_add_net_port(evaluator, 443, LANDLOCK_ACCESS_NET_CONNECT_TCP) == LL_ERROR_OK &&
+             /* The second layer only handles writes and allows them in one subdirectory. */
+             ll_evaluator_push_layer_masks(evaluator, LANDLOCK_ACCESS_FS_WRITE_FILE, 0, 0) == LL_ERROR_OK &&
+             ll_evaluator_add_path(evaluator, "/tmp/work/out", LANDLOCK_ACCESS_FS_WRITE_FILE) == LL_ERROR_OK;
+    if (!ok)
+    {
+        fail("failed to populate evaluator");
+    }
+
+    if (ll_evaluator_add_path(evaluator, "/usr", LANDLOCK_ACCESS_FS_EXECUTE) != LL_ERROR_ADD_RULE_INCONSISTENT_ACCESS)
+    {
+        fail("evaluator should reject rules outside the handled access");
+    }
+    if (ll_evaluator_check_path(evaluator, "/usr/lib/libc.so.6", LANDLOCK_ACCESS_FS_READ_FILE) != 1 ||
+        ll_evaluator_check_path(evaluator, "/usr/lib/libc.so.6", LANDLOCK_ACCESS_FS_EXECUTE) != 1)
+    {
+        fail("evaluator should allow reads and unhandled access beneath a rule");
+    }
+    if (ll_evaluator_check_path(evaluator, "/etc/passwd", LANDLOCK_ACCESS_FS_READ_FILE) != 0 ||
+        ll_evaluator_check_path(evaluator, "/usrlocal", LANDLOCK_ACCESS_FS_READ_FILE) != 0)
+    {
+        fail("evaluator should deny reads outside the rules");
+    }
+    if (ll_evaluator_check_path(evaluator, "/tmp/work/./a", LANDLOCK_ACCESS_FS_WRITE_FILE) != 0 ||
+        ll_evaluator_check_path(evaluator, "/tmp/work/out/a", LANDLOCK_ACCESS_FS_WRITE_FILE) != 1)
+    {
+        fail("evaluator should intersect stacked layers");
+    }
+    if (ll_evaluator_check_path(evaluator, "/tmp/work/out/../a", LANDLOCK_ACCESS_FS_WRITE_FILE) >= 0)
+    {
+        fail("evaluator should reject queries with dot-dot components");
+    }
+    if (ll_evaluator_check_net_port(evaluator, 443, LANDLOCK_ACCESS_NET_CONNECT_TCP) != 1 ||
+        ll_evaluator_check_net_port(evaluator, 443, LANDLOCK_ACCESS_NET_BIND_TCP) != 0 ||
+        ll_evaluator_check_net_port(evaluator, 80, LANDLOCK_ACCESS_NET_CONNECT_TCP) != 0)
+    {
+        fail("evaluator port checks did not match the rules");
+    }
+
+    ll_evaluator_free(evaluator);
+}
+
+static void test_evaluator_push_policy_error(void)
+{
+    ll_evaluator_t *evaluator = NULL;
+    ll_policy_t *broken = NULL;
+    ll_policy_t *valid = NULL;
+    if (ll_evaluator_create(&evaluator) != LL_ERROR_OK || ll_policy_create(&broken) != LL_ERROR_OK ||
+        ll_policy_create(&valid) != LL_ERROR_OK ||
+        ll_policy_handle(broken, LANDLOCK_ACCESS_FS_READ_FILE, 0, 0) != LL_ERROR_OK ||
+        ll_policy_add_path(broken, "/usr", LANDLOCK_ACCESS_FS_READ_FILE) != LL_ERROR_OK ||
+        ll_policy_add_path(broken, "/etc", LANDLOCK_ACCESS_FS_WRITE_FILE) != LL_ERROR_OK ||
+        ll_policy_handle(valid, LANDLOCK_ACCESS_FS_READ_FILE, 0, 0) != LL_ERROR_OK ||
+        ll_policy_add_path(valid, "/etc", LANDLOCK_ACCESS_FS_READ_FILE) != LL_ERROR_OK)
+    {
+        fail("failed to build policies");
+    }
+    else if (ll_evaluator_push_policy(evaluator, broken) != LL_ERROR_ADD_RULE_INCONSISTENT_ACCESS ||
+             ll_evaluator_check_path(evaluator, "/etc/passwd", LANDLOCK_ACCESS_FS_READ_FILE) != 1)
+    {
+        fail("a policy with an unhandled right should leave no layer behind");
+    }
+    else if (ll_evaluator_push_policy(evaluator, valid) != LL_ERROR_OK ||
+             ll_evaluator_check_path(evaluator, "/etc/passwd", LANDLOCK_ACCESS_FS_READ_FILE) != 1 ||
+             ll_evaluator_check_path(evaluator, "/usr/lib/x", LANDLOCK_ACCESS_FS_READ_FILE) != 0)
+    {
+        fail("rules of a discarded layer should not reach the next one");
+    }
+    ll_policy_free(valid);
+    ll_policy_free(broken);
+    ll_evaluator_free(evaluator);
+}
+
+/* Resolve service names repeatedly; stores nonzero in *(int *)arg on failure. */
+static void *resolve_services(void *const arg)
+{
+    int *const failed = arg;
+    ll_portset_t *set = NULL;
+    *failed = ll_portset_create(&set) != LL_ERROR_OK;
+    for (int i = 0; i < 200 && !*failed; i++)
+    {
+        *failed = ll_portset_parse(set, "https,ssh", LANDLOCK_ACCESS_NET_CONNECT_TCP, NULL) != LL_ERROR_OK ||
+                  ll_portset_count(set) != 2 || ll_portset_access(set, 443) != LANDLOCK_ACCESS_NET_CONNECT_TCP ||
+                  ll_portset_access(set, 22) != LANDLOCK_ACCESS_NET_CONNECT_TCP;
+    }
+    ll_portset_free(set);
+    return NULL;
+}
+
+static void test_portset_services_threads(void)
+{
+    int results[4] = {0};
+    resolve_services(&results[0]);
+    if (results[0])
+    {
+        /* No services database to resolve against. */
+        return;
+    }
+    pthread_t threads[4];
+    size_t started = 0;
+    while (started < 4 && pthread_create(&threads[started], NULL, resolve_services, &results[started]) == 0)
+    {
+        started++;
+    }
+    int failed = started != 4;
+    for (size_t i = 0; i < started; i++)
+    {
+        failed |= pthread_join(threads[i], NULL) != 0 || results[i];
+    }
+    if (failed)
+    {
+        fail("service names should resolve concurrently");
+    }
+}
+
+static void test_portset_ranges(void)
+{
+    ll_portset_t *set = NULL;
+    if (ll_portset_create(&set) != LL_ERROR_OK)
+    {
+        fail("failed to create port set");
+        return;
+    }
+
+    size_t offset = 0;
+    if (ll_portset_parse(set, "8080,32768-60999", LANDLOCK_ACCESS_NET_CONNECT_TCP, &offset) != LL_ERROR_OK ||
+        ll_portset_add_range(set, 8080, 8081, LANDLOCK_ACCESS_NET_BIND_TCP) != LL_ERROR_OK)
+    {
+        fail("failed to add port ranges");
+    }
+    if (ll_portset_parse(set, "80,70000", LANDLOCK_ACCESS_NET_CONNECT_TCP, &offset) !=
+            LL_ERROR_ADD_RULE_PORT_OUT_OF_RANGE ||
+        offset != 3 || ll_portset_access(set, 80) != 0)
+    {
+        fail("out-of-range port should be rejected before anything is added");
+    }
+    const __u64 bad_list[] = {443, 65536};
+    size_t invalid = 0;
+    if (ll_portset_add_list(set, bad_list, 2, LANDLOCK_ACCESS_NET_CONNECT_TCP, &invalid) !=
+            LL_ERROR_ADD_RULE_PORT_OUT_OF_RANGE ||
+        invalid != 1)
+    {
+        fail("out-of-range port list entry should be reported");
+    }
+
+    const size_t expected = (60999 - 32768 + 1) + 2;
+    if (ll_portset_count(set) != expected ||
+        ll_portset_access(set, 8080) != (LANDLOCK_ACCESS_NET_BIND_TCP | LANDLOCK_ACCESS_NET_CONNECT_TCP) ||
+        ll_portset_access(set, 32767) != 0 || ll_portset_access(set, 60999) != LANDLOCK_ACCESS_NET_CONNECT_TCP)
+    {
+        fail("port set contents do not match the added ranges");
+    }
+
+    ll_evaluator_t *evaluator = NULL;
+    if (ll_evaluator_create(&evaluator) != LL_ERROR_OK ||
+        ll_evaluator_push_layer_masks(evaluator, 0, LL_ACCESS_GROUP_NET_ALL, 0) != LL_ERROR_OK ||
+        ll_evaluator_add_portset(evaluator, set) != LL_ERROR_OK ||
+        ll_evaluator_check_net_port(evaluator, 40000, LANDLOCK_ACCESS_NET_CONNECT_TCP) != 1 ||
+        ll_evaluator_check_net_port(evaluator, 40000, LANDLOCK_ACCESS_NET_BIND_TCP) != 0)
+    {
+        fail("evaluator does not reflect the port set");
+    }
+    ll_evaluator_free(evaluator);
+
+    ll_ruleset_attr_t attr = ll_ruleset_attr_create(LL_ABI_LATEST, LL_ABI_COMPAT_BEST_EFFORT);
+    attr = ll_ruleset_attr_net(attr, LL_ACCESS_GROUP_NET_ALL);
+    ll_ruleset_result_t res = ll_ruleset_create_result(attr);
+    if (res.err == LL_ERROR_OK)
+    {
+        size_t rules = 0;
+        if (ll_ruleset_add_portset(res.ruleset, set, 0, &rules) != LL_ERROR_OK || rules != expected)
+        {
+            fail("port set should expand to one rule per port");
+        }
+    }
+    ll_ruleset_close(res.ruleset);
+    ll_portset_free(set);
+}
+
+static void test_policy_merge_stack(void)
+{
+    static const char first_text[] = "handle fs.read_file,fs.write_file,net.connect_tcp\n"
+                                     "path fs.read_file /usr\n"
+                                     "path fs.read_file,fs.write_file /tmp\n"
+                                     "port net.connect_tcp 443\n";
+    static const char second_text[] = "handle fs.write_file,fs.execute\n"
+                                      "path fs.write_file /tmp/work\n"
+                                      "path fs.execute /usr/bin\n";
+    ll_policy_t *first = NULL;
+    ll_policy_t *second = NULL;
+    ll_policy_t *merged = NULL;
+    size_t line = 0;
+    int exact = 0;
+    if (ll_policy_create(&first) != LL_ERROR_OK || ll_policy_create(&second) != LL_ERROR_OK ||
+        ll_policy_parse(first, first_text, sizeof(first_text) - 1, &line) != LL_ERROR_OK ||
+        ll_policy_parse(second, second_text, sizeof(second_text) - 1, &line) != LL_ERROR_OK)
+    {
+        fail("failed to build policies to merge");
+        ll_policy_free(first);
+        ll_policy_free(second);
+        return;
+    }
+    const ll_policy_t *steps[] = {first, second};
+    if (ll_policy_merge(steps, 2, &merged, &exact) != LL_ERROR_OK || !exact)
+    {
+        fail("merging filesystem and network steps should be exact");
+        ll_policy_free(first);
+        ll_policy_free(second);
+        return;
+    }
+
+    ll_evaluator_t *stacked = NULL;
+    ll_evaluator_t *single = NULL;
+    if (ll_evaluator_create(&stacked) != LL_ERROR_OK || ll_evaluator_create(&single) != LL_ERROR_OK ||
+        ll_evaluator_push_policy(stacked, first) != LL_ERROR_OK ||
+        ll_evaluator_push_policy(stacked, second) != LL_ERROR_OK ||
+        ll_evaluator_push_policy(single, merged) != LL_ERROR_OK)
+    {
+        fail("failed to load evaluators");
+    }
+    static const char *const paths[] = {"/usr/bin/env", "/usr/lib/x", "/tmp/a", "/tmp/work/b", "/etc/passwd", "/"};
+    static const __u64 rights[] = {LANDLOCK_ACCESS_FS_READ_FILE, LANDLOCK_ACCESS_FS_WRITE_FILE,
+                                   LANDLOCK_ACCESS_FS_EXECUTE, LANDLOCK_ACCESS_FS_REFER};
+    for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); i++)
+    {
+        for (size_t j = 0; j < sizeof(rights) / sizeof(rights[0]); j++)
+        {
+            if (ll_evaluator_check_path(stacked, paths[i], rights[j]) !=
+                ll_evaluator_check_path(single, paths[i], rights[j]))
+            {
+                fail("merged policy differs from stacked layers");
+            }
+        }
+    }
+    if (ll_evaluator_check_net_port(single, 443, LANDLOCK_ACCESS_NET_CONNECT_TCP) != 1 ||
+        ll_evaluator_check_net_port(single, 80, LANDLOCK_ACCESS_NET_CONNECT_TCP) != 0)
+    {
+        fail("merged policy port rules are wrong");
+    }
+
+    const ll_layer_report_t report = ll_layer_report();
+    if (report.total != report.inherited + report.applied || report.total + report.remaining < LL_MAX_LAYERS)
+    {
+        fail("layer report is inconsistent");
+    }
+
+    /* Enforcing leaves the environment alone until the count is exported. */
+    const pid_t pid = fork();
+    if (pid == 0)
+    {
+        const ll_ruleset_attr_t attr = ll_ruleset_attr_create(LL_ABI_LATEST, LL_ABI_COMPAT_BEST_EFFORT);
+        ll_ruleset_result_t res = ll_ruleset_create_result(ll_ruleset_attr_fs(attr, LANDLOCK_ACCESS_FS_MAKE_DIR));
+        const char *const before = getenv("LIBLANDLOCK_LAYERS");
+        char *const saved = before ? strdup(before) : NULL;
+        if (LL_ERRORED(res.err) || LL_ERRORED(ll_ruleset_enforce(res.ruleset, 0)))
+        {
+            _exit(0);
+        }
+        const char *const after = getenv("LIBLANDLOCK_LAYERS");
+        int ok = (!saved && !after) || (saved && after && strcmp(saved, after) == 0);
+        ll_layer_export();
+        char expected[16];
+        snprintf(expected, sizeof(expected), "%u", ll_layer_report().total);
+        const char *const exported = getenv("LIBLANDLOCK_LAYERS");
+        ok = ok && exported && strcmp(exported, expected) == 0;
+        _exit(ok ? 0 : 1);
+    }
+    int status = 0;
+    if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        fail("layer count should only reach the environment through ll_layer_export");
+    }
+
+    ll_evaluator_free(stacked);
+    ll_evaluator_free(single);
+    ll_policy_free(merged);
+    ll_policy_free(first);
+    ll_policy_free(second);
+}
+
+static void check_phases(const ll_policy_t *startup, const ll_policy_t *serving, const ll_policy_t *widen)
+{
+    ll_ruleset_attr_t attr = ll_ruleset_attr_create(LL_ABI_LATEST, LL_ABI_COMPAT_BEST_EFFORT);
+    ll_phases_t *phases = NULL;
+    unsigned int warnings = 0;
+    if (ll_phases_create(attr, 0, &phases) != LL_ERROR_OK)
+    {
+        fail("failed to create phases");
+        return;
+    }
+    if (LL_ERRORED(ll_phases_add(phases, startup, &warnings)))
+    {
+        /* Kernel without Landlock: rulesets cannot be prebuilt. */
+        ll_phases_free(phases);
+        return;
+    }
+    if (warnings & (LL_PHASE_WARN_NOT_SUBSET | LL_PHASE_WARN_NO_EFFECT))
+    {
+        fail("first phase should not be compared with anything");
+    }
+    if (LL_ERRORED(ll_phases_add(phases, serving, &warnings)) || warnings != 0)
+    {
+        fail("narrowing phase should be accepted without warnings");
+    }
+    if (LL_ERRORED(ll_phases_add(phases, serving, &warnings)) || warnings != LL_PHASE_WARN_NO_EFFECT)
+    {
+        fail("repeated phase should be reported as a wasted layer");
+    }
+    if (LL_ERRORED(ll_phases_add(phases, widen, &warnings)) || !(warnings & LL_PHASE_WARN_NOT_SUBSET))
+    {
+        fail("widening phase should be reported");
+    }
+    if (ll_phases_advance(phases) != LL_ERROR_INVALID_ARGUMENT)
+    {
+        fail("phases should not be entered before sealing");
+    }
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        if (ll_phases_seal(phases) != LL_ERROR_OK || ll_phases_advance(phases) != LL_ERROR_OK)
+        {
+            _exit(1);
+        }
+        int fd = open("/etc/passwd", O_RDONLY);
+        if (fd < 0)
+        {
+            _exit(1);
+        }
+        close(fd);
+        if (ll_phases_advance(phases) != LL_ERROR_OK || ll_phases_current(phases) != 2)
+        {
+            _exit(1);
+        }
+        fd = open("/etc/passwd", O_RDONLY);
+        _exit(fd < 0 ? 0 : 1);
+    }
+    int status = 0;
+    if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        fail("phase transitions did not restrict as expected");
+    }
+    ll_phases_free(phases);
+}
+
+static void test_phases(void)
+{
+    static const char startup_text[] = "handle fs.read_file,fs.write_file\n"
+                                       "path fs.read_file /\n"
+                                       "path fs.read_file,fs.write_file /tmp\n";
+    static const char serving_text[] = "handle fs.read_file,fs.write_file\n"
+                                       "path fs.read_file /usr\n"
+                                       "path fs.read_file,fs.write_file /tmp\n";
+    static const char widen_text[] = "handle fs.write_file\n"
+                                     "path fs.write_file /var\n";
+    ll_policy_t *startup = NULL;
+    ll_policy_t *serving = NULL;
+    ll_policy_t *widen = NULL;
+    size_t line = 0;
+    if (ll_policy_create(&startup) != LL_ERROR_OK || ll_policy_create(&serving) != LL_ERROR_OK ||
+        ll_policy_create(&widen) != LL_ERROR_OK ||
+        ll_policy_parse(startup, startup_text, sizeof(startup_text) - 1, &line) != LL_ERROR_OK ||
+        ll_policy_parse(serving, serving_text, sizeof(serving_text) - 1, &line) != LL_ERROR_OK ||
+        ll_policy_parse(widen, widen_text, sizeof(widen_text) - 1, &line) != LL_ERROR_OK)
+    {
+        fail("failed to build phase policies");
+    }
+    else
+    {
+        check_phases(startup, serving, widen);
+    }
+
+    ll_policy_free(startup);
+    ll_policy_free(serving);
+    ll_policy_free(widen);
+}
+
+static void test_broker_socketpair(void)
+{
+    ll_ruleset_attr_t attr = ll_ruleset_attr_create(LL_ABI_LATEST, LL_ABI_COMPAT_BEST_EFFORT);
+    attr = ll_ruleset_attr_fs(attr, LANDLOCK_ACCESS_FS_READ_FILE);
+    ll_ruleset_journal_t *journal = NULL;
+    if (LL_ERRORED(ll_ruleset_journal_create(attr, &journal)))
+    {
+        /* Kernel without Landlock: nothing to broker. */
+        return;
+    }
+
+    ll_broker_t *broker = NULL;
+    if (ll_broker_create(&broker) != LL_ERROR_OK || ll_broker_add(broker, "web", journal) != LL_ERROR_OK)
+    {
+        fail("failed to publish ruleset");
+        ll_ruleset_journal_free(journal);
+        ll_broker_free(broker);
+        return;
+    }
+
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0)
+    {
+        fail("failed to create socket pair");
+        ll_broker_free(broker);
+        return;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(sv[0]);
+        ll_ruleset_result_t missing = ll_broker_fetch(sv[1], "db");
+        if (missing.err != LL_ERROR_BROKER_NOT_FOUND || missing.ruleset)
+        {
+            _exit(1);
+        }
+        /* Rules added to one client's ruleset must not reach the next client's. */
+        ll_ruleset_result_t widened = ll_broker_fetch(sv[1], "web");
+        if (widened.err != LL_ERROR_OK ||
+            ll_ruleset_add_path(widened.ruleset, "/etc/passwd", LANDLOCK_ACCESS_FS_READ_FILE, 0) != LL_ERROR_OK)
+        {
+            _exit(1);
+        }
+        ll_ruleset_close(widened.ruleset);
+        ll_ruleset_result_t fetched = ll_broker_fetch(sv[1], "web");
+        ll_ruleset_info_t info;
+        if (fetched.err != LL_ERROR_OK || ll_ruleset_info(fetched.ruleset, &info) < 0 ||
+            info.handled_access_fs != LANDLOCK_ACCESS_FS_READ_FILE ||
+            ll_ruleset_enforce(fetched.ruleset, 0) != LL_ERROR_OK)
+        {
+            _exit(1);
+        }
+        ll_ruleset_close(fetched.ruleset);
+        _exit(open("/etc/passwd", O_RDONLY) < 0 ? 0 : 1);
+    }
+    close(sv[1]);
+
+    if (pid < 0 || ll_broker_serve_fd(broker, sv[0]) != 1 || ll_broker_serve_fd(broker, sv[0]) != 1 ||
+        ll_broker_serve_fd(broker, sv[0]) != 1)
+    {
+        fail("broker failed to answer requests");
+    }
+    int status = 0;
+    if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        fail("brokered ruleset did not restrict the client");
+    }
+    if (ll_broker_serve_fd(broker, sv[0]) != 0)
+    {
+        fail("broker should report the closed connection");
+    }
+
+    int pipe_fds[2];
+    if (pipe(pipe_fds) == 0)
+    {
+        ll_ruleset_info_t info = {.abi = 1, .compat_mode = LL_ABI_COMPAT_BEST_EFFORT};
+        ll_ruleset_result_t bogus = ll_ruleset_from_fd(pipe_fds[0], info);
+        if (bogus.err != LL_ERROR_INVALID_ARGUMENT)
+        {
+            fail("non-ruleset descriptor should be rejected");
+            ll_ruleset_close(bogus.ruleset);
+        }
+        else
+        {
+            close(pipe_fds[0]);
+        }
+        close(pipe_fds[1]);
+    }
+
+    close(sv[0]);
+    ll_broker_free(broker);
+}
+
+/* Fetch "web" as user 65534 while the broker serves; returns the child's exit status. */
+static int broker_fetch_as_nobody(ll_broker_t *const broker, const char *const path, const ll_error_t expected)
+{
+    const pid_t pid = fork();
+    if (pid == 0)
+    {
+        int fd = -1;
+        if (setgid(65534) < 0 || setuid(65534) < 0 || ll_broker_connect(path, &fd) != LL_ERROR_OK)
+        {
+            _exit(1);
+        }
+        ll_ruleset_result_t res = ll_broker_fetch(fd, "web");
+        ll_ruleset_close(res.ruleset);
+        _exit(res.err == expected ? 0 : 2);
+    }
+    int status = -1;
+    while (pid > 0 && waitpid(pid, &status, WNOHANG) == 0)
+    {
+        size_t served = 0;
+        if (ll_broker_poll(broker, 50, &served) != LL_ERROR_OK)
+        {
+            break;
+        }
+    }
+    return status;
+}
+
+static void test_broker_peer_check(void)
+{
+    ll_ruleset_attr_t attr = ll_ruleset_attr_create(LL_ABI_LATEST, LL_ABI_COMPAT_BEST_EFFORT);
+    attr = ll_ruleset_attr_fs(attr, LANDLOCK_ACCESS_FS_READ_FILE);
+    ll_ruleset_journal_t *journal = NULL;
+    if (geteuid() != 0 || LL_ERRORED(ll_ruleset_journal_create(attr, &journal)))
+    {
+        /* Checking another user's request needs root to switch users. */
+        return;
+    }
+    char dir[] = "/tmp/ll-broker-XXXXXX";
+    if (!mkdtemp(dir))
+    {
+        fail("failed to create temporary directory");
+        ll_ruleset_journal_free(journal);
+        return;
+    }
+    char path[sizeof(dir) + 8];
+    snprintf(path, sizeof(path), "%s/sock", dir);
+    ll_broker_t *broker = NULL;
+    if (ll_broker_create(&broker) != LL_ERROR_OK || ll_broker_add(broker, "web", journal) != LL_ERROR_OK ||
+        ll_broker_listen(broker, path) != LL_ERROR_OK || chmod(dir, 0755) < 0 || chmod(path, 0777) < 0)
+    {
+        fail("failed to start broker");
+    }
+    else
+    {
+        const int denied = broker_fetch_as_nobody(broker, path, LL_ERROR_BROKER_DENIED);
+        const int allowed = ll_broker_allow_uid(broker, 65534) == LL_ERROR_OK
+                                ? broker_fetch_as_nobody(broker, path, LL_ERROR_OK)
+                                : -1;
+        if (!WIFEXITED(denied) || WEXITSTATUS(denied) != 0 || !WIFEXITED(allowed) || WEXITSTATUS(allowed) != 0)
+        {
+            fail("the broker should serve only allowed users");
+        }
+    }
+    ll_broker_free(broker);
+    unlink(path);
+    rmdir(dir);
+}
+
+/* Client side of test_broker_connection_cache; sync[0] asks for a new journal, sync[1] waits for it. */
+static int broker_cache_client(const char *const path, const int request_fd, const int reply_fd)
+{
+    int fd = -1;
+    if (ll_broker_connect(path, &fd) != LL_ERROR_OK)
+    {
+        return 1;
+    }
+    ll_ruleset_result_t widened = ll_broker_fetch(fd, "web");
+    if (widened.err != LL_ERROR_OK ||
+        ll_ruleset_add_path(widened.ruleset, "/etc/passwd", LANDLOCK_ACCESS_FS_READ_FILE, 0) != LL_ERROR_OK)
+    {
+        return 2;
+    }
+    ll_ruleset_close(widened.ruleset);
+
+    /* The same connection gets its cached ruleset back, with the rule it added. */
+    ll_ruleset_result_t cached = ll_broker_fetch(fd, "web");
+    if (cached.err != LL_ERROR_OK)
+    {
+        return 3;
+    }
+    const pid_t pid = fork();
+    if (pid == 0)
+    {
+        _exit(ll_ruleset_enforce(cached.ruleset, 0) == LL_ERROR_OK && open("/etc/passwd", O_RDONLY) >= 0 ? 0 : 1);
+    }
+    int status = -1;
+    if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        return 4;
+    }
+    ll_ruleset_close(cached.ruleset);
+
+    /* Replacing the journal invalidates the cached ruleset. */
+    char byte = 0;
+    if (write(request_fd, &byte, 1) != 1 || read(reply_fd, &byte, 1) != 1)
+    {
+        return 5;
+    }
+    ll_ruleset_result_t fresh = ll_broker_fetch(fd, "web");
+    if (fresh.err != LL_ERROR_OK || ll_ruleset_enforce(fresh.ruleset, 0) != LL_ERROR_OK)
+    {
+        return 6;
+    }
+    return open("/etc/passwd", O_RDONLY) < 0 ? 0 : 7;
+}
+
+static void test_broker_connection_cache(void)
+{
+    ll_ruleset_attr_t attr = ll_ruleset_attr_create(LL_ABI_LATEST, LL_ABI_COMPAT_BEST_EFFORT);
+    attr = ll_ruleset_attr_fs(attr, LANDLOCK_ACCESS_FS_READ_FILE);
+    ll_ruleset_journal_t *journal = NULL;
+    ll_ruleset_journal_t *replacement = NULL;
+    if (LL_ERRORED(ll_ruleset_journal_create(attr, &journal)))
+    {
+        return;
+    }
+    if (ll_ruleset_journal_create(attr, &replacement) != LL_ERROR_OK)
+    {
+        fail("failed to create journal");
+        ll_ruleset_journal_free(journal);
+        return;
+    }
+    char dir[] = "/tmp/ll-broker-XXXXXX";
+    if (!mkdtemp(dir))
+    {
+        fail("failed to create temporary directory");
+        ll_ruleset_journal_free(journal);
+        ll_ruleset_journal_free(replacement);
+        return;
+    }
+    char path[sizeof(dir) + 8];
+    snprintf(path, sizeof(path), "%s/sock", dir);
+    ll_broker_t *broker = NULL;
+    int request[2] = {-1, -1};
+    int reply[2] = {-1, -1};
+    if (ll_broker_create(&broker) != LL_ERROR_OK || ll_broker_add(broker, "web", journal) != LL_ERROR_OK ||
+        ll_broker_listen(broker, path) != LL_ERROR_OK || pipe(request) < 0 || pipe(reply) < 0 ||
+        fcntl(request[0], F_SETFL, O_NONBLOCK) < 0)
+    {
+        fail("failed to start broker");
+    }
+    else
+    {
+        const pid_t pid = fork();
+        if (pid == 0)
+        {
+            _exit(broker_cache_client(path, request[1], reply[0]));
+        }
+        int status = -1;
+        while (pid > 0 && waitpid(pid, &status, WNOHANG) == 0)
+        {
+            size_t served = 0;
+            char byte;
+            if (ll_broker_poll(broker, 50, &served) != LL_ERROR_OK)
+            {
+                break;
+            }
+            if (replacement && read(request[0], &byte, 1) == 1)
+            {
+                if (ll_broker_add(broker, "web", replacement) != LL_ERROR_OK || write(reply[1], &byte, 1) != 1)
+                {
+                    break;
+                }
+                replacement = NULL;
+            }
+        }
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            fail("a connection should reuse its ruleset until the journal is replaced");
+        }
+    }
+
+    /* A non-blocking connection without a pending request is not an error to drop it for. */
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0, sv) == 0)
+    {
+        errno = 0;
+        if (ll_broker_serve_fd(broker, sv[0]) != LL_ERROR_SYSTEM || (errno != EAGAIN && errno != EWOULDBLOCK))
+        {
+            fail("an empty non-blocking connection should report EAGAIN");
+        }
+        close(sv[0]);
+        close(sv[1]);
+    }
+
+    for (size_t i = 0; i < 2; i++)
+    {
+        if (request[i] >= 0)
+        {
+            close(request[i]);
+        }
+        if (reply[i] >= 0)
+        {
+            close(reply[i]);
+        }
+    }
+    ll_ruleset_journal_free(replacement);
+    ll_broker_free(broker);
+    unlink(path);
+    rmdir(dir);
+}
+
+static int run_open_worker(const int conn_fd)
+{
+    ll_open_worker_t *worker = NULL;
+    if (ll_open_worker_connect(conn_fd, 0, &worker) != LL_ERROR_OK)
+    {
+        return 1;
+    }
+    /* The worker's own ruleset denies every read. */
+    if (open("/etc/passwd", O_RDONLY) >= 0)
+    {
+        return 2;
+    }
+
+    const size_t reads = LL_OPEN_RING_SLOTS - 2;
+    for (size_t i = 0; i < reads; i++)
+    {
+        if (ll_open_worker_submit(worker, "/etc/passwd", O_RDONLY, 0, NULL) != LL_ERROR_OK)
+        {
+            return 3;
+        }
+    }
+    if (ll_open_worker_submit(worker, "/etc/passwd", O_WRONLY, 0, NULL) != LL_ERROR_OK ||
+        ll_open_worker_submit(worker, "/usr/../etc/passwd", O_RDONLY, 0, NULL) != LL_ERROR_OK ||
+        ll_open_worker_submit(worker, "/etc/passwd", O_RDONLY, 0, NULL) != LL_ERROR_OUT_OF_MEMORY)
+    {
+        return 4;
+    }
+
+    static ll_open_result_t results[LL_OPEN_RING_SLOTS];
+    size_t count = 0;
+    if (ll_open_worker_flush(worker, results, LL_OPEN_RING_SLOTS, &count) != LL_ERROR_OK ||
+        count != LL_OPEN_RING_SLOTS)
+    {
+        return 5;
+    }
+    for (size_t i = 0; i < reads; i++)
+    {
+        char c;
+        if (results[i].error != 0 || read(results[i].fd, &c, 1) != 1)
+        {
+            return 6;
+        }
+        close(results[i].fd);
+    }
+    if (results[reads].error != EACCES || results[reads + 1].error != EINVAL)
+    {
+        return 7;
+    }
+
+    const int fd = ll_open_worker_open(worker, "/etc/passwd", O_RDONLY, 0);
+    if (fd < 0 || ll_open_worker_open(worker, "/etc/hostname", O_RDONLY, 0) >= 0 || errno != EACCES)
+    {
+        return 8;
+    }
+    close(fd);
+    ll_open_worker_free(worker);
+    return 0;
+}
+
+static void test_open_broker(void)
+{
+    ll_ruleset_attr_t attr = ll_ruleset_attr_create(LL_ABI_LATEST, LL_ABI_COMPAT_BEST_EFFORT);
+    attr = ll_ruleset_attr_fs(attr, LANDLOCK_ACCESS_FS_READ_FILE);
+    ll_ruleset_result_t res = ll_ruleset_create_result(attr);
+    if (LL_ERRORED(res.err))
+    {
+        /* Kernel without Landlock: the worker could not be sandboxed. */
+        return;
+    }
+
+    ll_evaluator_t *evaluator = NULL;
+    int sv[2] = {-1, -1};
+    if (ll_evaluator_create(&evaluator) != LL_ERROR_OK ||
+        ll_evaluator_push_layer_masks(evaluator, LANDLOCK_ACCESS_FS_READ_FILE | LANDLOCK_ACCESS_FS_WRITE_FILE, 0, 0) !=
+            LL_ERROR_OK ||
+        ll_evaluator_add_path(evaluator, "/etc/passwd", LANDLOCK_ACCESS_FS_READ_FILE) != LL_ERROR_OK ||
+        socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0)
+    {
+        fail("failed to set up the file-open broker test");
+        ll_evaluator_free(evaluator);
+        ll_ruleset_close(res.ruleset);
+        return;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(sv[0]);
+        _exit(run_open_worker(sv[1]));
+    }
+    close(sv[1]);
+
+    ll_open_broker_t *broker = NULL;
+    if (pid < 0 || ll_open_broker_create(evaluator, res.ruleset, sv[0], &broker) != LL_ERROR_OK)
+    {
+        fail("failed to start the file-open broker");
+        close(sv[0]);
+    }
+    else
+    {
+        while (ll_open_broker_serve(broker) > 0)
+        {
+        }
+    }
+
+    int status = 0;
+    if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        fail("file-open worker did not get the expected results");
+    }
+    ll_open_broker_free(broker);
+    ll_evaluator_free(evaluator);
+    ll_ruleset_close(res.ruleset);
+}
+
+static int plugin_probe(void *ctx, const void *in, size_t in_len, void *out, size_t out_capacity, size_t *out_len)
+{
+    const char *text = in;
+    char *reply = out;
+    size_t len = in_len < out_capacity ? in_len : out_capacity;
+    for (size_t i = 0; i < len; i++)
+    {
+        reply[i] = text[len - 1 - i];
+    }
+    *out_len = len;
+
+    /* Report whether a descriptor of the host was inherited. */
+    if (ctx && fcntl(*(const int *)ctx, F_GETFD) >= 0)
+    {
+        return 2;
+    }
+    /* Report whether the sandbox still lets the plugin read files. */
+    const int fd = open("/etc/passwd", O_RDONLY);
+    if (fd >= 0)
+    {
+        close(fd);
+        return 1;
+    }
+    return 0;
+}
+
+static void test_plugin_host(void)
+{
+    ll_ruleset_attr_t attr = ll_ruleset_attr_create(LL_ABI_LATEST, LL_ABI_COMPAT_BEST_EFFORT);
+    attr = ll_ruleset_attr_fs(attr, LANDLOCK_ACCESS_FS_READ_FILE);
+    attr = ll_ruleset_attr_scope(attr, LANDLOCK_SCOPE_SIGNAL | LANDLOCK_SCOPE_ABSTRACT_UNIX_SOCKET);
+    ll_ruleset_result_t res = ll_ruleset_create_result(attr);
+    if (LL_ERRORED(res.err))
+    {
+        /* Kernel without Landlock: the helper could not be sandboxed. */
+        return;
+    }
+
+    /* The helper must not inherit this descriptor, which it could use despite the ruleset. */
+    int host_fd = open("/etc/hosts", O_RDONLY | O_CLOEXEC);
+    ll_plugin_options_t options = ll_plugin_options_defaults();
+    options.fn = plugin_probe;
+    options.ctx = &host_fd;
+    options.buffer_size = 256;
+    ll_plugin_host_t *host = NULL;
+    if (ll_plugin_host_start(&options, res.ruleset, &host) != LL_ERROR_OK)
+    {
+        fail("failed to start plugin host");
+        ll_ruleset_close(res.ruleset);
+        return;
+    }
+
+    for (int i = 0; i < 100; i++)
+    {
+        size_t capacity = 0;
+        char *request = ll_plugin_host_request_buffer(host, &capacity);
+        const int len = snprintf(request, capacity, "call %d", i);
+        const void *response = NULL;
+        size_t response_len = 0;
+        int status = -1;
+        char expected[32];
+        for (int j = 0; j < len; j++)
+        {
+            expected[j] = request[len - 1 - j];
+        }
+        if (ll_plugin_host_call(host, (size_t)len, &response, &response_len, &status) != LL_ERROR_OK ||
+            response_len != (size_t)len || memcmp(response, expected, (size_t)len) != 0 || status != 0)
+        {
+            fail("plugin call returned an unexpected response");
+            break;
+        }
+    }
+    if (ll_plugin_host_call(host, 257, NULL, NULL, NULL) != LL_ERROR_INVALID_ARGUMENT)
+    {
+        fail("oversized plugin request should be rejected");
+    }
+
+    int wait_status = -1;
+    ll_plugin_host_stop(host, &wait_status);
+    if (!WIFEXITED(wait_status) || WEXITSTATUS(wait_status) != 0)
+    {
+        fail("plugin helper did not shut down cleanly");
+    }
+
+    options.fn = NULL;
+    options.library = "liblandlock-no-such-plugin.so";
+    options.symbol = "plugin_main";
+    if (ll_plugin_host_start(&options, res.ruleset, &host) != LL_ERROR_PLUGIN_EXITED)
+    {
+        fail("missing plugin library should stop the helper");
+    }
+    ll_ruleset_close(res.ruleset);
+    if (host_fd >= 0)
+    {
+        close(host_fd);
+    }
+}
+
+static void test_elf_analyze(void)
+{
+    ll_elf_deps_t *deps = NULL;
+    if (ll_elf_analyze("/etc/passwd", &deps) != LL_ERROR_INVALID_ARGUMENT)
+    {
+        fail("non-ELF file should be rejected");
+        ll_elf_deps_free(deps);
+    }
+    if (ll_elf_analyze("/bin/true", &deps) != LL_ERROR_OK)
+    {
+        fail("failed to analyse /bin/true");
+        return;
+    }
+    const size_t count = ll_elf_deps_count(deps);
+    int has_libc = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        has_libc |= strstr(ll_elf_deps_path(deps, i), "libc.so") != NULL;
+    }
+    if (strcmp(ll_elf_deps_path(deps, 0), "/bin/true") != 0 || (count > 1 && !has_libc))
+    {
+        fail("analysis should list the binary and its C library");
+    }
+
+    ll_elf_deps_t *cached = NULL;
+    if (ll_elf_analyze("/bin/true", &cached) != LL_ERROR_OK || ll_elf_deps_count(cached) != count)
+    {
+        fail("cached analysis should match the first one");
+    }
+    ll_elf_deps_free(cached);
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        ll_ruleset_attr_t attr = ll_ruleset_attr_create(LL_ABI_LATEST, LL_ABI_COMPAT_BEST_EFFORT);
+        attr = ll_ruleset_attr_fs(attr, LANDLOCK_ACCESS_FS_EXECUTE | LANDLOCK_ACCESS_FS_READ_FILE);
+        ll_ruleset_result_t res = ll_ruleset_create_result(attr);
+        if (LL_ERRORED(res.err))
+        {
+            _exit(0);
+        }
+        /* Collapsing every directory must not widen the loader cache's rule to /etc. */
+        if (ll_ruleset_add_elf_deps(res.ruleset, deps, 1, 0, NULL) != LL_ERROR_OK ||
+            ll_ruleset_enforce(res.ruleset, 0) != LL_ERROR_OK)
+        {
+            _exit(1);
+        }
+        if (open("/etc/passwd", O_RDONLY) >= 0 || (count > 1 && open("/etc/ld.so.cache", O_RDONLY) < 0))
+        {
+            _exit(1);
+        }
+        execl("/bin/true", "true", (char *)NULL);
+        _exit(1);
+    }
+    int status = 0;
+    if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        fail("binary should run with only its analysed dependencies allowed");
+    }
+    ll_elf_deps_free(deps);
+}
+
+static void test_mapped_files(void)
+{
+    char template[] = "/tmp/liblandlock-mapped-XXXXXX";
+    const int log_fd = mkstemp(template);
+    if (log_fd < 0)
+    {
+        fail("failed to create temporary file");
+        return;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        ll_ruleset_attr_t attr = ll_ruleset_attr_create(LL_ABI_LATEST, LL_ABI_COMPAT_BEST_EFFORT);
+        attr = ll_ruleset_attr_fs(attr, LANDLOCK_ACCESS_FS_READ_FILE | LANDLOCK_ACCESS_FS_WRITE_FILE |
+                                            LANDLOCK_ACCESS_FS_EXECUTE);
+        ll_ruleset_result_t res = ll_ruleset_create_result(attr);
+        if (LL_ERRORED(res.err))
+        {
+            _exit(0);
+        }
+        char exe[PATH_MAX];
+        const ssize_t len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+        size_t added = 0;
+        if (len <= 0 ||
+            ll_ruleset_add_mapped_files(res.ruleset, LL_MAPPED_FILES_OPEN_FDS, 0, &added) != LL_ERROR_OK ||
+            added < 2 || ll_ruleset_enforce(res.ruleset, 0) != LL_ERROR_OK)
+        {
+            _exit(1);
+        }
+        exe[len] = '\0';
+        const int exe_fd = open(exe, O_RDONLY);
+        const int log_again = open(template, O_WRONLY);
+        if (exe_fd < 0 || log_again < 0 || open("/etc/passwd", O_RDONLY) >= 0 || open(exe, O_WRONLY) >= 0)
+        {
+            _exit(1);
+        }
+        _exit(0);
+    }
+    int status = 0;
+    if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        fail("mapped and open files should stay accessible, and nothing else");
+    }
+    close(log_fd);
+    unlink(template);
+}
+
+static void test_mount_plan(void)
+{
+    ll_mount_table_t *table = NULL;
+    if (ll_mount_table_load(&table) != LL_ERROR_OK || ll_mount_table_count(table) == 0)
+    {
+        fail("mount table should load");
+        ll_mount_table_free(table);
+        return;
+    }
+    ll_mount_info_t info;
+    const long proc = ll_mount_table_find(table, "//proc/./self");
+    if (proc < 0 || ll_mount_table_get(table, (size_t)proc, &info) != 0 || strcmp(info.fs_type, "proc") != 0 ||
+        strcmp(info.mount_point, "/proc") != 0)
+    {
+        fail("/proc/self should resolve to the proc mount");
+    }
+    if (ll_mount_table_find(table, "proc") != -1 || ll_mount_table_find(table, "/proc/../etc") != -1)
+    {
+        fail("relative paths and .. should be rejected");
+    }
+
+    const __u64 read = LANDLOCK_ACCESS_FS_READ_FILE;
+    const ll_path_rule_t rules[] = {
+        {"/proc/self", read},
+        {"/", read},
+        {"/proc/1", read},
+        {"/proc/", LANDLOCK_ACCESS_FS_READ_DIR},
+    };
+    const char *const slow[] = {"proc", NULL};
+    ll_plan_options_t options = ll_plan_options_defaults();
+    options.collapse_threshold = 2;
+    options.slow_fs_types = slow;
+    options.slow_action = LL_PLAN_SLOW_DEFER;
+    ll_plan_rule_t plan[4];
+    size_t count = 0;
+    if (ll_mount_plan(table, rules, 4, &options, plan, &count) != LL_ERROR_OK || count != 3)
+    {
+        fail("collapsed plan should keep three rules");
+        ll_mount_table_free(table);
+        return;
+    }
+    if (strcmp(plan[0].path, "/") != 0 || !(plan[0].flags & LL_PLAN_SUBMOUNTS) || (plan[0].flags & LL_PLAN_SLOW))
+    {
+        fail("root rule should come first and cover submounts");
+    }
+    if (strcmp(plan[1].path, "/proc") != 0 || plan[1].mount_index != proc || plan[1].access != read ||
+        plan[1].flags != (LL_PLAN_COLLAPSED | LL_PLAN_SLOW | LL_PLAN_DEFERRED))
+    {
+        fail("proc rules should collapse to the mount point and be deferred");
+    }
+    if (strcmp(plan[2].path, "/proc/") != 0 || !(plan[2].flags & LL_PLAN_DEFERRED) ||
+        (plan[2].flags & LL_PLAN_COLLAPSED))
+    {
+        fail("rule with other access should stay apart");
+    }
+
+    ll_ruleset_attr_t attr = ll_ruleset_attr_create(LL_ABI_LATEST, LL_ABI_COMPAT_BEST_EFFORT);
+    attr = ll_ruleset_attr_fs(attr, LANDLOCK_ACCESS_FS_READ_FILE | LANDLOCK_ACCESS_FS_READ_DIR);
+    ll_ruleset_result_t res = ll_ruleset_create_result(attr);
+    if (!LL_ERRORED(res.err))
+    {
+        if (ll_ruleset_add_plan(res.ruleset, plan, count, 1, 0, NULL) != LL_ERROR_OK)
+        {
+            fail("planned rules should be added");
+        }
+        ll_ruleset_close(res.ruleset);
+    }
+    ll_mount_table_free(table);
+}
+
+struct stalled_open
+{
+    const char *path;
+    int fd;
+};
+
+static int stalled_open(void *const ctx, const char *const path)
+{
+    struct stalled_open *const stalled = ctx;
+    if (strcmp(path, stalled->path) == 0)
+    {
+        char c;
+        (void)!read(stalled->fd, &c, 1);
+        close(stalled->fd);
+    }
+    return open(path, O_PATH | O_CLOEXEC);
+}
+
+static void test_add_paths_bounded(void)
+{
+    ll_ruleset_attr_t attr = ll_ruleset_attr_create(LL_ABI_LATEST, LL_ABI_COMPAT_BEST_EFFORT);
+    attr = ll_ruleset_attr_fs(attr, LANDLOCK_ACCESS_FS_READ_FILE);
+    ll_ruleset_result_t res = ll_ruleset_create_result(attr);
+    if (LL_ERRORED(res.err))
+    {
+        return;
+    }
+    const __u64 read = LANDLOCK_ACCESS_FS_READ_FILE;
+    ll_path_rule_t rules[] = {
+        {"/etc", read},
+        {"/usr", read},
+        {"/tmp", read},
+        {"/nonexistent-liblandlock", read},
+    };
+    ll_error_t results[4];
+    size_t failed = 0;
+    if (ll_ruleset_add_paths_bounded(res.ruleset, rules, 3, NULL, 0, results, &failed) != LL_ERROR_OK ||
+        results[0] != LL_ERROR_OK || results[2] != LL_ERROR_OK)
+    {
+        fail("healthy paths should be added");
+    }
+    if (ll_ruleset_add_paths_bounded(res.ruleset, rules, 4, NULL, 0, results, &failed) != LL_ERROR_ADD_RULE_BAD_FD ||
+        failed != 3)
+    {
+        fail("a missing path should fail like ll_ruleset_add_paths");
+    }
+
+    /* One open blocks until the write end of the pipe is closed, standing in for a stalled mount. */
+    int stall[2];
+    if (pipe(stall) < 0)
+    {
+        fail("failed to create pipe");
+        ll_ruleset_close(res.ruleset);
+        return;
+    }
+    static struct stalled_open stalled;
+    stalled.path = rules[1].path;
+    stalled.fd = stall[0];
+    ll_resolve_options_t options = ll_resolve_options_defaults();
+    options.path_timeout_ms = 50;
+    options.threads = 1;
+    options.open_path = stalled_open;
+    options.open_ctx = &stalled;
+    const ll_error_t err = ll_ruleset_add_paths_bounded(res.ruleset, rules, 3, &options, 0, results, &failed);
+    if (err != LL_ERROR_TIMEOUT || failed != 1 || results[0] != LL_ERROR_OK || results[1] != LL_ERROR_TIMEOUT ||
+        results[2] != LL_ERROR_OK)
+    {
+        fail("a stalled path should be skipped while the others are added");
+    }
+    /* Releases the abandoned thread, which closes the read end and its descriptor. */
+    close(stall[1]);
+    ll_ruleset_close(res.ruleset);
+}
+
+static void test_trim_dir_only(void)
+{
+    ll_ruleset_attr_t attr = ll_ruleset_attr_create(LL_ABI_LATEST, LL_ABI_COMPAT_BEST_EFFORT);
+    attr = ll_ruleset_attr_fs(attr, LANDLOCK_ACCESS_FS_READ_FILE | LANDLOCK_ACCESS_FS_READ_DIR |
+                                        LANDLOCK_ACCESS_FS_MAKE_REG);
+    ll_ruleset_result_t res = ll_ruleset_create_result(attr);
+    if (LL_ERRORED(res.err))
+    {
+        return;
+    }
+    char file[] = "/tmp/liblandlock-trim-XXXXXX";
+    const int fd = mkstemp(file);
+    if (fd < 0)
+    {
+        fail("failed to create temporary file");
+        ll_ruleset_close(res.ruleset);
+        return;
+    }
+    close(fd);
+
+    const __u64 dir_rights = LANDLOCK_ACCESS_FS_READ_DIR | LANDLOCK_ACCESS_FS_MAKE_REG;
+    const __u64 all = LANDLOCK_ACCESS_FS_READ_FILE | dir_rights;
+    if (!LL_ERRORED(ll_ruleset_add_path(res.ruleset, file, all, 0)) ||
+        ll_ruleset_add_path(res.ruleset, file, all, LL_ADD_RULE_TRIM_DIR_ONLY) != LL_ERROR_OK)
+    {
+        fail("directory-only rights should be trimmed on files only when asked");
+    }
+
+    const ll_path_rule_t rules[] = {
+        {file, all},
+        {"/tmp", all},
+        {file, LANDLOCK_ACCESS_FS_READ_DIR},
+    };
+    __u64 trimmed[3] = {1, 1, 1};
+    if (ll_ruleset_add_paths_trimmed(res.ruleset, rules, 3, 0, trimmed, NULL) != LL_ERROR_OK ||
+        trimmed[0] != dir_rights || trimmed[1] != 0 || trimmed[2] != LANDLOCK_ACCESS_FS_READ_DIR)
+    {
+        fail("trimmed rights should be reported per rule");
+    }
+    unlink(file);
+    ll_ruleset_close(res.ruleset);
+}
+
+static void test_policy_cache(void)
+{
+    char dir[] = "/tmp/liblandlock-cache-XXXXXX";
+    if (!mkdtemp(dir))
+    {
+        fail("failed to create temporary directory");
+        return;
+    }
+    char file[sizeof(dir) + 8];
+    char cache[sizeof(dir) + 8];
+    snprintf(file, sizeof(file), "%s/data", dir);
+    snprintf(cache, sizeof(cache), "%s/cache", dir);
+    const int fd = open(file, O_CREAT | O_WRONLY | O_CLOEXEC, 0600);
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+
+    const __u64 read = LANDLOCK_ACCESS_FS_READ_FILE | LANDLOCK_ACCESS_FS_READ_DIR;
+    ll_policy_t *policy = NULL;
+    ll_policy_t *reordered = NULL;
+    __u64 fingerprint = 0;
+    __u64 other = 1;
+    if (ll_policy_create(&policy) != LL_ERROR_OK || ll_policy_create(&reordered) != LL_ERROR_OK ||
+        ll_policy_handle(policy, read, 0, 0) != LL_ERROR_OK || ll_policy_handle(reordered, read, 0, 0) != LL_ERROR_OK ||
+        ll_policy_add_path(policy, dir, read) != LL_ERROR_OK || ll_policy_add_path(policy, file, read) != LL_ERROR_OK ||
+        ll_policy_add_path(reordered, file, read) != LL_ERROR_OK ||
+        ll_policy_add_path(reordered, dir, read) != LL_ERROR_OK)
+    {
+        fail("policy setup failed");
+    }
+    const ll_ruleset_attr_t attr = ll_ruleset_attr_create(LL_ABI_LATEST, LL_ABI_COMPAT_BEST_EFFORT);
+    if (ll_policy_fingerprint(policy, attr, &fingerprint) == LL_ERROR_OK)
+    {
+        if (ll_policy_fingerprint(reordered, attr, &other) != LL_ERROR_OK || other != fingerprint)
+        {
+            fail("fingerprint should not depend on rule order");
+        }
+        if (ll_policy_add_path(reordered, "/usr", read) != LL_ERROR_OK ||
+            ll_policy_fingerprint(reordered, attr, &other) != LL_ERROR_OK || other == fingerprint)
+        {
+            fail("fingerprint should change with the rules");
+        }
+
+        const ll_policy_cache_status_t expected[] = {LL_POLICY_CACHE_MISS, LL_POLICY_CACHE_HIT,
+                                                     LL_POLICY_CACHE_STALE, LL_POLICY_CACHE_HIT};
+        for (size_t i = 0; i < 4; i++)
+        {
+            if (i == 2)
+            {
+                const struct timespec times[2] = {{1000, 0}, {1000, 0}};
+                utimensat(AT_FDCWD, file, times, 0);
+            }
+            ll_policy_cache_status_t status = LL_POLICY_CACHE_MISS;
+            ll_ruleset_result_t res = ll_policy_create_ruleset_cached(policy, attr, cache, &status);
+            if (LL_ERRORED(res.err) || status != expected[i])
+            {
+                fail("cached policy resolution should miss, hit, go stale and hit again");
+            }
+            ll_ruleset_close(res.ruleset);
+        }
+        /* Widen the cached rule for the file: its access mask opens the 56-byte entry before the path. */
+        size_t len = 0;
+        char *data = NULL;
+        FILE *stream = fopen(cache, "rb");
+        if (stream)
+        {
+            data = malloc(4096);
+            len = data ? fread(data, 1, 4096, stream) : 0;
+            fclose(stream);
+        }
+        char *path = NULL;
+        for (size_t i = 0; data && !path && i + strlen(file) <= len; i++)
+        {
+            path = memcmp(data + i, file, strlen(file)) == 0 ? data + i : NULL;
+        }
+        if (!path || path - data < 56)
+        {
+            fail("cached rule not found");
+        }
+        else
+        {
+            __u64 access = 0;
+            memcpy(&access, path - 56, sizeof(access));
+            access |= LANDLOCK_ACCESS_FS_WRITE_FILE;
+            memcpy(path - 56, &access, sizeof(access));
+            stream = fopen(cache, "wb");
+            if (!stream || fwrite(data, 1, len, stream) != len)
+            {
+                fail("failed to rewrite cache");
+            }
+            if (stream)
+            {
+                fclose(stream);
+            }
+        }
+        free(data);
+        ll_policy_cache_status_t status = LL_POLICY_CACHE_HIT;
+        ll_ruleset_result_t res = ll_policy_create_ruleset_cached(policy, attr, cache, &status);
+        if (LL_ERRORED(res.err) || status != LL_POLICY_CACHE_STALE)
+        {
+            fail("a cached rule wider than the policy's should be refused");
+        }
+        ll_ruleset_close(res.ruleset);
+
+        status = LL_POLICY_CACHE_HIT;
+        res = ll_policy_create_ruleset_cached(policy, attr, cache, &status);
+        if (chmod(cache, 0666) < 0 || LL_ERRORED(res.err) || status != LL_POLICY_CACHE_HIT)
+        {
+            fail("a rewritten cache should hit");
+        }
+        ll_ruleset_close(res.ruleset);
+        res = ll_policy_create_ruleset_cached(policy, attr, cache, &status);
+        if (LL_ERRORED(res.err) || status != LL_POLICY_CACHE_STALE)
+        {
+            fail("a cache file writable by others should be ignored");
+        }
+        ll_ruleset_close(res.ruleset);
+
+        status = LL_POLICY_CACHE_HIT;
+        res = ll_policy_create_ruleset_cached(reordered, attr, cache, &status);
+        if (LL_ERRORED(res.err) || status != LL_POLICY_CACHE_STALE)
+        {
+            fail("another policy should resolve in full");
+        }
+        ll_ruleset_close(res.ruleset);
+    }
+    ll_policy_free(reordered);
+    ll_policy_free(policy);
+    unlink(cache);
+    unlink(file);
+    rmdir(dir);
+}
+
+static void test_fake_kernel(void)
+{
+    ll_fake_kernel_t *kernel = NULL;
+    if (ll_fake_kernel_create(1, &kernel) != LL_ERROR_OK)
+    {
+        fail("fake kernel should be created");
+        return;
+    }
+    ll_backend_set(ll_fake_kernel_backend(kernel));
+
+    ll_abi_t abi = 0;
+    int errata = 0;
+    if (ll_get_abi_version(&abi) != LL_ERROR_OK || abi != 1 || ll_get_errata(&errata) == LL_ERROR_OK)
+    {
+        fail("fake kernel should report ABI 1 without errata");
+    }
+
+    ll_ruleset_attr_t attr = ll_ruleset_attr_create(4, LL_ABI_COMPAT_BEST_EFFORT);
+    attr = ll_ruleset_attr_fs(attr, LANDLOCK_ACCESS_FS_READ_FILE | LANDLOCK_ACCESS_FS_READ_DIR |
+                                        LANDLOCK_ACCESS_FS_TRUNCATE);
+    attr = ll_ruleset_attr_net(attr, LANDLOCK_ACCESS_NET_CONNECT_TCP);
+    ll_ruleset_result_t res = ll_ruleset_create_result(attr);
+    ll_ruleset_info_t info;
+    if (LL_ERRORED(res.err) || ll_ruleset_info(res.ruleset, &info) < 0 ||
+        info.handled_access_fs != (LANDLOCK_ACCESS_FS_READ_FILE | LANDLOCK_ACCESS_FS_READ_DIR) ||
+        info.handled_access_net != 0)
+    {
+        fail("best-effort ruleset should be downgraded to ABI 1");
+    }
+    if (ll_ruleset_add_path(res.ruleset, "/etc/passwd", LANDLOCK_ACCESS_FS_READ_DIR, 0) !=
+            LL_ERROR_ADD_RULE_INCONSISTENT_ACCESS ||
+        ll_ruleset_add_path(res.ruleset, "/etc", LANDLOCK_ACCESS_FS_READ_DIR, 0) != LL_ERROR_OK ||
+        ll_ruleset_add_net_port(res.ruleset, 443, LANDLOCK_ACCESS_NET_CONNECT_TCP, 0) == LL_ERROR_OK)
+    {
+        fail("fake kernel should validate rules like ABI 1");
+    }
+    attr.compat_mode = LL_ABI_COMPAT_STRICT;
+    if (ll_ruleset_create_result(attr).err != LL_ERROR_RULESET_INCOMPATIBLE)
+    {
+        fail("strict ABI 4 ruleset should be rejected by ABI 1");
+    }
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        for (int i = 0; i < 64; i++)
+        {
+            if (ll_ruleset_enforce(res.ruleset, 0) != LL_ERROR_OK)
+            {
+                _exit(1);
+            }
+        }
+        _exit(ll_ruleset_enforce(res.ruleset, 0) == LL_ERROR_RESTRICT_LIMIT_REACHED ? 0 : 2);
+    }
+    int status = 0;
+    if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        fail("fake kernel should stop at 64 layers");
+    }
+
+    ll_fake_kernel_stats_t stats;
+    ll_fake_kernel_stats(kernel, &stats);
+    if (stats.rules != 1 || stats.layers != 0 || stats.add_rule_calls != 3)
+    {
+        fail("fake kernel counters are off");
+    }
+    ll_ruleset_close(res.ruleset);
+    ll_backend_set(NULL);
+    ll_fake_kernel_free(kernel);
+}
+
+static void test_enforce_stack_partial(void)
+{
+    ll_fake_kernel_t *kernel = NULL;
+    if (ll_fake_kernel_create(1, &kernel) != LL_ERROR_OK)
+    {
+        fail("fake kernel should be created");
+        return;
+    }
+    ll_backend_set(ll_fake_kernel_backend(kernel));
+
+    /* The scope keeps the merge inexact; only the first layer loses access rights on ABI 1. */
+    ll_policy_t *first = NULL;
+    ll_policy_t *second = NULL;
+    if (ll_policy_create(&first) != LL_ERROR_OK || ll_policy_create(&second) != LL_ERROR_OK ||
+        ll_policy_handle(first, LANDLOCK_ACCESS_FS_READ_FILE, 0, LANDLOCK_SCOPE_SIGNAL) != LL_ERROR_OK ||
+        ll_policy_handle(second, LANDLOCK_ACCESS_FS_READ_FILE, 0, 0) != LL_ERROR_OK)
+    {
+        fail("stack policies should be created");
+    }
+    const ll_policy_t *const steps[] = {first, second};
+    unsigned int layers = 0;
+    const ll_error_t err = ll_policy_enforce_stack(
+        steps, 2, ll_ruleset_attr_create(LL_ABI_LATEST, LL_ABI_COMPAT_BEST_EFFORT), 0, &layers);
+    if (err != LL_ERROR_OK_PARTIAL_SANDBOX || layers != 2)
+    {
+        fail("a partial layer below a complete one should make the stack partial");
+    }
+    ll_policy_free(first);
+    ll_policy_free(second);
+    ll_backend_set(NULL);
+    ll_fake_kernel_free(kernel);
+}
+
+static void test_probe_run(void)
+{
+    ll_ruleset_attr_t attr = ll_ruleset_attr_create(LL_ABI_LATEST, LL_ABI_COMPAT_BEST_EFFORT);
+    attr = ll_ruleset_attr_fs(attr, LANDLOCK_ACCESS_FS_READ_FILE);
+    ll_ruleset_result_t res = ll_ruleset_create_result(attr);
+    if (LL_ERRORED(res.err))
+    {
+        return;
+    }
+    char dir[] = "/tmp/liblandlock-probe-XXXXXX";
+    if (!mkdtemp(dir))
+    {
+        fail("failed to create temporary directory");
+        ll_ruleset_close(res.ruleset);
+        return;
+    }
+    char allowed[sizeof(dir) + 8];
+    char denied[sizeof(dir) + 8];
+    snprintf(allowed, sizeof(allowed), "%s/a", dir);
+    snprintf(denied, sizeof(denied), "%s/b", dir);
+    const int fd_a = open(allowed, O_CREAT | O_WRONLY | O_CLOEXEC, 0600);
+    const int fd_b = open(denied, O_CREAT | O_WRONLY | O_CLOEXEC, 0600);
+    if (fd_a >= 0)
+    {
+        close(fd_a);
+    }
+    if (fd_b >= 0)
+    {
+        close(fd_b);
+    }
+
+    const ll_probe_t probes[] = {
+        {.op = LL_PROBE_READ, .target = allowed, .expect_allowed = 1},
+        {.op = LL_PROBE_READ, .target = denied, .expect_allowed = 0},
+        {.op = LL_PROBE_READ, .target = denied, .expect_allowed = 1},
+    };
+    ll_probe_result_t results[3];
+    size_t failed = 0;
+    if (ll_ruleset_add_path(res.ruleset, allowed, LANDLOCK_ACCESS_FS_READ_FILE, 0) != LL_ERROR_OK ||
+        ll_probe_run(res.ruleset, 0, probes, 3, 2, results, &failed) != LL_ERROR_OK)
+    {
+        fail("probes should run");
+    }
+    else if (results[0].outcome != LL_PROBE_ALLOWED || results[1].outcome != LL_PROBE_DENIED ||
+             !results[0].passed || !results[1].passed || results[2].passed || failed != 1)
+    {
+        fail("probe outcomes should reflect the ruleset");
+    }
+    if (ll_probe_run(NULL, 0, probes, 3, 0, results, NULL) != LL_ERROR_INVALID_ARGUMENT)
+    {
+        fail("probing without a ruleset should be rejected");
+    }
+    unlink(allowed);
+    unlink(denied);
+    rmdir(dir);
+    ll_ruleset_close(res.ruleset);
+}
+
+static int write_text_file(const char *const path, const char *const text)
+{
+    FILE *const file = fopen(path, "w");
+    if (!file)
+    {
+        return -1;
+    }
+    const int ok = fputs(text, file) >= 0;
+    return fclose(file) == 0 && ok ? 0 : -1;
+}
+
+static void test_policy_watch(void)
+{
+    char dir[] = "/tmp/liblandlock-watch-XXXXXX";
+    if (!mkdtemp(dir))
+    {
+        fail("failed to create temporary directory");
+        return;
+    }
+    char policy_path[sizeof(dir) + 16];
+    char tmp_path[sizeof(dir) + 16];
+    char text[512];
+    snprintf(policy_path, sizeof(policy_path), "%s/policy", dir);
+    snprintf(tmp_path, sizeof(tmp_path), "%s/policy.tmp", dir);
+    snprintf(text, sizeof(text), "handle fs.read_file\npath fs.read_file %s\n", policy_path);
+    if (write_text_file(policy_path, text) < 0)
+    {
+        fail("failed to write policy");
+        rmdir(dir);
+        return;
+    }
+
+    const char *const paths[] = {policy_path};
+    ll_policy_watch_t *watch = NULL;
+    ll_ruleset_attr_t attr = ll_ruleset_attr_create(LL_ABI_LATEST, LL_ABI_COMPAT_BEST_EFFORT);
+    if (ll_policy_watch_create(paths, 1, attr, &watch, NULL) != LL_ERROR_OK)
+    {
+        unlink(policy_path);
+        rmdir(dir);
+        return;
+    }
+    unsigned long token = 0;
+    const ll_ruleset_t *const first = ll_policy_watch_pin(watch, &token);
+    int reloaded = 1;
+    if (!first || ll_policy_watch_generation(watch) != 1 ||
+        ll_policy_watch_process(watch, 0, &reloaded, NULL) != LL_ERROR_OK || reloaded)
+    {
+        fail("a new watch should publish one ruleset and see no changes");
+    }
+
+    /* Replace the policy by renaming, as editors do, to allow the temporary file instead. */
+    snprintf(text, sizeof(text), "handle fs.read_file\npath fs.read_file %s\n", tmp_path);
+    if (write_text_file(tmp_path, text) < 0 || rename(tmp_path, policy_path) < 0 ||
+        write_text_file(tmp_path, "") < 0 ||
+        ll_policy_watch_process(watch, 1000, &reloaded, NULL) != LL_ERROR_OK || !reloaded ||
+        ll_policy_watch_generation(watch) != 2)
+    {
+        fail("a renamed policy file should be reloaded");
+    }
+    ll_policy_watch_unpin(watch, token);
+
+    size_t line = 0;
+    if (write_text_file(policy_path, "bogus\n") < 0 ||
+        ll_policy_watch_process(watch, 1000, &reloaded, &line) != LL_ERROR_POLICY_SYNTAX || reloaded ||
+        line != 1 || ll_policy_watch_generation(watch) != 2)
+    {
+        fail("a broken policy should keep the previous ruleset");
+    }
+
+    int pid = -1;
+    const ll_error_t err = ll_policy_watch_fork(watch, 0, &pid);
+    if (pid == 0)
+    {
+        const int allowed = open(tmp_path, O_RDONLY | O_CLOEXEC);
+        const int denied = open(policy_path, O_RDONLY | O_CLOEXEC);
+        _exit(err == LL_ERROR_OK && allowed >= 0 && denied < 0 && errno == EACCES ? 0 : 1);
+    }
+    int status = 0;
+    if (err != LL_ERROR_OK || pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+        WEXITSTATUS(status) != 0)
+    {
+        fail("forked workers should enforce the newest ruleset");
+    }
+
+    ll_policy_watch_free(watch);
+    unlink(tmp_path);
+    unlink(policy_path);
+    rmdir(dir);
+}
+
+static void test_ruleset_build(void)
+{
+    const ll_ruleset_attr_t attr = ll_ruleset_attr_create(LL_ABI_LATEST, LL_ABI_COMPAT_BEST_EFFORT);
+    ll_ruleset_result_t res = ll_ruleset_create_result(ll_ruleset_attr_fs(attr, LANDLOCK_ACCESS_FS_READ_FILE));
+    if (LL_ERRORED(res.err))
+    {
+        return;
+    }
+    ll_ruleset_close(res.ruleset);
+
+    ll_policy_t *policy = NULL;
+    if (ll_policy_create(&policy) != LL_ERROR_OK)
+    {
+        fail("policy should be created");
+        return;
+    }
+    if (ll_policy_handle(policy, LANDLOCK_ACCESS_FS_READ_FILE | LANDLOCK_ACCESS_FS_READ_DIR, 0, 0) != LL_ERROR_OK ||
+        ll_policy_add_path(policy, "/usr", LANDLOCK_ACCESS_FS_READ_FILE | LANDLOCK_ACCESS_FS_READ_DIR) !=
+            LL_ERROR_OK ||
+        ll_policy_add_path(policy, "/nonexistent/liblandlock", LANDLOCK_ACCESS_FS_READ_FILE) != LL_ERROR_OK)
+    {
+        fail("policy rules should be added");
+        ll_policy_free(policy);
+        return;
+    }
+
+    ll_ruleset_build_t *build = NULL;
+    if (ll_ruleset_build_start(policy, attr, &build) != LL_ERROR_OK)
+    {
+        fail("build should start");
+        ll_policy_free(policy);
+        return;
+    }
+    /* The build works on a copy. */
+    ll_policy_free(policy);
+
+    struct pollfd pfd = {.fd = ll_ruleset_build_fd(build), .events = POLLIN};
+    size_t failed = 0;
+    if (poll(&pfd, 1, 5000) != 1 || !ll_ruleset_build_done(build))
+    {
+        fail("build eventfd should become readable");
+    }
+    res = ll_ruleset_build_collect(build, &failed);
+    if (res.err == LL_ERROR_OK || res.ruleset || failed != 1)
+    {
+        fail("a missing path should fail the build at its index");
+    }
+    if (ll_ruleset_build_collect(build, NULL).err != LL_ERROR_INVALID_ARGUMENT)
+    {
+        fail("a build should only be collected once");
+    }
+    ll_ruleset_build_free(build);
+
+    if (ll_policy_create(&policy) != LL_ERROR_OK ||
+        ll_policy_handle(policy, LANDLOCK_ACCESS_FS_READ_FILE, 0, 0) != LL_ERROR_OK ||
+        ll_policy_add_path(policy, "/usr", LANDLOCK_ACCESS_FS_READ_FILE) != LL_ERROR_OK ||
+        ll_ruleset_build_start(policy, attr, &build) != LL_ERROR_OK)
+    {
+        fail("second build should start");
+        ll_policy_free(policy);
+        return;
+    }
+    ll_policy_free(policy);
+    ll_ruleset_build_cancel(build);
+    res = ll_ruleset_build_collect(build, NULL);
+    if (res.err == LL_ERROR_OK)
+    {
+        ll_ruleset_close(res.ruleset);
+    }
+    else if (res.err != LL_ERROR_CANCELED || res.ruleset)
+    {
+        fail("a cancelled build should finish without a ruleset");
+    }
+    ll_ruleset_build_free(build);
+
+    /* Freeing a running build leaves the cleanup to its worker. */
+    if (ll_policy_create(&policy) == LL_ERROR_OK &&
+        ll_policy_handle(policy, LANDLOCK_ACCESS_FS_READ_FILE, 0, 0) == LL_ERROR_OK &&
+        ll_ruleset_build_start(policy, attr, &build) == LL_ERROR_OK)
+    {
+        ll_ruleset_build_free(build);
+    }
+    ll_policy_free(policy);
+
+    /* A downgrade at creation survives the rest of the build. */
+    ll_fake_kernel_t *kernel = NULL;
+    if (ll_fake_kernel_create(1, &kernel) != LL_ERROR_OK)
+    {
+        fail("fake kernel should be created");
+        return;
+    }
+    ll_backend_set(ll_fake_kernel_backend(kernel));
+    policy = NULL;
+    build = NULL;
+    if (ll_policy_create(&policy) != LL_ERROR_OK ||
+        ll_policy_handle(policy, LANDLOCK_ACCESS_FS_READ_FILE | LANDLOCK_ACCESS_FS_TRUNCATE, 0, 0) != LL_ERROR_OK ||
+        ll_policy_add_path(policy, "/usr", LANDLOCK_ACCESS_FS_READ_FILE) != LL_ERROR_OK ||
+        ll_ruleset_build_start(policy, attr, &build) != LL_ERROR_OK)
+    {
+        fail("downgraded build should start");
+    }
+    else
+    {
+        res = ll_ruleset_build_collect(build, NULL);
+        if (res.err != LL_ERROR_OK_PARTIAL_SANDBOX || !res.ruleset)
+        {
+            fail("a downgraded build should report a partial sandbox");
+        }
+        ll_ruleset_close(res.ruleset);
+    }
+    ll_ruleset_build_free(build);
+    ll_policy_free(policy);
+    ll_backend_set(NULL);
+    ll_fake_kernel_free(kernel);
+}
+
+static void test_syscall_filter(void)
+{
+    ll_syscall_filter_t *filter = NULL;
+    if (ll_syscall_filter_create(SECCOMP_RET_ALLOW, &filter) != LL_ERROR_OK)
+    {
+        fail("syscall filter should be created");
+        return;
+    }
+    /* Alternate denied and unlisted numbers past the real syscalls to force a deep tree. */
+    ll_error_t err = ll_syscall_filter_add(filter, SYS_getppid, SECCOMP_RET_ERRNO | EXDEV);
+    for (int i = 0; i < 600 && !LL_ERRORED(err); i++)
+    {
+        err = ll_syscall_filter_add(filter, 5000 + 2 * i, SECCOMP_RET_ERRNO | EXDEV);
+    }
+    struct sock_filter *program = NULL;
+    size_t len = 0;
+    if (LL_ERRORED(err) || ll_syscall_filter_add(filter, -1, SECCOMP_RET_ALLOW) != LL_ERROR_INVALID_ARGUMENT ||
+        ll_syscall_filter_compile(filter, NULL, &program, &len) != LL_ERROR_OK || len < 1200)
+    {
+        fail("syscall filter should compile to a search tree");
+    }
+    free(program);
+
+    const pid_t pid = fork();
+    if (pid == 0)
+    {
+        int ok = ll_syscall_filter_install(filter, NULL) == LL_ERROR_OK;
+        errno = 0;
+        ok = ok && syscall(SYS_getppid) == -1 && errno == EXDEV;
+        errno = 0;
+        ok = ok && syscall(5000 + 2 * 300) == -1 && errno == EXDEV;
+        errno = 0;
+        ok = ok && syscall(5000 + 2 * 300 + 1) == -1 && errno == ENOSYS;
+        errno = 0;
+        ok = ok && syscall(5000 + 2 * 599 + 1) == -1 && errno == ENOSYS;
+        _exit(ok ? 0 : 1);
+    }
+    int status = 0;
+    if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        fail("installed syscall filter should dispatch by syscall number");
+    }
+
+    ll_syscall_filter_free(filter);
+
+    /*
+     * With a ruleset handling directory creation, unlisted mkdir() calls are
+     * left to Landlock while an explicit entry still applies; ftruncate() is
+     * never left to Landlock.
+     */
+    ll_ruleset_attr_t attr = ll_ruleset_attr_create(LL_ABI_LATEST, LL_ABI_COMPAT_BEST_EFFORT);
+    ll_ruleset_result_t res = ll_ruleset_create_result(
+        ll_ruleset_attr_fs(attr, LANDLOCK_ACCESS_FS_MAKE_DIR | LANDLOCK_ACCESS_FS_TRUNCATE));
+    char dir[] = "/tmp/liblandlock-seccomp-XXXXXX";
+    if (LL_ERRORED(res.err) || !mkdtemp(dir))
+    {
+        ll_ruleset_close(res.ruleset);
+        return;
+    }
+    char sub[sizeof(dir) + 4];
+    snprintf(sub, sizeof(sub), "%s/d", dir);
+    filter = NULL;
+    err = ll_syscall_filter_create(SECCOMP_RET_ERRNO | EXDEV, &filter);
+    err = LL_ERRORED(err) ? err : ll_syscall_filter_add(filter, SYS_exit_group, SECCOMP_RET_ALLOW);
+    err = LL_ERRORED(err) ? err : ll_syscall_filter_add(filter, SYS_exit, SECCOMP_RET_ALLOW);
+#ifdef SYS_mkdir
+    err = LL_ERRORED(err) ? err : ll_syscall_filter_add(filter, SYS_mkdirat, SECCOMP_RET_ERRNO | EPERM);
+#endif
+    if (LL_ERRORED(err) || ll_ruleset_add_path(res.ruleset, dir, LANDLOCK_ACCESS_FS_MAKE_DIR, 0) != LL_ERROR_OK)
+    {
+        fail("filter entries and rule should be added");
+    }
+    const pid_t child = fork();
+    if (child == 0)
+    {
+        int ok = ll_ruleset_enforce_filtered(res.ruleset, 0, filter) == LL_ERROR_OK;
+        errno = 0;
+        ok = ok && syscall(SYS_getppid) == -1 && errno == EXDEV;
+        errno = 0;
+        ok = ok && syscall(SYS_ftruncate, -1, 0) == -1 && errno == EXDEV;
+#ifdef SYS_mkdir
+        errno = 0;
+        ok = ok && syscall(SYS_mkdirat, AT_FDCWD, sub, 0700) == -1 && errno == EPERM;
+        ok = ok && syscall(SYS_mkdir, sub, 0700) == 0;
+        errno = 0;
+        ok = ok && syscall(SYS_mkdir, "/tmp/liblandlock-seccomp-denied", 0700) == -1 && errno == EACCES;
+#else
+        ok = ok && syscall(SYS_mkdirat, AT_FDCWD, sub, 0700) == 0;
+        errno = 0;
+        ok = ok && syscall(SYS_mkdirat, AT_FDCWD, "/tmp/liblandlock-seccomp-denied", 0700) == -1 && errno == EACCES;
+#endif
+        _exit(ok ? 0 : 1);
+    }
+    if (child < 0 || waitpid(child, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        fail("only unlisted syscalls governed by the ruleset should be excluded from the filter");
+    }
+    rmdir(sub);
+    rmdir(dir);
+    ll_ruleset_close(res.ruleset);
+    ll_syscall_filter_free(filter);
+}
+
+static void test_profiles(void)
+{
+    size_t count = 0;
+    if (ll_profile_from_name("python") != LL_PROFILE_PYTHON || ll_profile_from_name("cobol") != 0 ||
+        !ll_profile_paths(LL_PROFILE_DYNAMIC_C, &count) || count == 0 ||
+        !ll_profile_ports(LL_PROFILE_TLS_CLIENT, &count) || count != 1 ||
+        ll_profile_paths((ll_profile_t)(1U << 20), &count) || count != 0)
+    {
+        fail("profile tables should be looked up by name and value");
+    }
+    if (access("/usr/bin/true", X_OK) != 0 || access("/etc/hosts", R_OK) != 0)
+    {
+        return;
+    }
+
+    const ll_ruleset_attr_t attr = ll_ruleset_attr_create(LL_ABI_LATEST, LL_ABI_COMPAT_BEST_EFFORT);
+    if (ll_profile_create_ruleset(1U << 20, attr, NULL, 0).err != LL_ERROR_INVALID_ARGUMENT)
+    {
+        fail("unknown profile bits should be rejected");
+    }
+    const ll_path_rule_t extra[] = {{"/usr/bin/true", LANDLOCK_ACCESS_FS_EXECUTE | LANDLOCK_ACCESS_FS_READ_FILE}};
+    ll_ruleset_result_t res = ll_profile_create_ruleset(LL_PROFILE_DYNAMIC_C | LL_PROFILE_DNS_RESOLVER, attr, extra, 1);
+    if (res.err == LL_ERROR_RULESET_CREATE_DISABLED || res.err == LL_ERROR_UNSUPPORTED_SYSCALL)
+    {
+        return;
+    }
+    if (res.err != LL_ERROR_OK)
+    {
+        fail("profiles should build a ruleset");
+        return;
+    }
+
+    const pid_t pid = fork();
+    if (pid == 0)
+    {
+        if (ll_ruleset_enforce(res.ruleset, 0) != LL_ERROR_OK)
+        {
+            _exit(1);
+        }
+        const int hosts = open("/etc/hosts", O_RDONLY | O_CLOEXEC);
+        errno = 0;
+        const int denied = open("/usr/bin/false", O_RDONLY | O_CLOEXEC);
+        if (hosts < 0 || denied >= 0 || errno != EACCES)
+        {
+            _exit(2);
+        }
+        /* A dynamically linked program starts with only the profile and its own rule. */
+        const pid_t exec_pid = fork();
+        if (exec_pid == 0)
+        {
+            execl("/usr/bin/true", "true", (char *)NULL);
+            _exit(127);
+        }
+        int exec_status = 0;
+        _exit(exec_pid > 0 && waitpid(exec_pid, &exec_status, 0) == exec_pid && WIFEXITED(exec_status) &&
+                      WEXITSTATUS(exec_status) == 0
+                  ? 0
+                  : 3);
+    }
+    int status = 0;
+    if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        fail("profiles should allow a dynamically linked program and deny the rest");
+    }
+    ll_ruleset_close(res.ruleset);
+}
+
+static void test_path_canonicalize(void)
+{
+    const ll_path_rule_t rules[] = {
+        {"/usr//lib/", LANDLOCK_ACCESS_FS_READ_FILE},
+        {"./a//b/", LANDLOCK_ACCESS_FS_EXECUTE},
+        {"/usr/lib/.", LANDLOCK_ACCESS_FS_WRITE_FILE},
+        {"//", LANDLOCK_ACCESS_FS_READ_DIR},
+        {"a/../b", LANDLOCK_ACCESS_FS_READ_FILE},
+        {"./", LANDLOCK_ACCESS_FS_READ_FILE},
+        {"/", LANDLOCK_ACCESS_FS_READ_FILE},
+        {"/a-fairly-long//component/./crossing/sixteen-byte/blocks/", LANDLOCK_ACCESS_FS_READ_FILE},
+        {"/a-fairly-long/component/crossing/sixteen-byte/blocks", LANDLOCK_ACCESS_FS_WRITE_FILE},
+    };
+    ll_path_rule_t *out = NULL;
+    size_t count = 0;
+    if (ll_path_rules_canonicalize(rules, sizeof(rules) / sizeof(rules[0]), &out, &count) != LL_ERROR_OK ||
+        count != 6)
+    {
+        fail("canonical duplicates should be merged");
+        free(out);
+        return;
+    }
+    const char *const expected[] = {"/usr/lib", "a/b", "/", "a/../b", ".",
+                                    "/a-fairly-long/component/crossing/sixteen-byte/blocks"};
+    const __u64 expected_access[] = {LANDLOCK_ACCESS_FS_READ_FILE | LANDLOCK_ACCESS_FS_WRITE_FILE,
+                                     LANDLOCK_ACCESS_FS_EXECUTE,
+                                     LANDLOCK_ACCESS_FS_READ_DIR | LANDLOCK_ACCESS_FS_READ_FILE,
+                                     LANDLOCK_ACCESS_FS_READ_FILE,
+                                     LANDLOCK_ACCESS_FS_READ_FILE,
+                                     LANDLOCK_ACCESS_FS_READ_FILE | LANDLOCK_ACCESS_FS_WRITE_FILE};
+    for (size_t i = 0; i < count; i++)
+    {
+        if (strcmp(out[i].path, expected[i]) != 0 || out[i].access != expected_access[i])
+        {
+            fail("paths should be canonicalised in first-occurrence order");
+            break;
+        }
+    }
+    free(out);
+
+    /* Enough rules to grow the table. */
+    const size_t many = 20000;
+    ll_path_rule_t *big = malloc(many * sizeof(*big));
+    char *names = malloc(many * 32);
+    if (!big || !names)
+    {
+        fail("allocation failed");
+        free(big);
+        free(names);
+        return;
+    }
+    for (size_t i = 0; i < many; i++)
+    {
+        snprintf(names + i * 32, 32, "/srv//data/%zu/", i % 5000);
+        big[i].path = names + i * 32;
+        big[i].access = 1ULL << (i % 3);
+    }
+    if (ll_path_rules_canonicalize(big, many, &out, &count) != LL_ERROR_OK || count != 5000 ||
+        strcmp(out[4999].path, "/srv/data/4999") != 0 || out[0].access != 7 ||
+        ll_path_rules_canonicalize(NULL, 1, &out, &count) != LL_ERROR_INVALID_ARGUMENT)
+    {
+        fail("large rule lists should be deduplicated");
+    }
+    free(out);
+    free(big);
+    free(names);
+}
+
+static void test_manifest_stream(void)
+{
+    ll_ruleset_attr_t attr = ll_ruleset_attr_create(LL_ABI_LATEST, LL_ABI_COMPAT_BEST_EFFORT);
+    attr = ll_ruleset_attr_fs(attr, LANDLOCK_ACCESS_FS_READ_FILE);
+    ll_ruleset_result_t res = ll_ruleset_create_result(attr);
+    if (res.err != LL_ERROR_OK)
+    {
+        return;
+    }
+
+    /* Written up front into a pipe, and read back in chunks shorter than a line. */
+    int fds[2];
+    if (pipe(fds) < 0)
+    {
+        fail("pipe failed");
+        ll_ruleset_close(res.ruleset);
+        return;
+    }
+    const char *const head = "# comment\n\n/etc//hosts\r\n/nonexistent/manifest-entry\n";
+    int written = write(fds[1], head, strlen(head)) == (ssize_t)strlen(head);
+    for (int i = 0; i < 1000 && written; i++)
+    {
+        written = write(fds[1], "/usr/lib/./\n", 12) == 12;
+    }
+    written = written && write(fds[1], "/etc/hostname", 13) == 13;
+    close(fds[1]);
+
+    ll_manifest_options_t options = ll_manifest_options_defaults();
+    options.chunk_size = 7;
+    options.max_inflight = 2;
+    ll_manifest_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+    if (!written ||
+        ll_ruleset_add_manifest_fd(res.ruleset, fds[0], LANDLOCK_ACCESS_FS_READ_FILE, LL_ADD_RULE_SKIP_MISSING,
+                                   &options, &stats, NULL) != LL_ERROR_OK ||
+        stats.lines != 1005 || stats.skipped != 1 || stats.rules != (access("/etc/hostname", F_OK) == 0 ? 1002 : 1001) ||
+        stats.inflight_limit != 2 || stats.peak_inflight == 0 || stats.peak_inflight > 2 ||
+        stats.rules_per_second <= 0.0)
+    {
+        fail("a streamed manifest should add every listed path");
+    }
+    close(fds[0]);
+
+    /* Without LL_ADD_RULE_SKIP_MISSING the missing entry fails and is located. */
+    size_t line = 0;
+    if (ll_ruleset_add_manifest_buffer(res.ruleset, head, strlen(head), LANDLOCK_ACCESS_FS_READ_FILE, 0, NULL,
+                                       &stats, &line) == LL_ERROR_OK ||
+        line != 4 || stats.rules != 1)
+    {
+        fail("a missing manifest entry should fail at its line");
+    }
+    char *const long_line = malloc(PATH_MAX + 2);
+    if (long_line)
+    {
+        memset(long_line, 'a', PATH_MAX + 1);
+        long_line[0] = '/';
+        long_line[PATH_MAX + 1] = '\n';
+        if (ll_ruleset_add_manifest_buffer(res.ruleset, long_line, PATH_MAX + 2, LANDLOCK_ACCESS_FS_READ_FILE, 0,
+                                           NULL, NULL, &line) != LL_ERROR_INVALID_ARGUMENT ||
+            line != 1)
+        {
+            fail("overlong manifest lines should be rejected");
+        }
+        free(long_line);
+    }
+    /* Rights the ruleset does not handle are dropped, as ll_ruleset_add_paths does. */
+    const char *const hosts_line = "/etc/hosts\n";
+    if (ll_ruleset_add_manifest_buffer(res.ruleset, hosts_line, strlen(hosts_line),
+                                       LANDLOCK_ACCESS_FS_READ_FILE | LANDLOCK_ACCESS_FS_WRITE_FILE, 0, NULL, &stats,
+                                       NULL) != LL_ERROR_OK ||
+        stats.rules != 1)
+    {
+        fail("unhandled manifest rights should be dropped on a best-effort ruleset");
+    }
+
+    const pid_t pid = fork();
+    if (pid == 0)
+    {
+        if (ll_ruleset_enforce(res.ruleset, 0) != LL_ERROR_OK)
+        {
+            _exit(1);
+        }
+        const int hosts = open("/etc/hosts", O_RDONLY | O_CLOEXEC);
+        errno = 0;
+        const int denied = open("/etc/passwd", O_RDONLY | O_CLOEXEC);
+        _exit(hosts >= 0 && denied < 0 && errno == EACCES ? 0 : 2);
+    }
+    int status = 0;
+    if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        fail("a manifest-built ruleset should allow only the listed paths");
+    }
+    ll_ruleset_close(res.ruleset);
+}
+
+static void test_ruleset_derive(void)
+{
+    char dir[] = "/tmp/ll-journal-XXXXXX";
+    if (!mkdtemp(dir))
+    {
+        fail("failed to create temporary directory");
+        return;
+    }
+    char moved[sizeof(dir) + 8];
+    snprintf(moved, sizeof(moved), "%s.moved", dir);
+
+    ll_ruleset_attr_t attr = ll_ruleset_attr_create(LL_ABI_LATEST, LL_ABI_COMPAT_BEST_EFFORT);
+    attr = ll_ruleset_attr_fs(attr, LANDLOCK_ACCESS_FS_READ_FILE | LANDLOCK_ACCESS_FS_READ_DIR);
+    ll_ruleset_journal_t *journal = NULL;
+    if (LL_ERRORED(ll_ruleset_journal_create(attr, &journal)))
+    {
+        rmdir(dir);
+        return;
+    }
+    const ll_path_rule_t base[] = {
+        {"/etc/hosts", LANDLOCK_ACCESS_FS_READ_FILE | LANDLOCK_ACCESS_FS_READ_DIR},
+        {"/nonexistent/journal-entry", LANDLOCK_ACCESS_FS_READ_FILE},
+        {dir, LANDLOCK_ACCESS_FS_READ_DIR},
+    };
+    size_t failed = 0;
+    if (ll_ruleset_journal_add_paths(journal, base, 3, LL_ADD_RULE_SKIP_MISSING | LL_ADD_RULE_TRIM_DIR_ONLY,
+                                     &failed) != LL_ERROR_OK ||
+        !ll_ruleset_journal_base(journal) ||
+        ll_ruleset_journal_add_path(journal, "/nonexistent/journal-entry", LANDLOCK_ACCESS_FS_READ_FILE, 0) ==
+            LL_ERROR_OK)
+    {
+        fail("a journal should record the base rules");
+    }
+
+    /* Replaying uses the recorded descriptors, so the base directory may move away. */
+    const ll_path_rule_t delta[] = {{"/etc/passwd", LANDLOCK_ACCESS_FS_READ_FILE}};
+    const ll_path_rule_t bad_delta[] = {{"/etc/hosts", LANDLOCK_ACCESS_FS_READ_FILE},
+                                        {"/nonexistent/delta", LANDLOCK_ACCESS_FS_READ_FILE}};
+    ll_ruleset_result_t plain = ll_ruleset_derive(journal, NULL, 0, 0, NULL);
+    ll_ruleset_result_t res = {.err = LL_ERROR_INVALID_ARGUMENT, .ruleset = NULL};
+    if (rename(dir, moved) == 0)
+    {
+        res = ll_ruleset_derive(journal, delta, 1, 0, NULL);
+    }
+    const ll_ruleset_result_t bad = ll_ruleset_derive(journal, bad_delta, 2, 0, &failed);
+    ll_ruleset_journal_free(journal);
+    if (LL_ERRORED(plain.err) || LL_ERRORED(res.err) || !LL_ERRORED(bad.err) || bad.ruleset || failed != 1)
+    {
+        fail("rulesets should derive from a journal plus a delta");
+    }
+
+    for (int i = 0; i < 2 && !LL_ERRORED(plain.err) && !LL_ERRORED(res.err); i++)
+    {
+        const pid_t pid = fork();
+        if (pid == 0)
+        {
+            if (ll_ruleset_enforce(i == 0 ? plain.ruleset : res.ruleset, 0) != LL_ERROR_OK)
+            {
+                _exit(1);
+            }
+            const int hosts = open("/etc/hosts", O_RDONLY | O_CLOEXEC);
+            const int listed = open(moved, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            errno = 0;
+            const int passwd = open("/etc/passwd", O_RDONLY | O_CLOEXEC);
+            const int passwd_ok = i == 0 ? passwd < 0 && errno == EACCES : passwd >= 0;
+            _exit(hosts >= 0 && listed >= 0 && passwd_ok ? 0 : 2);
+        }
+        int status = 0;
+        if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            fail("derived rulesets should hold the base rules and their own delta");
+        }
+    }
+    ll_ruleset_close(plain.ruleset);
+    ll_ruleset_close(res.ruleset);
+    rmdir(moved);
+    rmdir(dir);
+}
+
+static void test_fd_cache(void)
+{
+    char dir[] = "/tmp/ll-fdcache-XXXXXX";
+    if (!mkdtemp(dir))
+    {
+        fail("failed to create temporary directory");
+        return;
+    }
+    char sub[3][sizeof(dir) + 4];
+    for (int i = 0; i < 3; i++)
+    {
+        snprintf(sub[i], sizeof(sub[i]), "%s/%c", dir, 'a' + i);
+        (void)mkdir(sub[i], 0700);
+    }
+    ll_ruleset_attr_t attr = ll_ruleset_attr_create(LL_ABI_LATEST, LL_ABI_COMPAT_BEST_EFFORT);
+    attr = ll_ruleset_attr_fs(attr, LANDLOCK_ACCESS_FS_READ_FILE | LANDLOCK_ACCESS_FS_READ_DIR);
+    ll_ruleset_result_t res = ll_ruleset_create_result(attr);
+    ll_fd_cache_options_t options = ll_fd_cache_options_defaults();
+    options.max_fds = 2;
+    if (res.err != LL_ERROR_OK || ll_fd_cache_enable(&options) != LL_ERROR_OK)
+    {
+        ll_ruleset_close(res.ruleset);
+        for (int i = 0; i < 3; i++)
+        {
+            rmdir(sub[i]);
+        }
+        rmdir(dir);
+        return;
+    }
+
+    ll_fd_cache_stats_t before;
+    ll_fd_cache_stats_t after;
+    ll_fd_cache_stats(&before);
+    const ll_path_rule_t rules[] = {
+        {sub[0], LANDLOCK_ACCESS_FS_READ_DIR},
+        {sub[1], LANDLOCK_ACCESS_FS_READ_DIR},
+        {sub[0], LANDLOCK_ACCESS_FS_READ_DIR},
+        {"/etc/hosts", LANDLOCK_ACCESS_FS_READ_FILE},
+        {sub[2], LANDLOCK_ACCESS_FS_READ_DIR},
+    };
+    size_t failed = 0;
+    if (ll_ruleset_add_path(res.ruleset, sub[0], LANDLOCK_ACCESS_FS_READ_DIR, 0) != LL_ERROR_OK ||
+        ll_ruleset_add_paths(res.ruleset, rules, 5, 0, &failed) != LL_ERROR_OK)
+    {
+        fail("cached paths should be added");
+    }
+    ll_fd_cache_stats(&after);
+    if (after.lookups - before.lookups != 6 || after.hits - before.hits != 2 ||
+        after.evictions - before.evictions != 1 || after.cached_fds != 2 || after.hit_rate <= 0.0)
+    {
+        fail("the cache should serve repeated directories within its budget");
+    }
+
+    /* A directory replaced under its path is opened afresh. */
+    before = after;
+    if (rmdir(sub[2]) < 0 || mkdir(sub[2], 0700) < 0 ||
+        ll_ruleset_add_path(res.ruleset, sub[2], LANDLOCK_ACCESS_FS_READ_DIR, 0) != LL_ERROR_OK ||
+        ll_ruleset_add_path(res.ruleset, sub[2], LANDLOCK_ACCESS_FS_READ_DIR, 0) != LL_ERROR_OK)
+    {
+        fail("a replaced directory should still be added");
+    }
+    ll_fd_cache_stats(&after);
+    if (after.stale - before.stale != 1 || after.hits - before.hits != 1)
+    {
+        fail("a replaced directory should invalidate its cache entry");
+    }
+
+    ll_fd_cache_disable();
+    ll_fd_cache_stats(&after);
+    if (after.cached_fds != 0 ||
+        ll_ruleset_add_path(res.ruleset, sub[1], LANDLOCK_ACCESS_FS_READ_DIR, 0) != LL_ERROR_OK)
+    {
+        fail("a disabled cache should hold no descriptors");
+    }
+    ll_ruleset_close(res.ruleset);
+    for (int i = 0; i < 3; i++)
+    {
+        rmdir(sub[i]);
+    }
+    rmdir(dir);
+}
+
 int main(void)
 {
     test_abi_version_query();
@@ -366,6 +2938,39 @@ int main(void)
     test_restrict_self_flags();
     test_create_ruleset_best_effort();
     test_ruleset_enforcement();
+    test_audit_reader_replay();
+    test_policy_parse_format();
+    test_learner_offline();
+    test_learner_collapse();
+    test_learner_run_exec();
+    test_evaluator_layers();
+    test_evaluator_push_policy_error();
+    test_portset_ranges();
+    test_portset_services_threads();
+    test_policy_merge_stack();
+    test_phases();
+    test_broker_socketpair();
+    test_broker_peer_check();
+    test_broker_connection_cache();
+    test_open_broker();
+    test_plugin_host();
+    test_elf_analyze();
+    test_mapped_files();
+    test_mount_plan();
+    test_add_paths_bounded();
+    test_trim_dir_only();
+    test_policy_cache();
+    test_fake_kernel();
+    test_enforce_stack_partial();
+    test_probe_run();
+    test_policy_watch();
+    test_ruleset_build();
+    test_syscall_filter();
+    test_profiles();
+    test_path_canonicalize();
+    test_manifest_stream();
+    test_ruleset_derive();
+    test_fd_cache();
 
     if (tests_failed == 0)
     {